@@ -0,0 +1,70 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Converts the text vocabulary (ORBvoc.txt) to the binary format, which System
+// memory-maps at startup. The MD5 of the text file is stored in the binary
+// header, so sessions saved with either file can be loaded with the other.
+
+#include<iostream>
+#include<chrono>
+
+#include <orbslam3/ORBVocabulary.h>
+#include <orbslam3/System.h>
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    if(argc != 3)
+    {
+        cerr << endl << "Usage: ./convert_vocabulary path_to_text_vocabulary path_to_binary_vocabulary" << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    ORB_SLAM3::ORBVocabulary vocabulary;
+    if(!vocabulary.loadFromTextFile(argv[1]))
+    {
+        cerr << "Failed to load the text vocabulary " << argv[1] << endl;
+        return 1;
+    }
+    auto end = chrono::steady_clock::now();
+    cout << "Text vocabulary loaded in " << chrono::duration<double>(end - start).count() << " s" << endl;
+
+    const string checksum = ORB_SLAM3::System::CalculateCheckSum(argv[1], ORB_SLAM3::System::TEXT_FILE);
+    if(!vocabulary.saveToBinaryFile(argv[2], checksum))
+    {
+        cerr << "Failed to write the binary vocabulary " << argv[2] << endl;
+        return 1;
+    }
+
+    // Read it back with the full payload check
+    ORB_SLAM3::ORBVocabulary binary;
+    start = chrono::steady_clock::now();
+    if(!binary.loadFromBinaryFile(argv[2], true) || binary.size() != vocabulary.size())
+    {
+        cerr << "Failed to read back the binary vocabulary " << argv[2] << endl;
+        return 1;
+    }
+    end = chrono::steady_clock::now();
+    cout << "Binary vocabulary loaded in " << chrono::duration<double>(end - start).count() << " s" << endl;
+
+    cout << "Wrote " << binary.size() << " words to " << argv[2] << " (checksum " << checksum << ")" << endl;
+
+    return 0;
+}
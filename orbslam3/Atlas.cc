@@ -16,10 +16,17 @@
 * If not, see <http://www.gnu.org/licenses/>.
 */
 
+// Standard
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
 // 3rdparty
 #include <glog/logging.h>
+#include <boost/serialization/string.hpp>
 // Local
 #include "orbslam3/Atlas.h"
+#include "orbslam3/KeyFrameDatabase.h"
 #include "orbslam3/Viewer.h"
 
 namespace ORB_SLAM3
@@ -72,11 +79,15 @@ void Atlas::CreateNewMap()
 
     mpCurrentMap = new Map(mnLastInitKFidMap);
     mpCurrentMap->SetCurrentMap();
+    mpCurrentMap->SetReclaimer(mpReclaimer);
     mspMaps.insert(mpCurrentMap);
 }
 
 void Atlas::ChangeMap(Map* pMap)
 {
+    // A map of a lazily loaded atlas is paged in before becoming the current one
+    LoadMap(pMap);
+
     std::unique_lock<std::mutex> lock(mMutexAtlas);
     LOG(INFO) << "Change to map with id: " << pMap->GetId();
     if(mpCurrentMap){
@@ -99,6 +110,14 @@ void Atlas::SetViewer(Viewer* pViewer)
     mHasViewer = true;
 }
 
+void Atlas::SetReclaimer(EpochReclaimer* pReclaimer)
+{
+    std::unique_lock<std::mutex> lock(mMutexAtlas);
+    mpReclaimer = pReclaimer;
+    for(Map* pMap : mspMaps)
+        pMap->SetReclaimer(pReclaimer);
+}
+
 void Atlas::AddKeyFrame(KeyFrame* pKF)
 {
     Map* pMapKF = pKF->GetMap();
@@ -299,6 +318,27 @@ bool Atlas::isImuInitialized()
 }
 
 void Atlas::PreSave()
+{
+    // Legacy archives hold every map in memory
+    for(auto pMi : GetAllMaps())
+        LoadMap(pMi);
+
+    {
+        std::unique_lock<std::mutex> lock(mMutexLazyLoad);
+        PrepareSave();
+    }
+
+    std::set<GeometricCamera*> spCams(mvpCameras.begin(), mvpCameras.end());
+    for(auto pMi : mvpBackupMaps)
+    {
+        if(!pMi || pMi->IsBad())
+            continue;
+
+        pMi->PreSave(spCams);
+    }
+}
+
+void Atlas::PrepareSave()
 {
     if(mpCurrentMap){
         if(!mspMaps.empty() && mnLastInitKFidMap < mpCurrentMap->GetMaxKFid())
@@ -312,25 +352,351 @@ void Atlas::PreSave()
             return elem1->GetId() < elem2->GetId();
         }
     };
+    mvpBackupMaps.clear();
     std::copy(mspMaps.begin(), mspMaps.end(), std::back_inserter(mvpBackupMaps));
     std::sort(mvpBackupMaps.begin(), mvpBackupMaps.end(), compFunctor());
 
-    std::set<GeometricCamera*> spCams(mvpCameras.begin(), mvpCameras.end());
     for(auto pMi : mvpBackupMaps)
     {
         if(!pMi || pMi->IsBad())
             continue;
 
-        if(pMi->GetAllKeyFrames().size() == 0) {
+        if(pMi->KeyFramesInMap() == 0 && !mmUnloadedMaps.count(pMi)) {
             // Empty map, erase before of save it.
             SetMapBad(pMi);
-            continue;
         }
-        pMi->PreSave(spCams);
     }
     RemoveBadMaps();
 }
 
+bool Atlas::Save(const std::string &filename, const std::string &strVocabularyName, const std::string &strVocabularyChecksum,
+                 const AtlasProgressCallback &progress)
+{
+    std::unique_lock<std::mutex> lockLazy(mMutexLazyLoad);
+    PrepareSave();
+
+    std::vector<Map*> vpMaps;
+    std::size_t nTotal = 0;
+    for(auto pMi : mvpBackupMaps)
+    {
+        if(!pMi || pMi->IsBad())
+            continue;
+
+        vpMaps.push_back(pMi);
+        nTotal += pMi->MapPointsInMap() + pMi->KeyFramesInMap();
+        auto it = mmUnloadedMaps.find(pMi);
+        if(it != mmUnloadedMaps.end())
+        {
+            for(const AtlasFileSection &section : it->second)
+            {
+                if(section.type == AtlasSection::kMapPoints || section.type == AtlasSection::kKeyFrames)
+                    nTotal += section.count;
+            }
+        }
+    }
+    mvpBackupMaps.clear();
+
+    // Written aside and renamed once complete, an existing file is never left half overwritten
+    const std::string tmpFilename = filename + ".tmp";
+    AtlasFileWriter writer(tmpFilename);
+    if(!writer.IsOpen())
+    {
+        LOG(ERROR) << "Failed to open " << tmpFilename;
+        return false;
+    }
+
+    bool bOk = writer.Write(AtlasSection::kAtlas, 0, vpMaps.size(), [&](boost::archive::binary_oarchive &ar) {
+        ar & strVocabularyName;
+        ar & strVocabularyChecksum;
+        serializeHeader(ar, mnLastInitKFidMap);
+    });
+
+    std::set<GeometricCamera*> spCams(mvpCameras.begin(), mvpCameras.end());
+    std::size_t nDone = 0;
+    const auto itemsSaved = [&](const std::size_t n)
+    {
+        // Bad KeyFrames and MapPoints are counted in the total but not saved
+        nDone = std::min(nDone + n, nTotal);
+        if(progress)
+            progress(nDone, nTotal);
+    };
+    for(auto pMi : vpMaps)
+    {
+        if(!bOk)
+            break;
+        auto it = mmUnloadedMaps.find(pMi);
+        if(it != mmUnloadedMaps.end())
+            bOk = CopyUnloadedMap(writer, it->second, itemsSaved);
+        else
+            bOk = pMi->Save(writer, spCams, itemsSaved);
+    }
+
+    if(!writer.Close() || !bOk || std::rename(tmpFilename.c_str(), filename.c_str()) != 0)
+    {
+        LOG(ERROR) << "Failed to save the atlas to " << filename;
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    if(progress)
+        progress(nTotal, nTotal);
+    return true;
+}
+
+bool Atlas::Load(const std::string &filename, std::string &strVocabularyName, std::string &strVocabularyChecksum,
+                 const AtlasProgressCallback &progress, const bool bLazy)
+{
+    std::unique_ptr<AtlasFileReader> pReader(new AtlasFileReader(filename));
+    const std::vector<AtlasFileSection> &vSections = pReader->Sections();
+    if(!pReader->IsOpen() || vSections.empty() || vSections[0].type != AtlasSection::kAtlas)
+    {
+        LOG(ERROR) << "Invalid atlas file " << filename;
+        return false;
+    }
+
+    bool bOk = pReader->Read(vSections[0], [&](boost::archive::binary_iarchive &ar) {
+        ar & strVocabularyName;
+        ar & strVocabularyChecksum;
+        serializeHeader(ar, mnLastInitKFidMap);
+    });
+    if(!bOk)
+        return false;
+
+    // Creating the maps below moves the map id counter which was just loaded
+    const long unsigned int nNextMapId = Map::nNextId;
+
+    std::map<std::uint32_t, std::vector<AtlasFileSection> > mvSectionsByMap;
+    for(std::size_t i = 1; i < vSections.size(); ++i)
+        mvSectionsByMap[vSections[i].map_id].push_back(vSections[i]);
+
+    // In lazy mode, only the headers of the maps with a BoW index are read
+    const auto isLazy = [bLazy](const std::vector<AtlasFileSection> &vMapSections)
+    {
+        return bLazy && std::any_of(vMapSections.begin(), vMapSections.end(), [](const AtlasFileSection &section) {
+            return section.type == AtlasSection::kBowIndex;
+        });
+    };
+
+    std::size_t nTotal = 0, nDone = 0;
+    for(const auto &mapSections : mvSectionsByMap)
+    {
+        if(isLazy(mapSections.second))
+            continue;
+        for(const AtlasFileSection &section : mapSections.second)
+        {
+            if(section.type == AtlasSection::kMapPoints || section.type == AtlasSection::kKeyFrames)
+                nTotal += section.count;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mMutexLazyLoad);
+    mvpBackupMaps.clear();
+    mmUnloadedMaps.clear();
+    for(const auto &mapSections : mvSectionsByMap)
+    {
+        if(!bOk)
+            break;
+
+        Map* pMap = new Map();
+        mvpBackupMaps.push_back(pMap);
+        const bool bUnloaded = isLazy(mapSections.second);
+        if(bUnloaded)
+            mmUnloadedMaps[pMap] = mapSections.second;
+
+        for(const AtlasFileSection &section : mapSections.second)
+        {
+            if(bUnloaded && section.type != AtlasSection::kMap)
+                continue;
+
+            bOk = pMap->Load(*pReader, section);
+            if(!bOk)
+                break;
+
+            if(section.count > 0 && (section.type == AtlasSection::kMapPoints || section.type == AtlasSection::kKeyFrames))
+            {
+                nDone += section.count;
+                if(progress)
+                    progress(nDone, nTotal);
+            }
+        }
+    }
+
+    Map::nNextId = nNextMapId;
+    if(bOk && !mmUnloadedMaps.empty())
+    {
+        LOG(INFO) << mmUnloadedMaps.size() << " of " << mvpBackupMaps.size() << " maps will be loaded on demand";
+        mpLazyReader = std::move(pReader);
+    }
+    return bOk;
+}
+
+bool Atlas::LoadMap(Map* pMap)
+{
+    bool bOk = true;
+    {
+        std::unique_lock<std::mutex> lock(mMutexLazyLoad);
+        auto it = mmUnloadedMaps.find(pMap);
+        if(it == mmUnloadedMaps.end())
+            return true;
+
+        const auto start = std::chrono::steady_clock::now();
+        for(const AtlasFileSection &section : it->second)
+        {
+            if(section.type != AtlasSection::kMapPoints && section.type != AtlasSection::kKeyFrames)
+                continue;
+
+            bOk = pMap->Load(*mpLazyReader, section);
+            if(!bOk)
+                break;
+        }
+        mmUnloadedMaps.erase(it);
+        mpKeyFrameDB->eraseUnloaded(pMap);
+
+        if(bOk)
+        {
+            std::map<unsigned int,GeometricCamera*> mpCams;
+            for(auto pCam : mvpCameras)
+                mpCams[pCam->id()] = pCam;
+            pMap->PostLoad(mpKeyFrameDB, mpORBVocabulary, mpCams);
+
+            const auto stop = std::chrono::steady_clock::now();
+            LOG(INFO) << "Map " << pMap->GetId() << " loaded on demand with " << pMap->KeyFramesInMap() << " KFs and "
+                      << pMap->MapPointsInMap() << " MPs in " << std::chrono::duration<double, std::milli>(stop - start).count() << " ms";
+        }
+    }
+
+    if(!bOk)
+    {
+        LOG(ERROR) << "Failed to load map " << pMap->GetId() << " on demand, it is discarded";
+        std::unique_lock<std::mutex> lock(mMutexAtlas);
+        SetMapBad(pMap);
+    }
+    return bOk;
+}
+
+bool Atlas::IsMapLoaded(Map* pMap)
+{
+    std::unique_lock<std::mutex> lock(mMutexLazyLoad);
+    return !mmUnloadedMaps.count(pMap);
+}
+
+bool Atlas::CopyUnloadedMap(AtlasFileWriter &writer, const std::vector<AtlasFileSection> &vSections, const std::function<void(std::size_t)> &itemsSaved)
+{
+    for(const AtlasFileSection &section : vSections)
+    {
+        if(!writer.Copy(*mpLazyReader, section))
+            return false;
+
+        if(section.type == AtlasSection::kMapPoints || section.type == AtlasSection::kKeyFrames)
+            itemsSaved(section.count);
+    }
+    return true;
+}
+
+bool Atlas::CaptureSnapshot(const std::string &filename, const std::string &strVocabularyName, const std::string &strVocabularyChecksum,
+                            Snapshot &snapshot)
+{
+    snapshot = Snapshot();
+    snapshot.strFilename = filename;
+    snapshot.pWriter.reset(new AtlasFileWriter(filename + ".tmp"));
+    if(!snapshot.pWriter->IsOpen())
+    {
+        LOG(ERROR) << "Failed to open " << filename << ".tmp";
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lockLazy(mMutexLazyLoad);
+    std::set<GeometricCamera*> spCams;
+    bool bOk;
+    {
+        std::unique_lock<std::mutex> lock(mMutexAtlas);
+        for(auto pMi : mspMaps)
+        {
+            if(pMi && !pMi->IsBad() && (pMi->KeyFramesInMap() > 0 || mmUnloadedMaps.count(pMi)))
+                snapshot.vpMaps.push_back(pMi);
+        }
+        std::sort(snapshot.vpMaps.begin(), snapshot.vpMaps.end(), [](Map* pM1, Map* pM2) {
+            return pM1->GetId() < pM2->GetId();
+        });
+        spCams.insert(mvpCameras.begin(), mvpCameras.end());
+
+        // Same rule as PrepareSave, without touching the running atlas
+        unsigned long int nLastInitKFidMap = mnLastInitKFidMap;
+        if(mpCurrentMap && !mspMaps.empty() && nLastInitKFidMap < mpCurrentMap->GetMaxKFid())
+            nLastInitKFidMap = mpCurrentMap->GetMaxKFid()+1;
+
+        bOk = snapshot.pWriter->Write(AtlasSection::kAtlas, 0, snapshot.vpMaps.size(), [&](boost::archive::binary_oarchive &ar) {
+            ar & strVocabularyName;
+            ar & strVocabularyChecksum;
+            serializeHeader(ar, nLastInitKFidMap);
+        });
+    }
+
+    snapshot.vvpMapPoints.resize(snapshot.vpMaps.size());
+    snapshot.vvpKeyFrames.resize(snapshot.vpMaps.size());
+    snapshot.vvUnloadedSections.resize(snapshot.vpMaps.size());
+    for(std::size_t i = 0; i < snapshot.vpMaps.size() && bOk; ++i)
+    {
+        auto it = mmUnloadedMaps.find(snapshot.vpMaps[i]);
+        if(it != mmUnloadedMaps.end())
+        {
+            snapshot.vvUnloadedSections[i] = it->second;
+            for(const AtlasFileSection &section : it->second)
+            {
+                if(section.type == AtlasSection::kMapPoints || section.type == AtlasSection::kKeyFrames)
+                    snapshot.nTotal += section.count;
+            }
+            continue;
+        }
+
+        bOk = snapshot.vpMaps[i]->CaptureSnapshot(*snapshot.pWriter, spCams, snapshot.vvpMapPoints[i], snapshot.vvpKeyFrames[i]);
+        snapshot.nTotal += snapshot.vvpMapPoints[i].size() + snapshot.vvpKeyFrames[i].size();
+    }
+
+    if(!bOk)
+    {
+        snapshot.pWriter.reset();
+        std::remove((filename + ".tmp").c_str());
+    }
+    return bOk;
+}
+
+bool Atlas::SaveSnapshot(Snapshot &snapshot, const AtlasProgressCallback &progress)
+{
+    if(!snapshot.pWriter)
+        return false;
+
+    std::size_t nDone = 0;
+    const auto itemsSaved = [&](const std::size_t n)
+    {
+        nDone += n;
+        if(progress)
+            progress(nDone, snapshot.nTotal);
+    };
+
+    bool bOk = true;
+    for(std::size_t i = 0; i < snapshot.vpMaps.size() && bOk; ++i)
+    {
+        if(!snapshot.vvUnloadedSections[i].empty())
+        {
+            std::unique_lock<std::mutex> lock(mMutexLazyLoad);
+            bOk = CopyUnloadedMap(*snapshot.pWriter, snapshot.vvUnloadedSections[i], itemsSaved);
+        }
+        else
+            bOk = snapshot.vpMaps[i]->SaveSnapshot(*snapshot.pWriter, snapshot.vvpMapPoints[i], snapshot.vvpKeyFrames[i], itemsSaved);
+    }
+
+    const std::string tmpFilename = snapshot.strFilename + ".tmp";
+    bOk = snapshot.pWriter->Close() && bOk;
+    snapshot.pWriter.reset();
+    if(!bOk || std::rename(tmpFilename.c_str(), snapshot.strFilename.c_str()) != 0)
+    {
+        LOG(ERROR) << "Failed to save the atlas snapshot to " << snapshot.strFilename;
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
 void Atlas::PostLoad()
 {
     std::map<unsigned int,GeometricCamera*> mpCams;
@@ -339,16 +705,33 @@ void Atlas::PostLoad()
         mpCams[pCam->id()] = pCam;
     }
 
+    std::unique_lock<std::mutex> lock(mMutexLazyLoad);
     mspMaps.clear();
     unsigned long int numKF = 0, numMP = 0;
     for(auto pMi : mvpBackupMaps)
     {
         mspMaps.insert(pMi);
+
+        // Maps loaded on demand only index the words of their KeyFrames
+        auto it = mmUnloadedMaps.find(pMi);
+        if(it != mmUnloadedMaps.end())
+        {
+            for(const AtlasFileSection &section : it->second)
+            {
+                if(section.type == AtlasSection::kBowIndex)
+                    pMi->LoadBowIndex(*mpLazyReader, section, mpKeyFrameDB);
+            }
+            continue;
+        }
+
         pMi->PostLoad(mpKeyFrameDB, mpORBVocabulary, mpCams);
-        numKF += pMi->GetAllKeyFrames().size();
-        numMP += pMi->GetAllMapPoints().size();
+        numKF += pMi->KeyFramesInMap();
+        numMP += pMi->MapPointsInMap();
     }
     mvpBackupMaps.clear();
+
+    if(!mmUnloadedMaps.empty())
+        mpKeyFrameDB->SetMapLoader([this](Map* pMap) { LoadMap(pMap); });
 }
 
 void Atlas::SetKeyFrameDababase(KeyFrameDatabase* pKFDB)
@@ -377,7 +760,7 @@ long unsigned int Atlas::GetNumLivedKF()
     long unsigned int num = 0;
     for(auto pMap_i : mspMaps)
     {
-        num += pMap_i->GetAllKeyFrames().size();
+        num += pMap_i->KeyFramesInMap();
     }
 
     return num;
@@ -387,7 +770,7 @@ long unsigned int Atlas::GetNumLivedMP() {
     std::unique_lock<std::mutex> lock(mMutexAtlas);
     long unsigned int num = 0;
     for (auto pMap_i : mspMaps) {
-        num += pMap_i->GetAllMapPoints().size();
+        num += pMap_i->MapPointsInMap();
     }
 
     return num;
@@ -20,12 +20,17 @@
 #define ATLAS_H
 
 // Standard
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <string>
 // 3rdparty
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/export.hpp>
 // Local
+#include "orbslam3/AtlasFile.h"
 #include "orbslam3/CameraModels/GeometricCamera.h"
 #include "orbslam3/CameraModels/KannalaBrandt8.h"
 #include "orbslam3/CameraModels/Pinhole.h"
@@ -41,6 +46,7 @@ class Map;
 class MapPoint;
 class KeyFrame;
 class KeyFrameDatabase;
+class EpochReclaimer;
 class Frame;
 class KannalaBrandt8;
 class Pinhole;
@@ -71,6 +77,22 @@ class Atlas
         ar & mnLastInitKFidMap;
     }
 
+    // Everything but the maps, for the streamed atlas file
+    template<class Archive>
+    void serializeHeader(Archive &ar, unsigned long int &nLastInitKFidMap)
+    {
+        ar.template register_type<Pinhole>();
+        ar.template register_type<KannalaBrandt8>();
+
+        ar & mvpCameras;
+        ar & Map::nNextId;
+        ar & Frame::nNextId;
+        ar & KeyFrame::nNextId;
+        ar & MapPoint::nNextId;
+        ar & GeometricCamera::next_id;
+        ar & nLastInitKFidMap;
+    }
+
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
@@ -85,6 +107,9 @@ public:
 
     void SetViewer(Viewer* pViewer);
 
+    // Reclaimer of the bad MapPoints of all the maps, present and future (see Map::RetireMapPoint)
+    void SetReclaimer(EpochReclaimer* pReclaimer);
+
     // Method for change components in the current map
     void AddKeyFrame(KeyFrame* pKF);
     void AddMapPoint(MapPoint* pMP);
@@ -129,6 +154,42 @@ public:
     void PreSave();
     void PostLoad();
 
+    // Streamed save/load in the chunked atlas file (see AtlasFile.h), with the
+    // vocabulary the atlas was built with. Save replaces PreSave; after Load,
+    // set the KeyFrameDatabase and vocabulary then PostLoad as usual.
+    // With bLazy, Load only reads the map headers and PostLoad indexes the words
+    // of their KeyFrames in the KeyFrameDatabase. A map is then paged in by
+    // LoadMap when place recognition points into it or it becomes the current map.
+    bool Save(const std::string &filename, const std::string &strVocabularyName, const std::string &strVocabularyChecksum,
+              const AtlasProgressCallback &progress = AtlasProgressCallback());
+    bool Load(const std::string &filename, std::string &strVocabularyName, std::string &strVocabularyChecksum,
+              const AtlasProgressCallback &progress = AtlasProgressCallback(), const bool bLazy = false);
+
+    // Page in a map of a lazily loaded atlas (no-op if it is already loaded)
+    bool LoadMap(Map* pMap);
+    bool IsMapLoaded(Map* pMap);
+
+    // Atlas captured by CaptureSnapshot, to be written by SaveSnapshot
+    struct Snapshot
+    {
+        std::unique_ptr<AtlasFileWriter> pWriter;
+        std::string strFilename;
+        std::vector<Map*> vpMaps;
+        std::vector<std::vector<MapPoint*> > vvpMapPoints;
+        std::vector<std::vector<KeyFrame*> > vvpKeyFrames;
+        std::vector<std::vector<AtlasFileSection> > vvUnloadedSections; // Copied as is for the maps not loaded
+        std::size_t nTotal = 0;
+    };
+
+    // Save while the system runs. CaptureSnapshot is called with the update lock
+    // of the current map held and only backs up the graph of every map, unlike
+    // Save it neither marks empty maps bad nor erases anything. SaveSnapshot then
+    // writes the file from any thread, locking each KeyFrame and MapPoint while
+    // it is serialized.
+    bool CaptureSnapshot(const std::string &filename, const std::string &strVocabularyName, const std::string &strVocabularyChecksum,
+                         Snapshot &snapshot);
+    bool SaveSnapshot(Snapshot &snapshot, const AtlasProgressCallback &progress = AtlasProgressCallback());
+
     std::map<long unsigned int, KeyFrame*> GetAtlasKeyframes();
 
     void SetKeyFrameDababase(KeyFrameDatabase* pKFDB);
@@ -143,6 +204,12 @@ public:
 
 protected:
 
+    // Sorted maps to save in mvpBackupMaps, without the empty ones (called with mMutexLazyLoad held)
+    void PrepareSave();
+
+    // Copy the sections of a map not loaded from the loaded file (called with mMutexLazyLoad held)
+    bool CopyUnloadedMap(AtlasFileWriter &writer, const std::vector<AtlasFileSection> &vSections, const std::function<void(std::size_t)> &itemsSaved);
+
     std::set<Map*> mspMaps;
     std::set<Map*> mspBadMaps;
     // Its necessary change the container from set to vector because libboost 1.58 and Ubuntu 16.04 have an error with this cointainer
@@ -157,10 +224,17 @@ protected:
     Viewer* mpViewer;
     bool mHasViewer;
 
+    EpochReclaimer* mpReclaimer = nullptr;
+
     // Class references for the map reconstruction from the save file
     KeyFrameDatabase* mpKeyFrameDB;
     ORBVocabulary* mpORBVocabulary;
 
+    // Lazily loaded atlas: the file stays open and the maps not loaded yet keep their sections
+    std::unique_ptr<AtlasFileReader> mpLazyReader;
+    std::map<Map*, std::vector<AtlasFileSection> > mmUnloadedMaps;
+    std::mutex mMutexLazyLoad;
+
     // Mutex
     std::mutex mMutexAtlas;
 
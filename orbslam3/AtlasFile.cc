@@ -0,0 +1,303 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <cstring>
+#include <exception>
+#include <streambuf>
+// 3rdparty
+#include <glog/logging.h>
+// Local
+#include "orbslam3/AtlasFile.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+constexpr char kMagic[8]       = {'O', 'R', 'B', 'A', 'T', 'L', 'A', 'S'};
+constexpr char kIndexMagic[8]  = {'A', 'T', 'L', 'A', 'S', 'I', 'D', 'X'};
+// 3: the feature grids of the keyframes are stored in compressed rows.
+constexpr std::uint32_t kVersion = 3;
+
+constexpr std::uint64_t kHeaderSize = 16;
+constexpr std::uint64_t kEntrySize  = 40;
+constexpr std::uint64_t kFooterSize = 24;
+
+// ──────────────────────────────────────────────────────────────────────────── //
+
+std::uint64_t Fnv1a(const char* data, const std::size_t size) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+template <typename T>
+void WritePod(std::ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadPod(std::istream& is, T& value) {
+  return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+// Output stream buffer appending to a vector, so that the payload memory is
+// reused from one section to the next.
+class VectorWriteBuffer : public std::streambuf {
+public:
+  explicit VectorWriteBuffer(std::vector<char>& data) : data_(data) {}
+
+protected:
+  int_type overflow(const int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      data_.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char* s, const std::streamsize n) override {
+    data_.insert(data_.end(), s, s + n);
+    return n;
+  }
+
+private:
+  std::vector<char>& data_;
+};
+
+// Input stream buffer over a memory block.
+class MemoryReadBuffer : public std::streambuf {
+public:
+  MemoryReadBuffer(char* data, const std::size_t size) {
+    setg(data, data, data + size);
+  }
+};
+
+bool IsValidType(const std::uint32_t type) {
+  return type >= static_cast<std::uint32_t>(AtlasSection::kAtlas)
+      && type <= static_cast<std::uint32_t>(AtlasSection::kBowIndex);
+}
+
+} // namespace
+
+// ──────────────────────────────────────────────────────────────────────────── //
+
+AtlasFileWriter::AtlasFileWriter(const std::string& filename)
+  : file_(filename, std::ios::binary | std::ios::trunc) {
+  file_.write(kMagic, sizeof(kMagic));
+  WritePod(file_, kVersion);
+  WritePod(file_, std::uint32_t(0));
+  offset_ = kHeaderSize;
+}
+
+bool AtlasFileWriter::IsOpen() const {
+  return file_.is_open() && file_.good();
+}
+
+bool AtlasFileWriter::Write(
+  const AtlasSection type,
+  const std::uint32_t map_id,
+  const std::uint64_t count,
+  const std::function<void(boost::archive::binary_oarchive&)>& serialize
+) {
+  if (!IsOpen()) {
+    return false;
+  }
+
+  buffer_.clear();
+  try {
+    VectorWriteBuffer stream_buffer(buffer_);
+    boost::archive::binary_oarchive archive(stream_buffer);
+    serialize(archive);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to serialize an atlas section: " << e.what();
+    return false;
+  }
+
+  return Append(type, map_id, count);
+}
+
+bool AtlasFileWriter::Copy(AtlasFileReader& reader, const AtlasFileSection& section) {
+  if (!IsOpen() || !reader.ReadPayload(section, buffer_)) {
+    return false;
+  }
+  return Append(section.type, section.map_id, section.count);
+}
+
+bool AtlasFileWriter::Append(
+  const AtlasSection type,
+  const std::uint32_t map_id,
+  const std::uint64_t count
+) {
+  file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  if (!file_) {
+    LOG(ERROR) << "Failed to write an atlas section";
+    return false;
+  }
+
+  AtlasFileSection section;
+  section.type   = type;
+  section.map_id = map_id;
+  section.count  = count;
+  section.offset = offset_;
+  section.size   = buffer_.size();
+  section.hash   = Fnv1a(buffer_.data(), buffer_.size());
+  sections_.push_back(section);
+  offset_ += section.size;
+  return true;
+}
+
+bool AtlasFileWriter::Close() {
+  if (!IsOpen()) {
+    return false;
+  }
+
+  const std::uint64_t index_offset = offset_;
+  for (const AtlasFileSection& section : sections_) {
+    WritePod(file_, static_cast<std::uint32_t>(section.type));
+    WritePod(file_, section.map_id);
+    WritePod(file_, section.count);
+    WritePod(file_, section.offset);
+    WritePod(file_, section.size);
+    WritePod(file_, section.hash);
+  }
+  WritePod(file_, index_offset);
+  WritePod(file_, static_cast<std::uint64_t>(sections_.size()));
+  file_.write(kIndexMagic, sizeof(kIndexMagic));
+
+  file_.close();
+  return !file_.fail();
+}
+
+const std::vector<AtlasFileSection>& AtlasFileWriter::Sections() const {
+  return sections_;
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+
+AtlasFileReader::AtlasFileReader(const std::string& filename)
+  : file_(filename, std::ios::binary) {
+  if (!IsAtlasFile(filename) || !file_) {
+    return;
+  }
+
+  // Header.
+  char magic[sizeof(kMagic)];
+  std::uint32_t version = 0, reserved = 0;
+  if (!file_.read(magic, sizeof(magic)) || !ReadPod(file_, version) || !ReadPod(file_, reserved)) {
+    return;
+  }
+  if (version != kVersion) {
+    LOG(ERROR) << "Unsupported atlas file version " << version;
+    return;
+  }
+
+  // Footer.
+  file_.seekg(0, std::ios::end);
+  const std::uint64_t file_size = static_cast<std::uint64_t>(file_.tellg());
+  if (file_size < kHeaderSize + kFooterSize) {
+    LOG(ERROR) << "Truncated atlas file";
+    return;
+  }
+  std::uint64_t index_offset = 0, n_sections = 0;
+  char index_magic[sizeof(kIndexMagic)];
+  file_.seekg(static_cast<std::streamoff>(file_size - kFooterSize));
+  if (!ReadPod(file_, index_offset) || !ReadPod(file_, n_sections)
+      || !file_.read(index_magic, sizeof(index_magic))
+      || std::memcmp(index_magic, kIndexMagic, sizeof(kIndexMagic)) != 0
+      || index_offset < kHeaderSize
+      || n_sections > (file_size - kFooterSize - index_offset) / kEntrySize
+      || index_offset + n_sections * kEntrySize + kFooterSize != file_size) {
+    LOG(ERROR) << "Truncated atlas file or corrupted atlas index";
+    return;
+  }
+
+  // Index.
+  file_.seekg(static_cast<std::streamoff>(index_offset));
+  sections_.resize(n_sections);
+  for (AtlasFileSection& section : sections_) {
+    std::uint32_t type = 0;
+    if (!ReadPod(file_, type) || !ReadPod(file_, section.map_id) || !ReadPod(file_, section.count)
+        || !ReadPod(file_, section.offset) || !ReadPod(file_, section.size)
+        || !ReadPod(file_, section.hash) || !IsValidType(type) || section.offset < kHeaderSize
+        || section.offset > index_offset || section.size > index_offset - section.offset) {
+      LOG(ERROR) << "Corrupted atlas index";
+      sections_.clear();
+      return;
+    }
+    section.type = static_cast<AtlasSection>(type);
+  }
+  open_ = true;
+}
+
+bool AtlasFileReader::IsOpen() const {
+  return open_;
+}
+
+const std::vector<AtlasFileSection>& AtlasFileReader::Sections() const {
+  return sections_;
+}
+
+bool AtlasFileReader::Read(
+  const AtlasFileSection& section,
+  const std::function<void(boost::archive::binary_iarchive&)>& deserialize
+) {
+  if (!ReadPayload(section, buffer_)) {
+    return false;
+  }
+
+  try {
+    MemoryReadBuffer stream_buffer(buffer_.data(), buffer_.size());
+    boost::archive::binary_iarchive archive(stream_buffer);
+    deserialize(archive);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to deserialize the atlas section at offset " << section.offset << ": "
+               << e.what();
+    return false;
+  }
+  return true;
+}
+
+bool AtlasFileReader::ReadPayload(const AtlasFileSection& section, std::vector<char>& payload) {
+  if (!open_) {
+    return false;
+  }
+
+  payload.resize(section.size);
+  file_.clear();
+  file_.seekg(static_cast<std::streamoff>(section.offset));
+  if (!file_.read(payload.data(), static_cast<std::streamsize>(section.size))
+      || Fnv1a(payload.data(), payload.size()) != section.hash) {
+    LOG(ERROR) << "Corrupted atlas section at offset " << section.offset;
+    return false;
+  }
+  return true;
+}
+
+bool AtlasFileReader::IsAtlasFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  return file.read(magic, sizeof(magic)) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+} // namespace ORB_SLAM3
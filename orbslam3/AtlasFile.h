@@ -0,0 +1,148 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ATLAS_FILE_H
+#define ATLAS_FILE_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+// 3rdparty
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+namespace ORB_SLAM3 {
+
+class AtlasFileReader;
+
+// Chunked on-disk format of a saved atlas:
+//
+//   header   "ORBATLAS", format version (u32), reserved (u32)
+//   payloads one per section, back to back
+//   index    one entry per section (see AtlasFileSection)
+//   footer   index offset (u64), number of sections (u64), "ATLASIDX"
+//
+// Every payload is a self-contained boost binary archive, so sections are
+// written and read one at a time and only one of them is ever held in memory.
+// The atlas is split into an atlas section (vocabulary, cameras, static ids),
+// then per map a header section, blocks of MapPoints and KeyFrames, and the
+// words of its KeyFrames (to index a map in the KeyFrameDatabase without
+// loading it). Integers are stored in host (little-endian) order.
+
+enum class AtlasSection : std::uint32_t {
+  kAtlas     = 1,
+  kMap       = 2,
+  kMapPoints = 3,
+  kKeyFrames = 4,
+  kBowIndex  = 5,
+};
+
+// Index entry of a section.
+struct AtlasFileSection {
+  AtlasSection type;
+  std::uint32_t map_id; // Id of the map the section belongs to (0 for kAtlas)
+  std::uint64_t count;  // Number of MapPoints or KeyFrames in the section
+  std::uint64_t offset; // Payload position in the file
+  std::uint64_t size;   // Payload size in bytes
+  std::uint64_t hash;   // FNV-1a of the payload
+};
+
+// Called with the number of MapPoints and KeyFrames processed so far and
+// their total.
+using AtlasProgressCallback = std::function<void(const std::size_t done, const std::size_t total)>;
+
+class AtlasFileWriter {
+public:
+  explicit AtlasFileWriter(const std::string& filename);
+
+  AtlasFileWriter(const AtlasFileWriter&)            = delete;
+  AtlasFileWriter& operator=(const AtlasFileWriter&) = delete;
+
+  bool IsOpen() const;
+
+  // Append a section whose payload is written by `serialize`.
+  bool Write(
+    const AtlasSection type,
+    const std::uint32_t map_id,
+    const std::uint64_t count,
+    const std::function<void(boost::archive::binary_oarchive&)>& serialize
+  );
+
+  // Write the index and the footer. The file is only valid once this
+  // returned true.
+  bool Close();
+
+  // Append a section of another atlas file as is, without deserializing it.
+  bool Copy(AtlasFileReader& reader, const AtlasFileSection& section);
+
+  const std::vector<AtlasFileSection>& Sections() const;
+
+private:
+  // Write `buffer_` as the payload of a new section.
+  bool Append(const AtlasSection type, const std::uint32_t map_id, const std::uint64_t count);
+
+  std::ofstream file_;
+  std::uint64_t offset_ = 0;
+  std::vector<AtlasFileSection> sections_;
+  std::vector<char> buffer_; // Payload being serialized, reused across sections
+};
+
+class AtlasFileReader {
+public:
+  // Read the header and the index, see IsOpen.
+  explicit AtlasFileReader(const std::string& filename);
+
+  AtlasFileReader(const AtlasFileReader&)            = delete;
+  AtlasFileReader& operator=(const AtlasFileReader&) = delete;
+
+  // Whether the file is an atlas file with a consistent index.
+  bool IsOpen() const;
+
+  const std::vector<AtlasFileSection>& Sections() const;
+
+  // Check the payload of a section and hand it to `deserialize`. Returns false
+  // on a corrupted payload or a deserialization error.
+  bool Read(
+    const AtlasFileSection& section,
+    const std::function<void(boost::archive::binary_iarchive&)>& deserialize
+  );
+
+  // Check the payload of a section and copy it to `payload`.
+  bool ReadPayload(const AtlasFileSection& section, std::vector<char>& payload);
+
+  // Whether the file starts with the atlas file magic (legacy atlas files are
+  // plain boost archives).
+  static bool IsAtlasFile(const std::string& filename);
+
+private:
+  std::ifstream file_;
+  bool open_ = false;
+  std::vector<AtlasFileSection> sections_;
+  std::vector<char> buffer_; // Payload being deserialized, reused across sections
+};
+
+} // namespace ORB_SLAM3
+
+#endif // ATLAS_FILE_H
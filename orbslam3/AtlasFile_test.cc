@@ -0,0 +1,160 @@
+// Standard
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+// Local
+#include "orbslam3/AtlasFile.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Write an atlas section then one section of `n` integers per map.
+void WriteFile(const std::string& filename, const std::vector<std::size_t>& sizes) {
+  AtlasFileWriter writer(filename);
+  ASSERT_TRUE(writer.IsOpen());
+  std::string name = "atlas";
+  ASSERT_TRUE(writer.Write(AtlasSection::kAtlas, 0, 0, [&name](boost::archive::binary_oarchive& ar) {
+    ar & name;
+  }));
+  for (std::size_t map = 0; map < sizes.size(); ++map) {
+    std::vector<int> values(sizes[map], static_cast<int>(map));
+    ASSERT_TRUE(writer.Write(
+      AtlasSection::kMapPoints,
+      static_cast<std::uint32_t>(map),
+      values.size(),
+      [&values](boost::archive::binary_oarchive& ar) { ar & values; }
+    ));
+  }
+  EXPECT_EQ(writer.Sections().size(), sizes.size() + 1);
+  ASSERT_TRUE(writer.Close());
+}
+
+} // namespace
+
+TEST(AtlasFile, RoundTrip) {
+  const std::string filename = ::testing::TempDir() + "atlas_round_trip.osa";
+  WriteFile(filename, {3, 0, 1000});
+  EXPECT_TRUE(AtlasFileReader::IsAtlasFile(filename));
+
+  AtlasFileReader reader(filename);
+  ASSERT_TRUE(reader.IsOpen());
+  const std::vector<AtlasFileSection>& sections = reader.Sections();
+  ASSERT_EQ(sections.size(), 4u);
+
+  EXPECT_EQ(sections[0].type, AtlasSection::kAtlas);
+  std::string name;
+  EXPECT_TRUE(reader.Read(sections[0], [&name](boost::archive::binary_iarchive& ar) { ar & name; }));
+  EXPECT_EQ(name, "atlas");
+
+  // Sections can be read in any order.
+  for (const std::size_t i : {3u, 1u, 2u}) {
+    EXPECT_EQ(sections[i].type, AtlasSection::kMapPoints);
+    EXPECT_EQ(sections[i].map_id, i - 1);
+    std::vector<int> values;
+    EXPECT_TRUE(reader.Read(sections[i], [&values](boost::archive::binary_iarchive& ar) { ar & values; }));
+    EXPECT_EQ(values.size(), sections[i].count);
+    EXPECT_EQ(values, std::vector<int>(sections[i].count, static_cast<int>(i - 1)));
+  }
+
+  std::remove(filename.c_str());
+}
+
+TEST(AtlasFile, Copy) {
+  const std::string source = ::testing::TempDir() + "atlas_copy_source.osa";
+  const std::string target = ::testing::TempDir() + "atlas_copy_target.osa";
+  WriteFile(source, {5, 7});
+
+  // Copy the sections of the second map only, in a new file.
+  {
+    AtlasFileReader reader(source);
+    ASSERT_TRUE(reader.IsOpen());
+    AtlasFileWriter writer(target);
+    ASSERT_TRUE(writer.Copy(reader, reader.Sections()[0]));
+    ASSERT_TRUE(writer.Copy(reader, reader.Sections()[2]));
+    ASSERT_TRUE(writer.Close());
+  }
+
+  AtlasFileReader reader(target);
+  ASSERT_TRUE(reader.IsOpen());
+  ASSERT_EQ(reader.Sections().size(), 2u);
+  const AtlasFileSection& section = reader.Sections()[1];
+  EXPECT_EQ(section.type, AtlasSection::kMapPoints);
+  EXPECT_EQ(section.map_id, 1u);
+  EXPECT_EQ(section.count, 7u);
+  std::vector<int> values;
+  EXPECT_TRUE(reader.Read(section, [&values](boost::archive::binary_iarchive& ar) { ar & values; }));
+  EXPECT_EQ(values, std::vector<int>(7, 1));
+
+  std::remove(source.c_str());
+  std::remove(target.c_str());
+}
+
+TEST(AtlasFile, Corruption) {
+  const std::string filename = ::testing::TempDir() + "atlas_corrupted.osa";
+  WriteFile(filename, {100});
+
+  // A flipped payload byte only fails the section it belongs to.
+  {
+    AtlasFileReader reader(filename);
+    ASSERT_TRUE(reader.IsOpen());
+    const AtlasFileSection section = reader.Sections()[1];
+    std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(static_cast<std::streamoff>(section.offset + section.size / 2));
+    f.put(static_cast<char>(0x5a));
+  }
+  {
+    AtlasFileReader reader(filename);
+    ASSERT_TRUE(reader.IsOpen());
+    std::string name;
+    EXPECT_TRUE(reader.Read(reader.Sections()[0], [&name](boost::archive::binary_iarchive& ar) { ar & name; }));
+    std::vector<int> values;
+    EXPECT_FALSE(reader.Read(reader.Sections()[1], [&values](boost::archive::binary_iarchive& ar) { ar & values; }));
+  }
+
+  // A truncated file (e.g. a crash while saving) has no valid index.
+  {
+    std::ifstream in(filename, std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), static_cast<std::streamsize>(content.size() - 1));
+  }
+  EXPECT_TRUE(AtlasFileReader::IsAtlasFile(filename));
+  EXPECT_FALSE(AtlasFileReader(filename).IsOpen());
+
+  // Neither are legacy nor missing files.
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out << "22 serialization::archive";
+  }
+  EXPECT_FALSE(AtlasFileReader::IsAtlasFile(filename));
+  EXPECT_FALSE(AtlasFileReader(filename).IsOpen());
+  EXPECT_FALSE(AtlasFileReader(::testing::TempDir() + "missing.osa").IsOpen());
+
+  std::remove(filename.c_str());
+}
+
+TEST(AtlasFile, OlderVersion) {
+  const std::string filename = ::testing::TempDir() + "atlas_older_version.osa";
+  WriteFile(filename, {10});
+
+  // The header of a file saved before the keyframe grids were compressed.
+  {
+    std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(8);
+    const std::uint32_t version = 2;
+    f.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  }
+  EXPECT_TRUE(AtlasFileReader::IsAtlasFile(filename));
+  AtlasFileReader reader(filename);
+  EXPECT_FALSE(reader.IsOpen());
+  EXPECT_TRUE(reader.Sections().empty());
+
+  std::remove(filename.c_str());
+}
@@ -33,6 +33,8 @@
 
 namespace ORB_SLAM3 {
 
+class ThreadPool;
+
 class GeometricCamera {
 public:
   enum class Type : uint8_t {
@@ -120,6 +122,12 @@ public:
     return type_;
   }
 
+  // Workers used by the two-view reconstruction created after this call
+  // (nullptr to spawn dedicated threads). Not owned and not serialized.
+  void setThreadPool(ThreadPool* thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
   // ──────────────────────────── //
   // Static members
   static uint8_t next_id;
@@ -141,6 +149,7 @@ protected:
   std::vector<float> params_;
   uint8_t id_;
   Type type_;
+  ThreadPool* thread_pool_ = nullptr;
 };
 
 } // namespace ORB_SLAM3
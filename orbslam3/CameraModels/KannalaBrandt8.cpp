@@ -214,7 +214,7 @@ bool KannalaBrandt8::reconstructFromTwoViews(
   std::vector<bool>& triangulated_flags
 ) {
   if (!reconstructor_) {
-    reconstructor_ = std::make_unique<TwoViewReconstruction>(K());
+    reconstructor_ = std::make_unique<TwoViewReconstruction>(K(), 1.f, 200, thread_pool_);
   }
 
   // Extract 2D points from keypoints.
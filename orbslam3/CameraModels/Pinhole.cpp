@@ -100,7 +100,7 @@ bool Pinhole::reconstructFromTwoViews(
   std::vector<bool>& triangulated_flags
 ) {
   if (!reconstructor_) {
-    reconstructor_ = std::make_unique<TwoViewReconstruction>(K());
+    reconstructor_ = std::make_unique<TwoViewReconstruction>(K(), 1.f, 200, thread_pool_);
   }
 
   return reconstructor_->reconstruct(
@@ -0,0 +1,164 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <algorithm>
+#include <limits>
+#include <utility>
+// Local
+#include "orbslam3/EpochReclaimer.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+constexpr std::uint64_t kFree = std::numeric_limits<std::uint64_t>::max();
+
+} // namespace
+
+EpochReclaimer::EpochReclaimer(const std::uint64_t grace_epochs)
+  : grace_epochs_(std::max<std::uint64_t>(grace_epochs, 1)) {}
+
+EpochReclaimer::~EpochReclaimer() {
+  const std::vector<Retired> ready(retired_.begin(), retired_.end());
+  retired_.clear();
+  Reclaim(ready);
+}
+
+EpochReclaimer::ParticipantId EpochReclaimer::Register() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.participants;
+  const auto free = std::find(participants_.begin(), participants_.end(), kFree);
+  if (free != participants_.end()) {
+    *free = epoch_;
+    return static_cast<ParticipantId>(free - participants_.begin());
+  }
+  participants_.push_back(epoch_);
+  return participants_.size() - 1;
+}
+
+void EpochReclaimer::Unregister(const ParticipantId id) {
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    participants_[id] = kFree;
+    --stats_.participants;
+    Collect(ready);
+  }
+  Reclaim(ready);
+}
+
+void EpochReclaimer::Quiesce(const ParticipantId id) {
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    participants_[id] = epoch_;
+    Collect(ready);
+  }
+  Reclaim(ready);
+}
+
+void EpochReclaimer::Retire(void* object, const ReclaimFunction reclaim) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  retired_.push_back({object, reclaim, epoch_});
+  ++stats_.retired;
+}
+
+EpochReclaimer::Stats EpochReclaimer::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats   = stats_;
+  stats.epoch   = epoch_;
+  stats.pending = retired_.size();
+  return stats;
+}
+
+void EpochReclaimer::Collect(std::vector<Retired>& ready) {
+  const bool all_quiescent = std::all_of(
+    participants_.begin(),
+    participants_.end(),
+    [this](const std::uint64_t epoch) { return epoch == kFree || epoch == epoch_; }
+  );
+  if (all_quiescent) {
+    ++epoch_;
+  }
+
+  while (!retired_.empty() && retired_.front().epoch + grace_epochs_ <= epoch_) {
+    ready.push_back(retired_.front());
+    retired_.pop_front();
+  }
+}
+
+void EpochReclaimer::Reclaim(const std::vector<Retired>& ready) {
+  if (ready.empty()) {
+    return;
+  }
+
+  std::size_t reclaimed = 0;
+  for (const Retired& retired : ready) {
+    if (retired.reclaim(retired.object)) {
+      ++reclaimed;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.reclaimed += reclaimed;
+  stats_.kept += ready.size() - reclaimed;
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+
+EpochParticipant::EpochParticipant(EpochReclaimer* reclaimer) : reclaimer_(reclaimer) {
+  if (reclaimer_ != nullptr) {
+    id_ = reclaimer_->Register();
+  }
+}
+
+EpochParticipant::~EpochParticipant() {
+  if (reclaimer_ != nullptr) {
+    reclaimer_->Unregister(id_);
+  }
+}
+
+EpochParticipant::EpochParticipant(EpochParticipant&& other) noexcept
+  : reclaimer_(std::exchange(other.reclaimer_, nullptr)), id_(other.id_) {}
+
+EpochParticipant& EpochParticipant::operator=(EpochParticipant&& other) noexcept {
+  if (this != &other) {
+    if (reclaimer_ != nullptr) {
+      reclaimer_->Unregister(id_);
+    }
+    reclaimer_ = std::exchange(other.reclaimer_, nullptr);
+    id_        = other.id_;
+  }
+  return *this;
+}
+
+bool EpochParticipant::IsRegistered() const {
+  return reclaimer_ != nullptr;
+}
+
+void EpochParticipant::Quiesce() {
+  if (reclaimer_ != nullptr) {
+    reclaimer_->Quiesce(id_);
+  }
+}
+
+} // namespace ORB_SLAM3
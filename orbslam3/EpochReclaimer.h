@@ -0,0 +1,136 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EPOCH_RECLAIMER_H
+#define EPOCH_RECLAIMER_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// Deferred reclamation of objects removed from the shared structures (the
+// culled MapPoints of a map) while other threads may still hold pointers to
+// them.
+//
+// Every thread keeping such pointers registers as a participant and calls
+// Quiesce() at points where it holds none of the retired objects it saw before
+// its previous call (quiescent-state-based reclamation). The global epoch
+// advances once all the participants quiesced in the current one, and an
+// object retired in epoch e is reclaimed once the epoch reaches e + grace: with
+// a grace of 2, every participant went through a quiescent state after the
+// object was retired.
+//
+// The objects are reclaimed by the thread calling Quiesce(), outside of the
+// lock. The reclaim function may decline (e.g. the object turned out to be
+// still referenced), the object is then kept for good.
+class EpochReclaimer {
+public:
+  using ParticipantId = std::size_t;
+
+  // Returns whether the object was freed.
+  using ReclaimFunction = bool (*)(void* object);
+
+  struct Stats {
+    std::uint64_t epoch      = 0;
+    std::size_t participants = 0;
+    std::size_t retired      = 0; // Objects retired since the creation
+    std::size_t reclaimed    = 0; // Retired objects freed
+    std::size_t kept         = 0; // Retired objects the reclaim function declined
+    std::size_t pending      = 0; // Retired objects waiting for their grace period
+  };
+
+  explicit EpochReclaimer(const std::uint64_t grace_epochs = 2);
+
+  // Reclaim the pending objects, all the participants must be gone.
+  ~EpochReclaimer();
+
+  EpochReclaimer(const EpochReclaimer&)            = delete;
+  EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+  // A new participant is quiescent in the current epoch.
+  ParticipantId Register();
+  void Unregister(const ParticipantId id);
+
+  // Declare the participant quiescent, advance the epoch if it was the last
+  // one and reclaim the objects whose grace period is over.
+  void Quiesce(const ParticipantId id);
+
+  // Hand an object, unreachable from the shared structures, for reclamation.
+  void Retire(void* object, const ReclaimFunction reclaim);
+
+  Stats GetStats() const;
+
+private:
+  struct Retired {
+    void* object;
+    ReclaimFunction reclaim;
+    std::uint64_t epoch;
+  };
+
+  // Advance the epoch if all the participants are quiescent in it and move the
+  // objects whose grace period is over to `ready`. Called under the lock.
+  void Collect(std::vector<Retired>& ready);
+
+  // Call the reclaim functions, outside of the lock.
+  void Reclaim(const std::vector<Retired>& ready);
+
+  const std::uint64_t grace_epochs_;
+  mutable std::mutex mutex_;
+  std::uint64_t epoch_ = 0;
+  std::vector<std::uint64_t> participants_; // Last quiescent epoch, kFree for unused ids
+  std::deque<Retired> retired_;             // In retirement order, hence by epoch
+  Stats stats_;
+};
+
+// ──────────────────────────────────────────────────────────────────────────── //
+
+// Registration of a participant, released with the object. Does nothing
+// without reclaimer, so that the threads do not have to check whether the
+// reclamation is enabled.
+class EpochParticipant {
+public:
+  EpochParticipant() = default;
+  explicit EpochParticipant(EpochReclaimer* reclaimer);
+  ~EpochParticipant();
+
+  EpochParticipant(EpochParticipant&& other) noexcept;
+  EpochParticipant& operator=(EpochParticipant&& other) noexcept;
+
+  EpochParticipant(const EpochParticipant&)            = delete;
+  EpochParticipant& operator=(const EpochParticipant&) = delete;
+
+  bool IsRegistered() const;
+
+  void Quiesce();
+
+private:
+  EpochReclaimer* reclaimer_ = nullptr;
+  EpochReclaimer::ParticipantId id_ = 0;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // EPOCH_RECLAIMER_H
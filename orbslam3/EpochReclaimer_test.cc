@@ -0,0 +1,125 @@
+// Standard
+#include <atomic>
+#include <thread>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/EpochReclaimer.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+std::atomic<int> reclaimed{0};
+
+bool ReclaimInt(void* object) {
+  delete static_cast<int*>(object);
+  ++reclaimed;
+  return true;
+}
+
+bool KeepInt(void*) {
+  return false;
+}
+
+} // namespace
+
+TEST(EpochReclaimer, GracePeriod) {
+  reclaimed = 0;
+  EpochReclaimer reclaimer(2);
+  EpochParticipant a(&reclaimer);
+  EpochParticipant b(&reclaimer);
+
+  reclaimer.Retire(new int(1), &ReclaimInt);
+  a.Quiesce(); // Both were quiescent since their registration: epoch 1
+  b.Quiesce();
+  EXPECT_EQ(reclaimed, 0);
+  a.Quiesce(); // Both quiesced after the retirement: epoch 2
+  EXPECT_EQ(reclaimed, 1);
+
+  // A participant that never quiesces holds the reclamation back...
+  reclaimer.Retire(new int(2), &ReclaimInt);
+  for (int i = 0; i < 10; ++i) {
+    a.Quiesce();
+  }
+  EXPECT_EQ(reclaimed, 1);
+  EXPECT_EQ(reclaimer.GetStats().pending, 1u);
+
+  // ... until it is gone.
+  b = EpochParticipant();
+  a.Quiesce();
+  a.Quiesce();
+  EXPECT_EQ(reclaimed, 2);
+
+  const EpochReclaimer::Stats stats = reclaimer.GetStats();
+  EXPECT_EQ(stats.participants, 1u);
+  EXPECT_EQ(stats.retired, 2u);
+  EXPECT_EQ(stats.reclaimed, 2u);
+  EXPECT_EQ(stats.kept, 0u);
+  EXPECT_EQ(stats.pending, 0u);
+}
+
+TEST(EpochReclaimer, KeptAndPending) {
+  reclaimed = 0;
+  int kept = 0;
+  {
+    EpochReclaimer reclaimer(3);
+    {
+      EpochParticipant participant(&reclaimer);
+      reclaimer.Retire(&kept, &KeepInt);
+      reclaimer.Retire(new int(1), &ReclaimInt);
+      for (int i = 0; i < 3; ++i) {
+        participant.Quiesce();
+      }
+      reclaimer.Retire(new int(2), &ReclaimInt);
+      const EpochReclaimer::Stats stats = reclaimer.GetStats();
+      EXPECT_EQ(stats.reclaimed, 1u);
+      EXPECT_EQ(stats.kept, 1u);
+      EXPECT_EQ(stats.pending, 1u);
+    }
+    EXPECT_EQ(reclaimed, 1);
+  }
+  // The pending objects are reclaimed with the reclaimer.
+  EXPECT_EQ(reclaimed, 2);
+
+  // Without reclaimer, the participants do nothing.
+  EpochParticipant participant(nullptr);
+  EXPECT_FALSE(participant.IsRegistered());
+  participant.Quiesce();
+}
+
+TEST(EpochReclaimer, Concurrent) {
+  reclaimed = 0;
+  constexpr int kThreads    = 4;
+  constexpr int kIterations = 20000;
+
+  EpochReclaimer reclaimer(2);
+  std::atomic<int*> shared{new int(0)};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&reclaimer, &shared, t] {
+      EpochParticipant participant(&reclaimer);
+      for (int i = 0; i < kIterations; ++i) {
+        // Use the current object, replace and retire it from time to time.
+        int* current = shared.load();
+        EXPECT_GE(*current, 0);
+        if (i % 16 == t) {
+          int* replaced = shared.exchange(new int(i));
+          reclaimer.Retire(replaced, &ReclaimInt);
+        }
+        participant.Quiesce();
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  const EpochReclaimer::Stats stats = reclaimer.GetStats();
+  EXPECT_EQ(stats.participants, 0u);
+  EXPECT_EQ(stats.retired, static_cast<std::size_t>(kThreads * kIterations / 16));
+  EXPECT_EQ(stats.reclaimed + stats.pending, stats.retired);
+  EXPECT_GT(stats.reclaimed, 0u);
+  delete shared.load();
+}
@@ -0,0 +1,62 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Standard
+#include <cassert>
+// Local
+#include "orbslam3/FeatureGrid.h"
+
+namespace ORB_SLAM3 {
+
+void FeatureGrid::Build(const int cols, const int rows, const std::vector<int>& cells) {
+  assert(cols >= 0 && rows >= 0);
+  cols_             = cols;
+  rows_             = rows;
+  const int n_cells = cols * rows;
+
+  // Count the keypoints of every cell, then turn the counts into offsets.
+  offsets_.assign(n_cells + 1, 0);
+  for (const int cell : cells) {
+    assert(cell < n_cells);
+    if (cell >= 0) {
+      ++offsets_[cell + 1];
+    }
+  }
+  for (int cell = 0; cell < n_cells; ++cell) {
+    offsets_[cell + 1] += offsets_[cell];
+  }
+
+  // Scatter in keypoint order, so the indices of a cell stay sorted. Every
+  // offset is advanced to the next one, then shifted back in place.
+  indices_.resize(offsets_[n_cells]);
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    if (cells[i] >= 0) {
+      indices_[offsets_[cells[i]]++] = static_cast<std::uint32_t>(i);
+    }
+  }
+  for (int cell = n_cells; cell > 0; --cell) {
+    offsets_[cell] = offsets_[cell - 1];
+  }
+  offsets_[0] = 0;
+}
+
+} // namespace ORB_SLAM3
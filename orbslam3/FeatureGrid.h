@@ -0,0 +1,94 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FEATURE_GRID_H
+#define FEATURE_GRID_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+// 3rdparty
+#include <boost/serialization/vector.hpp>
+
+namespace ORB_SLAM3 {
+
+// Keypoint indices bucketed in the cells of a grid over the image, stored as
+// compressed rows: the indices of cell c are indices_[offsets_[c]] to
+// indices_[offsets_[c + 1] - 1], in increasing order. Two flat vectors instead
+// of one vector per cell, so the grid of a frame is built without per-cell
+// allocations and copied to the next frame or to its keyframe in two blocks.
+class FeatureGrid {
+public:
+  // Indices of the keypoints of one cell, valid until the grid is rebuilt.
+  class Cell {
+  public:
+    Cell(const std::uint32_t* first, const std::uint32_t* last) : first_(first), last_(last) {}
+
+    const std::uint32_t* begin() const { return first_; }
+    const std::uint32_t* end() const { return last_; }
+    std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+    bool empty() const { return first_ == last_; }
+
+  private:
+    const std::uint32_t* first_;
+    const std::uint32_t* last_;
+  };
+
+  // Grid without cell.
+  FeatureGrid() = default;
+
+  // Rebuild the grid with `cols` x `rows` cells from the cell of every
+  // keypoint: cells[i] = col * rows + row for keypoint i, or -1 when the
+  // keypoint is outside the grid. The storage of the previous grid is reused.
+  void Build(const int cols, const int rows, const std::vector<int>& cells);
+
+  int Cols() const { return cols_; }
+  int Rows() const { return rows_; }
+
+  // Number of keypoints in the grid.
+  std::size_t NumIndices() const { return indices_.size(); }
+
+  // Keypoints of the cell, which must be in the grid.
+  Cell At(const int col, const int row) const {
+    const std::size_t cell = static_cast<std::size_t>(col) * rows_ + row;
+    return Cell(indices_.data() + offsets_[cell], indices_.data() + offsets_[cell + 1]);
+  }
+
+  template <class Archive>
+  void serialize(Archive& ar, const unsigned int) {
+    ar & cols_;
+    ar & rows_;
+    ar & offsets_;
+    ar & indices_;
+  }
+
+private:
+  int cols_ = 0;
+  int rows_ = 0;
+  std::vector<std::uint32_t> offsets_; // cols_ * rows_ + 1 entries
+  std::vector<std::uint32_t> indices_;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // FEATURE_GRID_H
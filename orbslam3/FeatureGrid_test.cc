@@ -0,0 +1,93 @@
+// Standard
+#include <random>
+#include <sstream>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+// Local
+#include "orbslam3/FeatureGrid.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+constexpr int kCols = 64;
+constexpr int kRows = 48;
+
+// Random cell of every keypoint, some outside the grid.
+std::vector<int> RandomCells(const std::size_t count, const unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> cell(-1, kCols * kRows - 1);
+  std::vector<int> cells(count);
+  for (int& c : cells) {
+    c = cell(rng);
+  }
+  return cells;
+}
+
+// Compare the grid to one vector per cell, as the original frame grid.
+void ExpectSameCells(const FeatureGrid& grid, const std::vector<int>& cells) {
+  std::vector<std::vector<std::size_t>> expected(kCols * kRows);
+  std::size_t n_inside = 0;
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    if (cells[i] >= 0) {
+      expected[cells[i]].push_back(i);
+      ++n_inside;
+    }
+  }
+
+  ASSERT_EQ(grid.Cols(), kCols);
+  ASSERT_EQ(grid.Rows(), kRows);
+  EXPECT_EQ(grid.NumIndices(), n_inside);
+  for (int col = 0; col < kCols; ++col) {
+    for (int row = 0; row < kRows; ++row) {
+      const FeatureGrid::Cell cell = grid.At(col, row);
+      const std::vector<std::size_t> indices(cell.begin(), cell.end());
+      ASSERT_EQ(indices, expected[col * kRows + row]) << "cell " << col << ", " << row;
+      EXPECT_EQ(cell.size(), indices.size());
+      EXPECT_EQ(cell.empty(), indices.empty());
+    }
+  }
+}
+
+} // namespace
+
+TEST(FeatureGrid, Empty) {
+  const FeatureGrid grid;
+  EXPECT_EQ(grid.Cols(), 0);
+  EXPECT_EQ(grid.Rows(), 0);
+  EXPECT_EQ(grid.NumIndices(), 0u);
+}
+
+TEST(FeatureGrid, MatchesPerCellVectors) {
+  FeatureGrid grid;
+  for (const std::size_t count : {0, 1, 1000, 5000}) {
+    SCOPED_TRACE(count);
+    const std::vector<int> cells = RandomCells(count, static_cast<unsigned>(count));
+    grid.Build(kCols, kRows, cells);
+    ExpectSameCells(grid, cells);
+  }
+}
+
+TEST(FeatureGrid, CopyAndArchive) {
+  const std::vector<int> cells = RandomCells(2000, 3);
+  FeatureGrid grid;
+  grid.Build(kCols, kRows, cells);
+
+  const FeatureGrid copy = grid;
+  ExpectSameCells(copy, cells);
+
+  std::stringstream ss;
+  {
+    boost::archive::text_oarchive oa(ss);
+    oa << grid;
+  }
+  FeatureGrid loaded;
+  {
+    boost::archive::text_iarchive ia(ss);
+    ia >> loaded;
+  }
+  ExpectSameCells(loaded, cells);
+}
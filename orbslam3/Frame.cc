@@ -31,6 +31,8 @@
 #include "orbslam3/MapPoint.h"
 #include "orbslam3/ORBextractor.h"
 #include "orbslam3/ORBmatcher.h"
+#include "orbslam3/StereoMatching.h"
+#include "orbslam3/ThreadPool.h"
 
 namespace ORB_SLAM3
 {
@@ -74,13 +76,9 @@ Frame::Frame(const Frame &frame)
      mTlr(frame.mTlr), mRlr(frame.mRlr), mtlr(frame.mtlr), mTrl(frame.mTrl),
      mTcw(frame.mTcw), mbHasPose(false), mbHasVelocity(false)
 {
-    for(int i=0;i<FRAME_GRID_COLS;i++)
-        for(int j=0; j<FRAME_GRID_ROWS; j++){
-            mGrid[i][j]=frame.mGrid[i][j];
-            if(frame.Nleft > 0){
-                mGridRight[i][j] = frame.mGridRight[i][j];
-            }
-        }
+    mGrid = frame.mGrid;
+    if(frame.Nleft > 0)
+        mGridRight = frame.mGridRight;
 
     if(frame.mbHasPose)
         SetPose(frame.GetPose());
@@ -100,7 +98,7 @@ Frame::Frame(const Frame &frame)
 }
 
 
-Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, Frame* pPrevF, const IMU::Calib &ImuCalib)
+Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, Frame* pPrevF, const IMU::Calib &ImuCalib, ThreadPool* pThreadPool)
     :mpcpi(NULL), mpORBvocabulary(voc),mpORBextractorLeft(extractorLeft),mpORBextractorRight(extractorRight), mTimeStamp(timeStamp), mK(K.clone()), mK_(Converter::toEigenMatrix3f(K)), mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
      mImuCalib(ImuCalib), mpImuPreintegrated(NULL), mpPrevFrame(pPrevF),mpImuPreintegratedFrame(NULL), mpReferenceKF(static_cast<KeyFrame*>(NULL)), mbIsSet(false), mbImuPreintegrated(false),
      mpCamera(pCamera) ,mpCamera2(nullptr), mbHasPose(false), mbHasVelocity(false)
@@ -121,10 +119,7 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     auto time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,0,0);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,0,0);
-    threadLeft.join();
-    threadRight.join();
+    ExtractORBStereo(imLeft,imRight,0,0,0,0,pThreadPool);
 #ifdef REGISTER_TIMES
     auto time_EndExtORB = std::chrono::steady_clock::now();
 
@@ -140,7 +135,7 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     auto time_StartStereoMatches = std::chrono::steady_clock::now();
 #endif
-    ComputeStereoMatches();
+    ComputeStereoMatches(pThreadPool);
 #ifdef REGISTER_TIMES
     auto time_EndStereoMatches = std::chrono::steady_clock::now();
 
@@ -387,20 +382,9 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
 
 void Frame::AssignFeaturesToGrid()
 {
-    // Fill matrix with points
-    const int nCells = FRAME_GRID_COLS*FRAME_GRID_ROWS;
-
-    int nReserve = 0.5f*N/(nCells);
-
-    for(unsigned int i=0; i<FRAME_GRID_COLS;i++)
-        for (unsigned int j=0; j<FRAME_GRID_ROWS;j++){
-            mGrid[i][j].reserve(nReserve);
-            if(Nleft != -1){
-                mGridRight[i][j].reserve(nReserve);
-            }
-        }
-
-
+    // Cell of each keypoint, -1 if outside the grid
+    std::vector<int> vCells(Nleft == -1 ? N : Nleft);
+    std::vector<int> vCellsRight(Nleft == -1 ? 0 : N-Nleft);
 
     for(int i=0;i<N;i++)
     {
@@ -409,13 +393,16 @@ void Frame::AssignFeaturesToGrid()
                                                                  : mvKeysRight[i - Nleft];
 
         int nGridPosX, nGridPosY;
-        if(PosInGrid(kp,nGridPosX,nGridPosY)){
-            if(Nleft == -1 || i < Nleft)
-                mGrid[nGridPosX][nGridPosY].push_back(i);
-            else
-                mGridRight[nGridPosX][nGridPosY].push_back(i - Nleft);
-        }
+        const int nCell = PosInGrid(kp,nGridPosX,nGridPosY) ? nGridPosX*FRAME_GRID_ROWS+nGridPosY : -1;
+        if(Nleft == -1 || i < Nleft)
+            vCells[i] = nCell;
+        else
+            vCellsRight[i - Nleft] = nCell;
     }
+
+    mGrid.Build(FRAME_GRID_COLS,FRAME_GRID_ROWS,vCells);
+    if(Nleft != -1)
+        mGridRight.Build(FRAME_GRID_COLS,FRAME_GRID_ROWS,vCellsRight);
 }
 
 void Frame::ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1)
@@ -427,6 +414,26 @@ void Frame::ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1)
         monoRight = (*mpORBextractorRight)(im,cv::Mat(),mvKeysRight,mDescriptorsRight,vLapping);
 }
 
+void Frame::ExtractORBStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const int x0Left, const int x1Left, const int x0Right, const int x1Right, ThreadPool* pThreadPool)
+{
+    if(pThreadPool)
+    {
+        // The calling thread extracts one of the images, so at most one worker is taken
+        pThreadPool->ParallelFor(0, 2, [&](const std::size_t i) {
+            if(i==0)
+                ExtractORB(0,imLeft,x0Left,x1Left);
+            else
+                ExtractORB(1,imRight,x0Right,x1Right);
+        }, "Frame::ExtractORB");
+        return;
+    }
+
+    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,x0Left,x1Left);
+    thread threadRight(&Frame::ExtractORB,this,1,imRight,x0Right,x1Right);
+    threadLeft.join();
+    threadRight.join();
+}
+
 bool Frame::isSet() const {
     return mbIsSet;
 }
@@ -452,6 +459,13 @@ void Frame::SetVelocity(Eigen::Vector3f Vwb)
     mbHasVelocity = true;
 }
 
+void Frame::SetPrevFrame(Frame* pPrevF)
+{
+    mpPrevFrame = pPrevF;
+    if(pPrevF && pPrevF->HasVelocity())
+        SetVelocity(pPrevF->GetVelocity());
+}
+
 Eigen::Vector3f Frame::GetVelocity() const
 {
     return mVw;
@@ -660,33 +674,41 @@ Eigen::Vector3f Frame::inRefCoordinates(Eigen::Vector3f pCw)
 std::vector<std::size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const float  &r, const int minLevel, const int maxLevel, const bool bRight) const
 {
     std::vector<std::size_t> vIndices;
-    vIndices.reserve(N);
+    GetFeaturesInArea(x,y,r,vIndices,minLevel,maxLevel,bRight);
+    return vIndices;
+}
+
+void Frame::GetFeaturesInArea(const float &x, const float  &y, const float  &r, std::vector<std::size_t> &vIndices, const int minLevel, const int maxLevel, const bool bRight) const
+{
+    vIndices.clear();
+
+    const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
 
     float factorX = r;
     float factorY = r;
 
     const int nMinCellX = std::max(0,(int)std::floor((x-mnMinX-factorX)*mfGridElementWidthInv));
-    if(nMinCellX>=FRAME_GRID_COLS)
+    if(nMinCellX>=grid.Cols())
     {
-        return vIndices;
+        return;
     }
 
-    const int nMaxCellX = std::min((int)FRAME_GRID_COLS-1,(int)std::ceil((x-mnMinX+factorX)*mfGridElementWidthInv));
+    const int nMaxCellX = std::min(grid.Cols()-1,(int)std::ceil((x-mnMinX+factorX)*mfGridElementWidthInv));
     if(nMaxCellX<0)
     {
-        return vIndices;
+        return;
     }
 
     const int nMinCellY = std::max(0,(int)std::floor((y-mnMinY-factorY)*mfGridElementHeightInv));
-    if(nMinCellY>=FRAME_GRID_ROWS)
+    if(nMinCellY>=grid.Rows())
     {
-        return vIndices;
+        return;
     }
 
-    const int nMaxCellY = std::min((int)FRAME_GRID_ROWS-1,(int)std::ceil((y-mnMinY+factorY)*mfGridElementHeightInv));
+    const int nMaxCellY = std::min(grid.Rows()-1,(int)std::ceil((y-mnMinY+factorY)*mfGridElementHeightInv));
     if(nMaxCellY<0)
     {
-        return vIndices;
+        return;
     }
 
     const bool bCheckLevels = (minLevel>0) || (maxLevel>=0);
@@ -695,15 +717,11 @@ std::vector<std::size_t> Frame::GetFeaturesInArea(const float &x, const float  &
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            const std::vector<std::size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            if(vCell.empty())
-                continue;
-
-            for(std::size_t j=0, jend=vCell.size(); j<jend; j++)
+            for(const std::uint32_t idx : grid.At(ix,iy))
             {
-                const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
+                const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[idx]
+                                                         : (!bRight) ? mvKeys[idx]
+                                                                     : mvKeysRight[idx];
                 if(bCheckLevels)
                 {
                     if(kpUn.octave<minLevel)
@@ -717,12 +735,10 @@ std::vector<std::size_t> Frame::GetFeaturesInArea(const float &x, const float  &
                 const float disty = kpUn.pt.y-y;
 
                 if(fabs(distx)<factorX && fabs(disty)<factorY)
-                    vIndices.push_back(vCell[j]);
+                    vIndices.push_back(idx);
             }
         }
     }
-
-    return vIndices;
 }
 
 bool Frame::PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY)
@@ -738,12 +754,19 @@ bool Frame::PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY)
 }
 
 
-void Frame::ComputeBoW()
+void Frame::ComputeBoW(ThreadPool* pThreadPool)
 {
     if(mBowVec.empty())
     {
         std::vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
+        ORBVocabulary::ParallelFor parallelFor;
+        if(pThreadPool)
+        {
+            parallelFor = [pThreadPool](size_t begin, size_t end, const std::function<void(size_t)> &fn) {
+                pThreadPool->ParallelFor(begin, end, fn, "Frame::ComputeBoW");
+            };
+        }
+        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4,parallelFor);
     }
 }
 
@@ -811,7 +834,7 @@ void Frame::ComputeImageBounds(const cv::Mat &imLeft)
     }
 }
 
-void Frame::ComputeStereoMatches()
+void Frame::ComputeStereoMatches(ThreadPool* pThreadPool)
 {
     mvuRight = std::vector<float>(N,-1.0f);
     mvDepth = std::vector<float>(N,-1.0f);
@@ -820,52 +843,59 @@ void Frame::ComputeStereoMatches()
 
     const int nRows = mpORBextractorLeft->mvImagePyramid[0].rows;
 
-    //Assign keypoints to row table
-    std::vector<std::vector<std::size_t> > vRowIndices(nRows,std::vector<std::size_t>());
-
-    for(int i=0; i<nRows; i++)
-        vRowIndices[i].reserve(200);
-
+    //Assign keypoints to row table, the right keypoints of row y being vRowIndices[vRowStart[y]..vRowStart[y+1])
     const int Nr = mvKeysRight.size();
+    std::vector<int> vRowStart(nRows+1,0);
+    std::vector<int> vMinRow(Nr), vMaxRow(Nr);
 
     for(int iR=0; iR<Nr; iR++)
     {
         const cv::KeyPoint &kp = mvKeysRight[iR];
         const float &kpY = kp.pt.y;
         const float r = 2.0f*mvScaleFactors[mvKeysRight[iR].octave];
-        const int maxr = std::ceil(kpY+r);
-        const int minr = std::floor(kpY-r);
+        vMaxRow[iR] = std::min(static_cast<int>(std::ceil(kpY+r)),nRows-1);
+        vMinRow[iR] = std::max(static_cast<int>(std::floor(kpY-r)),0);
 
-        for(int yi=minr;yi<=maxr;yi++)
-            vRowIndices[yi].push_back(iR);
+        for(int yi=vMinRow[iR];yi<=vMaxRow[iR];yi++)
+            vRowStart[yi+1]++;
     }
+    for(int yi=0; yi<nRows; yi++)
+        vRowStart[yi+1] += vRowStart[yi];
+
+    std::vector<int> vRowIndices(vRowStart[nRows]);
+    std::vector<int> vRowFill(vRowStart.begin(),vRowStart.end()-1);
+    for(int iR=0; iR<Nr; iR++)
+        for(int yi=vMinRow[iR];yi<=vMaxRow[iR];yi++)
+            vRowIndices[vRowFill[yi]++] = iR;
 
     // Set limits for search
     const float minZ = mb;
     const float minD = 0;
     const float maxD = mbf/minZ;
 
-    // For each left keypoint search a match in the right image
-    std::vector<std::pair<int, int> > vDistIdx;
-    vDistIdx.reserve(N);
+    // Correlation distance of the match of each left keypoint, -1 if none
+    std::vector<int> vBestDists(N,-1);
 
-    for(int iL=0; iL<N; iL++)
+    // For each left keypoint search a match in the right image
+    const auto matchKeyPoint = [&](const int iL)
     {
         const cv::KeyPoint &kpL = mvKeys[iL];
         const int &levelL = kpL.octave;
         const float &vL = kpL.pt.y;
         const float &uL = kpL.pt.x;
 
-        const std::vector<std::size_t> &vCandidates = vRowIndices[vL];
+        const int row = static_cast<int>(vL);
+        const int* vCandidates = vRowIndices.data()+vRowStart[row];
+        const int nCandidates = vRowStart[row+1]-vRowStart[row];
 
-        if(vCandidates.empty())
-            continue;
+        if(nCandidates==0)
+            return;
 
         const float minU = uL-maxD;
         const float maxU = uL-minD;
 
         if(maxU<0)
-            continue;
+            return;
 
         int bestDist = ORBmatcher::TH_HIGH;
         std::size_t bestIdxR = 0;
@@ -873,7 +903,7 @@ void Frame::ComputeStereoMatches()
         const cv::Mat &dL = mDescriptors.row(iL);
 
         // Compare descriptor to right keypoints
-        for(std::size_t iC=0; iC<vCandidates.size(); iC++)
+        for(int iC=0; iC<nCandidates; iC++)
         {
             const std::size_t iR = vCandidates[iC];
             const cv::KeyPoint &kpR = mvKeysRight[iR];
@@ -907,46 +937,24 @@ void Frame::ComputeStereoMatches()
             const float scaleduR0 = std::round(uR0*scaleFactor);
 
             // sliding window search
-            const int w = 5;
-            cv::Mat IL = mpORBextractorLeft->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduL-w,scaleduL+w+1);
-
-            int bestDist = INT_MAX;
-            int bestincR = 0;
-            const int L = 5;
-            std::vector<float> vDists;
-            vDists.resize(2*L+1);
+            const int w = Stereo::kWindowHalfSize;
+            const int L = Stereo::kSearchRadius;
 
             const float iniu = scaleduR0+L-w;
             const float endu = scaleduR0+L+w+1;
             if(iniu<0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
-                continue;
-
-            for(int incR=-L; incR<=+L; incR++)
-            {
-                cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduR0+incR-w,scaleduR0+incR+w+1);
+                return;
 
-                float dist = cv::norm(IL,IR,cv::NORM_L1);
-                if(dist<bestDist)
-                {
-                    bestDist =  dist;
-                    bestincR = incR;
-                }
-
-                vDists[L+incR] = dist;
-            }
-
-            if(bestincR==-L || bestincR==L)
-                continue;
+            int vDists[Stereo::kOffsets];
+            if(!Stereo::WindowSads(mpORBextractorLeft->mvImagePyramid[kpL.octave],mpORBextractorRight->mvImagePyramid[kpL.octave],
+                                   scaleduL,scaleduR0,scaledvL,vDists))
+                return;
 
             // Sub-pixel match (Parabola fitting)
-            const float dist1 = vDists[L+bestincR-1];
-            const float dist2 = vDists[L+bestincR];
-            const float dist3 = vDists[L+bestincR+1];
-
-            const float deltaR = (dist1-dist3)/(2.0f*(dist1+dist3-2.0f*dist2));
-
-            if(deltaR<-1 || deltaR>1)
-                continue;
+            int bestincR;
+            float deltaR;
+            if(!Stereo::RefineMinimum(vDists,bestDist,bestincR,deltaR))
+                return;
 
             // Re-scaled coordinate
             float bestuR = mvScaleFactors[kpL.octave]*((float)scaleduR0+(float)bestincR+deltaR);
@@ -962,10 +970,36 @@ void Frame::ComputeStereoMatches()
                 }
                 mvDepth[iL]=mbf/disparity;
                 mvuRight[iL] = bestuR;
-                vDistIdx.push_back(std::pair<int,int>(bestDist,iL));
+                vBestDists[iL] = bestDist;
             }
         }
+    };
+
+    if(pThreadPool)
+    {
+        // Blocks of keypoints, every keypoint only writes its own entries
+        const int nBlockSize = 64;
+        pThreadPool->ParallelFor(0, (N+nBlockSize-1)/nBlockSize, [&](const std::size_t iBlock) {
+            const int begin = static_cast<int>(iBlock)*nBlockSize;
+            const int end = std::min(N,begin+nBlockSize);
+            for(int iL=begin; iL<end; iL++)
+                matchKeyPoint(iL);
+        }, "Frame::ComputeStereoMatches");
     }
+    else
+    {
+        for(int iL=0; iL<N; iL++)
+            matchKeyPoint(iL);
+    }
+
+    std::vector<std::pair<int, int> > vDistIdx;
+    vDistIdx.reserve(N);
+    for(int iL=0; iL<N; iL++)
+        if(vBestDists[iL]>=0)
+            vDistIdx.push_back(std::pair<int,int>(vBestDists[iL],iL));
+
+    if(vDistIdx.empty())
+        return;
 
     std::sort(vDistIdx.begin(),vDistIdx.end());
     const float median = vDistIdx[vDistIdx.size()/2].first;
@@ -1034,7 +1068,7 @@ void Frame::setIntegrated()
     mbImuPreintegrated = true;
 }
 
-Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF, const IMU::Calib &ImuCalib)
+Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF, const IMU::Calib &ImuCalib, ThreadPool* pThreadPool)
         :mpcpi(NULL), mpORBvocabulary(voc),mpORBextractorLeft(extractorLeft),mpORBextractorRight(extractorRight), mTimeStamp(timeStamp), mK(K.clone()), mK_(Converter::toEigenMatrix3f(K)),  mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
          mImuCalib(ImuCalib), mpImuPreintegrated(NULL), mpPrevFrame(pPrevF),mpImuPreintegratedFrame(NULL), mpReferenceKF(static_cast<KeyFrame*>(NULL)), mbImuPreintegrated(false), mpCamera(pCamera), mpCamera2(pCamera2),
          mbHasPose(false), mbHasVelocity(false)
@@ -1059,10 +1093,10 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     auto time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[1]);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[1]);
-    threadLeft.join();
-    threadRight.join();
+    ExtractORBStereo(imLeft,imRight,
+                     static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[1],
+                     static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[1],
+                     pThreadPool);
 #ifdef REGISTER_TIMES
     auto time_EndExtORB = std::chrono::steady_clock::now();
 
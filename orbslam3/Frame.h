@@ -31,6 +31,7 @@
 #include <opencv2/features2d.hpp>
 #include <orbslam3/external/Sophus/sophus/se3.hpp>
 // Local
+#include "orbslam3/FeatureGrid.h"
 #include "orbslam3/ImuTypes.h"
 #include "orbslam3/ORBVocabulary.h"
 
@@ -44,6 +45,7 @@ class KeyFrame;
 class ConstraintPoseImu;
 class GeometricCamera;
 class ORBextractor;
+class ThreadPool;
 
 class Frame
 {
@@ -53,8 +55,16 @@ public:
     // Copy constructor.
     Frame(const Frame &frame);
 
+    // Move constructor and assignments. A frame is handed over by moving it (extraction to tracking) or by
+    // assigning it to a long-lived frame (current to last): the copy assignment shares the cv::Mat buffers,
+    // which are not modified once the frame is built, and reuses the storage of the vectors and maps of the
+    // destination, so no allocation is needed once the frames have reached their steady-state size.
+    Frame(Frame &&frame) = default;
+    Frame& operator=(const Frame &frame) = default;
+    Frame& operator=(Frame &&frame) = default;
+
     // Constructor for stereo cameras.
-    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
+    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib(), ThreadPool* pThreadPool = nullptr);
 
     // Constructor for RGB-D cameras.
     Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
@@ -68,8 +78,11 @@ public:
     // Extract ORB on the image. 0 for left image and 1 for right image.
     void ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1);
 
-    // Compute Bag of Words representation.
-    void ComputeBoW();
+    // Extract ORB on both stereo images concurrently, on the pool workers if given.
+    void ExtractORBStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const int x0Left, const int x1Left, const int x0Right, const int x1Right, ThreadPool* pThreadPool);
+
+    // Compute Bag of Words representation, on the pool workers if given.
+    void ComputeBoW(ThreadPool* pThreadPool = nullptr);
 
     // Set the camera pose. (Imu pose is not modified!)
     void SetPose(const Sophus::SE3<float> &Tcw);
@@ -93,6 +106,10 @@ public:
 
     void SetNewBias(const IMU::Bias &b);
 
+    // Chain the frame to the previous one, inheriting its velocity (inertial sensors). For frames built
+    // without their previous frame, before it was tracked.
+    void SetPrevFrame(Frame* pPrevF);
+
     // Check if a MapPoint is in the frustum of the camera
     // and fill variables of the MapPoint to be used by the tracking
     bool isInFrustum(MapPoint* pMP, float viewingCosLimit);
@@ -106,9 +123,13 @@ public:
 
     std::vector<std::size_t> GetFeaturesInArea(const float &x, const float  &y, const float  &r, const int minLevel=-1, const int maxLevel=-1, const bool bRight = false) const;
 
+    // Same, filling the buffer of the caller (cleared first) to avoid an allocation per query in the matcher loops.
+    void GetFeaturesInArea(const float &x, const float  &y, const float  &r, std::vector<std::size_t> &vIndices, const int minLevel=-1, const int maxLevel=-1, const bool bRight = false) const;
+
     // Search a match for each keypoint in the left image to a keypoint in the right image.
     // If there is a match, depth is computed and the right coordinate associated to the left keypoint is stored.
-    void ComputeStereoMatches();
+    // The keypoints are matched on the pool workers if given.
+    void ComputeStereoMatches(ThreadPool* pThreadPool = nullptr);
 
     // Associate a "right" coordinate to a keypoint if there is valid depth in the depthmap.
     void ComputeStereoFromRGBD(const cv::Mat &imDepth);
@@ -244,7 +265,7 @@ public:
     // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
     static float mfGridElementWidthInv;
     static float mfGridElementHeightInv;
-    std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    FeatureGrid mGrid;
 
     IMU::Bias mPredBias;
 
@@ -336,9 +357,9 @@ public:
     std::vector<Eigen::Vector3f> mvStereo3Dpoints;
 
     //Grid for the right image
-    std::vector<std::size_t> mGridRight[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    FeatureGrid mGridRight;
 
-    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
+    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib(), ThreadPool* pThreadPool = nullptr);
 
     //Stereo fisheye
     void ComputeStereoFishEyeMatches();
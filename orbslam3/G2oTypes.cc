@@ -1208,6 +1208,7 @@ Matrix15d ConstraintPoseImu::solveHessian(Matrix15d H) {
     }
   }
   H = solver.eigenvectors() * eigens.asDiagonal() * solver.eigenvectors().transpose();
+  return H;
 }
 
 EdgePriorPoseImu::EdgePriorPoseImu(const ConstraintPoseImu* constraint) {
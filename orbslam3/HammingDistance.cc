@@ -0,0 +1,333 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <algorithm>
+#include <atomic>
+// 3rdparty
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define ORB_SLAM3_HAMMING_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define ORB_SLAM3_HAMMING_NEON
+#endif
+// Local
+#include "orbslam3/HammingDistance.h"
+
+namespace ORB_SLAM3 {
+namespace Hamming {
+
+namespace {
+
+using DistancesFn = void (*)(
+  const std::uint8_t*,
+  const std::uint8_t*,
+  std::size_t,
+  const std::size_t*,
+  std::size_t,
+  int*
+);
+
+inline const std::uint8_t* Row(
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t i
+) {
+  return base + stride * (indices ? indices[i] : i);
+}
+
+// ──────────────────────────── //
+// Scalar
+
+void DistancesScalar(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count,
+  int* distances
+) {
+  for (std::size_t i = 0; i < count; ++i) {
+    distances[i] = DistanceScalar(query, Row(base, stride, indices, i));
+  }
+}
+
+#ifdef ORB_SLAM3_HAMMING_X86
+
+// ──────────────────────────── //
+// x86 popcnt
+
+__attribute__((target("popcnt"))) void DistancesPopcnt(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count,
+  int* distances
+) {
+  std::uint64_t q[4];
+  std::memcpy(q, query, kDescriptorBytes);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint64_t c[4];
+    std::memcpy(c, Row(base, stride, indices, i), kDescriptorBytes);
+    distances[i] = static_cast<int>(
+      _mm_popcnt_u64(q[0] ^ c[0]) + _mm_popcnt_u64(q[1] ^ c[1])
+      + _mm_popcnt_u64(q[2] ^ c[2]) + _mm_popcnt_u64(q[3] ^ c[3])
+    );
+  }
+}
+
+// ──────────────────────────── //
+// x86 AVX2
+
+__attribute__((target("avx2"))) void DistancesAVX2(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count,
+  int* distances
+) {
+  // Popcount of every nibble value, duplicated in both 128-bit lanes.
+  const __m256i lut = _mm256_setr_epi8(
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+  );
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i zero     = _mm256_setzero_si256();
+  const __m256i q        = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+
+  for (std::size_t i = 0; i < count; ++i) {
+    const __m256i c = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(Row(base, stride, indices, i))
+    );
+    const __m256i x   = _mm256_xor_si256(q, c);
+    const __m256i lo  = _mm256_and_si256(x, low_mask);
+    const __m256i hi  = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+    const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+    // Sum the 32 byte counts into four 64-bit lanes, then fold them.
+    const __m256i sad = _mm256_sad_epu8(cnt, zero);
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+    distances[i] = _mm_cvtsi128_si32(_mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum)));
+  }
+}
+
+// ──────────────────────────── //
+// x86 AVX-512 VPOPCNTDQ
+
+__attribute__((target("avx512f,avx512vl,avx512vpopcntdq"))) void DistancesAVX512(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count,
+  int* distances
+) {
+  const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+  for (std::size_t i = 0; i < count; ++i) {
+    const __m256i c = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(Row(base, stride, indices, i))
+    );
+    const __m256i cnt = _mm256_popcnt_epi64(_mm256_xor_si256(q, c));
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(cnt), _mm256_extracti128_si256(cnt, 1));
+    distances[i] = _mm_cvtsi128_si32(_mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum)));
+  }
+}
+
+#endif // ORB_SLAM3_HAMMING_X86
+
+#ifdef ORB_SLAM3_HAMMING_NEON
+
+// ──────────────────────────── //
+// ARM NEON
+
+void DistancesNEON(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count,
+  int* distances
+) {
+  const uint8x16_t q0 = vld1q_u8(query);
+  const uint8x16_t q1 = vld1q_u8(query + 16);
+  for (std::size_t i = 0; i < count; ++i) {
+    const std::uint8_t* c = Row(base, stride, indices, i);
+    const uint8x16_t cnt0 = vcntq_u8(veorq_u8(q0, vld1q_u8(c)));
+    const uint8x16_t cnt1 = vcntq_u8(veorq_u8(q1, vld1q_u8(c + 16)));
+    // Each byte is at most 16 after the add, widen before the horizontal sum.
+    distances[i] = static_cast<int>(vaddvq_u16(vpaddlq_u8(vaddq_u8(cnt0, cnt1))));
+  }
+}
+
+#endif // ORB_SLAM3_HAMMING_NEON
+
+// ──────────────────────────── //
+// Dispatch
+
+DistancesFn KernelFunction(const Kernel kernel) {
+  switch (kernel) {
+#ifdef ORB_SLAM3_HAMMING_X86
+    case Kernel::Popcnt: return DistancesPopcnt;
+    case Kernel::AVX2:   return DistancesAVX2;
+    case Kernel::AVX512: return DistancesAVX512;
+#endif
+#ifdef ORB_SLAM3_HAMMING_NEON
+    case Kernel::NEON:   return DistancesNEON;
+#endif
+    default:             return DistancesScalar;
+  }
+}
+
+Kernel DetectKernel() {
+  // Native 64-bit vector popcount first, then the AVX2 nibble lookup.
+  for (const Kernel kernel : {Kernel::AVX512, Kernel::AVX2, Kernel::NEON, Kernel::Popcnt}) {
+    if (IsSupported(kernel)) {
+      return kernel;
+    }
+  }
+  return Kernel::Scalar;
+}
+
+std::atomic<Kernel>& CurrentKernel() {
+  static std::atomic<Kernel> kernel(DetectKernel());
+  return kernel;
+}
+
+} // namespace
+
+int DistanceScalar(const std::uint8_t* a, const std::uint8_t* b) {
+  int dist = 0;
+  for (std::size_t i = 0; i < kDescriptorBytes; i += 4) {
+    std::uint32_t va, vb;
+    std::memcpy(&va, a + i, 4);
+    std::memcpy(&vb, b + i, 4);
+    std::uint32_t v = va ^ vb;
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+  }
+  return dist;
+}
+
+void Distances(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count,
+  int* distances
+) {
+  KernelFunction(CurrentKernel().load(std::memory_order_relaxed))(
+    query, base, stride, indices, count, distances
+  );
+}
+
+BestMatches SearchBest(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count
+) {
+  const DistancesFn distances_fn = KernelFunction(CurrentKernel().load(std::memory_order_relaxed));
+
+  // Score in fixed-size chunks so the distances stay on the stack.
+  constexpr std::size_t kChunk = 64;
+  int distances[kChunk];
+
+  BestMatches matches;
+  for (std::size_t first = 0; first < count; first += kChunk) {
+    const std::size_t n = std::min(kChunk, count - first);
+    distances_fn(query, base, stride, indices ? indices + first : nullptr, n, distances);
+    if (!indices) {
+      base += stride * n;
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+      const int dist = distances[i];
+      if (dist < matches.second_distance) {
+        const int index = static_cast<int>(indices ? indices[first + i] : first + i);
+        if (dist < matches.best_distance) {
+          matches.second_distance = matches.best_distance;
+          matches.second_index    = matches.best_index;
+          matches.best_distance   = dist;
+          matches.best_index      = index;
+        } else {
+          matches.second_distance = dist;
+          matches.second_index    = index;
+        }
+      }
+    }
+  }
+
+  return matches;
+}
+
+Kernel ActiveKernel() {
+  return CurrentKernel().load(std::memory_order_relaxed);
+}
+
+bool SetKernel(const Kernel kernel) {
+  if (!IsSupported(kernel)) {
+    return false;
+  }
+  CurrentKernel().store(kernel, std::memory_order_relaxed);
+  return true;
+}
+
+bool IsSupported(const Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Scalar:
+      return true;
+#ifdef ORB_SLAM3_HAMMING_X86
+    case Kernel::Popcnt:
+      return __builtin_cpu_supports("popcnt");
+    case Kernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+    case Kernel::AVX512:
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+          && __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+#ifdef ORB_SLAM3_HAMMING_NEON
+    case Kernel::NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+const char* KernelName(const Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::Popcnt: return "popcnt";
+    case Kernel::AVX2:   return "avx2";
+    case Kernel::AVX512: return "avx512";
+    case Kernel::NEON:   return "neon";
+  }
+  return "unknown";
+}
+
+} // namespace Hamming
+} // namespace ORB_SLAM3
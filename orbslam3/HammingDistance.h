@@ -0,0 +1,112 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAMMING_DISTANCE_H
+#define HAMMING_DISTANCE_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace ORB_SLAM3 {
+namespace Hamming {
+
+// Size in bytes of an ORB descriptor (256 bits).
+constexpr std::size_t kDescriptorBytes = 32;
+
+// Distance used as "no match yet" by the matcher loops. No candidate at this
+// distance (every bit different) is ever reported as best or second best.
+constexpr int kMaxDistance = 256;
+
+// Instruction set used by the batched kernels.
+enum class Kernel {
+  Scalar, // Portable SWAR popcount
+  Popcnt, // x86 64-bit popcnt
+  AVX2,   // x86 AVX2 nibble lookup
+  AVX512, // x86 AVX-512 VPOPCNTDQ
+  NEON    // ARM vcnt
+};
+
+// Best and second best candidates of a 1-to-N search. Indices refer to the
+// candidate position (or to the value taken from the index list when one is
+// given), -1 when no candidate was closer than kMaxDistance.
+struct BestMatches {
+  int best_distance   = kMaxDistance;
+  int best_index      = -1;
+  int second_distance = kMaxDistance;
+  int second_index    = -1;
+};
+
+// Hamming distance between two 256-bit descriptors. Inline since this is the
+// innermost call of every matcher; compiles to 4 popcnt with -march=native.
+inline int Distance(const std::uint8_t* a, const std::uint8_t* b) {
+  int dist = 0;
+  for (std::size_t i = 0; i < kDescriptorBytes; i += 8) {
+    std::uint64_t va, vb;
+    std::memcpy(&va, a + i, 8);
+    std::memcpy(&vb, b + i, 8);
+    dist += __builtin_popcountll(va ^ vb);
+  }
+  return dist;
+}
+
+// Reference implementation (the original 8 x 32-bit SWAR loop). Kept for tests
+// and benchmarks.
+int DistanceScalar(const std::uint8_t* a, const std::uint8_t* b);
+
+// Distances between the query and `count` candidates. Candidate i starts at
+// `base + stride * (indices ? indices[i] : i)`.
+void Distances(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count,
+  int* distances
+);
+
+// Best and second best candidates of the query, with the same tie-breaking as
+// the matcher loops (strictly smaller wins, the first seen is kept).
+BestMatches SearchBest(
+  const std::uint8_t* query,
+  const std::uint8_t* base,
+  const std::size_t stride,
+  const std::size_t* indices,
+  const std::size_t count
+);
+
+// Kernel picked at startup from the CPU features.
+Kernel ActiveKernel();
+
+// Force a kernel, mostly for tests and benchmarks. Returns false and keeps the
+// current one if the CPU does not support it.
+bool SetKernel(const Kernel kernel);
+
+// Whether the CPU (and the build) support the kernel.
+bool IsSupported(const Kernel kernel);
+
+const char* KernelName(const Kernel kernel);
+
+} // namespace Hamming
+} // namespace ORB_SLAM3
+
+#endif // HAMMING_DISTANCE_H
@@ -0,0 +1,121 @@
+// Standard
+#include <random>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/HammingDistance.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Random descriptors stored row by row with the given stride.
+std::vector<std::uint8_t> RandomDescriptors(const std::size_t count, const std::size_t stride) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<std::uint8_t> data(count * stride);
+  for (auto& b : data) {
+    b = static_cast<std::uint8_t>(byte(rng));
+  }
+  return data;
+}
+
+const Hamming::Kernel kAllKernels[] = {
+  Hamming::Kernel::Scalar,
+  Hamming::Kernel::Popcnt,
+  Hamming::Kernel::AVX2,
+  Hamming::Kernel::AVX512,
+  Hamming::Kernel::NEON,
+};
+
+} // namespace
+
+TEST(Hamming, Distance) {
+  std::uint8_t a[Hamming::kDescriptorBytes] = {};
+  std::uint8_t b[Hamming::kDescriptorBytes] = {};
+  EXPECT_EQ(Hamming::Distance(a, b), 0);
+  EXPECT_EQ(Hamming::DistanceScalar(a, b), 0);
+
+  b[0]  = 0x01;
+  b[31] = 0xff;
+  EXPECT_EQ(Hamming::Distance(a, b), 9);
+  EXPECT_EQ(Hamming::DistanceScalar(a, b), 9);
+
+  std::fill(std::begin(b), std::end(b), 0xff);
+  EXPECT_EQ(Hamming::Distance(a, b), 256);
+  EXPECT_EQ(Hamming::DistanceScalar(a, b), 256);
+}
+
+TEST(Hamming, KernelsMatchScalar) {
+  // Odd count and padded stride to exercise the tails.
+  const std::size_t count  = 131;
+  const std::size_t stride = 48;
+  const auto data          = RandomDescriptors(count + 1, stride);
+  const std::uint8_t* query = data.data() + count * stride;
+
+  std::vector<std::size_t> indices;
+  for (std::size_t i = 0; i < count; i += 3) {
+    indices.push_back(count - 1 - i);
+  }
+
+  const Hamming::Kernel initial = Hamming::ActiveKernel();
+  for (const Hamming::Kernel kernel : kAllKernels) {
+    if (!Hamming::SetKernel(kernel)) {
+      continue;
+    }
+    SCOPED_TRACE(Hamming::KernelName(kernel));
+
+    std::vector<int> distances(count);
+    Hamming::Distances(query, data.data(), stride, nullptr, count, distances.data());
+    for (std::size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(distances[i], Hamming::DistanceScalar(query, data.data() + i * stride));
+      EXPECT_EQ(distances[i], Hamming::Distance(query, data.data() + i * stride));
+    }
+
+    Hamming::Distances(query, data.data(), stride, indices.data(), indices.size(), distances.data());
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      EXPECT_EQ(distances[i], Hamming::DistanceScalar(query, data.data() + indices[i] * stride));
+    }
+  }
+  Hamming::SetKernel(initial);
+}
+
+TEST(Hamming, SearchBest) {
+  const std::size_t count  = 200;
+  const std::size_t stride = Hamming::kDescriptorBytes;
+  const auto data          = RandomDescriptors(count + 1, stride);
+  const std::uint8_t* query = data.data() + count * stride;
+
+  // Reference: the loop used by the matchers.
+  int best = 256, best_idx = -1, second = 256, second_idx = -1;
+  for (std::size_t i = 0; i < count; ++i) {
+    const int dist = Hamming::DistanceScalar(query, data.data() + i * stride);
+    if (dist < best) {
+      second     = best;
+      second_idx = best_idx;
+      best       = dist;
+      best_idx   = static_cast<int>(i);
+    } else if (dist < second) {
+      second     = dist;
+      second_idx = static_cast<int>(i);
+    }
+  }
+
+  const Hamming::BestMatches matches = Hamming::SearchBest(query, data.data(), stride, nullptr, count);
+  EXPECT_EQ(matches.best_distance, best);
+  EXPECT_EQ(matches.best_index, best_idx);
+  EXPECT_EQ(matches.second_distance, second);
+  EXPECT_EQ(matches.second_index, second_idx);
+
+  // The indexed search reports the indices themselves.
+  const std::vector<std::size_t> indices = {7, static_cast<std::size_t>(best_idx), 3};
+  const Hamming::BestMatches indexed     = Hamming::SearchBest(query, data.data(), stride, indices.data(), indices.size());
+  EXPECT_EQ(indexed.best_index, best_idx);
+  EXPECT_EQ(indexed.best_distance, best);
+
+  // Empty search.
+  const Hamming::BestMatches empty = Hamming::SearchBest(query, data.data(), stride, nullptr, 0);
+  EXPECT_EQ(empty.best_index, -1);
+  EXPECT_EQ(empty.second_index, -1);
+}
@@ -0,0 +1,234 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+// 3rdparty
+#include <opencv2/imgproc.hpp>
+// Local
+#include "orbslam3/ImageInput.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+// Fixed-point weights of cv::cvtColor (RGB to gray, ITU-R BT.601).
+constexpr int kGrayShift   = 14;
+constexpr int kRedWeight   = 4899;
+constexpr int kGreenWeight = 9617;
+constexpr int kBlueWeight  = 1868;
+constexpr int kGrayRound   = 1 << (kGrayShift - 1);
+
+template <int kChannels, int kRed, int kBlue>
+void ColorRowToGray(const std::uint8_t* src, const int width, std::uint8_t* dst) {
+  for (int x = 0; x < width; ++x, src += kChannels) {
+    dst[x] = static_cast<std::uint8_t>(
+      (src[kRed] * kRedWeight + src[1] * kGreenWeight + src[kBlue] * kBlueWeight + kGrayRound) >> kGrayShift
+    );
+  }
+}
+
+template <typename T>
+void ScaleRow(const T* src, const float factor, const int width, float* dst) {
+  for (int x = 0; x < width; ++x) {
+    dst[x] = static_cast<float>(src[x]) * factor;
+  }
+}
+
+void CheckView(const void* data, const int width, const int height, const std::size_t step, const std::size_t pixel_size) {
+  if (data == nullptr || width <= 0 || height <= 0 || step < width * pixel_size) {
+    throw std::invalid_argument("Invalid image view");
+  }
+}
+
+std::size_t DepthSize(const DepthFormat format) {
+  return format == DepthFormat::kUInt16 ? sizeof(std::uint16_t) : sizeof(float);
+}
+
+} // namespace
+
+int Channels(const PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kGray8:
+      return 1;
+    case PixelFormat::kRGB8:
+    case PixelFormat::kBGR8:
+      return 3;
+    case PixelFormat::kRGBA8:
+    case PixelFormat::kBGRA8:
+      return 4;
+  }
+  return 1;
+}
+
+void ConvertRowToGray(const std::uint8_t* src, const PixelFormat format, const int width, std::uint8_t* dst) {
+  switch (format) {
+    case PixelFormat::kGray8:
+      std::memcpy(dst, src, width);
+      break;
+    case PixelFormat::kRGB8:
+      ColorRowToGray<3, 0, 2>(src, width, dst);
+      break;
+    case PixelFormat::kBGR8:
+      ColorRowToGray<3, 2, 0>(src, width, dst);
+      break;
+    case PixelFormat::kRGBA8:
+      ColorRowToGray<4, 0, 2>(src, width, dst);
+      break;
+    case PixelFormat::kBGRA8:
+      ColorRowToGray<4, 2, 0>(src, width, dst);
+      break;
+  }
+}
+
+void ConvertRowToDepth(const void* src, const DepthFormat format, const float factor, const int width, float* dst) {
+  if (format == DepthFormat::kUInt16) {
+    ScaleRow(static_cast<const std::uint16_t*>(src), factor, width, dst);
+  } else {
+    ScaleRow(static_cast<const float*>(src), factor, width, dst);
+  }
+}
+
+void BilinearResampler::ComputeTaps(const int src_size, const int dst_size, int* ofs, float* alpha) {
+  const float scale = static_cast<float>(src_size) / dst_size;
+  for (int i = 0; i < dst_size; ++i) {
+    const float f = (i + 0.5f) * scale - 0.5f;
+    int i0        = static_cast<int>(std::floor(f));
+    float a       = f - i0;
+    if (i0 < 0) {
+      i0 = 0;
+      a  = 0.f;
+    } else if (i0 >= src_size - 1) {
+      i0 = src_size - 1;
+      a  = 0.f;
+    }
+    ofs[i]   = i0;
+    alpha[i] = a;
+  }
+}
+
+// ─────────────────────────────────────────────────────────────────────────── //
+
+cv::Mat ImageConverter::ToGray(const ImageView& src, const cv::Size& size) {
+  const int channels = Channels(src.format);
+  CheckView(src.data, src.width, src.height, src.step, channels);
+
+  const cv::Size dst_size = size.empty() ? cv::Size(src.width, src.height) : size;
+  cv::Mat dst             = Acquire(dst_size, CV_8U);
+  if (dst_size.width == src.width && dst_size.height == src.height) {
+    for (int y = 0; y < src.height; ++y) {
+      ConvertRowToGray(src.data + y * src.step, src.format, src.width, dst.ptr<std::uint8_t>(y));
+    }
+    return dst;
+  }
+
+  gray_row_.resize(src.width);
+  resampler_.Resample(
+    src.width,
+    src.height,
+    dst_size.width,
+    dst_size.height,
+    [&](const int y, float* row) {
+      ConvertRowToGray(src.data + y * src.step, src.format, src.width, gray_row_.data());
+      for (int x = 0; x < src.width; ++x) {
+        row[x] = gray_row_[x];
+      }
+    },
+    [&](const int y, const float* row) {
+      std::uint8_t* out = dst.ptr<std::uint8_t>(y);
+      for (int x = 0; x < dst_size.width; ++x) {
+        out[x] = cv::saturate_cast<std::uint8_t>(row[x]);
+      }
+    }
+  );
+  return dst;
+}
+
+cv::Mat ImageConverter::ToDepth(const DepthView& src, const float factor, const cv::Size& size) {
+  CheckView(src.data, src.width, src.height, src.step, DepthSize(src.format));
+
+  const cv::Size dst_size = size.empty() ? cv::Size(src.width, src.height) : size;
+  cv::Mat dst             = Acquire(dst_size, CV_32F);
+  const auto source_row   = [&src](const int y) {
+    return static_cast<const std::uint8_t*>(src.data) + y * src.step;
+  };
+  if (dst_size.width == src.width && dst_size.height == src.height) {
+    for (int y = 0; y < src.height; ++y) {
+      ConvertRowToDepth(source_row(y), src.format, factor, src.width, dst.ptr<float>(y));
+    }
+    return dst;
+  }
+
+  resampler_.Resample(
+    src.width,
+    src.height,
+    dst_size.width,
+    dst_size.height,
+    [&](const int y, float* row) { ConvertRowToDepth(source_row(y), src.format, factor, src.width, row); },
+    [&](const int y, const float* row) { std::memcpy(dst.ptr<float>(y), row, dst_size.width * sizeof(float)); }
+  );
+  return dst;
+}
+
+cv::Mat ImageConverter::Remap(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2) {
+  cv::Mat dst = Acquire(map1.size(), src.type());
+  cv::remap(src, dst, map1, map2, cv::INTER_LINEAR);
+  return dst;
+}
+
+std::size_t ImageConverter::PooledBuffers() const {
+  return pool_.size();
+}
+
+std::size_t ImageConverter::Allocations() const {
+  return allocations_;
+}
+
+cv::Mat ImageConverter::Acquire(const cv::Size& size, const int type) {
+  // A buffer is free when the pool holds the only reference to it.
+  const auto is_free = [](cv::Mat& buffer) {
+    return buffer.u != nullptr && CV_XADD(&buffer.u->refcount, 0) == 1;
+  };
+
+  cv::Mat* stale = nullptr;
+  for (cv::Mat& buffer : pool_) {
+    if (!is_free(buffer)) {
+      continue;
+    }
+    if (buffer.size() == size && buffer.type() == type) {
+      return buffer;
+    }
+    stale = &buffer;
+  }
+
+  // Replace a free buffer of another geometry (e.g. after a change of resolution) before growing.
+  ++allocations_;
+  if (stale != nullptr) {
+    stale->create(size, type);
+    return *stale;
+  }
+  pool_.emplace_back(size, type);
+  return pool_.back();
+}
+
+} // namespace ORB_SLAM3
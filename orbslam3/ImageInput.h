@@ -0,0 +1,191 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_INPUT_H
+#define IMAGE_INPUT_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+// 3rdparty
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+
+enum class PixelFormat { kGray8, kRGB8, kBGR8, kRGBA8, kBGRA8 };
+enum class DepthFormat { kUInt16, kFloat32 };
+
+// Caller-owned image (e.g. a camera driver buffer), read in place: the pixels
+// are converted straight into the buffers of the tracking.
+struct ImageView {
+  const std::uint8_t* data = nullptr;
+  int width                = 0;
+  int height               = 0;
+  std::size_t step         = 0; // Bytes between the starts of two rows
+  PixelFormat format       = PixelFormat::kGray8;
+};
+
+// Caller-owned depth map, in the units given by the depth map factor.
+struct DepthView {
+  const void* data   = nullptr;
+  int width          = 0;
+  int height         = 0;
+  std::size_t step   = 0; // Bytes between the starts of two rows
+  DepthFormat format = DepthFormat::kUInt16;
+};
+
+// Called once the pixels of the views are converted, the caller can then
+// reuse its buffers.
+using ReleaseCallback = std::function<void()>;
+
+// Number of channels of a pixel format.
+int Channels(const PixelFormat format);
+
+// ─────────────────────────────────────────────────────────────────────────── //
+
+// Kernels of the converter, on raw rows.
+
+// Gray levels of `width` pixels, with the fixed-point weights of cv::cvtColor
+// (bit-exact with it).
+void ConvertRowToGray(const std::uint8_t* src, const PixelFormat format, const int width, std::uint8_t* dst);
+
+// Metric depths of `width` pixels.
+void ConvertRowToDepth(const void* src, const DepthFormat format, const float factor, const int width, float* dst);
+
+// Bilinear resampling, with the pixel centers of cv::resize (INTER_LINEAR):
+// every source row is converted once, by fetch_row(y, float* row), then
+// interpolated and handed to store_row(y, const float* row). The scratch
+// buffers are only reallocated when they grow.
+class BilinearResampler {
+public:
+  template <typename FetchRow, typename StoreRow>
+  void Resample(
+    const int src_width,
+    const int src_height,
+    const int dst_width,
+    const int dst_height,
+    FetchRow&& fetch_row,
+    StoreRow&& store_row
+  );
+
+private:
+  // Source index and weight of the next index, for every destination index
+  // (the weight is 0 on the borders, where the next index would be outside).
+  static void ComputeTaps(const int src_size, const int dst_size, int* ofs, float* alpha);
+
+  std::vector<float> rows_;   // Two converted source rows
+  std::vector<float> dst_row_;
+  std::vector<int> xofs_;
+  std::vector<float> xalpha_;
+  std::vector<int> yofs_;
+  std::vector<float> yalpha_;
+};
+
+template <typename FetchRow, typename StoreRow>
+void BilinearResampler::Resample(
+  const int src_width,
+  const int src_height,
+  const int dst_width,
+  const int dst_height,
+  FetchRow&& fetch_row,
+  StoreRow&& store_row
+) {
+  rows_.resize(2 * static_cast<std::size_t>(src_width));
+  dst_row_.resize(dst_width);
+  xofs_.resize(dst_width);
+  xalpha_.resize(dst_width);
+  yofs_.resize(dst_height);
+  yalpha_.resize(dst_height);
+  ComputeTaps(src_width, dst_width, xofs_.data(), xalpha_.data());
+  ComputeTaps(src_height, dst_height, yofs_.data(), yalpha_.data());
+
+  // Source rows held in the two slots of rows_, -1 when empty.
+  int held[2] = {-1, -1};
+  const auto row = [&](const int y) -> const float* {
+    for (int slot = 0; slot < 2; ++slot) {
+      if (held[slot] == y) {
+        return rows_.data() + slot * static_cast<std::size_t>(src_width);
+      }
+    }
+    // Rows are requested in increasing order: replace the lowest one.
+    const int slot = held[0] < held[1] ? 0 : 1;
+    float* data    = rows_.data() + slot * static_cast<std::size_t>(src_width);
+    fetch_row(y, data);
+    held[slot] = y;
+    return data;
+  };
+
+  for (int y = 0; y < dst_height; ++y) {
+    const int y0        = yofs_[y];
+    const float beta    = yalpha_[y];
+    const float* top    = row(y0);
+    const float* bottom = beta > 0.f ? row(y0 + 1) : top;
+
+    for (int x = 0; x < dst_width; ++x) {
+      const int x0      = xofs_[x];
+      const int x1      = x0 + (xalpha_[x] > 0.f ? 1 : 0);
+      const float alpha = xalpha_[x];
+      const float t     = top[x0] + alpha * (top[x1] - top[x0]);
+      const float b     = bottom[x0] + alpha * (bottom[x1] - bottom[x0]);
+      dst_row_[x]       = t + beta * (b - t);
+    }
+    store_row(y, dst_row_.data());
+  }
+}
+
+// ─────────────────────────────────────────────────────────────────────────── //
+
+// Converts the views into pooled cv::Mat buffers: color conversion, scaling and
+// depth conversion are fused in one pass over the source. A buffer returns to
+// the pool once the last cv::Mat referring to it is released, so in steady
+// state no buffer is allocated. Not thread-safe: a converter serves one thread
+// at a time.
+class ImageConverter {
+public:
+  // Gray image of the given size (the size of the view when empty).
+  cv::Mat ToGray(const ImageView& src, const cv::Size& size = cv::Size());
+
+  // CV_32F depth map, scaled by `factor`, of the given size (the size of the
+  // view when empty).
+  cv::Mat ToDepth(const DepthView& src, const float factor, const cv::Size& size = cv::Size());
+
+  // Remap (e.g. rectify) a gray image into a pooled buffer.
+  cv::Mat Remap(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2);
+
+  std::size_t PooledBuffers() const;
+  // Buffers allocated since the creation of the converter.
+  std::size_t Allocations() const;
+
+private:
+  // A free buffer of the given geometry, allocated if there is none.
+  cv::Mat Acquire(const cv::Size& size, const int type);
+
+  std::vector<cv::Mat> pool_;
+  std::size_t allocations_ = 0;
+  BilinearResampler resampler_;
+  std::vector<std::uint8_t> gray_row_; // Source row converted to gray, before the resampling
+};
+
+} // namespace ORB_SLAM3
+
+#endif // IMAGE_INPUT_H
@@ -0,0 +1,97 @@
+// Standard
+#include <cstdint>
+#include <stdexcept>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <opencv2/imgproc.hpp>
+// Local
+#include "orbslam3/ImageInput.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Random image whose rows are padded, as the buffers of a camera driver.
+cv::Mat RandomImage(const int width, const int height, const int type) {
+  cv::Mat padded(height, width + 16, type);
+  cv::randu(padded, cv::Scalar::all(0), cv::Scalar::all(256));
+  return padded.colRange(0, width);
+}
+
+ImageView View(const cv::Mat& image, const PixelFormat format) {
+  ImageView view;
+  view.data   = image.data;
+  view.width  = image.cols;
+  view.height = image.rows;
+  view.step   = image.step;
+  view.format = format;
+  return view;
+}
+
+} // namespace
+
+TEST(ImageInput, Gray) {
+  ImageConverter converter;
+  const cv::Mat bgr = RandomImage(64, 48, CV_8UC3);
+  cv::Mat expected;
+  cv::cvtColor(bgr, expected, cv::COLOR_BGR2GRAY);
+  EXPECT_EQ(cv::norm(converter.ToGray(View(bgr, PixelFormat::kBGR8)), expected, cv::NORM_INF), 0.0);
+
+  const cv::Mat rgba = RandomImage(64, 48, CV_8UC4);
+  cv::cvtColor(rgba, expected, cv::COLOR_RGBA2GRAY);
+  EXPECT_EQ(cv::norm(converter.ToGray(View(rgba, PixelFormat::kRGBA8)), expected, cv::NORM_INF), 0.0);
+
+  // Color conversion and scaling in one pass, as cvtColor then resize.
+  cv::Mat gray;
+  cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+  for (const cv::Size size : {cv::Size(32, 24), cv::Size(100, 70)}) {
+    cv::resize(gray, expected, size, 0, 0, cv::INTER_LINEAR);
+    const cv::Mat resized = converter.ToGray(View(bgr, PixelFormat::kBGR8), size);
+    ASSERT_EQ(resized.size(), size);
+    EXPECT_LE(cv::norm(resized, expected, cv::NORM_INF), 1.0);
+  }
+}
+
+TEST(ImageInput, Depth) {
+  ImageConverter converter;
+  cv::Mat depth(48, 64, CV_16U);
+  cv::randu(depth, cv::Scalar::all(0), cv::Scalar::all(10000));
+
+  DepthView view;
+  view.data   = depth.data;
+  view.width  = depth.cols;
+  view.height = depth.rows;
+  view.step   = depth.step;
+  view.format = DepthFormat::kUInt16;
+
+  cv::Mat expected;
+  depth.convertTo(expected, CV_32F, 1.0 / 5000.0);
+  const cv::Mat converted = converter.ToDepth(view, 1.f / 5000.f);
+  ASSERT_EQ(converted.type(), CV_32F);
+  EXPECT_LE(cv::norm(converted, expected, cv::NORM_INF), 1e-6);
+}
+
+TEST(ImageInput, Pool) {
+  ImageConverter converter;
+  const cv::Mat bgr = RandomImage(64, 48, CV_8UC3);
+  const ImageView view = View(bgr, PixelFormat::kBGR8);
+
+  // A buffer still referred to is not reused.
+  cv::Mat first        = converter.ToGray(view);
+  const cv::Mat second = converter.ToGray(view);
+  EXPECT_NE(first.data, second.data);
+  EXPECT_EQ(converter.Allocations(), 2u);
+
+  // Released buffers are reused, without allocation.
+  const std::uint8_t* data = first.data;
+  first.release();
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(converter.ToGray(view).data, data);
+  }
+  EXPECT_EQ(converter.Allocations(), 2u);
+  EXPECT_EQ(converter.PooledBuffers(), 2u);
+
+  ImageView invalid = view;
+  invalid.step      = 10;
+  EXPECT_THROW(converter.ToGray(invalid), std::invalid_argument);
+}
@@ -0,0 +1,515 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// Standard
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+// 3rdparty
+#include <Eigen/Cholesky>
+#include <Eigen/SVD>
+// Local
+#include "orbslam3/G2oTypes.h"
+#include "orbslam3/ImuTypes.h"
+#include "orbslam3/InertialPoseSolver.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+const double kDeltaMono   = std::sqrt(5.991);
+const double kDeltaStereo = std::sqrt(7.815);
+
+// Threshold under which Optimizer::Marginalize drops a singular value.
+constexpr double kMinSingularValue = 1e-6;
+
+// Weight of an error of chi2 e2 in the normal equations under the Huber kernel
+// of g2o::RobustKernelHuber.
+double HuberWeight(const double e2, const double delta) {
+  return e2 <= delta * delta ? 1.0 : delta / std::sqrt(e2);
+}
+
+// Derivative of an error under the body update of VertexPose, from the
+// derivative J_b of the projection wrt the body point x_b: J_b * [-[x_b]x | I].
+template <int D>
+void BodyJacobian(const Eigen::Matrix<double, D, 3>& J_b, const Eigen::Vector3d& x_b, Eigen::Matrix<double, D, 6>& J) {
+  for (int k = 0; k < D; ++k) {
+    const double a = J_b(k, 0), b = J_b(k, 1), c = J_b(k, 2);
+    J(k, 0) = c * x_b.y() - b * x_b.z();
+    J(k, 1) = a * x_b.z() - c * x_b.x();
+    J(k, 2) = b * x_b.x() - a * x_b.y();
+    J(k, 3) = a;
+    J(k, 4) = b;
+    J(k, 5) = c;
+  }
+}
+
+// Add an observation with the information info * I to the normal equations of
+// the pose.
+template <int D>
+void AccumulatePose(
+  const Eigen::Matrix<double, D, 1>& e,
+  const Eigen::Matrix<double, D, 6>& J,
+  const double info,
+  const double delta,
+  const bool robust,
+  Matrix6d& H,
+  Vector6d& b
+) {
+  const double w                        = info * (robust ? HuberWeight(info * e.squaredNorm(), delta) : 1.0);
+  const Eigen::Matrix<double, 6, D> JtW = w * J.transpose();
+  H.noalias() += JtW * J;
+  b.noalias() -= JtW * e;
+}
+
+// Update of the vertices of a state, as VertexPose::oplusImpl and the
+// additive velocity and bias vertices.
+void Update(ImuState& state, const Vector15d& dx) {
+  state.t_wb += state.R_wb * dx.segment<3>(3);
+  state.R_wb = normalizeRotation(state.R_wb * expSO3(dx.head<3>()));
+  state.v_wb += dx.segment<3>(6);
+  state.bias_gyro += dx.segment<3>(9);
+  state.bias_acc += dx.segment<3>(12);
+}
+
+} // namespace
+
+const InertialPoseSolver::Thresholds InertialPoseSolver::kLastKeyFrame = {
+  {12.f, 7.5f, 5.991f, 5.991f},
+  {15.6f, 9.8f, 7.815f, 7.815f}
+};
+
+const InertialPoseSolver::Thresholds InertialPoseSolver::kLastFrame = {
+  {5.991f, 5.991f, 5.991f, 5.991f},
+  {15.6f, 9.8f, 7.815f, 7.815f}
+};
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Observations
+
+void InertialPoseSolver::Observations::Clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  u.clear();
+  v.clear();
+  u_right.clear();
+  info.clear();
+  index.clear();
+  cam.clear();
+  close.clear();
+  outlier.clear();
+}
+
+void InertialPoseSolver::Observations::Add(
+  const std::size_t i,
+  const Eigen::Vector3d& x_w,
+  const double obs_u,
+  const double obs_v,
+  const double inv_sigma2
+) {
+  x.push_back(x_w.x());
+  y.push_back(x_w.y());
+  z.push_back(x_w.z());
+  u.push_back(obs_u);
+  v.push_back(obs_v);
+  info.push_back(inv_sigma2);
+  index.push_back(static_cast<std::uint32_t>(i));
+  outlier.push_back(0);
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Problem
+
+void InertialPoseSolver::Reset(
+  const GeometricCamera* left,
+  const Sophus::SE3d& T_cb,
+  const double bf,
+  const GeometricCamera* right,
+  const Sophus::SE3d& T_rl
+) {
+  cameras_[0].Set(left);
+  R_cb_[0] = T_cb.rotationMatrix();
+  t_cb_[0] = T_cb.translation();
+  cameras_[1].Set(right);
+  R_cb_[1] = T_rl.rotationMatrix() * R_cb_[0];
+  t_cb_[1] = T_rl.rotationMatrix() * t_cb_[0] + T_rl.translation();
+  bf_      = bf;
+
+  preintegrated_ = nullptr;
+  prior_         = nullptr;
+  mono_.Clear();
+  stereo_.Clear();
+}
+
+void InertialPoseSolver::AddMono(
+  const std::size_t index,
+  const Eigen::Vector3d& x_w,
+  const Eigen::Vector2d& uv,
+  const double inv_sigma2,
+  const std::size_t cam_idx,
+  const bool close
+) {
+  assert(cam_idx < 2 && cameras_[cam_idx].camera != nullptr);
+  mono_.Add(index, x_w, uv.x(), uv.y(), inv_sigma2);
+  mono_.cam.push_back(static_cast<std::uint8_t>(cam_idx));
+  mono_.close.push_back(close);
+}
+
+void InertialPoseSolver::AddStereo(
+  const std::size_t index,
+  const Eigen::Vector3d& x_w,
+  const Eigen::Vector3d& uvr,
+  const double inv_sigma2
+) {
+  stereo_.Add(index, x_w, uvr.x(), uvr.y(), inv_sigma2);
+  stereo_.u_right.push_back(uvr.z());
+}
+
+void InertialPoseSolver::SetInertial(
+  IMU::Preintegrated* preintegrated,
+  const Eigen::Matrix3d& info_gyro,
+  const Eigen::Matrix3d& info_acc
+) {
+  preintegrated_ = preintegrated;
+  JR_gyro_       = preintegrated->JR_gyro.cast<double>();
+  JV_gyro_       = preintegrated->JV_gyro.cast<double>();
+  JP_gyro_       = preintegrated->JP_gyro.cast<double>();
+  JV_acc_        = preintegrated->JV_acc.cast<double>();
+  JP_acc_        = preintegrated->JP_acc.cast<double>();
+  dt_            = preintegrated->t;
+  info_gyro_     = info_gyro;
+  info_acc_      = info_acc;
+
+  // Information of EdgeInertial, without its negative eigenvalues.
+  Matrix9d info = preintegrated->C.block<9, 9>(0, 0).cast<double>().inverse();
+  info          = (info + info.transpose()) / 2.0;
+  Eigen::SelfAdjointEigenSolver<Matrix9d> solver(info);
+  Vector9d eigens = solver.eigenvalues();
+  for (int i = 0; i < 9; ++i) {
+    if (eigens[i] < 1e-12) {
+      eigens[i] = 0.0;
+    }
+  }
+  info_inertial_ = solver.eigenvectors() * eigens.asDiagonal() * solver.eigenvectors().transpose();
+}
+
+void InertialPoseSolver::SetPrior(const ConstraintPoseImu* prior) {
+  prior_ = prior;
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Errors
+
+Eigen::Vector2d InertialPoseSolver::MonoError(
+  const std::size_t i,
+  const BodyPose& pose,
+  Eigen::Matrix<double, 2, 6>* J,
+  double& depth
+) const {
+  const std::size_t k       = mono_.cam[i];
+  const Eigen::Vector3d x_b = pose.R_bw * (Eigen::Vector3d(mono_.x[i], mono_.y[i], mono_.z[i]) - pose.t_wb);
+  const Eigen::Vector3d x_c = R_cb_[k] * x_b + t_cb_[k];
+  depth                     = x_c.z();
+  Eigen::Vector2d uv;
+  Eigen::Matrix<double, 2, 3> J_uv;
+  cameras_[k].Project(x_c, uv, J_uv);
+  if (J != nullptr) {
+    BodyJacobian<2>(J_uv * R_cb_[k], x_b, *J);
+  }
+  return Eigen::Vector2d(mono_.u[i] - uv.x(), mono_.v[i] - uv.y());
+}
+
+Eigen::Vector3d InertialPoseSolver::StereoError(
+  const std::size_t i,
+  const BodyPose& pose,
+  Eigen::Matrix<double, 3, 6>* J
+) const {
+  const Eigen::Vector3d x_b = pose.R_bw * (Eigen::Vector3d(stereo_.x[i], stereo_.y[i], stereo_.z[i]) - pose.t_wb);
+  const Eigen::Vector3d x_c = R_cb_[0] * x_b + t_cb_[0];
+  Eigen::Vector2d uv;
+  Eigen::Matrix<double, 2, 3> J_uv;
+  cameras_[0].Project(x_c, uv, J_uv);
+  if (J != nullptr) {
+    Eigen::Matrix3d J_uvr;
+    J_uvr.topRows<2>() = J_uv;
+    J_uvr.row(2)       = J_uv.row(0);
+    J_uvr(2, 2) += bf_ / (x_c.z() * x_c.z());
+    BodyJacobian<3>(J_uvr * R_cb_[0], x_b, *J);
+  }
+  return Eigen::Vector3d(
+    stereo_.u[i] - uv.x(),
+    stereo_.v[i] - uv.y(),
+    stereo_.u_right[i] - (uv.x() - bf_ / x_c.z())
+  );
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Solver
+
+void InertialPoseSolver::Linearize(
+  const ImuState& current,
+  const ImuState& previous,
+  const bool robust_visual,
+  const bool robust_prior,
+  Matrix30d& H,
+  Vector30d& b
+) const {
+  H.setZero();
+  b.setZero();
+
+  // Observations of the current frame, on its pose.
+  const BodyPose pose{current.R_wb.transpose(), current.t_wb};
+  Matrix6d H_pose = Matrix6d::Zero();
+  Vector6d b_pose = Vector6d::Zero();
+  Eigen::Matrix<double, 2, 6> J2;
+  Eigen::Matrix<double, 3, 6> J3;
+  double depth;
+  for (std::size_t i = 0; i < mono_.Size(); ++i) {
+    if (!mono_.outlier[i]) {
+      const Eigen::Vector2d e = MonoError(i, pose, &J2, depth);
+      AccumulatePose<2>(e, J2, mono_.info[i], kDeltaMono, robust_visual, H_pose, b_pose);
+    }
+  }
+  for (std::size_t i = 0; i < stereo_.Size(); ++i) {
+    if (!stereo_.outlier[i]) {
+      const Eigen::Vector3d e = StereoError(i, pose, &J3);
+      AccumulatePose<3>(e, J3, stereo_.info[i], kDeltaStereo, robust_visual, H_pose, b_pose);
+    }
+  }
+  H.topLeftCorner<6, 6>() = H_pose;
+  b.head<6>()             = b_pose;
+
+  // Preintegrated measurements, as EdgeInertial, with the biases of the
+  // previous frame. Current frame in columns 0-14, previous one in 15-29.
+  const IMU::Bias bias(
+    static_cast<float>(previous.bias_acc.x()),
+    static_cast<float>(previous.bias_acc.y()),
+    static_cast<float>(previous.bias_acc.z()),
+    static_cast<float>(previous.bias_gyro.x()),
+    static_cast<float>(previous.bias_gyro.y()),
+    static_cast<float>(previous.bias_gyro.z())
+  );
+  const Eigen::Matrix3d dR         = preintegrated_->getDeltaRotation(bias).cast<double>();
+  const Eigen::Vector3d dV         = preintegrated_->getDeltaVelocity(bias).cast<double>();
+  const Eigen::Vector3d dP         = preintegrated_->getDeltaPosition(bias).cast<double>();
+  const Eigen::Vector3d dbias_gyro = preintegrated_->getDeltaBias(bias).gyro().cast<double>();
+  const Eigen::Vector3d g(0.0, 0.0, -IMU::kGravity);
+
+  const Eigen::Matrix3d R_bw_1 = previous.R_wb.transpose();
+  const Eigen::Matrix3d eR     = dR.transpose() * R_bw_1 * current.R_wb;
+  const Eigen::Vector3d er     = logSO3(eR);
+  const Eigen::Vector3d dv     = R_bw_1 * (current.v_wb - previous.v_wb - g * dt_);
+  const Eigen::Vector3d dp     = R_bw_1 * (current.t_wb - previous.t_wb - previous.v_wb * dt_ - g * dt_ * dt_ / 2.0);
+  const Eigen::Matrix3d Jr_inv = inverseRightJacobianSO3(er);
+
+  Vector9d e_inertial;
+  e_inertial << er, dv - dV, dp - dP;
+
+  Eigen::Matrix<double, 9, 30> J_inertial = Eigen::Matrix<double, 9, 30>::Zero();
+  J_inertial.block<3, 3>(0, 0)  = Jr_inv;
+  J_inertial.block<3, 3>(6, 3)  = R_bw_1 * current.R_wb;
+  J_inertial.block<3, 3>(3, 6)  = R_bw_1;
+  J_inertial.block<3, 3>(0, 15) = -Jr_inv * current.R_wb.transpose() * previous.R_wb;
+  J_inertial.block<3, 3>(3, 15) = Sophus::SO3d::hat(dv);
+  J_inertial.block<3, 3>(6, 15) = Sophus::SO3d::hat(dp);
+  J_inertial.block<3, 3>(6, 18) = -Eigen::Matrix3d::Identity();
+  J_inertial.block<3, 3>(3, 21) = -R_bw_1;
+  J_inertial.block<3, 3>(6, 21) = -R_bw_1 * dt_;
+  J_inertial.block<3, 3>(0, 24) = -Jr_inv * eR.transpose() * rightJacobianSO3(JR_gyro_ * dbias_gyro) * JR_gyro_;
+  J_inertial.block<3, 3>(3, 24) = -JV_gyro_;
+  J_inertial.block<3, 3>(6, 24) = -JP_gyro_;
+  J_inertial.block<3, 3>(3, 27) = -JV_acc_;
+  J_inertial.block<3, 3>(6, 27) = -JP_acc_;
+
+  // A fixed previous frame only needs the block of the current one.
+  if (prior_ == nullptr) {
+    const Eigen::Matrix<double, 15, 9> JtW = J_inertial.leftCols<15>().transpose() * info_inertial_;
+    H.topLeftCorner<15, 15>().noalias() += JtW * J_inertial.leftCols<15>();
+    b.head<15>().noalias() -= JtW * e_inertial;
+  } else {
+    const Eigen::Matrix<double, 30, 9> JtW = J_inertial.transpose() * info_inertial_;
+    H.noalias() += JtW * J_inertial;
+    b.noalias() -= JtW * e_inertial;
+  }
+
+  // Random walks of the biases, as EdgeGyroRW and EdgeAccRW.
+  const auto random_walk = [&H, &b](const int c, const int p, const Eigen::Matrix3d& info, const Eigen::Vector3d& e) {
+    H.block<3, 3>(c, c) += info;
+    H.block<3, 3>(p, p) += info;
+    H.block<3, 3>(c, p) -= info;
+    H.block<3, 3>(p, c) -= info;
+    b.segment<3>(c) -= info * e;
+    b.segment<3>(p) += info * e;
+  };
+  random_walk(9, 24, info_gyro_, current.bias_gyro - previous.bias_gyro);
+  random_walk(12, 27, info_acc_, current.bias_acc - previous.bias_acc);
+
+  // Prior of the previous frame, as EdgePriorPoseImu.
+  if (prior_ != nullptr) {
+    const Eigen::Matrix3d R_prior = prior_->R_wb_.transpose() * previous.R_wb;
+    Vector15d e_prior;
+    e_prior << logSO3(R_prior),
+               prior_->R_wb_.transpose() * (previous.t_wb - prior_->t_wb_),
+               previous.v_wb - prior_->v_wb_,
+               previous.bias_gyro - prior_->bias_gyro_,
+               previous.bias_acc - prior_->bias_acc_;
+
+    Matrix15d J_prior         = Matrix15d::Identity();
+    J_prior.block<3, 3>(0, 0) = inverseRightJacobianSO3(e_prior.head<3>());
+    J_prior.block<3, 3>(3, 3) = R_prior;
+
+    const double chi2         = e_prior.dot(prior_->H_ * e_prior);
+    const double w            = robust_prior ? HuberWeight(chi2, kPriorDelta) : 1.0;
+    const Matrix15d JtW_prior = w * J_prior.transpose() * prior_->H_;
+    H.bottomRightCorner<15, 15>().noalias() += JtW_prior * J_prior;
+    b.tail<15>().noalias() -= JtW_prior * e_prior;
+  }
+}
+
+void InertialPoseSolver::Optimize(ImuState& current, ImuState& previous, const bool robust) const {
+  Matrix30d H;
+  Vector30d b;
+  Vector30d dx = Vector30d::Zero();
+  for (int iteration = 0; iteration < kIterations; ++iteration) {
+    Linearize(current, previous, robust, true, H, b);
+    // Like the dense linear solver of g2o, stop on a system that is not
+    // positive semi-definite.
+    if (prior_ != nullptr) {
+      const Eigen::LDLT<Matrix30d> ldlt(H);
+      if (!ldlt.isPositive()) {
+        break;
+      }
+      dx = ldlt.solve(b);
+    } else {
+      const Eigen::LDLT<Matrix15d> ldlt(H.topLeftCorner<15, 15>());
+      if (!ldlt.isPositive()) {
+        break;
+      }
+      dx.head<15>() = ldlt.solve(b.head<15>());
+    }
+
+    Update(current, dx.head<15>());
+    if (prior_ != nullptr) {
+      Update(previous, dx.tail<15>());
+    }
+  }
+}
+
+int InertialPoseSolver::Classify(const ImuState& current, const float chi2_mono, const float chi2_stereo) {
+  const BodyPose pose{current.R_wb.transpose(), current.t_wb};
+  const float chi2_close = kCloseFactor * chi2_mono;
+  int n_bad              = 0;
+  double depth;
+  for (std::size_t i = 0; i < mono_.Size(); ++i) {
+    const float chi2 = static_cast<float>(mono_.info[i] * MonoError(i, pose, nullptr, depth).squaredNorm());
+    const bool close = mono_.close[i] != 0;
+    mono_.outlier[i] = (chi2 > chi2_mono && !close) || (close && chi2 > chi2_close) || depth <= 0.0;
+    n_bad += mono_.outlier[i];
+  }
+  for (std::size_t i = 0; i < stereo_.Size(); ++i) {
+    const float chi2   = static_cast<float>(stereo_.info[i] * StereoError(i, pose, nullptr).squaredNorm());
+    stereo_.outlier[i] = chi2 > chi2_stereo;
+    n_bad += stereo_.outlier[i];
+  }
+  return n_bad;
+}
+
+int InertialPoseSolver::Recover(const ImuState& current) {
+  const BodyPose pose{current.R_wb.transpose(), current.t_wb};
+  int n_bad = 0;
+  double depth;
+  for (std::size_t i = 0; i < mono_.Size(); ++i) {
+    if (mono_.info[i] * MonoError(i, pose, nullptr, depth).squaredNorm() < kChi2MonoRecover) {
+      mono_.outlier[i] = 0;
+    } else {
+      ++n_bad;
+    }
+  }
+  for (std::size_t i = 0; i < stereo_.Size(); ++i) {
+    if (stereo_.info[i] * StereoError(i, pose, nullptr).squaredNorm() < kChi2StereoRecover) {
+      stereo_.outlier[i] = 0;
+    } else {
+      ++n_bad;
+    }
+  }
+  return n_bad;
+}
+
+int InertialPoseSolver::Solve(
+  ImuState& current,
+  ImuState& previous,
+  const Thresholds& thresholds,
+  const bool recover,
+  std::vector<bool>& outliers,
+  Matrix15d& H
+) {
+  assert(preintegrated_ != nullptr);
+  std::fill(mono_.outlier.begin(), mono_.outlier.end(), 0);
+  std::fill(stereo_.outlier.begin(), stereo_.outlier.end(), 0);
+
+  // Every round goes on from the state of the previous one. The inertial
+  // edges count in the size of the graph.
+  const int n       = static_cast<int>(NumObservations());
+  const int n_edges = n + (prior_ != nullptr ? 4 : 3);
+  int n_bad         = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    Optimize(current, previous, round < kRobustRounds);
+    n_bad = Classify(current, thresholds.mono[round], thresholds.stereo[round]);
+    if (n_edges < kMinForRounds) {
+      break;
+    }
+  }
+
+  if (recover && n - n_bad < kMinInliers) {
+    n_bad = Recover(current);
+  }
+
+  // Information of the refined state, without the kernels. A free previous
+  // frame is marginalized out with the pseudo-inverse of Optimizer::Marginalize.
+  Matrix30d H_all;
+  Vector30d b_all;
+  Linearize(current, previous, false, false, H_all, b_all);
+  if (prior_ == nullptr) {
+    H = H_all.topLeftCorner<15, 15>();
+  } else {
+    const Eigen::JacobiSVD<Matrix15d> svd(H_all.bottomRightCorner<15, 15>(), Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Vector15d inv_singular = svd.singularValues();
+    for (int i = 0; i < 15; ++i) {
+      inv_singular[i] = inv_singular[i] > kMinSingularValue ? 1.0 / inv_singular[i] : 0.0;
+    }
+    const Matrix15d H_pp_inv = svd.matrixV() * inv_singular.asDiagonal() * svd.matrixU().transpose();
+    H = H_all.topLeftCorner<15, 15>()
+      - H_all.topRightCorner<15, 15>() * H_pp_inv * H_all.bottomLeftCorner<15, 15>();
+  }
+
+  for (std::size_t i = 0; i < mono_.Size(); ++i) {
+    outliers[mono_.index[i]] = mono_.outlier[i] != 0;
+  }
+  for (std::size_t i = 0; i < stereo_.Size(); ++i) {
+    outliers[stereo_.index[i]] = stereo_.outlier[i] != 0;
+  }
+  return n - n_bad;
+}
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,219 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef INERTIAL_POSE_SOLVER_H
+#define INERTIAL_POSE_SOLVER_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+// 3rdparty
+#include <Eigen/Core>
+#include <orbslam3/external/Sophus/sophus/se3.hpp>
+// Local
+#include "orbslam3/PoseSolver.h"
+
+namespace ORB_SLAM3 {
+
+class ConstraintPoseImu;
+class GeometricCamera;
+
+namespace IMU {
+struct Preintegrated;
+} // namespace IMU
+
+// Body pose, velocity and biases of a frame, the vertices of a frame in the
+// inertial g2o graphs.
+struct ImuState {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  Eigen::Matrix3d R_wb      = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d t_wb      = Eigen::Vector3d::Zero();
+  Eigen::Vector3d v_wb      = Eigen::Vector3d::Zero();
+  Eigen::Vector3d bias_gyro = Eigen::Vector3d::Zero();
+  Eigen::Vector3d bias_acc  = Eigen::Vector3d::Zero();
+};
+
+// Visual-inertial refinement of the state of a frame, with the problems of
+// Optimizer::PoseInertialOptimizationLastKeyFrame and LastFrame: reprojection
+// errors of the frame, the preintegrated IMU measurements and the bias random
+// walks since the previous frame, and, when the previous frame is free, the
+// prior of its ConstraintPoseImu.
+//
+// The unknowns are the 15 dimensions of the frame, then the 15 of the previous
+// frame when it is free, in the order of the g2o vertices: rotation and
+// translation in the body frame, velocity, gyroscope and accelerometer biases.
+// The iterations are those of g2o::OptimizationAlgorithmGaussNewton on a fixed
+// 15x15 or 30x30 system, the observations are kept as contiguous arrays, so a
+// solver that is kept between frames does not allocate once its arrays have
+// grown to the number of matches.
+class InertialPoseSolver {
+public:
+  using Matrix15d = Eigen::Matrix<double, 15, 15>;
+  using Matrix30d = Eigen::Matrix<double, 30, 30>;
+  using Vector30d = Eigen::Matrix<double, 30, 1>;
+
+  // Schedule of the g2o graphs.
+  static constexpr int kRounds         = 4;  // outlier classifications
+  static constexpr int kIterations     = 10; // iterations per round
+  static constexpr int kRobustRounds   = 3;  // first rounds with the Huber kernel
+  static constexpr int kMinForRounds   = 10; // edges to run past the first round
+  static constexpr int kMinInliers     = 30; // inliers under which outliers are recovered
+  static constexpr float kChi2MonoRecover   = 18.f;
+  static constexpr float kChi2StereoRecover = 24.f;
+  static constexpr float kCloseFactor       = 1.5f; // of the mono threshold for close points
+  static constexpr double kPriorDelta       = 5.0;  // Huber delta of the prior
+
+  // Chi2 thresholds of the rounds.
+  struct Thresholds {
+    float mono[kRounds];
+    float stereo[kRounds];
+  };
+  static const Thresholds kLastKeyFrame; // of PoseInertialOptimizationLastKeyFrame
+  static const Thresholds kLastFrame;    // of PoseInertialOptimizationLastFrame
+
+  InertialPoseSolver() = default;
+
+  // Drop the problem of the previous frame and set the cameras: `left` with the
+  // transform from the body to the left camera, `right` with the transform from
+  // the left to the right camera, and bf for the stereo observations. The
+  // cameras are not owned.
+  void Reset(
+    const GeometricCamera* left,
+    const Sophus::SE3d& T_cb,
+    const double bf,
+    const GeometricCamera* right = nullptr,
+    const Sophus::SE3d& T_rl     = Sophus::SE3d()
+  );
+
+  // Observation `index` of the map point at `x_w` in camera cam_idx (0 left,
+  // 1 right), with the information inv_sigma2 * I. A close point gets a looser
+  // threshold. The index is the one of the outlier flags written by Solve.
+  void AddMono(
+    std::size_t index,
+    const Eigen::Vector3d& x_w,
+    const Eigen::Vector2d& uv,
+    double inv_sigma2,
+    std::size_t cam_idx,
+    bool close
+  );
+  // (u, v, u_right) in the left image.
+  void AddStereo(std::size_t index, const Eigen::Vector3d& x_w, const Eigen::Vector3d& uvr, double inv_sigma2);
+
+  // Measurements since the previous frame, and the information of the random
+  // walks of the gyroscope and accelerometer biases. Not owned.
+  void SetInertial(IMU::Preintegrated* preintegrated, const Eigen::Matrix3d& info_gyro, const Eigen::Matrix3d& info_acc);
+
+  // Free the previous frame with this prior, else it is fixed.
+  void SetPrior(const ConstraintPoseImu* prior);
+
+  std::size_t NumObservations() const { return mono_.Size() + stereo_.Size(); }
+
+  // Refine `current`, and `previous` when it has a prior, and write the class
+  // of each observation to outliers[index]. When `recover` and fewer than
+  // kMinInliers inliers remain, the outliers under the recover thresholds are
+  // inliers again. H is the information of the refined current state, the
+  // previous one marginalized out. Returns the number of observations that
+  // are not outliers, as the g2o graphs.
+  int Solve(
+    ImuState& current,
+    ImuState& previous,
+    const Thresholds& thresholds,
+    bool recover,
+    std::vector<bool>& outliers,
+    Matrix15d& H
+  );
+
+private:
+  // Observations of one kind, as a structure of arrays.
+  struct Observations {
+    std::vector<double> x, y, z; // map point
+    std::vector<double> u, v, u_right;
+    std::vector<double> info;
+    std::vector<std::uint32_t> index;
+    std::vector<std::uint8_t> cam, close, outlier;
+
+    std::size_t Size() const { return index.size(); }
+    void Clear();
+    void Add(std::size_t i, const Eigen::Vector3d& x_w, double obs_u, double obs_v, double inv_sigma2);
+  };
+
+  // Body pose of a state, as the observations read it.
+  struct BodyPose {
+    Eigen::Matrix3d R_bw;
+    Eigen::Vector3d t_wb;
+  };
+
+  // Error of observation i with the body pose, and its derivative wrt the
+  // pose update of the state when J is given. `depth` is the camera depth.
+  Eigen::Vector2d MonoError(
+    std::size_t i,
+    const BodyPose& pose,
+    Eigen::Matrix<double, 2, 6>* J,
+    double& depth
+  ) const;
+  Eigen::Vector3d StereoError(std::size_t i, const BodyPose& pose, Eigen::Matrix<double, 3, 6>* J) const;
+
+  // Normal equations H dx = b of the Gauss-Newton step at the states, H over
+  // the 30 unknowns. Robust Huber kernels on the observations when
+  // `robust_visual`, on the prior when `robust_prior`.
+  void Linearize(
+    const ImuState& current,
+    const ImuState& previous,
+    bool robust_visual,
+    bool robust_prior,
+    Matrix30d& H,
+    Vector30d& b
+  ) const;
+
+  // At most kIterations Gauss-Newton iterations.
+  void Optimize(ImuState& current, ImuState& previous, bool robust) const;
+
+  // Reclassify every observation at `current` with the thresholds of a round,
+  // returns the number of outliers.
+  int Classify(const ImuState& current, float chi2_mono, float chi2_stereo);
+
+  // Inlier again every outlier under the recover thresholds, returns the
+  // number of observations over them.
+  int Recover(const ImuState& current);
+
+  CameraProjection cameras_[2];
+  Eigen::Matrix3d R_cb_[2];
+  Eigen::Vector3d t_cb_[2];
+  double bf_ = 0.0;
+
+  IMU::Preintegrated* preintegrated_ = nullptr;
+  Eigen::Matrix<double, 9, 9> info_inertial_;
+  Eigen::Matrix3d info_gyro_, info_acc_;
+  Eigen::Matrix3d JR_gyro_, JV_gyro_, JP_gyro_, JV_acc_, JP_acc_;
+  double dt_ = 0.0;
+
+  const ConstraintPoseImu* prior_ = nullptr;
+
+  Observations mono_, stereo_;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // INERTIAL_POSE_SOLVER_H
@@ -0,0 +1,341 @@
+// Benchmark of the visual-inertial pose refinement of a frame, on the problems
+// of Optimizer::PoseInertialOptimizationLastKeyFrame (previous state fixed) and
+// PoseInertialOptimizationLastFrame (previous state free, with its prior): the
+// g2o graphs of the optimizer against InertialPoseSolver. The frames are
+// synthetic, with the calibration of EuRoC VI (Examples/Monocular-Inertial/
+// EuRoC.yaml): a 20Hz camera, a 200Hz IMU, 1px image noise and 5% of wrong
+// matches. The states and outliers of both should match, but for the rare
+// match at the edge of a chi2 threshold.
+//
+// Usage: InertialPoseSolver_bench [n_points] [n_frames]
+
+// Standard
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+// 3rdparty
+#include <orbslam3/external/g2o/g2o/core/block_solver.h>
+#include <orbslam3/external/g2o/g2o/core/optimization_algorithm_gauss_newton.h>
+#include <orbslam3/external/g2o/g2o/core/robust_kernel_impl.h>
+#include <orbslam3/external/g2o/g2o/core/sparse_optimizer.h>
+#include <orbslam3/external/g2o/g2o/solvers/linear_solver_dense.h>
+// Local
+#include "orbslam3/CameraModels/Pinhole.h"
+#include "orbslam3/G2oTypes.h"
+#include "orbslam3/ImuTypes.h"
+#include "orbslam3/InertialPoseSolver.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// EuRoC VI calibration.
+constexpr float kFx          = 458.654f;
+constexpr float kFy          = 457.296f;
+constexpr float kCx          = 367.215f;
+constexpr float kCy          = 248.375f;
+constexpr float kNoiseGyro   = 1.7e-4f;
+constexpr float kNoiseAcc    = 2.0e-3f;
+constexpr float kGyroWalk    = 1.9393e-5f;
+constexpr float kAccWalk     = 3.0e-3f;
+constexpr float kImuRate     = 200.f;
+constexpr int kImuPerFrame   = 10; // at 20Hz
+constexpr double kPixelNoise = 1.0;
+
+struct Problem {
+  std::unique_ptr<IMU::Preintegrated> preintegrated;
+  ImuState previous, current; // initial guesses
+  std::vector<Eigen::Vector3d> points;
+  std::vector<Eigen::Vector2d> uvs;
+};
+
+Sophus::SE3d BodyToCamera() {
+  Eigen::Matrix4d T_bc;
+  T_bc << 0.0148655429818, -0.999880929698, 0.00414029679422, -0.0216401454975,
+          0.999557249008, 0.0149672133247, 0.025715529948, -0.064676986768,
+          -0.0257744366974, 0.00375618835797, 0.999660727178, 0.00981073058949,
+          0.0, 0.0, 0.0, 1.0;
+  return Sophus::SE3d(normalizeRotation(T_bc.topLeftCorner<3, 3>()), T_bc.topRightCorner<3, 1>()).inverse();
+}
+
+// A frame moving from the previous one, seen with `n_points` matches.
+Problem MakeProblem(const Sophus::SE3d& T_cb, const IMU::Calib& calib, const int n_points, std::mt19937& rng) {
+  std::normal_distribution<double> unit(0.0, 1.0);
+  std::uniform_real_distribution<double> xy(-3.0, 3.0);
+  std::uniform_real_distribution<double> z(1.5, 10.0);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  Problem problem;
+  problem.preintegrated = std::make_unique<IMU::Preintegrated>(IMU::Bias(), calib);
+  const Eigen::Vector3f acc_mean(
+    static_cast<float>(0.5 * unit(rng)),
+    static_cast<float>(0.5 * unit(rng)),
+    static_cast<float>(IMU::kGravity + 0.5 * unit(rng))
+  );
+  const Eigen::Vector3f gyro_mean(
+    static_cast<float>(0.3 * unit(rng)),
+    static_cast<float>(0.3 * unit(rng)),
+    static_cast<float>(0.3 * unit(rng))
+  );
+  for (int k = 0; k < kImuPerFrame; ++k) {
+    const Eigen::Vector3f noise = Eigen::Vector3d(unit(rng), unit(rng), unit(rng)).cast<float>();
+    problem.preintegrated->integrateNewMeasurement(acc_mean + 0.05f * noise, gyro_mean + 0.01f * noise, 1.f / kImuRate);
+  }
+
+  ImuState& previous = problem.previous;
+  previous.R_wb      = Sophus::SO3d::exp(Eigen::Vector3d(0.1 * unit(rng), 0.1 * unit(rng), unit(rng))).matrix();
+  previous.t_wb      = Eigen::Vector3d(unit(rng), unit(rng), unit(rng));
+  previous.v_wb      = 0.5 * Eigen::Vector3d(unit(rng), unit(rng), unit(rng));
+  const double dt    = problem.preintegrated->t;
+  const Eigen::Vector3d g(0.0, 0.0, -IMU::kGravity);
+  ImuState truth = previous;
+  truth.R_wb     = normalizeRotation(previous.R_wb * problem.preintegrated->getOriginalDeltaRotation().cast<double>());
+  truth.v_wb     = previous.v_wb + g * dt + previous.R_wb * problem.preintegrated->getOriginalDeltaVelocity().cast<double>();
+  truth.t_wb     = previous.t_wb + previous.v_wb * dt + 0.5 * g * dt * dt
+             + previous.R_wb * problem.preintegrated->getOriginalDeltaPosition().cast<double>();
+
+  // The guess of the tracking, a few centimeters and tenths of a degree away.
+  problem.current      = truth;
+  problem.current.R_wb = truth.R_wb * Sophus::SO3d::exp(0.005 * Eigen::Vector3d(unit(rng), unit(rng), unit(rng))).matrix();
+  problem.current.t_wb += 0.02 * Eigen::Vector3d(unit(rng), unit(rng), unit(rng));
+  problem.current.v_wb += 0.05 * Eigen::Vector3d(unit(rng), unit(rng), unit(rng));
+
+  const Sophus::SE3d T_wc = (T_cb * Sophus::SE3d(Sophus::SO3d(truth.R_wb), truth.t_wb).inverse()).inverse();
+  for (int i = 0; i < n_points; ++i) {
+    const Eigen::Vector3d x_c(xy(rng), xy(rng), z(rng));
+    Eigen::Vector2d uv(kFx * x_c.x() / x_c.z() + kCx, kFy * x_c.y() / x_c.z() + kCy);
+    uv += kPixelNoise * Eigen::Vector2d(unit(rng), unit(rng));
+    if (uniform(rng) < 0.05) {
+      uv += Eigen::Vector2d(20.0 + 40.0 * uniform(rng), -20.0 - 40.0 * uniform(rng));
+    }
+    problem.points.push_back(T_wc * x_c);
+    problem.uvs.push_back(uv);
+  }
+  return problem;
+}
+
+VertexPose* MakeVertexPose(const ImuState& state, const Sophus::SE3d& T_cb, GeometricCamera* camera) {
+  ImuCamPose pose;
+  pose.R_wb    = state.R_wb;
+  pose.t_wb    = state.t_wb;
+  pose.R_cb    = {T_cb.rotationMatrix()};
+  pose.t_cb    = {T_cb.translation()};
+  pose.R_bc    = {T_cb.rotationMatrix().transpose()};
+  pose.t_bc    = {T_cb.inverse().translation()};
+  pose.R_cw    = {pose.R_cb[0] * state.R_wb.transpose()};
+  pose.t_cw    = {pose.t_cb[0] - pose.R_cw[0] * state.t_wb};
+  pose.cameras = {camera};
+  pose.bf      = 0.0;
+
+  VertexPose* vertex = new VertexPose();
+  vertex->setEstimate(pose);
+  return vertex;
+}
+
+// The graph of the optimizer on the problem, with the previous state free
+// when there is a prior.
+int SolveWithG2o(
+  const Problem& problem,
+  const Sophus::SE3d& T_cb,
+  GeometricCamera* camera,
+  const ConstraintPoseImu* prior,
+  ImuState& current,
+  ImuState& previous,
+  std::vector<bool>& outliers
+) {
+  const InertialPoseSolver::Thresholds& thresholds
+    = prior != nullptr ? InertialPoseSolver::kLastFrame : InertialPoseSolver::kLastKeyFrame;
+
+  g2o::SparseOptimizer optimizer;
+  auto* linear_solver = new g2o::LinearSolverDense<g2o::BlockSolverX::PoseMatrixType>();
+  optimizer.setAlgorithm(new g2o::OptimizationAlgorithmGaussNewton(new g2o::BlockSolverX(linear_solver)));
+
+  VertexPose* VP  = MakeVertexPose(current, T_cb, camera);
+  auto* VV        = new VertexVelocity();
+  auto* VG        = new VertexGyroBias();
+  auto* VA        = new VertexAccBias();
+  VertexPose* VPk = MakeVertexPose(previous, T_cb, camera);
+  auto* VVk       = new VertexVelocity();
+  auto* VGk       = new VertexGyroBias();
+  auto* VAk       = new VertexAccBias();
+  VV->setEstimate(current.v_wb);
+  VG->setEstimate(current.bias_gyro);
+  VA->setEstimate(current.bias_acc);
+  VVk->setEstimate(previous.v_wb);
+  VGk->setEstimate(previous.bias_gyro);
+  VAk->setEstimate(previous.bias_acc);
+  g2o::OptimizableGraph::Vertex* vertices[] = {VP, VV, VG, VA, VPk, VVk, VGk, VAk};
+  for (int id = 0; id < 8; ++id) {
+    vertices[id]->setId(id);
+    vertices[id]->setFixed(id >= 4 && prior == nullptr);
+    optimizer.addVertex(vertices[id]);
+  }
+
+  std::vector<EdgeMonoOnlyPose*> edges;
+  for (std::size_t i = 0; i < problem.points.size(); ++i) {
+    auto* e = new EdgeMonoOnlyPose(problem.points[i].cast<float>(), 0);
+    e->setVertex(0, VP);
+    e->setMeasurement(problem.uvs[i]);
+    e->setInformation(Eigen::Matrix2d::Identity());
+    auto* rk = new g2o::RobustKernelHuber;
+    rk->setDelta(std::sqrt(5.991));
+    e->setRobustKernel(rk);
+    optimizer.addEdge(e);
+    edges.push_back(e);
+  }
+
+  auto* ei = new EdgeInertial(problem.preintegrated.get());
+  ei->setVertex(0, VPk);
+  ei->setVertex(1, VVk);
+  ei->setVertex(2, VGk);
+  ei->setVertex(3, VAk);
+  ei->setVertex(4, VP);
+  ei->setVertex(5, VV);
+  optimizer.addEdge(ei);
+
+  auto* egr = new EdgeGyroRW();
+  egr->setVertex(0, VGk);
+  egr->setVertex(1, VG);
+  egr->setInformation(problem.preintegrated->C.block<3, 3>(9, 9).cast<double>().inverse());
+  optimizer.addEdge(egr);
+
+  auto* ear = new EdgeAccRW();
+  ear->setVertex(0, VAk);
+  ear->setVertex(1, VA);
+  ear->setInformation(problem.preintegrated->C.block<3, 3>(12, 12).cast<double>().inverse());
+  optimizer.addEdge(ear);
+
+  if (prior != nullptr) {
+    auto* ep = new EdgePriorPoseImu(prior);
+    ep->setVertex(0, VPk);
+    ep->setVertex(1, VVk);
+    ep->setVertex(2, VGk);
+    ep->setVertex(3, VAk);
+    auto* rkp = new g2o::RobustKernelHuber;
+    rkp->setDelta(InertialPoseSolver::kPriorDelta);
+    ep->setRobustKernel(rkp);
+    optimizer.addEdge(ep);
+  }
+
+  int n_bad = 0;
+  for (int it = 0; it < InertialPoseSolver::kRounds; ++it) {
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(InertialPoseSolver::kIterations);
+    n_bad = 0;
+    for (std::size_t i = 0; i < edges.size(); ++i) {
+      edges[i]->computeError();
+      outliers[i] = edges[i]->chi2() > thresholds.mono[it] || !edges[i]->isDepthPositive();
+      edges[i]->setLevel(outliers[i] ? 1 : 0);
+      n_bad += outliers[i];
+      if (it == InertialPoseSolver::kRobustRounds - 1) {
+        edges[i]->setRobustKernel(0);
+      }
+    }
+  }
+
+  current.R_wb      = VP->estimate().R_wb;
+  current.t_wb      = VP->estimate().t_wb;
+  current.v_wb      = VV->estimate();
+  current.bias_gyro = VG->estimate();
+  current.bias_acc  = VA->estimate();
+  previous.R_wb     = VPk->estimate().R_wb;
+  previous.t_wb     = VPk->estimate().t_wb;
+  return static_cast<int>(edges.size()) - n_bad;
+}
+
+double Distance(const ImuState& a, const ImuState& b) {
+  return std::max({
+    logSO3(a.R_wb.transpose() * b.R_wb).norm(),
+    (a.t_wb - b.t_wb).norm(),
+    (a.v_wb - b.v_wb).norm(),
+    (a.bias_gyro - b.bias_gyro).norm(),
+    (a.bias_acc - b.bias_acc).norm(),
+  });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int n_points = argc > 1 ? std::atoi(argv[1]) : 150;
+  const int n_frames = argc > 2 ? std::atoi(argv[2]) : 500;
+  if (n_points <= 0 || n_frames <= 0) {
+    std::fprintf(stderr, "Usage: %s [n_points] [n_frames]\n", argv[0]);
+    return 1;
+  }
+
+  Pinhole camera({kFx, kFy, kCx, kCy});
+  const Sophus::SE3d T_cb = BodyToCamera();
+  const float sf          = std::sqrt(kImuRate);
+  const IMU::Calib calib(T_cb.inverse().cast<float>(), kNoiseGyro * sf, kNoiseAcc * sf, kGyroWalk / sf, kAccWalk / sf);
+
+  std::mt19937 rng(42);
+  std::vector<Problem> problems;
+  problems.reserve(n_frames);
+  for (int f = 0; f < n_frames; ++f) {
+    problems.push_back(MakeProblem(T_cb, calib, n_points, rng));
+  }
+
+  InertialPoseSolver solver;
+  for (const bool with_prior : {false, true}) {
+    double g2o_ms = 0.0, dense_ms = 0.0, max_distance = 0.0;
+    int mismatches = 0;
+    for (const Problem& problem : problems) {
+      const ConstraintPoseImu prior(
+        problem.previous.R_wb,
+        problem.previous.t_wb,
+        problem.previous.v_wb,
+        problem.previous.bias_gyro,
+        problem.previous.bias_acc,
+        Matrix15d::Identity() * 1e4
+      );
+      const ConstraintPoseImu* prior_ptr = with_prior ? &prior : nullptr;
+
+      ImuState g2o_current = problem.current, g2o_previous = problem.previous;
+      std::vector<bool> g2o_outliers(problem.points.size(), false);
+      auto start = std::chrono::steady_clock::now();
+      const int g2o_inliers
+        = SolveWithG2o(problem, T_cb, &camera, prior_ptr, g2o_current, g2o_previous, g2o_outliers);
+      auto stop = std::chrono::steady_clock::now();
+      g2o_ms += std::chrono::duration<double, std::milli>(stop - start).count();
+
+      ImuState current = problem.current, previous = problem.previous;
+      std::vector<bool> outliers(problem.points.size(), false);
+      InertialPoseSolver::Matrix15d H;
+      start = std::chrono::steady_clock::now();
+      solver.Reset(&camera, T_cb, 0.0);
+      for (std::size_t i = 0; i < problem.points.size(); ++i) {
+        solver.AddMono(i, problem.points[i], problem.uvs[i], 1.0, 0, false);
+      }
+      solver.SetInertial(
+        problem.preintegrated.get(),
+        problem.preintegrated->C.block<3, 3>(9, 9).cast<double>().inverse(),
+        problem.preintegrated->C.block<3, 3>(12, 12).cast<double>().inverse()
+      );
+      solver.SetPrior(prior_ptr);
+      const InertialPoseSolver::Thresholds& thresholds
+        = with_prior ? InertialPoseSolver::kLastFrame : InertialPoseSolver::kLastKeyFrame;
+      const int inliers = solver.Solve(current, previous, thresholds, false, outliers, H);
+      stop = std::chrono::steady_clock::now();
+      dense_ms += std::chrono::duration<double, std::milli>(stop - start).count();
+
+      max_distance = std::max(max_distance, Distance(current, g2o_current));
+      mismatches += inliers != g2o_inliers || outliers != g2o_outliers;
+    }
+
+    std::printf(
+      "%-13s g2o %.3f ms, dense %.3f ms (x%.1f), max state difference %.2e, %d/%d frames with other outliers\n",
+      with_prior ? "LastFrame" : "LastKeyFrame",
+      g2o_ms / n_frames,
+      dense_ms / n_frames,
+      g2o_ms / dense_ms,
+      max_distance,
+      mismatches,
+      n_frames
+    );
+  }
+  return 0;
+}
@@ -0,0 +1,288 @@
+// Standard
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <orbslam3/external/g2o/g2o/core/block_solver.h>
+#include <orbslam3/external/g2o/g2o/core/optimization_algorithm_gauss_newton.h>
+#include <orbslam3/external/g2o/g2o/core/robust_kernel_impl.h>
+#include <orbslam3/external/g2o/g2o/core/sparse_optimizer.h>
+#include <orbslam3/external/g2o/g2o/solvers/linear_solver_dense.h>
+// Local
+#include "orbslam3/CameraModels/Pinhole.h"
+#include "orbslam3/G2oTypes.h"
+#include "orbslam3/ImuTypes.h"
+#include "orbslam3/InertialPoseSolver.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// A frame 50ms after the previous one, with 10 IMU measurements between them
+// and the matches of the frame.
+struct Problem {
+  Pinhole camera{std::vector<float>{450.f, 450.f, 320.f, 240.f}};
+  Sophus::SE3d T_cb;
+  ImuState previous, current; // ground truth
+  std::unique_ptr<IMU::Preintegrated> preintegrated;
+  std::vector<Eigen::Vector3d> points;
+  std::vector<Eigen::Vector2d> uvs;
+};
+
+std::unique_ptr<Problem> MakeProblem(const std::size_t n_points, const unsigned seed) {
+  auto problem  = std::make_unique<Problem>();
+  problem->T_cb = Sophus::SE3d(Sophus::SO3d::exp(Eigen::Vector3d(0.01, -0.02, 1.57)), Eigen::Vector3d(0.02, -0.06, 0.01));
+
+  const Sophus::SE3f T_bc = problem->T_cb.inverse().cast<float>();
+  const IMU::Calib calib(T_bc, 1.7e-4f * 14.f, 2.0e-3f * 14.f, 1.9e-5f / 14.f, 3.0e-3f / 14.f);
+  problem->preintegrated = std::make_unique<IMU::Preintegrated>(IMU::Bias(), calib);
+  for (int k = 0; k < 10; ++k) {
+    const Eigen::Vector3f acc(0.3f, -0.2f + 0.01f * k, IMU::kGravity + 0.1f);
+    const Eigen::Vector3f gyro(0.05f, -0.1f, 0.2f);
+    problem->preintegrated->integrateNewMeasurement(acc, gyro, 0.005);
+  }
+
+  // The current state that the measurements predict from the previous one.
+  ImuState& previous = problem->previous;
+  previous.R_wb      = Sophus::SO3d::exp(Eigen::Vector3d(0.1, 0.05, -0.3)).matrix();
+  previous.t_wb      = Eigen::Vector3d(1.0, -0.5, 0.8);
+  previous.v_wb      = Eigen::Vector3d(0.4, 0.1, -0.05);
+  const double dt    = problem->preintegrated->t;
+  const Eigen::Vector3d g(0.0, 0.0, -IMU::kGravity);
+  ImuState& current = problem->current;
+  current.R_wb      = normalizeRotation(previous.R_wb * problem->preintegrated->getOriginalDeltaRotation().cast<double>());
+  current.v_wb      = previous.v_wb + g * dt + previous.R_wb * problem->preintegrated->getOriginalDeltaVelocity().cast<double>();
+  current.t_wb      = previous.t_wb + previous.v_wb * dt + 0.5 * g * dt * dt
+                 + previous.R_wb * problem->preintegrated->getOriginalDeltaPosition().cast<double>();
+
+  // Points in front of the current camera.
+  const Sophus::SE3d T_cw = problem->T_cb * Sophus::SE3d(Sophus::SO3d(current.R_wb), current.t_wb).inverse();
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> xy(-2.0, 2.0);
+  std::uniform_real_distribution<double> z(2.0, 8.0);
+  for (std::size_t i = 0; i < n_points; ++i) {
+    const Eigen::Vector3d x_c(xy(rng), xy(rng), z(rng));
+    problem->points.push_back(T_cw.inverse() * x_c);
+    problem->uvs.emplace_back(450.0 * x_c.x() / x_c.z() + 320.0, 450.0 * x_c.y() / x_c.z() + 240.0);
+  }
+  return problem;
+}
+
+// Initial guess of the current state.
+ImuState Perturb(const ImuState& state) {
+  ImuState perturbed = state;
+  perturbed.R_wb     = state.R_wb * Sophus::SO3d::exp(Eigen::Vector3d(0.01, -0.01, 0.015)).matrix();
+  perturbed.t_wb += Eigen::Vector3d(0.03, -0.02, 0.02);
+  perturbed.v_wb += Eigen::Vector3d(0.05, 0.02, -0.03);
+  return perturbed;
+}
+
+void Fill(InertialPoseSolver& solver, const Problem& problem, const std::vector<std::size_t>& wrong) {
+  solver.Reset(&problem.camera, problem.T_cb, 0.0);
+  for (std::size_t i = 0; i < problem.points.size(); ++i) {
+    Eigen::Vector2d uv = problem.uvs[i];
+    if (std::find(wrong.begin(), wrong.end(), i) != wrong.end()) {
+      uv += Eigen::Vector2d(30.0, -40.0);
+    }
+    solver.AddMono(i, problem.points[i], uv, 1.0, 0, false);
+  }
+  const Eigen::Matrix3d info_gyro = problem.preintegrated->C.block<3, 3>(9, 9).cast<double>().inverse();
+  const Eigen::Matrix3d info_acc  = problem.preintegrated->C.block<3, 3>(12, 12).cast<double>().inverse();
+  solver.SetInertial(problem.preintegrated.get(), info_gyro, info_acc);
+}
+
+ConstraintPoseImu MakePrior(const ImuState& state) {
+  Matrix15d H = Matrix15d::Identity() * 1e4;
+  return ConstraintPoseImu(state.R_wb, state.t_wb, state.v_wb, state.bias_gyro, state.bias_acc, H);
+}
+
+void ExpectNear(const ImuState& state, const ImuState& expected, const double tolerance) {
+  EXPECT_LT(logSO3(expected.R_wb.transpose() * state.R_wb).norm(), tolerance);
+  EXPECT_LT((state.t_wb - expected.t_wb).norm(), tolerance);
+  EXPECT_LT((state.v_wb - expected.v_wb).norm(), tolerance);
+  EXPECT_LT((state.bias_gyro - expected.bias_gyro).norm(), tolerance);
+  EXPECT_LT((state.bias_acc - expected.bias_acc).norm(), tolerance);
+}
+
+// Vertex of a state, the single left camera of the problem.
+VertexPose* MakeVertexPose(const ImuState& state, const Problem& problem) {
+  ImuCamPose pose;
+  pose.R_wb = state.R_wb;
+  pose.t_wb = state.t_wb;
+  pose.R_cb = {problem.T_cb.rotationMatrix()};
+  pose.t_cb = {problem.T_cb.translation()};
+  pose.R_bc = {problem.T_cb.rotationMatrix().transpose()};
+  pose.t_bc = {problem.T_cb.inverse().translation()};
+  pose.R_cw = {pose.R_cb[0] * state.R_wb.transpose()};
+  pose.t_cw = {pose.t_cb[0] - pose.R_cw[0] * state.t_wb};
+  pose.cameras = {const_cast<Pinhole*>(&problem.camera)};
+  pose.bf      = 0.0;
+
+  VertexPose* vertex = new VertexPose();
+  vertex->setEstimate(pose);
+  return vertex;
+}
+
+// The graph of Optimizer::PoseInertialOptimizationLastFrameG2o on the problem.
+ImuState SolveWithG2o(
+  const Problem& problem,
+  ImuState current,
+  const ImuState& previous,
+  const ConstraintPoseImu& prior,
+  std::vector<bool>& outliers
+) {
+  g2o::SparseOptimizer optimizer;
+  auto* linear_solver = new g2o::LinearSolverDense<g2o::BlockSolverX::PoseMatrixType>();
+  optimizer.setAlgorithm(new g2o::OptimizationAlgorithmGaussNewton(new g2o::BlockSolverX(linear_solver)));
+
+  VertexPose* VP  = MakeVertexPose(current, problem);
+  auto* VV        = new VertexVelocity();
+  auto* VG        = new VertexGyroBias();
+  auto* VA        = new VertexAccBias();
+  VertexPose* VPk = MakeVertexPose(previous, problem);
+  auto* VVk       = new VertexVelocity();
+  auto* VGk       = new VertexGyroBias();
+  auto* VAk       = new VertexAccBias();
+  VV->setEstimate(current.v_wb);
+  VG->setEstimate(current.bias_gyro);
+  VA->setEstimate(current.bias_acc);
+  VVk->setEstimate(previous.v_wb);
+  VGk->setEstimate(previous.bias_gyro);
+  VAk->setEstimate(previous.bias_acc);
+  g2o::OptimizableGraph::Vertex* vertices[] = {VP, VV, VG, VA, VPk, VVk, VGk, VAk};
+  for (int id = 0; id < 8; ++id) {
+    vertices[id]->setId(id);
+    optimizer.addVertex(vertices[id]);
+  }
+
+  std::vector<EdgeMonoOnlyPose*> edges;
+  for (std::size_t i = 0; i < problem.points.size(); ++i) {
+    auto* e = new EdgeMonoOnlyPose(problem.points[i].cast<float>(), 0);
+    e->setVertex(0, VP);
+    e->setMeasurement(outliers[i] ? Eigen::Vector2d(problem.uvs[i] + Eigen::Vector2d(30.0, -40.0)) : problem.uvs[i]);
+    e->setInformation(Eigen::Matrix2d::Identity());
+    auto* rk = new g2o::RobustKernelHuber;
+    rk->setDelta(std::sqrt(5.991));
+    e->setRobustKernel(rk);
+    optimizer.addEdge(e);
+    edges.push_back(e);
+  }
+
+  auto* ei = new EdgeInertial(problem.preintegrated.get());
+  ei->setVertex(0, VPk);
+  ei->setVertex(1, VVk);
+  ei->setVertex(2, VGk);
+  ei->setVertex(3, VAk);
+  ei->setVertex(4, VP);
+  ei->setVertex(5, VV);
+  optimizer.addEdge(ei);
+
+  auto* egr = new EdgeGyroRW();
+  egr->setVertex(0, VGk);
+  egr->setVertex(1, VG);
+  egr->setInformation(problem.preintegrated->C.block<3, 3>(9, 9).cast<double>().inverse());
+  optimizer.addEdge(egr);
+
+  auto* ear = new EdgeAccRW();
+  ear->setVertex(0, VAk);
+  ear->setVertex(1, VA);
+  ear->setInformation(problem.preintegrated->C.block<3, 3>(12, 12).cast<double>().inverse());
+  optimizer.addEdge(ear);
+
+  auto* ep = new EdgePriorPoseImu(&prior);
+  ep->setVertex(0, VPk);
+  ep->setVertex(1, VVk);
+  ep->setVertex(2, VGk);
+  ep->setVertex(3, VAk);
+  auto* rkp = new g2o::RobustKernelHuber;
+  rkp->setDelta(5);
+  ep->setRobustKernel(rkp);
+  optimizer.addEdge(ep);
+
+  std::fill(outliers.begin(), outliers.end(), false);
+  for (int it = 0; it < 4; ++it) {
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(10);
+    for (std::size_t i = 0; i < edges.size(); ++i) {
+      edges[i]->computeError();
+      outliers[i] = edges[i]->chi2() > InertialPoseSolver::kLastFrame.mono[it] || !edges[i]->isDepthPositive();
+      edges[i]->setLevel(outliers[i] ? 1 : 0);
+      if (it == 2) {
+        edges[i]->setRobustKernel(0);
+      }
+    }
+  }
+
+  current.R_wb      = VP->estimate().R_wb;
+  current.t_wb      = VP->estimate().t_wb;
+  current.v_wb      = VV->estimate();
+  current.bias_gyro = VG->estimate();
+  current.bias_acc  = VA->estimate();
+  return current;
+}
+
+} // namespace
+
+TEST(InertialPoseSolver, FixedPrevious) {
+  const auto problem = MakeProblem(80, 1);
+  InertialPoseSolver solver;
+  Fill(solver, *problem, {});
+
+  ImuState previous = problem->previous;
+  ImuState current  = Perturb(problem->current);
+  std::vector<bool> outliers(problem->points.size(), true);
+  InertialPoseSolver::Matrix15d H;
+  EXPECT_EQ(solver.Solve(current, previous, InertialPoseSolver::kLastKeyFrame, true, outliers, H), 80);
+  ExpectNear(current, problem->current, 1e-4);
+  EXPECT_EQ(outliers, std::vector<bool>(problem->points.size(), false));
+
+  // The fixed frame is untouched, and the information is symmetric and
+  // positive definite.
+  EXPECT_EQ(previous.t_wb, problem->previous.t_wb);
+  EXPECT_LT((H - H.transpose()).norm(), 1e-6 * H.norm());
+  EXPECT_EQ(Eigen::LDLT<InertialPoseSolver::Matrix15d>(H).info(), Eigen::Success);
+  EXPECT_GT(Eigen::SelfAdjointEigenSolver<InertialPoseSolver::Matrix15d>(H).eigenvalues().minCoeff(), 0.0);
+}
+
+TEST(InertialPoseSolver, RejectsOutliers) {
+  const auto problem = MakeProblem(80, 2);
+  const std::vector<std::size_t> wrong = {3, 17, 42, 60};
+  InertialPoseSolver solver;
+  Fill(solver, *problem, wrong);
+
+  ImuState previous = problem->previous;
+  ImuState current  = Perturb(problem->current);
+  std::vector<bool> outliers(problem->points.size(), false);
+  InertialPoseSolver::Matrix15d H;
+  EXPECT_EQ(solver.Solve(current, previous, InertialPoseSolver::kLastKeyFrame, true, outliers, H), 76);
+  ExpectNear(current, problem->current, 1e-4);
+  for (std::size_t i = 0; i < outliers.size(); ++i) {
+    EXPECT_EQ(outliers[i], std::find(wrong.begin(), wrong.end(), i) != wrong.end()) << i;
+  }
+}
+
+TEST(InertialPoseSolver, MatchesG2oWithPrior) {
+  const auto problem = MakeProblem(60, 3);
+  const std::vector<std::size_t> wrong = {5, 25};
+  const ConstraintPoseImu prior = MakePrior(problem->previous);
+  const ImuState initial        = Perturb(problem->current);
+
+  InertialPoseSolver solver;
+  Fill(solver, *problem, wrong);
+  solver.SetPrior(&prior);
+  ImuState previous = problem->previous;
+  ImuState current  = initial;
+  std::vector<bool> outliers(problem->points.size(), false);
+  InertialPoseSolver::Matrix15d H;
+  EXPECT_EQ(solver.Solve(current, previous, InertialPoseSolver::kLastFrame, true, outliers, H), 58);
+
+  std::vector<bool> g2o_outliers(problem->points.size(), false);
+  for (const std::size_t i : wrong) {
+    g2o_outliers[i] = true;
+  }
+  const ImuState g2o_current = SolveWithG2o(*problem, initial, problem->previous, prior, g2o_outliers);
+  ExpectNear(current, g2o_current, 1e-6);
+  EXPECT_EQ(outliers, g2o_outliers);
+}
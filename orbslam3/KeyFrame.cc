@@ -25,12 +25,29 @@
 #include "orbslam3/KeyFrameDatabase.h"
 #include "orbslam3/Map.h"
 #include "orbslam3/MapPoint.h"
+#include "orbslam3/ObjectPool.h"
+#include "orbslam3/ThreadPool.h"
 
 namespace ORB_SLAM3
 {
 
 long unsigned int KeyFrame::nNextId=0;
 
+void* KeyFrame::operator new(std::size_t size)
+{
+    if(size != sizeof(KeyFrame))
+        return ::operator new(size);
+    return ObjectPool<KeyFrame>::Instance().Allocate();
+}
+
+void KeyFrame::operator delete(void* p, std::size_t size)
+{
+    if(size != sizeof(KeyFrame))
+        ::operator delete(p);
+    else
+        ObjectPool<KeyFrame>::Instance().Deallocate(p);
+}
+
 KeyFrame::KeyFrame():
         mnFrameId(0),  mTimeStamp(0), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
         mfGridElementWidthInv(0), mfGridElementHeightInv(0),
@@ -68,19 +85,9 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
 {
     mnId=nNextId++;
 
-    mGrid.resize(mnGridCols);
-    if(F.Nleft != -1)  mGridRight.resize(mnGridCols);
-    for(int i=0; i<mnGridCols;i++)
-    {
-        mGrid[i].resize(mnGridRows);
-        if(F.Nleft != -1) mGridRight[i].resize(mnGridRows);
-        for(int j=0; j<mnGridRows; j++){
-            mGrid[i][j] = F.mGrid[i][j];
-            if(F.Nleft != -1){
-                mGridRight[i][j] = F.mGridRight[i][j];
-            }
-        }
-    }
+    mGrid = F.mGrid;
+    if(F.Nleft != -1)
+        mGridRight = F.mGridRight;
 
 
 
@@ -100,14 +107,21 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mnOriginMapId = pMap->GetId();
 }
 
-void KeyFrame::ComputeBoW()
+void KeyFrame::ComputeBoW(ThreadPool* pThreadPool)
 {
     if(mBowVec.empty() || mFeatVec.empty())
     {
         std::vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
+        ORBVocabulary::ParallelFor parallelFor;
+        if(pThreadPool)
+        {
+            parallelFor = [pThreadPool](size_t begin, size_t end, const std::function<void(size_t)> &fn) {
+                pThreadPool->ParallelFor(begin, end, fn, "KeyFrame::ComputeBoW");
+            };
+        }
         // Feature vector associate features with nodes in the 4th level (from leaves up)
         // We assume the vocabulary tree has 6 levels, change the 4 otherwise
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
+        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4,parallelFor);
     }
 }
 
@@ -600,6 +614,7 @@ void KeyFrame::SetBadFlag()
         if(mvpMapPoints[i])
         {
             mvpMapPoints[i]->EraseObservation(this);
+            mvpMapPoints[i]->SetPinned();
         }
     }
 
@@ -709,47 +724,52 @@ void KeyFrame::EraseConnection(KeyFrame* pKF)
 std::vector<std::size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const float &r, const bool bRight) const
 {
     std::vector<std::size_t> vIndices;
-    vIndices.reserve(N);
+    GetFeaturesInArea(x,y,r,vIndices,bRight);
+    return vIndices;
+}
+
+void KeyFrame::GetFeaturesInArea(const float &x, const float &y, const float &r, std::vector<std::size_t> &vIndices, const bool bRight) const
+{
+    vIndices.clear();
+
+    const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
 
     float factorX = r;
     float factorY = r;
 
     const int nMinCellX = std::max(0,(int)std::floor((x-mnMinX-factorX)*mfGridElementWidthInv));
-    if(nMinCellX>=mnGridCols)
-        return vIndices;
+    if(nMinCellX>=grid.Cols())
+        return;
 
-    const int nMaxCellX = std::min((int)mnGridCols-1,(int)std::ceil((x-mnMinX+factorX)*mfGridElementWidthInv));
+    const int nMaxCellX = std::min(grid.Cols()-1,(int)std::ceil((x-mnMinX+factorX)*mfGridElementWidthInv));
     if(nMaxCellX<0)
-        return vIndices;
+        return;
 
     const int nMinCellY = std::max(0,(int)std::floor((y-mnMinY-factorY)*mfGridElementHeightInv));
-    if(nMinCellY>=mnGridRows)
-        return vIndices;
+    if(nMinCellY>=grid.Rows())
+        return;
 
-    const int nMaxCellY = std::min((int)mnGridRows-1,(int)std::ceil((y-mnMinY+factorY)*mfGridElementHeightInv));
+    const int nMaxCellY = std::min(grid.Rows()-1,(int)std::ceil((y-mnMinY+factorY)*mfGridElementHeightInv));
     if(nMaxCellY<0)
-        return vIndices;
+        return;
 
     for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            const std::vector<std::size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            for(std::size_t j=0, jend=vCell.size(); j<jend; j++)
+            for(const std::uint32_t idx : grid.At(ix,iy))
             {
-                const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
+                const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[idx]
+                                                         : (!bRight) ? mvKeys[idx]
+                                                                     : mvKeysRight[idx];
                 const float distx = kpUn.pt.x-x;
                 const float disty = kpUn.pt.y-y;
 
                 if(fabs(distx)<r && fabs(disty)<r)
-                    vIndices.push_back(vCell[j]);
+                    vIndices.push_back(idx);
             }
         }
     }
-
-    return vIndices;
 }
 
 bool KeyFrame::IsInImage(const float &x, const float &y) const
@@ -849,15 +869,18 @@ void KeyFrame::UpdateMap(Map* pMap)
     mpMap = pMap;
 }
 
-void KeyFrame::PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP, std::set<GeometricCamera*>& spCam)
+void KeyFrame::PreSave(const std::function<bool(KeyFrame*)>& isKF, const std::function<bool(MapPoint*)>& isMP, std::set<GeometricCamera*>& spCam)
 {
+    // The system may still be running (atlas snapshot)
+    std::scoped_lock lock(mMutexConnections, mMutexFeatures);
+
     // Save the id of each MapPoint in this KF, there can be null pointer in the vector
     mvBackupMapPointsId.clear();
     mvBackupMapPointsId.reserve(N);
     for(int i = 0; i < N; ++i)
     {
 
-        if(mvpMapPoints[i] && spMP.find(mvpMapPoints[i]) != spMP.end()) // Checks if the element is not null
+        if(mvpMapPoints[i] && isMP(mvpMapPoints[i])) // Checks if the element is not null
             mvBackupMapPointsId.push_back(mvpMapPoints[i]->mnId);
         else // If the element is null his value is -1 because all the id are positives
             mvBackupMapPointsId.push_back(-1);
@@ -866,13 +889,13 @@ void KeyFrame::PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP, std:
     mBackupConnectedKeyFrameIdWeights.clear();
     for(auto it = mConnectedKeyFrameWeights.cbegin(), end = mConnectedKeyFrameWeights.cend(); it != end; ++it)
     {
-        if(spKF.find(it->first) != spKF.end())
+        if(isKF(it->first))
             mBackupConnectedKeyFrameIdWeights[it->first->mnId] = it->second;
     }
 
     // Save the parent id
     mBackupParentId = -1;
-    if(mpParent && spKF.find(mpParent) != spKF.end())
+    if(mpParent && isKF(mpParent))
         mBackupParentId = mpParent->mnId;
 
     // Save the id of the childrens KF
@@ -880,7 +903,7 @@ void KeyFrame::PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP, std:
     mvBackupChildrensId.reserve(mspChildrens.size());
     for(auto pKFi : mspChildrens)
     {
-        if(spKF.find(pKFi) != spKF.end())
+        if(isKF(pKFi))
             mvBackupChildrensId.push_back(pKFi->mnId);
     }
 
@@ -889,7 +912,7 @@ void KeyFrame::PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP, std:
     mvBackupLoopEdgesId.reserve(mspLoopEdges.size());
     for(auto pKFi : mspLoopEdges)
     {
-        if(spKF.find(pKFi) != spKF.end())
+        if(isKF(pKFi))
             mvBackupLoopEdgesId.push_back(pKFi->mnId);
     }
 
@@ -898,7 +921,7 @@ void KeyFrame::PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP, std:
     mvBackupMergeEdgesId.reserve(mspMergeEdges.size());
     for(auto pKFi : mspMergeEdges)
     {
-        if(spKF.find(pKFi) != spKF.end())
+        if(isKF(pKFi))
             mvBackupMergeEdgesId.push_back(pKFi->mnId);
     }
 
@@ -913,11 +936,11 @@ void KeyFrame::PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP, std:
 
     //Inertial data
     mBackupPrevKFId = -1;
-    if(mPrevKF && spKF.find(mPrevKF) != spKF.end())
+    if(mPrevKF && isKF(mPrevKF))
         mBackupPrevKFId = mPrevKF->mnId;
 
     mBackupNextKFId = -1;
-    if(mNextKF && spKF.find(mNextKF) != spKF.end())
+    if(mNextKF && isKF(mNextKF))
         mBackupNextKFId = mNextKF->mnId;
 
     if(mpImuPreintegrated)
@@ -1005,12 +1028,24 @@ void KeyFrame::PostLoad(std::map<long unsigned int, KeyFrame*>& mpKFid, std::map
 
 
     // Remove all backup container
+    ClearBackup();
+
+    UpdateBestCovisibles();
+}
+
+std::scoped_lock<std::mutex, std::mutex, std::mutex> KeyFrame::LockState()
+{
+    return std::scoped_lock<std::mutex, std::mutex, std::mutex>(mMutexPose, mMutexConnections, mMutexFeatures);
+}
+
+void KeyFrame::ClearBackup()
+{
     mvBackupMapPointsId.clear();
+    mvBackupMapPointsId.shrink_to_fit();
     mBackupConnectedKeyFrameIdWeights.clear();
     mvBackupChildrensId.clear();
     mvBackupLoopEdgesId.clear();
-
-    UpdateBestCovisibles();
+    mvBackupMergeEdgesId.clear();
 }
 
 bool KeyFrame::ProjectPointDistort(MapPoint* pMP, cv::Point2f &kp, float &u, float &v)
@@ -20,6 +20,8 @@
 #define KEYFRAME_H
 
 // Standard
+#include <cstddef>
+#include <functional>
 #include <mutex>
 #include <set>
 #include <vector>
@@ -33,6 +35,7 @@
 #include <opencv2/core.hpp>
 // Local
 #include "orbslam3/CameraModels/GeometricCamera.h"
+#include "orbslam3/FeatureGrid.h"
 #include "orbslam3/ImuTypes.h"
 #include "orbslam3/ORBVocabulary.h"
 #include "orbslam3/SerializationUtils.h"
@@ -44,6 +47,7 @@ class Frame;
 class KeyFrameDatabase;
 class Map;
 class MapPoint;
+class ThreadPool;
 
 class KeyFrame
 {
@@ -189,7 +193,10 @@ class KeyFrame
     }
 
 public:
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    // KeyFrames are allocated from ObjectPool<KeyFrame>
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
     KeyFrame();
     KeyFrame(Frame &F, Map* pMap, KeyFrameDatabase* pKFDB);
 
@@ -210,8 +217,8 @@ public:
     Eigen::Vector3f GetVelocity() const;
     bool isVelocitySet();
 
-    // Bag of Words Representation
-    void ComputeBoW();
+    // Bag of Words Representation, on the pool workers if given
+    void ComputeBoW(ThreadPool* pThreadPool = nullptr);
 
     // Covisibility graph functions
     void AddConnection(KeyFrame* pKF, const int &weight);
@@ -255,6 +262,8 @@ public:
 
     // KeyPoint functions
     std::vector<std::size_t> GetFeaturesInArea(const float &x, const float  &y, const float  &r, const bool bRight = false) const;
+    // Same, filling the buffer of the caller (cleared first) to avoid an allocation per query in the matcher loops.
+    void GetFeaturesInArea(const float &x, const float  &y, const float  &r, std::vector<std::size_t> &vIndices, const bool bRight = false) const;
     bool UnprojectStereo(int i, Eigen::Vector3f &x3D);
 
     // Image
@@ -292,8 +301,13 @@ public:
     bool ProjectPointDistort(MapPoint* pMP, cv::Point2f &kp, float &u, float &v);
     bool ProjectPointUnDistort(MapPoint* pMP, cv::Point2f &kp, float &u, float &v);
 
-    void PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP, std::set<GeometricCamera*>& spCam);
+    // Only the KeyFrames and MapPoints for which isKF and isMP are true are saved
+    void PreSave(const std::function<bool(KeyFrame*)>& isKF, const std::function<bool(MapPoint*)>& isMP, std::set<GeometricCamera*>& spCam);
     void PostLoad(std::map<long unsigned int, KeyFrame*>& mpKFid, std::map<long unsigned int, MapPoint*>& mpMPid, std::map<unsigned int, GeometricCamera*>& mpCamId);
+    // Release the ids filled by PreSave once serialized
+    void ClearBackup();
+    // Hold the pose, connections and features, to serialize the KeyFrame while the system runs
+    std::scoped_lock<std::mutex, std::mutex, std::mutex> LockState();
 
 
     void SetORBVocabulary(ORBVocabulary* pORBVoc);
@@ -451,7 +465,7 @@ protected:
     ORBVocabulary* mpORBvocabulary;
 
     // Grid over the image to speed up feature matching
-    std::vector< std::vector <std::vector<std::size_t> > > mGrid;
+    FeatureGrid mGrid;
 
     std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
     std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
@@ -511,7 +525,7 @@ public:
 
     const int NLeft, NRight;
 
-    std::vector< std::vector <std::vector<std::size_t> > > mGridRight;
+    FeatureGrid mGridRight;
 
     Sophus::SE3<float> GetRightPose();
     Sophus::SE3<float> GetRightPoseInverse();
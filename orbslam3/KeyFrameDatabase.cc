@@ -17,6 +17,9 @@
 */
 
 // Standard
+#include <algorithm>
+#include <iterator>
+#include <map>
 #include <set>
 // 3rdparty
 #include <orbslam3/external/DBoW2/DBoW2/BowVector.h>
@@ -33,6 +36,7 @@ KeyFrameDatabase::KeyFrameDatabase (const ORBVocabulary &voc):
     mpVoc(&voc)
 {
     mvInvertedFile.resize(voc.size());
+    mvUnloadedInvertedFile.resize(voc.size());
 }
 
 
@@ -69,10 +73,15 @@ void KeyFrameDatabase::clear()
 {
     mvInvertedFile.clear();
     mvInvertedFile.resize(mpVoc->size());
+    mvUnloadedInvertedFile.clear();
+    mvUnloadedInvertedFile.resize(mpVoc->size());
+    mnUnloadedEntries = 0;
 }
 
 void KeyFrameDatabase::clearMap(Map* pMap)
 {
+    eraseUnloaded(pMap);
+
     std::unique_lock<std::mutex> lock(mMutex);
 
     // Erase elements in the Inverse File for the entry
@@ -97,6 +106,38 @@ void KeyFrameDatabase::clearMap(Map* pMap)
     }
 }
 
+void KeyFrameDatabase::addUnloaded(Map* pMap, long unsigned int nKFId, const std::vector<unsigned int> &vWordIds)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    for(auto wordId : vWordIds)
+        mvUnloadedInvertedFile[wordId].push_back(std::make_pair(pMap, nKFId));
+    mnUnloadedEntries += vWordIds.size();
+}
+
+void KeyFrameDatabase::eraseUnloaded(Map* pMap)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if(mnUnloadedEntries == 0)
+        return;
+
+    for(auto &vEntries : mvUnloadedInvertedFile)
+    {
+        const auto itEnd = std::remove_if(vEntries.begin(), vEntries.end(), [pMap](const std::pair<Map*, long unsigned int> &entry) {
+            return entry.first == pMap;
+        });
+        mnUnloadedEntries -= std::distance(itEnd, vEntries.end());
+        vEntries.erase(itEnd, vEntries.end());
+    }
+}
+
+void KeyFrameDatabase::SetMapLoader(std::function<void(Map*)> loader)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mMapLoader = std::move(loader);
+}
+
 std::vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float minScore)
 {
     std::set<KeyFrame*> spConnectedKeyFrames = pKF->GetConnectedKeyFrames();
@@ -605,13 +646,13 @@ void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, std::vector<KeyFrame
 {
     std::list<KeyFrame*> lKFsSharingWords;
     std::set<KeyFrame*> spConnectedKF;
+    // Words shared with the KeyFrames of the maps not loaded yet
+    std::map<std::pair<Map*, long unsigned int>, int> mUnloadedSharedWords;
+    std::function<void(Map*)> mapLoader;
 
-    // Search all keyframes that share a word with current frame
+    // Search all keyframes (of the maps in pspMaps if given) that share a word with current frame
+    const auto searchSharedWords = [&](const std::set<Map*>* pspMaps)
     {
-        std::unique_lock<std::mutex> lock(mMutex);
-
-        spConnectedKF = pKF->GetConnectedKeyFrames();
-
         for(auto vit=pKF->mBowVec.cbegin(), vend=pKF->mBowVec.cend(); vit != vend; vit++)
         {
             std::list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
@@ -619,6 +660,8 @@ void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, std::vector<KeyFrame
             for(auto lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
             {
                 KeyFrame* pKFi=*lit;
+                if(pspMaps && !pspMaps->count(pKFi->GetMap()))
+                    continue;
 
                 if(pKFi->mnPlaceRecognitionQuery!=pKF->mnId)
                 {
@@ -633,9 +676,24 @@ void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, std::vector<KeyFrame
                 pKFi->mnPlaceRecognitionWords++;
             }
         }
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        spConnectedKF = pKF->GetConnectedKeyFrames();
+        searchSharedWords(NULL);
+
+        if(mnUnloadedEntries > 0 && mMapLoader)
+        {
+            mapLoader = mMapLoader;
+            for(auto vit=pKF->mBowVec.cbegin(), vend=pKF->mBowVec.cend(); vit != vend; vit++)
+            {
+                for(const auto &entry : mvUnloadedInvertedFile[vit->first])
+                    mUnloadedSharedWords[entry]++;
+            }
+        }
     }
-    if(lKFsSharingWords.empty())
-        return;
 
     // Only compare against those keyframes that share enough words
     int maxCommonWords=0;
@@ -644,9 +702,33 @@ void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, std::vector<KeyFrame
         if((*lit)->mnPlaceRecognitionWords>maxCommonWords)
             maxCommonWords=(*lit)->mnPlaceRecognitionWords;
     }
+    for(const auto &entry : mUnloadedSharedWords)
+    {
+        if(entry.second>maxCommonWords)
+            maxCommonWords=entry.second;
+    }
 
     int minCommonWords = maxCommonWords*0.8f;
 
+    // Page in the maps with keyframes sharing enough words, then search their keyframes too
+    std::set<Map*> spMapsToLoad;
+    for(const auto &entry : mUnloadedSharedWords)
+    {
+        if(entry.second>minCommonWords)
+            spMapsToLoad.insert(entry.first.first);
+    }
+    if(!spMapsToLoad.empty())
+    {
+        for(auto pMap : spMapsToLoad)
+            mapLoader(pMap);
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        searchSharedWords(&spMapsToLoad);
+    }
+
+    if(lKFsSharingWords.empty())
+        return;
+
     std::list<std::pair<float,KeyFrame*> > lScoreAndMatch;
 
     int nscores=0;
@@ -852,6 +934,9 @@ void KeyFrameDatabase::SetORBVocabulary(ORBVocabulary* pORBVoc)
 
     mvInvertedFile.clear();
     mvInvertedFile.resize(mpVoc->size());
+    mvUnloadedInvertedFile.clear();
+    mvUnloadedInvertedFile.resize(mpVoc->size());
+    mnUnloadedEntries = 0;
 }
 
 } //namespace ORB_SLAM
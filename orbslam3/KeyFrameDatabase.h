@@ -20,8 +20,10 @@
 #define KEYFRAMEDATABASE_H
 
 // Standard
+#include <functional>
 #include <list>
 #include <mutex>
+#include <utility>
 #include <vector>
 // 3rdparty
 #include <Eigen/Core>
@@ -77,6 +79,13 @@ public:
     void PostLoad(std::map<long unsigned int, KeyFrame*> mpKFid);
     void SetORBVocabulary(ORBVocabulary* pORBVoc);
 
+    // Maps of a lazily loaded atlas are indexed by the words of their KeyFrames only. When the
+    // KeyFrames of such a map share enough words with a query of DetectNBestCandidates, the map
+    // is paged in through the loader, which adds its KeyFrames and calls eraseUnloaded.
+    void addUnloaded(Map* pMap, long unsigned int nKFId, const std::vector<unsigned int> &vWordIds);
+    void eraseUnloaded(Map* pMap);
+    void SetMapLoader(std::function<void(Map*)> loader);
+
 protected:
 
    // Associated vocabulary
@@ -88,6 +97,11 @@ protected:
    // For save relation without pointer, this is necessary for save/load function
    std::vector<std::list<long unsigned int> > mvBackupInvertedFileId;
 
+   // Inverted file of the KeyFrames not loaded yet, by map and KeyFrame id
+   std::vector<std::vector<std::pair<Map*, long unsigned int> > > mvUnloadedInvertedFile;
+   std::size_t mnUnloadedEntries = 0;
+   std::function<void(Map*)> mMapLoader;
+
    // Mutex
    std::mutex mMutex;
 
@@ -0,0 +1,166 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <cassert>
+// 3rdparty
+#include <orbslam3/external/g2o/g2o/core/block_solver.h>
+#include <orbslam3/external/g2o/g2o/core/optimization_algorithm_levenberg.h>
+#include <orbslam3/external/g2o/g2o/core/robust_kernel_impl.h>
+#include <orbslam3/external/g2o/g2o/solvers/linear_solver_eigen.h>
+// Local
+#include "orbslam3/KeyFrame.h"
+#include "orbslam3/LocalBAContext.h"
+#include "orbslam3/Map.h"
+#include "orbslam3/MapPoint.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+// The keyframes and the map points have their own ids, which are interleaved
+// in the graph.
+int KeyFrameVertexId(const KeyFrame* pKF) { return static_cast<int>(2 * pKF->mnId); }
+int MapPointVertexId(const MapPoint* pMP) { return static_cast<int>(2 * pMP->mnId + 1); }
+
+} // namespace
+
+LocalBAContext::LocalBAContext() = default;
+
+LocalBAContext::~LocalBAContext() = default;
+
+void LocalBAContext::Clear() {
+  // The optimizer deletes its vertices, edges and solver.
+  optimizer_.reset();
+  keyframes_.clear();
+  map_points_.clear();
+  edges_.clear();
+  map_id_ = -1;
+}
+
+g2o::SparseOptimizer& LocalBAContext::Begin(Map* pMap) {
+  const long map_id = static_cast<long>(pMap->GetId());
+  if (map_id != map_id_) {
+    Clear();
+    map_id_ = map_id;
+  }
+  if (!optimizer_) {
+    using BlockSolver = g2o::BlockSolver_6_3;
+    BlockSolver::LinearSolverType* linear_solver =
+      new g2o::LinearSolverEigen<BlockSolver::PoseMatrixType>();
+    optimizer_.reset(new g2o::SparseOptimizer());
+    optimizer_->setAlgorithm(new g2o::OptimizationAlgorithmLevenberg(new BlockSolver(linear_solver)));
+    optimizer_->setVerbose(false);
+  }
+  ++window_;
+  return *optimizer_;
+}
+
+g2o::VertexSE3Expmap* LocalBAContext::AddKeyFrame(KeyFrame* pKF) {
+  Entry& entry = keyframes_[pKF->mnId];
+  if (!entry.vertex) {
+    g2o::VertexSE3Expmap* vertex = new g2o::VertexSE3Expmap();
+    vertex->setId(KeyFrameVertexId(pKF));
+    optimizer_->addVertex(vertex);
+    entry.vertex = vertex;
+  }
+  entry.window = window_;
+  return static_cast<g2o::VertexSE3Expmap*>(entry.vertex);
+}
+
+g2o::VertexSBAPointXYZ* LocalBAContext::AddMapPoint(MapPoint* pMP) {
+  Entry& entry = map_points_[pMP->mnId];
+  if (!entry.vertex) {
+    g2o::VertexSBAPointXYZ* vertex = new g2o::VertexSBAPointXYZ();
+    vertex->setId(MapPointVertexId(pMP));
+    vertex->setMarginalized(true);
+    optimizer_->addVertex(vertex);
+    entry.vertex = vertex;
+  }
+  entry.window = window_;
+  return static_cast<g2o::VertexSBAPointXYZ*>(entry.vertex);
+}
+
+g2o::VertexSE3Expmap* LocalBAContext::KeyFrameVertex(KeyFrame* pKF) const {
+  const auto it = keyframes_.find(pKF->mnId);
+  if (it == keyframes_.end() || it->second.window != window_)
+    return nullptr;
+  return static_cast<g2o::VertexSE3Expmap*>(it->second.vertex);
+}
+
+g2o::VertexSBAPointXYZ* LocalBAContext::MapPointVertex(MapPoint* pMP) const {
+  const auto it = map_points_.find(pMP->mnId);
+  if (it == map_points_.end() || it->second.window != window_)
+    return nullptr;
+  return static_cast<g2o::VertexSBAPointXYZ*>(it->second.vertex);
+}
+
+template <class EdgeType>
+EdgeType* LocalBAContext::AddEdge(MapPoint* pMP, KeyFrame* pKF, EdgeKind kind) {
+  EdgeEntry& entry = edges_[EdgeKey(pMP->mnId, pKF->mnId, kind)];
+  if (!entry.edge) {
+    assert(MapPointVertex(pMP) && KeyFrameVertex(pKF));
+    EdgeType* edge = new EdgeType();
+    edge->setVertex(0, map_points_.at(pMP->mnId).vertex);
+    edge->setVertex(1, keyframes_.at(pKF->mnId).vertex);
+    edge->setRobustKernel(new g2o::RobustKernelHuber);
+    optimizer_->addEdge(edge);
+    entry.edge = edge;
+  }
+  entry.window = window_;
+  return static_cast<EdgeType*>(entry.edge);
+}
+
+EdgeSE3ProjectXYZ* LocalBAContext::AddMonoEdge(MapPoint* pMP, KeyFrame* pKF) {
+  return AddEdge<EdgeSE3ProjectXYZ>(pMP, pKF, kMono);
+}
+
+g2o::EdgeStereoSE3ProjectXYZ* LocalBAContext::AddStereoEdge(MapPoint* pMP, KeyFrame* pKF) {
+  return AddEdge<g2o::EdgeStereoSE3ProjectXYZ>(pMP, pKF, kStereo);
+}
+
+EdgeSE3ProjectXYZToBody* LocalBAContext::AddBodyEdge(MapPoint* pMP, KeyFrame* pKF) {
+  return AddEdge<EdgeSE3ProjectXYZToBody>(pMP, pKF, kBody);
+}
+
+void LocalBAContext::End() {
+  // The edges first, the vertices would remove them too.
+  for (auto it = edges_.begin(); it != edges_.end();) {
+    if (it->second.window == window_) {
+      ++it;
+      continue;
+    }
+    optimizer_->removeEdge(it->second.edge);
+    it = edges_.erase(it);
+  }
+  for (std::map<unsigned long, Entry>* vertices : {&keyframes_, &map_points_}) {
+    for (auto it = vertices->begin(); it != vertices->end();) {
+      if (it->second.window == window_) {
+        ++it;
+        continue;
+      }
+      optimizer_->removeVertex(it->second.vertex);
+      it = vertices->erase(it);
+    }
+  }
+}
+
+} // namespace ORB_SLAM3
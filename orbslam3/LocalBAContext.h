@@ -0,0 +1,116 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef LOCAL_BA_CONTEXT_H
+#define LOCAL_BA_CONTEXT_H
+
+// Standard
+#include <map>
+#include <memory>
+#include <tuple>
+// 3rdparty
+#include <orbslam3/external/g2o/g2o/core/sparse_optimizer.h>
+// Local
+#include "orbslam3/OptimizableTypes.h"
+
+namespace ORB_SLAM3 {
+
+class KeyFrame;
+class Map;
+class MapPoint;
+
+// Graph of Optimizer::LocalBundleAdjustment kept between keyframes. The local
+// windows of consecutive keyframes share most of their keyframes, points and
+// observations, so the vertices and edges of a window stay in the graph while
+// they are in the next windows, and only the ones that enter or leave it are
+// created or removed. The solver is kept with them: its block structure and
+// the symbolic factorization of its linear solver are reused as long as the
+// window has the same sparsity pattern.
+//
+// A window is built between Begin and End: the objects that are added again
+// are marked and returned as they are, with the values of the previous window
+// that the caller overwrites, and End removes the ones that were not added.
+// The objects are keyed by the ids of the keyframes and the map points, so
+// the graph does not hold them. It is used from one thread at a time.
+class LocalBAContext {
+public:
+  LocalBAContext();
+  ~LocalBAContext();
+
+  LocalBAContext(const LocalBAContext&)            = delete;
+  LocalBAContext& operator=(const LocalBAContext&) = delete;
+
+  // Drop the graph, e.g. when the map it was built for is reset.
+  void Clear();
+
+  // Start the window of a local BA on pMap, with the graph of the previous
+  // window if it was on the same map. The optimizer owns a Levenberg solver.
+  g2o::SparseOptimizer& Begin(Map* pMap);
+
+  // Vertex of the keyframe or the map point, created when it enters the
+  // window. The map point vertices are marginalized.
+  g2o::VertexSE3Expmap* AddKeyFrame(KeyFrame* pKF);
+  g2o::VertexSBAPointXYZ* AddMapPoint(MapPoint* pMP);
+  // Vertex of the keyframe or the map point if it was added since Begin,
+  // nullptr otherwise.
+  g2o::VertexSE3Expmap* KeyFrameVertex(KeyFrame* pKF) const;
+  g2o::VertexSBAPointXYZ* MapPointVertex(MapPoint* pMP) const;
+
+  // Observation of the map point by the keyframe, both added since Begin,
+  // created with a Huber kernel when it enters the window.
+  EdgeSE3ProjectXYZ* AddMonoEdge(MapPoint* pMP, KeyFrame* pKF);
+  g2o::EdgeStereoSE3ProjectXYZ* AddStereoEdge(MapPoint* pMP, KeyFrame* pKF);
+  EdgeSE3ProjectXYZToBody* AddBodyEdge(MapPoint* pMP, KeyFrame* pKF);
+
+  // Remove the edges and the vertices that were not added since Begin.
+  void End();
+
+private:
+  enum EdgeKind { kMono, kStereo, kBody };
+
+  struct Entry {
+    g2o::OptimizableGraph::Vertex* vertex = nullptr;
+    unsigned long window                  = 0;
+  };
+  struct EdgeEntry {
+    g2o::OptimizableGraph::Edge* edge = nullptr;
+    unsigned long window              = 0;
+  };
+  // (map point, keyframe, kind) of an observation.
+  using EdgeKey = std::tuple<unsigned long, unsigned long, int>;
+
+  template <class EdgeType>
+  EdgeType* AddEdge(MapPoint* pMP, KeyFrame* pKF, EdgeKind kind);
+
+  std::unique_ptr<g2o::SparseOptimizer> optimizer_;
+  long map_id_          = -1;
+  unsigned long window_ = 0;
+
+  std::map<unsigned long, Entry> keyframes_;
+  std::map<unsigned long, Entry> map_points_;
+  std::map<EdgeKey, EdgeEntry> edges_;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // LOCAL_BA_CONTEXT_H
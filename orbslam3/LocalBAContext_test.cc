@@ -0,0 +1,136 @@
+// Standard
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <orbslam3/external/g2o/g2o/core/optimization_algorithm_levenberg.h>
+#include <orbslam3/external/g2o/g2o/core/robust_kernel.h>
+// Local
+#include "orbslam3/CameraModels/Pinhole.h"
+#include "orbslam3/KeyFrame.h"
+#include "orbslam3/LocalBAContext.h"
+#include "orbslam3/Map.h"
+#include "orbslam3/MapPoint.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+constexpr int kKeyFrames = 20, kPointsPerKeyFrame = 15, kWindow = 5;
+
+// Keyframes along the x axis and points in front of them. The window at w
+// has the keyframes w to w + kWindow - 1, the first one fixed, and the points
+// near them, which keyframe i sees when they are near i.
+struct Scene {
+  Pinhole camera{std::vector<float>{450.f, 450.f, 320.f, 240.f}};
+  std::vector<KeyFrame> keyframes{kKeyFrames};
+  std::vector<MapPoint> points{kKeyFrames * kPointsPerKeyFrame};
+  std::vector<g2o::SE3Quat> T_cw;
+  std::vector<Eigen::Vector3d> x_w;
+
+  Scene() {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+    for (int i = 0; i < kKeyFrames; ++i) {
+      keyframes[i].mnId = i;
+      T_cw.emplace_back(Eigen::Quaterniond::Identity(), Eigen::Vector3d(-0.2 * i, 0.0, 0.0));
+    }
+    for (std::size_t j = 0; j < points.size(); ++j) {
+      points[j].mnId = 100 + j;
+      x_w.emplace_back(0.2 * Near(j) + 0.5 * u(rng), 2.0 * u(rng), 6.0 + 2.0 * u(rng));
+    }
+  }
+
+  static int Near(std::size_t j) { return static_cast<int>(j) / kPointsPerKeyFrame; }
+};
+
+struct Result {
+  std::vector<double> poses;
+  std::size_t vertices = 0, edges = 0;
+};
+
+// Local BA of the window at w, with noisy points and observations.
+Result Adjust(Scene& scene, LocalBAContext& context, Map& map, const int w) {
+  g2o::SparseOptimizer& optimizer = context.Begin(&map);
+  static_cast<g2o::OptimizationAlgorithmLevenberg*>(optimizer.solver())->setUserLambdaInit(0.0);
+  for (int i = w; i < w + kWindow; ++i) {
+    g2o::VertexSE3Expmap* v = context.AddKeyFrame(&scene.keyframes[i]);
+    v->setEstimate(scene.T_cw[i]);
+    v->setFixed(i == w);
+  }
+  for (std::size_t j = 0; j < scene.points.size(); ++j) {
+    const int near = Scene::Near(j);
+    if (near < w - 2 || near > w + kWindow + 1)
+      continue;
+    MapPoint* pMP = &scene.points[j];
+    context.AddMapPoint(pMP)->setEstimate(scene.x_w[j] + Eigen::Vector3d(0.01, -0.02, 0.03));
+    for (int i = w; i < w + kWindow; ++i) {
+      if (std::abs(near - i) > 2)
+        continue;
+      const Eigen::Vector3d x_c = scene.T_cw[i].map(scene.x_w[j]);
+      const double noise        = 0.3 * ((i + j) % 3) - 0.3;
+      EdgeSE3ProjectXYZ* e      = context.AddMonoEdge(pMP, &scene.keyframes[i]);
+      e->setMeasurement(Eigen::Vector2d(450.0 * x_c.x() / x_c.z() + 320.0 + noise, 450.0 * x_c.y() / x_c.z() + 240.0));
+      e->setInformation(Eigen::Matrix2d::Identity());
+      e->robustKernel()->setDelta(std::sqrt(5.991));
+      e->pCamera = &scene.camera;
+    }
+  }
+  context.End();
+
+  optimizer.initializeOptimization();
+  optimizer.optimize(10);
+
+  Result result;
+  for (int i = w + 1; i < w + kWindow; ++i) {
+    const Eigen::Matrix<double, 7, 1> pose = context.KeyFrameVertex(&scene.keyframes[i])->estimate().toVector();
+    result.poses.insert(result.poses.end(), pose.data(), pose.data() + 7);
+  }
+  result.vertices = optimizer.vertices().size();
+  result.edges    = optimizer.edges().size();
+  return result;
+}
+
+} // namespace
+
+TEST(LocalBAContext, SlidingWindowMatchesNewGraphs) {
+  Scene scene;
+  Map map;
+  LocalBAContext kept;
+  for (int w = 2; w + kWindow <= kKeyFrames - 2; ++w) {
+    LocalBAContext fresh;
+    const Result expected = Adjust(scene, fresh, map, w);
+    const Result result   = Adjust(scene, kept, map, w);
+    EXPECT_EQ(result.vertices, expected.vertices);
+    EXPECT_EQ(result.edges, expected.edges);
+    ASSERT_EQ(result.poses.size(), expected.poses.size());
+    for (std::size_t k = 0; k < expected.poses.size(); ++k)
+      EXPECT_NEAR(result.poses[k], expected.poses[k], 1e-9);
+  }
+}
+
+TEST(LocalBAContext, KeepsTheObjectsInTheWindow) {
+  Scene scene;
+  Map map, other_map;
+  LocalBAContext context;
+  Adjust(scene, context, map, 4);
+  g2o::VertexSE3Expmap* keyframe = context.KeyFrameVertex(&scene.keyframes[6]);
+  g2o::VertexSBAPointXYZ* point  = context.MapPointVertex(&scene.points[6 * kPointsPerKeyFrame]);
+  ASSERT_NE(keyframe, nullptr);
+  ASSERT_NE(point, nullptr);
+  ASSERT_NE(context.MapPointVertex(&scene.points[2 * kPointsPerKeyFrame]), nullptr);
+
+  // The next window keeps the shared vertices and drops the ones it left.
+  Adjust(scene, context, map, 5);
+  EXPECT_EQ(context.KeyFrameVertex(&scene.keyframes[6]), keyframe);
+  EXPECT_EQ(context.MapPointVertex(&scene.points[6 * kPointsPerKeyFrame]), point);
+  EXPECT_EQ(context.KeyFrameVertex(&scene.keyframes[4]), nullptr);
+  EXPECT_EQ(context.MapPointVertex(&scene.points[2 * kPointsPerKeyFrame]), nullptr);
+
+  // A window on another map starts from an empty graph.
+  EXPECT_EQ(context.Begin(&other_map).vertices().size(), 0u);
+  context.End();
+}
@@ -37,6 +37,15 @@
 namespace ORB_SLAM3
 {
 
+namespace
+{
+
+// Period at which an idle thread still wakes up, to declare its quiescent state (see EpochReclaimer)
+// and to recheck the conditions not notified through the keyframe queue
+const std::chrono::milliseconds kIdlePeriod(50);
+
+}
+
 LocalMapping::LocalMapping(System* pSys, Atlas *pAtlas, const float bMonocular, bool bInertial, const std::string &_strSeqName):
     mpSystem(pSys), mbMonocular(bMonocular), mbInertial(bInertial), mbResetRequested(false), mbResetRequestedActiveMap(false), mbFinishRequested(false), mbFinished(true), mpAtlas(pAtlas), bInitializing(false),
     mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true),
@@ -51,6 +60,8 @@ LocalMapping::LocalMapping(System* pSys, Atlas *pAtlas, const float bMonocular,
     mNumLM = 0;
     mNumKFCulling=0;
 
+    mEpochParticipant = EpochParticipant(pSys ? pSys->GetReclaimer() : nullptr);
+
 #ifdef REGISTER_TIMES
     nLBA_exec = 0;
     nLBA_abort = 0;
@@ -153,12 +164,12 @@ void LocalMapping::Run()
                         }
 
                         bool bLarge = ((mpTracker->GetMatchesInliers()>75)&&mbMonocular)||((mpTracker->GetMatchesInliers()>100)&&!mbMonocular);
-                        Optimizer::LocalInertialBA(mpCurrentKeyFrame, &mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA, bLarge, !mpCurrentKeyFrame->GetMap()->GetIniertialBA2());
+                        Optimizer::LocalInertialBA(mpCurrentKeyFrame, &mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA, bLarge, !mpCurrentKeyFrame->GetMap()->GetIniertialBA2(), mpSystem->GetThreadPool());
                         b_doneLBA = true;
                     }
                     else
                     {
-                        Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA);
+                        Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA, mpSystem->GetThreadPool(), &mLocalBA);
                         b_doneLBA = true;
                     }
 
@@ -268,7 +279,8 @@ void LocalMapping::Run()
             // Safe area to stop
             while(isStopped() && !CheckFinish())
             {
-                usleep(3000);
+                Quiesce();
+                mNewKeyFrames.WaitFor(kIdlePeriod);
             }
             if(CheckFinish())
                 break;
@@ -282,36 +294,49 @@ void LocalMapping::Run()
         if(CheckFinish())
             break;
 
-        usleep(3000);
+        Quiesce();
+
+        // Woken by a new keyframe or a request
+        if(!CheckNewKeyFrames() || mbBadImu)
+            mNewKeyFrames.WaitFor(kIdlePeriod);
     }
 
+    mEpochParticipant = EpochParticipant();
     SetFinish();
 }
 
+void LocalMapping::Quiesce()
+{
+    if(!mEpochParticipant.IsRegistered())
+        return;
+
+    mlpRecentAddedMapPoints.remove_if([](MapPoint* pMP) { return pMP->isBad(); });
+    mEpochParticipant.Quiesce();
+}
+
 void LocalMapping::InsertKeyFrame(KeyFrame *pKF)
 {
-    std::unique_lock<std::mutex> lock(mMutexNewKFs);
-    mlNewKeyFrames.push_back(pKF);
+    mNewKeyFrames.Push(pKF);
     mbAbortBA=true;
 }
 
 
 bool LocalMapping::CheckNewKeyFrames()
 {
-    std::unique_lock<std::mutex> lock(mMutexNewKFs);
-    return(!mlNewKeyFrames.empty());
+    return(!mNewKeyFrames.Empty());
+}
+
+WorkQueue<KeyFrame*>::Metrics LocalMapping::GetQueueMetrics()
+{
+    return mNewKeyFrames.GetMetrics();
 }
 
 void LocalMapping::ProcessNewKeyFrame()
 {
-    {
-        std::unique_lock<std::mutex> lock(mMutexNewKFs);
-        mpCurrentKeyFrame = mlNewKeyFrames.front();
-        mlNewKeyFrames.pop_front();
-    }
+    mNewKeyFrames.TryPop(mpCurrentKeyFrame);
 
     // Compute Bags of Words structures
-    mpCurrentKeyFrame->ComputeBoW();
+    mpCurrentKeyFrame->ComputeBoW(mpSystem->GetThreadPool());
 
     // Associate MapPoints to the new keyframe and update normal and descriptor
     const std::vector<MapPoint*> vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
@@ -831,10 +856,12 @@ void LocalMapping::SearchInNeighbors()
 
 void LocalMapping::RequestStop()
 {
-    std::unique_lock<std::mutex> lock(mMutexStop);
-    mbStopRequested = true;
-    std::unique_lock<std::mutex> lock2(mMutexNewKFs);
-    mbAbortBA = true;
+    {
+        std::unique_lock<std::mutex> lock(mMutexStop);
+        mbStopRequested = true;
+        mbAbortBA = true;
+    }
+    mNewKeyFrames.Notify();
 }
 
 bool LocalMapping::Stop()
@@ -843,6 +870,7 @@ bool LocalMapping::Stop()
     if(mbStopRequested && !mbNotStop)
     {
         mbStopped = true;
+        mcvStopped.notify_all();
         LOG(INFO) << "Local Mapping STOP";
         return true;
     }
@@ -856,6 +884,12 @@ bool LocalMapping::isStopped()
     return mbStopped;
 }
 
+void LocalMapping::WaitUntilStopped()
+{
+    std::unique_lock<std::mutex> lock(mMutexStop);
+    mcvStopped.wait(lock, [this] { return mbStopped; });
+}
+
 bool LocalMapping::stopRequested()
 {
     std::unique_lock<std::mutex> lock(mMutexStop);
@@ -870,9 +904,9 @@ void LocalMapping::Release()
         return;
     mbStopped = false;
     mbStopRequested = false;
-    for(auto lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
-        delete *lit;
-    mlNewKeyFrames.clear();
+    for(KeyFrame* pKF : mNewKeyFrames.Clear())
+        delete pKF;
+    mNewKeyFrames.Notify();
 
     LOG(INFO) << "Local Mapping RELEASE";
 }
@@ -897,6 +931,8 @@ bool LocalMapping::SetNotStop(bool flag)
         return false;
 
     mbNotStop = flag;
+    if(!flag)
+        mNewKeyFrames.Notify();
 
     return true;
 }
@@ -1068,15 +1104,11 @@ void LocalMapping::RequestReset()
         mbResetRequested = true;
     }
     LOG(INFO) << "LM: Map reset, waiting...";
+    mNewKeyFrames.Notify();
 
-    while(1)
     {
-        {
-            std::unique_lock<std::mutex> lock2(mMutexReset);
-            if(!mbResetRequested)
-                break;
-        }
-        usleep(3000);
+        std::unique_lock<std::mutex> lock(mMutexReset);
+        mcvReset.wait(lock, [this] { return !mbResetRequested; });
     }
     LOG(INFO) << "LM: Map reset, Done!!!";
 }
@@ -1090,15 +1122,11 @@ void LocalMapping::RequestResetActiveMap(Map* pMap)
         mpMapToReset = pMap;
     }
     LOG(INFO) << "LM: Active map reset, waiting...";
+    mNewKeyFrames.Notify();
 
-    while(1)
     {
-        {
-            std::unique_lock<std::mutex> lock2(mMutexReset);
-            if(!mbResetRequestedActiveMap)
-                break;
-        }
-        usleep(3000);
+        std::unique_lock<std::mutex> lock(mMutexReset);
+        mcvReset.wait(lock, [this] { return !mbResetRequestedActiveMap; });
     }
     LOG(INFO) << "LM: Active map reset, Done!!!";
 }
@@ -1113,8 +1141,9 @@ void LocalMapping::ResetIfRequested()
             executed_reset = true;
 
             LOG(INFO) << "LM: Reseting Atlas in Local Mapping...";
-            mlNewKeyFrames.clear();
+            mNewKeyFrames.Clear();
             mlpRecentAddedMapPoints.clear();
+            mLocalBA.Clear();
             mbResetRequested = false;
             mbResetRequestedActiveMap = false;
 
@@ -1132,8 +1161,9 @@ void LocalMapping::ResetIfRequested()
         if(mbResetRequestedActiveMap) {
             executed_reset = true;
             LOG(INFO) << "LM: Reseting current map in Local Mapping...";
-            mlNewKeyFrames.clear();
+            mNewKeyFrames.Clear();
             mlpRecentAddedMapPoints.clear();
+            mLocalBA.Clear();
 
             // Inertial parameters
             mTinit = 0.f;
@@ -1145,6 +1175,9 @@ void LocalMapping::ResetIfRequested()
             mbResetRequestedActiveMap = false;
             LOG(INFO) << "LM: End reseting Local Mapping...";
         }
+
+        if(executed_reset)
+            mcvReset.notify_all();
     }
     if(executed_reset)
         LOG(INFO) << "LM: Reset free the mutex";
@@ -1153,8 +1186,11 @@ void LocalMapping::ResetIfRequested()
 
 void LocalMapping::RequestFinish()
 {
-    std::unique_lock<std::mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        std::unique_lock<std::mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    mNewKeyFrames.Notify();
 }
 
 bool LocalMapping::CheckFinish()
@@ -1169,6 +1205,7 @@ void LocalMapping::SetFinish()
     mbFinished = true;
     std::unique_lock<std::mutex> lock2(mMutexStop);
     mbStopped = true;
+    mcvStopped.notify_all();
 }
 
 bool LocalMapping::isFinished()
@@ -1311,9 +1348,9 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
     if (bFIBA)
     {
         if (priorA!=0.f)
-            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, true, priorG, priorA);
+            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, true, priorG, priorA, NULL, NULL, mpSystem->GetThreadPool());
         else
-            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, false);
+            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, false, 1e2, 1e6, NULL, NULL, mpSystem->GetThreadPool());
     }
 
     auto t5 = std::chrono::steady_clock::now();
@@ -1418,12 +1455,11 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
     mnKFs=vpKF.size();
     mIdxInit++;
 
-    for(auto lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
+    for(KeyFrame* pKF : mNewKeyFrames.Clear())
     {
-        (*lit)->SetBadFlag();
-        delete *lit;
+        pKF->SetBadFlag();
+        delete pKF;
     }
-    mlNewKeyFrames.clear();
 
     mpTracker->mState=Tracking::OK;
     bInitializing = false;
@@ -1487,12 +1523,11 @@ void LocalMapping::ScaleRefinement()
     }
     auto t3 = std::chrono::steady_clock::now();
 
-    for(auto lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
+    for(KeyFrame* pKF : mNewKeyFrames.Clear())
     {
-        (*lit)->SetBadFlag();
-        delete *lit;
+        pKF->SetBadFlag();
+        delete pKF;
     }
-    mlNewKeyFrames.clear();
 
     double t_inertial_only = std::chrono::duration_cast<std::chrono::duration<double> >(t1 - t0).count();
 
@@ -20,6 +20,7 @@
 #define LOCALMAPPING_H
 
 // Standard
+#include <condition_variable>
 #include <fstream>
 #include <list>
 #include <mutex>
@@ -27,6 +28,10 @@
 #include <vector>
 // 3rdparty
 #include <Eigen/Core>
+// Local
+#include "orbslam3/EpochReclaimer.h"
+#include "orbslam3/LocalBAContext.h"
+#include "orbslam3/WorkQueue.h"
 
 namespace ORB_SLAM3
 {
@@ -62,6 +67,8 @@ public:
     bool Stop();
     void Release();
     bool isStopped();
+    // Block until the local mapping stopped (or finished) after a RequestStop()
+    void WaitUntilStopped();
     bool stopRequested();
     bool AcceptKeyFrames();
     void SetAcceptKeyFrames(bool flag);
@@ -73,10 +80,12 @@ public:
     bool isFinished();
 
     int KeyframesInQueue(){
-        std::unique_lock<std::mutex> lock(mMutexNewKFs);
-        return mlNewKeyFrames.size();
+        return mNewKeyFrames.Size();
     }
 
+    // Depth of the keyframe queue, time the keyframes waited in it and time the thread waited for them
+    WorkQueue<KeyFrame*>::Metrics GetQueueMetrics();
+
     bool IsInitializing();
     double GetCurrKFTime();
     KeyFrame* GetCurrKF();
@@ -140,6 +149,11 @@ protected:
     void SearchInNeighbors();
     void KeyFrameCulling();
 
+    // Drop the bad recent MapPoints, then declare the local mapping quiescent
+    // so that they can be reclaimed (see EpochReclaimer)
+    void Quiesce();
+    EpochParticipant mEpochParticipant;
+
     System *mpSystem;
 
     bool mbMonocular;
@@ -150,6 +164,7 @@ protected:
     bool mbResetRequestedActiveMap;
     Map* mpMapToReset;
     std::mutex mMutexReset;
+    std::condition_variable mcvReset;
 
     bool CheckFinish();
     void SetFinish();
@@ -162,20 +177,23 @@ protected:
     LoopClosing* mpLoopCloser;
     Tracking* mpTracker;
 
-    std::list<KeyFrame*> mlNewKeyFrames;
+    // Keyframes inserted by the tracking. Stop, reset and finish requests notify it to wake the thread
+    WorkQueue<KeyFrame*> mNewKeyFrames;
 
     KeyFrame* mpCurrentKeyFrame;
 
     std::list<MapPoint*> mlpRecentAddedMapPoints;
 
-    std::mutex mMutexNewKFs;
-
     bool mbAbortBA;
 
+    // Graph of the local BA, kept between keyframes and dropped on reset
+    LocalBAContext mLocalBA;
+
     bool mbStopped;
     bool mbStopRequested;
     bool mbNotStop;
     std::mutex mMutexStop;
+    std::condition_variable mcvStopped;
 
     bool mbAcceptKeyFrames;
     std::mutex mMutexAccept;
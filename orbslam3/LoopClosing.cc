@@ -16,6 +16,8 @@
 * If not, see <http://www.gnu.org/licenses/>.
 */
 
+// Standard
+#include <chrono>
 // 3rdparty
 #include <glog/logging.h>
 // Local
@@ -36,10 +38,18 @@
 namespace ORB_SLAM3
 {
 
+namespace
+{
+
+// Period at which an idle thread still wakes up, to declare its quiescent state (see EpochReclaimer)
+const std::chrono::milliseconds kIdlePeriod(50);
+
+}
+
 LoopClosing::LoopClosing(Atlas *pAtlas, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale, const bool bActiveLC):
     mbResetRequested(false), mbResetActiveMapRequested(false), mbFinishRequested(false), mbFinished(true), mpAtlas(pAtlas),
     mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
-    mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0), mnLoopNumCoincidences(0), mnMergeNumCoincidences(0),
+    mbStopGBA(false), mpThreadGBA(NULL), mpReclaimer(nullptr), mpThreadPool(nullptr), mbFixScale(bFixScale), mnFullBAIdx(0), mnLoopNumCoincidences(0), mnMergeNumCoincidences(0),
     mbLoopDetected(false), mbMergeDetected(false), mnLoopNumNotFound(0), mnMergeNumNotFound(0), mbActiveLC(bActiveLC)
 {
     mnCovisibilityConsistencyTh = 3;
@@ -90,6 +100,17 @@ void LoopClosing::SetLocalMapper(LocalMapping *pLocalMapper)
     mpLocalMapper=pLocalMapper;
 }
 
+void LoopClosing::SetReclaimer(EpochReclaimer* pReclaimer)
+{
+    mpReclaimer = pReclaimer;
+    mEpochParticipant = EpochParticipant(pReclaimer);
+}
+
+void LoopClosing::SetThreadPool(ThreadPool* pThreadPool)
+{
+    mpThreadPool = pThreadPool;
+}
+
 
 void LoopClosing::Run()
 {
@@ -306,23 +327,33 @@ void LoopClosing::Run()
             break;
         }
 
-        usleep(5000);
+        // The MapPoints of a place recognition are kept until it is confirmed or discarded
+        if(mnLoopNumCoincidences == 0 && mnMergeNumCoincidences == 0)
+            mEpochParticipant.Quiesce();
+
+        // Woken by a new keyframe or a request. Without place recognition the keyframes are left in the queue
+        if(!mbActiveLC || !CheckNewKeyFrames())
+            mLoopKeyFrameQueue.WaitFor(kIdlePeriod);
     }
 
+    mEpochParticipant = EpochParticipant();
     SetFinish();
 }
 
 void LoopClosing::InsertKeyFrame(KeyFrame *pKF)
 {
-    std::unique_lock<std::mutex> lock(mMutexLoopQueue);
     if(pKF->mnId!=0)
-        mlpLoopKeyFrameQueue.push_back(pKF);
+        mLoopKeyFrameQueue.Push(pKF);
 }
 
 bool LoopClosing::CheckNewKeyFrames()
 {
-    std::unique_lock<std::mutex> lock(mMutexLoopQueue);
-    return(!mlpLoopKeyFrameQueue.empty());
+    return(!mLoopKeyFrameQueue.Empty());
+}
+
+WorkQueue<KeyFrame*>::Metrics LoopClosing::GetQueueMetrics()
+{
+    return mLoopKeyFrameQueue.GetMetrics();
 }
 
 bool LoopClosing::NewDetectCommonRegions()
@@ -332,9 +363,7 @@ bool LoopClosing::NewDetectCommonRegions()
         return false;
 
     {
-        std::unique_lock<std::mutex> lock(mMutexLoopQueue);
-        mpCurrentKF = mlpLoopKeyFrameQueue.front();
-        mlpLoopKeyFrameQueue.pop_front();
+        mLoopKeyFrameQueue.TryPop(mpCurrentKF);
         // Avoid that a keyframe can be erased while it is being process by this thread
         mpCurrentKF->SetNotErase();
         mpCurrentKF->mbCurrentPlaceRecognition = true;
@@ -349,7 +378,7 @@ bool LoopClosing::NewDetectCommonRegions()
         return false;
     }
 
-    if(mpTracker->mSensor == System::STEREO && mpLastMap->GetAllKeyFrames().size() < 5) //12
+    if(mpTracker->mSensor == System::STEREO && mpLastMap->KeyFramesInMap() < 5) //12
     {
         // LOG(WARNING) << "LoopClousure: Stereo KF inserted without check: " << mpCurrentKF->mnId;
         mpKeyFrameDB->add(mpCurrentKF);
@@ -357,7 +386,7 @@ bool LoopClosing::NewDetectCommonRegions()
         return false;
     }
 
-    if(mpLastMap->GetAllKeyFrames().size() < 12)
+    if(mpLastMap->KeyFramesInMap() < 12)
     {
         // LOG(WARNING) << "LoopClousure: Stereo KF inserted without check, map is small: " << mpCurrentKF->mnId;
         mpKeyFrameDB->add(mpCurrentKF);
@@ -996,10 +1025,7 @@ void LoopClosing::CorrectLoop()
     }
 
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
 
     // Ensure current keyframe is updated
     // LOG(INFO) << "Start updating connections";
@@ -1252,10 +1278,7 @@ void LoopClosing::MergeLocal()
     // LOG(INFO) << "Request Stop Local Mapping";
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
     // LOG(INFO) << "Local Map stopped";
 
     mpLocalMapper->EmptyQueue();
@@ -1710,10 +1733,7 @@ void LoopClosing::MergeLocal()
 
         mpLocalMapper->RequestStop();
         // Wait until Local Mapping has effectively stopped
-        while(!mpLocalMapper->isStopped())
-        {
-            usleep(1000);
-        }
+        mpLocalMapper->WaitUntilStopped();
 
         // Optimize graph (and update the loop position for each element form the begining to the end)
         if(mpTracker->mSensor != System::MONOCULAR)
@@ -1824,10 +1844,7 @@ void LoopClosing::MergeLocal2()
     // LOG(INFO) << "Request Stop Local Mapping";
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
     // LOG(INFO) << "Local Map stopped";
 
     Map* pCurrentMap = mpCurrentKF->GetMap();
@@ -2196,16 +2213,10 @@ void LoopClosing::RequestReset()
         std::unique_lock<std::mutex> lock(mMutexReset);
         mbResetRequested = true;
     }
+    mLoopKeyFrameQueue.Notify();
 
-    while(1)
-    {
-        {
-        std::unique_lock<std::mutex> lock2(mMutexReset);
-        if(!mbResetRequested)
-            break;
-        }
-        usleep(5000);
-    }
+    std::unique_lock<std::mutex> lock(mMutexReset);
+    mcvReset.wait(lock, [this] { return !mbResetRequested; });
 }
 
 void LoopClosing::RequestResetActiveMap(Map *pMap)
@@ -2215,16 +2226,10 @@ void LoopClosing::RequestResetActiveMap(Map *pMap)
         mbResetActiveMapRequested = true;
         mpMapToReset = pMap;
     }
+    mLoopKeyFrameQueue.Notify();
 
-    while(1)
-    {
-        {
-            std::unique_lock<std::mutex> lock2(mMutexReset);
-            if(!mbResetActiveMapRequested)
-                break;
-        }
-        usleep(3000);
-    }
+    std::unique_lock<std::mutex> lock(mMutexReset);
+    mcvReset.wait(lock, [this] { return !mbResetActiveMapRequested; });
 }
 
 void LoopClosing::ResetIfRequested()
@@ -2233,33 +2238,29 @@ void LoopClosing::ResetIfRequested()
     if(mbResetRequested)
     {
         LOG(INFO) << "Loop closer reset requested...";
-        mlpLoopKeyFrameQueue.clear();
+        mLoopKeyFrameQueue.Clear();
         mLastLoopKFid=0;  //TODO old variable, it is not use in the new algorithm
         mbResetRequested=false;
         mbResetActiveMapRequested = false;
+        mcvReset.notify_all();
     }
     else if(mbResetActiveMapRequested)
     {
-
-        for (auto it=mlpLoopKeyFrameQueue.cbegin(); it != mlpLoopKeyFrameQueue.cend();)
-        {
-            KeyFrame* pKFi = *it;
-            if(pKFi->GetMap() == mpMapToReset)
-            {
-                it = mlpLoopKeyFrameQueue.erase(it);
-            }
-            else
-                ++it;
-        }
+        Map* pMapToReset = mpMapToReset;
+        mLoopKeyFrameQueue.EraseIf([pMapToReset](KeyFrame* pKFi) { return pKFi->GetMap() == pMapToReset; });
 
         mLastLoopKFid=mpAtlas->GetLastInitKFid(); //TODO old variable, it is not use in the new algorithm
         mbResetActiveMapRequested=false;
+        mcvReset.notify_all();
 
     }
 }
 
 void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoopKF)
 {
+    // No MapPoint is reclaimed while the BA runs
+    EpochParticipant participant(mpReclaimer);
+
     VLOG(1) << "Starting Global Bundle Adjustment";
 
 #ifdef REGISTER_TIMES
@@ -2267,16 +2268,16 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 
     nFGBA_exec += 1;
 
-    vnGBAKFs.push_back(pActiveMap->GetAllKeyFrames().size());
-    vnGBAMPs.push_back(pActiveMap->GetAllMapPoints().size());
+    vnGBAKFs.push_back(pActiveMap->KeyFramesInMap());
+    vnGBAMPs.push_back(pActiveMap->MapPointsInMap());
 #endif
 
     const bool bImuInit = pActiveMap->isImuInitialized();
 
     if(!bImuInit)
-        Optimizer::GlobalBundleAdjustemnt(pActiveMap,10,&mbStopGBA,nLoopKF,false);
+        Optimizer::GlobalBundleAdjustemnt(pActiveMap,10,&mbStopGBA,nLoopKF,false,mpThreadPool);
     else
-        Optimizer::FullInertialBA(pActiveMap,7,false,nLoopKF,&mbStopGBA);
+        Optimizer::FullInertialBA(pActiveMap,7,false,nLoopKF,&mbStopGBA,false,1e2,1e6,NULL,NULL,mpThreadPool);
 
 #ifdef REGISTER_TIMES
     auto time_EndGBA = std::chrono::steady_clock::now();
@@ -2313,10 +2314,7 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
             mpLocalMapper->RequestStop();
             // Wait until Local Mapping has effectively stopped
 
-            while(!mpLocalMapper->isStopped() && !mpLocalMapper->isFinished())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             // Get Map Mutex
             std::unique_lock<std::mutex> lock(pActiveMap->mMutexMapUpdate);
@@ -2517,9 +2515,12 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 
 void LoopClosing::RequestFinish()
 {
-    std::unique_lock<std::mutex> lock(mMutexFinish);
-    // LOG(INFO) << "LC: Finish requested";
-    mbFinishRequested = true;
+    {
+        std::unique_lock<std::mutex> lock(mMutexFinish);
+        // LOG(INFO) << "LC: Finish requested";
+        mbFinishRequested = true;
+    }
+    mLoopKeyFrameQueue.Notify();
 }
 
 bool LoopClosing::CheckFinish()
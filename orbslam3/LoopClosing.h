@@ -20,6 +20,7 @@
 #define LOOPCLOSING_H
 
 // Standard
+#include <condition_variable>
 #include <list>
 #include <mutex>
 #include <set>
@@ -30,7 +31,9 @@
 #include <Eigen/Core>
 #include <orbslam3/external/g2o/g2o/types/sim3.h>
 // Local
+#include "orbslam3/EpochReclaimer.h"
 #include "orbslam3/ORBVocabulary.h"
+#include "orbslam3/WorkQueue.h"
 
 namespace ORB_SLAM3
 {
@@ -41,6 +44,7 @@ class KeyFrameDatabase;
 class LocalMapping;
 class Map;
 class MapPoint;
+class ThreadPool;
 class Tracking;
 class Viewer;
 
@@ -58,6 +62,12 @@ public:
 
     void SetLocalMapper(LocalMapping* pLocalMapper);
 
+    // Reclaimer of the bad MapPoints, to set before launching the thread
+    void SetReclaimer(EpochReclaimer* pReclaimer);
+
+    // Pool of the global BA, to set before launching the thread
+    void SetThreadPool(ThreadPool* pThreadPool);
+
     // Main function
     void Run();
 
@@ -82,6 +92,9 @@ public:
 
     bool isFinished();
 
+    // Depth of the keyframe queue, time the keyframes waited in it and time the thread waited for them
+    WorkQueue<KeyFrame*>::Metrics GetQueueMetrics();
+
     Viewer* mpViewer;
 
 #ifdef REGISTER_TIMES
@@ -149,6 +162,7 @@ protected:
     bool mbResetActiveMapRequested;
     Map* mpMapToReset;
     std::mutex mMutexReset;
+    std::condition_variable mcvReset;
 
     bool CheckFinish();
     void SetFinish();
@@ -164,9 +178,8 @@ protected:
 
     LocalMapping *mpLocalMapper;
 
-    std::list<KeyFrame*> mlpLoopKeyFrameQueue;
-
-    std::mutex mMutexLoopQueue;
+    // Keyframes processed by the local mapping. Reset and finish requests notify it to wake the thread
+    WorkQueue<KeyFrame*> mLoopKeyFrameQueue;
 
     // Loop detector parameters
     float mnCovisibilityConsistencyTh;
@@ -219,6 +232,12 @@ protected:
     std::mutex mMutexGBA;
     std::thread* mpThreadGBA;
 
+    // The loop closing is quiescent between two place recognitions, the global BA thread once finished
+    EpochReclaimer* mpReclaimer;
+    EpochParticipant mEpochParticipant;
+
+    ThreadPool* mpThreadPool;
+
     // Fix scale in the stereo/RGB-D case
     bool mbFixScale;
 
@@ -16,11 +16,16 @@
 * If not, see <http://www.gnu.org/licenses/>.
 */
 
+// Standard
+#include <algorithm>
+#include <unordered_set>
 // 3rdparty
 #include <glog/logging.h>
 // Local
 #include "orbslam3/Atlas.h"
+#include "orbslam3/AtlasFile.h"
 #include "orbslam3/CameraModels/GeometricCamera.h"
+#include "orbslam3/EpochReclaimer.h"
 #include "orbslam3/KeyFrame.h"
 #include "orbslam3/KeyFrameDatabase.h"
 #include "orbslam3/Map.h"
@@ -29,6 +34,28 @@
 namespace ORB_SLAM3
 {
 
+namespace
+{
+
+// Reclaim function of the retired MapPoints
+bool ReclaimMapPoint(void* pObject)
+{
+    MapPoint* pMP = static_cast<MapPoint*>(pObject);
+    if(!pMP->IsReclaimable())
+    {
+        // What still refers to it may follow it to its replacement, retired later
+        MapPoint* pRep = pMP->GetReplaced();
+        if(pRep)
+            pRep->SetPinned();
+        return false;
+    }
+
+    delete pMP;
+    return true;
+}
+
+} // namespace
+
 long unsigned int Map::nNextId=0;
 
 Map::Map():mnMaxKFid(0),mnBigChangeIdx(0), mbImuInitialized(false), mnMapChange(0), mpFirstRegionKF(static_cast<KeyFrame*>(NULL)),
@@ -61,10 +88,10 @@ Map::Map(int initKFid)
 Map::~Map()
 {
     //TODO: erase all points from memory
-    mspMapPoints.clear();
+    mMapPoints.Clear();
 
     //TODO: erase all keyframes from memory
-    mspKeyFrames.clear();
+    mKeyFrames.Clear();
 
     if(mThumbnail)
         delete mThumbnail;
@@ -77,13 +104,13 @@ Map::~Map()
 void Map::AddKeyFrame(KeyFrame *pKF)
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    if(mspKeyFrames.empty()){
+    if(mKeyFrames.Empty()){
         LOG(INFO) << "First KF:" << pKF->mnId << "; Map init KF:" << mnInitKFid;
         mnInitKFid = pKF->mnId;
         mpKFinitial = pKF;
         mpKFlowerID = pKF;
     }
-    mspKeyFrames.insert(pKF);
+    mKeyFrames.Insert(pKF);
     if(pKF->mnId>mnMaxKFid)
     {
         mnMaxKFid=pKF->mnId;
@@ -97,7 +124,7 @@ void Map::AddKeyFrame(KeyFrame *pKF)
 void Map::AddMapPoint(MapPoint *pMP)
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    mspMapPoints.insert(pMP);
+    mMapPoints.Insert(pMP);
 }
 
 void Map::SetImuInitialized()
@@ -115,24 +142,38 @@ bool Map::isImuInitialized()
 void Map::EraseMapPoint(MapPoint *pMP)
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    mspMapPoints.erase(pMP);
+    mMapPoints.Erase(pMP);
 
     // TODO: This only erase the pointer.
     // Delete the MapPoint
 }
 
+void Map::RetireMapPoint(MapPoint *pMP)
+{
+    std::unique_lock<std::mutex> lock(mMutexMap);
+    // Only the first retirement of a MapPoint still in the map hands it over
+    if(!mMapPoints.Erase(pMP) || !mpReclaimer)
+        return;
+
+    mvpReferenceMapPoints.erase(std::remove(mvpReferenceMapPoints.begin(), mvpReferenceMapPoints.end(), pMP),
+                                mvpReferenceMapPoints.end());
+    mpReclaimer->Retire(pMP, &ReclaimMapPoint);
+}
+
+void Map::SetReclaimer(EpochReclaimer* pReclaimer)
+{
+    std::unique_lock<std::mutex> lock(mMutexMap);
+    mpReclaimer = pReclaimer;
+}
+
 void Map::EraseKeyFrame(KeyFrame *pKF)
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    mspKeyFrames.erase(pKF);
-    if(mspKeyFrames.size()>0)
+    mKeyFrames.Erase(pKF);
+    if(mKeyFrames.Size()>0)
     {
         if(pKF->mnId == mpKFlowerID->mnId)
-        {
-            std::vector<KeyFrame*> vpKFs = std::vector<KeyFrame*>(mspKeyFrames.begin(),mspKeyFrames.end());
-            std::sort(vpKFs.begin(),vpKFs.end(),KeyFrame::lId);
-            mpKFlowerID = vpKFs[0];
-        }
+            mpKFlowerID = *std::min_element(mKeyFrames.begin(),mKeyFrames.end(),KeyFrame::lId);
     }
     else
     {
@@ -164,25 +205,37 @@ int Map::GetLastBigChangeIdx()
 std::vector<KeyFrame*> Map::GetAllKeyFrames()
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    return std::vector<KeyFrame*>(mspKeyFrames.begin(),mspKeyFrames.end());
+    return std::vector<KeyFrame*>(mKeyFrames.begin(),mKeyFrames.end());
 }
 
 std::vector<MapPoint*> Map::GetAllMapPoints()
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    return std::vector<MapPoint*>(mspMapPoints.begin(),mspMapPoints.end());
+    return std::vector<MapPoint*>(mMapPoints.begin(),mMapPoints.end());
+}
+
+Map::KeyFrameSnapshot Map::GetKeyFrameSnapshot()
+{
+    std::unique_lock<std::mutex> lock(mMutexMap);
+    return mKeyFrames.GetSnapshot();
+}
+
+Map::MapPointSnapshot Map::GetMapPointSnapshot()
+{
+    std::unique_lock<std::mutex> lock(mMutexMap);
+    return mMapPoints.GetSnapshot();
 }
 
 long unsigned int Map::MapPointsInMap()
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    return mspMapPoints.size();
+    return mMapPoints.Size();
 }
 
 long unsigned int Map::KeyFramesInMap()
 {
     std::unique_lock<std::mutex> lock(mMutexMap);
-    return mspKeyFrames.size();
+    return mKeyFrames.Size();
 }
 
 std::vector<MapPoint*> Map::GetReferenceMapPoints()
@@ -230,18 +283,18 @@ void Map::SetStoredMap()
 
 void Map::clear()
 {
-//    for(auto sit=mspMapPoints.begin(), send=mspMapPoints.end(); sit!=send; sit++)
+//    for(auto sit=mMapPoints.begin(), send=mMapPoints.end(); sit!=send; sit++)
 //        delete *sit;
 
-    for(auto sit=mspKeyFrames.begin(), send=mspKeyFrames.end(); sit!=send; sit++)
+    for(auto sit=mKeyFrames.begin(), send=mKeyFrames.end(); sit!=send; sit++)
     {
         KeyFrame* pKF = *sit;
         pKF->UpdateMap(static_cast<Map*>(NULL));
 //        delete *sit;
     }
 
-    mspMapPoints.clear();
-    mspKeyFrames.clear();
+    mMapPoints.Clear();
+    mKeyFrames.Clear();
     mnMaxKFid = mnInitKFid;
     mbImuInitialized = false;
     mvpReferenceMapPoints.clear();
@@ -275,7 +328,7 @@ void Map::ApplyScaledRotation(const Sophus::SE3f &T, const float s, const bool b
     Eigen::Matrix3f Ryw = Tyw.rotationMatrix();
     Eigen::Vector3f tyw = Tyw.translation();
 
-    for(auto sit=mspKeyFrames.begin(); sit!=mspKeyFrames.end(); sit++)
+    for(auto sit=mKeyFrames.begin(); sit!=mKeyFrames.end(); sit++)
     {
         KeyFrame* pKF = *sit;
         Sophus::SE3f Twc = pKF->GetPoseInverse();
@@ -290,7 +343,7 @@ void Map::ApplyScaledRotation(const Sophus::SE3f &T, const float s, const bool b
             pKF->SetVelocity(Ryw*Vw*s);
 
     }
-    for(auto sit=mspMapPoints.begin(); sit!=mspMapPoints.end(); sit++)
+    for(auto sit=mMapPoints.begin(); sit!=mMapPoints.end(); sit++)
     {
         MapPoint* pMP = *sit;
         pMP->SetWorldPos(s * Ryw * pMP->GetWorldPos() + tyw);
@@ -374,9 +427,39 @@ void Map::SetLastMapChange(int currentChangeId)
 }
 
 void Map::PreSave(std::set<GeometricCamera*> &spCams)
+{
+    PrepareSave();
+
+    const std::function<bool(KeyFrame*)> isKF = [this](KeyFrame* pKF) { return mKeyFrames.Contains(pKF); };
+    const std::function<bool(MapPoint*)> isMP = [this](MapPoint* pMP) { return mMapPoints.Contains(pMP); };
+
+    // Backup of MapPoints
+    mvpBackupMapPoints.clear();
+    for(auto pMPi : mMapPoints)
+    {
+        if(!pMPi || pMPi->isBad())
+            continue;
+
+        mvpBackupMapPoints.push_back(pMPi);
+        pMPi->PreSave(isKF,isMP);
+    }
+
+    // Backup of KeyFrames
+    mvpBackupKeyFrames.clear();
+    for(auto pKFi : mKeyFrames)
+    {
+        if(!pKFi || pKFi->isBad())
+            continue;
+
+        mvpBackupKeyFrames.push_back(pKFi);
+        pKFi->PreSave(isKF,isMP,spCams);
+    }
+}
+
+void Map::PrepareSave()
 {
     int nMPWithoutObs = 0;
-    for(auto pMPi : mspMapPoints)
+    for(auto pMPi : mMapPoints)
     {
         if(!pMPi || pMPi->isBad())
             continue;
@@ -396,6 +479,11 @@ void Map::PreSave(std::set<GeometricCamera*> &spCams)
         }
     }
 
+    BackupHeaderIds();
+}
+
+void Map::BackupHeaderIds()
+{
     // Saves the id of KF origins
     mvBackupKeyFrameOriginsId.clear();
     mvBackupKeyFrameOriginsId.reserve(mvpKeyFrameOrigins.size());
@@ -404,41 +492,236 @@ void Map::PreSave(std::set<GeometricCamera*> &spCams)
         mvBackupKeyFrameOriginsId.push_back(mvpKeyFrameOrigins[i]->mnId);
     }
 
+    mnBackupKFinitialID = -1;
+    if(mpKFinitial)
+    {
+        mnBackupKFinitialID = mpKFinitial->mnId;
+    }
 
-    // Backup of MapPoints
-    mvpBackupMapPoints.clear();
-    for(auto pMPi : mspMapPoints)
+    mnBackupKFlowerID = -1;
+    if(mpKFlowerID)
+    {
+        mnBackupKFlowerID = mpKFlowerID->mnId;
+    }
+
+}
+
+bool Map::Save(AtlasFileWriter &writer, std::set<GeometricCamera*> &spCams, const std::function<void(std::size_t)> &itemsSaved)
+{
+    PrepareSave();
+
+    bool bOk = writer.Write(AtlasSection::kMap, mnId, 0, [this](boost::archive::binary_oarchive &ar) {
+        serializeHeader(ar);
+    });
+
+    const std::function<bool(KeyFrame*)> isKF = [this](KeyFrame* pKF) { return mKeyFrames.Contains(pKF); };
+    const std::function<bool(MapPoint*)> isMP = [this](MapPoint* pMP) { return mMapPoints.Contains(pMP); };
+
+    // Blocks are backed up right before being written
+    std::vector<MapPoint*> vpMPs;
+    vpMPs.reserve(MAP_POINTS_PER_BLOCK);
+    for(auto pMPi : mMapPoints)
     {
         if(!pMPi || pMPi->isBad())
             continue;
 
-        mvpBackupMapPoints.push_back(pMPi);
-        pMPi->PreSave(mspKeyFrames,mspMapPoints);
+        pMPi->PreSave(isKF,isMP);
+        vpMPs.push_back(pMPi);
+        if(vpMPs.size() == MAP_POINTS_PER_BLOCK)
+        {
+            bOk = bOk && WriteMapPoints(writer, vpMPs, itemsSaved);
+            vpMPs.clear();
+        }
     }
+    bOk = bOk && WriteMapPoints(writer, vpMPs, itemsSaved);
 
-    // Backup of KeyFrames
-    mvpBackupKeyFrames.clear();
-    for(auto pKFi : mspKeyFrames)
+    std::vector<KeyFrame*> vpKFs, vpSavedKFs;
+    vpKFs.reserve(KEY_FRAMES_PER_BLOCK);
+    vpSavedKFs.reserve(mKeyFrames.Size());
+    for(auto pKFi : mKeyFrames)
     {
         if(!pKFi || pKFi->isBad())
             continue;
 
-        mvpBackupKeyFrames.push_back(pKFi);
-        pKFi->PreSave(mspKeyFrames,mspMapPoints, spCams);
+        pKFi->PreSave(isKF,isMP,spCams);
+        vpKFs.push_back(pKFi);
+        vpSavedKFs.push_back(pKFi);
+        if(vpKFs.size() == KEY_FRAMES_PER_BLOCK)
+        {
+            bOk = bOk && WriteKeyFrames(writer, vpKFs, itemsSaved);
+            vpKFs.clear();
+        }
     }
+    bOk = bOk && WriteKeyFrames(writer, vpKFs, itemsSaved);
 
-    mnBackupKFinitialID = -1;
-    if(mpKFinitial)
+    return bOk && WriteBowIndex(writer, vpSavedKFs);
+}
+
+bool Map::CaptureSnapshot(AtlasFileWriter &writer, std::set<GeometricCamera*> &spCams, std::vector<MapPoint*> &vpMPs, std::vector<KeyFrame*> &vpKFs)
+{
+    // The map update lock held by the caller keeps the optimizations out, the
+    // map mutex guards the sets. Local mapping may still insert and erase
+    // objects, so only the objects of the snapshots are saved and referenced.
+    MapPointSnapshot pMPs;
+    KeyFrameSnapshot pKFs;
+    bool bOk;
     {
-        mnBackupKFinitialID = mpKFinitial->mnId;
+        std::unique_lock<std::mutex> lock(mMutexMap);
+        pMPs = mMapPoints.GetSnapshot();
+        pKFs = mKeyFrames.GetSnapshot();
+        BackupHeaderIds();
+        bOk = writer.Write(AtlasSection::kMap, mnId, 0, [this](boost::archive::binary_oarchive &ar) {
+            serializeHeader(ar);
+        });
     }
+    const std::unordered_set<KeyFrame*> spKFs(pKFs->begin(), pKFs->end());
+    const std::unordered_set<MapPoint*> spMPs(pMPs->begin(), pMPs->end());
+    const std::function<bool(KeyFrame*)> isKF = [&spKFs](KeyFrame* pKF) { return spKFs.count(pKF) > 0; };
+    const std::function<bool(MapPoint*)> isMP = [&spMPs](MapPoint* pMP) { return spMPs.count(pMP) > 0; };
+
+    vpMPs.clear();
+    vpMPs.reserve(pMPs->size());
+    for(auto pMPi : *pMPs)
+    {
+        if(!pMPi || pMPi->isBad())
+            continue;
 
-    mnBackupKFlowerID = -1;
-    if(mpKFlowerID)
+        pMPi->PreSave(isKF,isMP,false);
+        vpMPs.push_back(pMPi);
+    }
+
+    vpKFs.clear();
+    vpKFs.reserve(pKFs->size());
+    for(auto pKFi : *pKFs)
     {
-        mnBackupKFlowerID = mpKFlowerID->mnId;
+        if(!pKFi || pKFi->isBad())
+            continue;
+
+        pKFi->PreSave(isKF,isMP,spCams);
+        vpKFs.push_back(pKFi);
     }
 
+    return bOk;
+}
+
+bool Map::SaveSnapshot(AtlasFileWriter &writer, const std::vector<MapPoint*> &vpMPs, const std::vector<KeyFrame*> &vpKFs, const std::function<void(std::size_t)> &itemsSaved)
+{
+    bool bOk = true;
+    for(std::size_t i = 0; i < vpMPs.size() && bOk; i += MAP_POINTS_PER_BLOCK)
+    {
+        const std::vector<MapPoint*> vpBlock(vpMPs.begin() + i, vpMPs.begin() + std::min(i + MAP_POINTS_PER_BLOCK, vpMPs.size()));
+        bOk = WriteMapPoints(writer, vpBlock, itemsSaved);
+    }
+    for(std::size_t i = 0; i < vpKFs.size() && bOk; i += KEY_FRAMES_PER_BLOCK)
+    {
+        const std::vector<KeyFrame*> vpBlock(vpKFs.begin() + i, vpKFs.begin() + std::min(i + KEY_FRAMES_PER_BLOCK, vpKFs.size()));
+        bOk = WriteKeyFrames(writer, vpBlock, itemsSaved);
+    }
+    return bOk && WriteBowIndex(writer, vpKFs);
+}
+
+bool Map::WriteMapPoints(AtlasFileWriter &writer, const std::vector<MapPoint*> &vpMPs, const std::function<void(std::size_t)> &itemsSaved)
+{
+    if(vpMPs.empty())
+        return true;
+
+    // Each MapPoint is locked while serialized, in case the system still runs
+    const bool bOk = writer.Write(AtlasSection::kMapPoints, mnId, vpMPs.size(), [&vpMPs](boost::archive::binary_oarchive &ar) {
+        for(auto pMPi : vpMPs)
+        {
+            auto lock = pMPi->LockState();
+            ar & pMPi;
+        }
+    });
+
+    for(auto pMPi : vpMPs)
+        pMPi->ClearBackup();
+    itemsSaved(vpMPs.size());
+    return bOk;
+}
+
+bool Map::WriteKeyFrames(AtlasFileWriter &writer, const std::vector<KeyFrame*> &vpKFs, const std::function<void(std::size_t)> &itemsSaved)
+{
+    if(vpKFs.empty())
+        return true;
+
+    // Each KeyFrame is locked while serialized, in case the system still runs
+    const bool bOk = writer.Write(AtlasSection::kKeyFrames, mnId, vpKFs.size(), [&vpKFs](boost::archive::binary_oarchive &ar) {
+        for(auto pKFi : vpKFs)
+        {
+            auto lock = pKFi->LockState();
+            ar & pKFi;
+        }
+    });
+
+    for(auto pKFi : vpKFs)
+        pKFi->ClearBackup();
+    itemsSaved(vpKFs.size());
+    return bOk;
+}
+
+bool Map::WriteBowIndex(AtlasFileWriter &writer, const std::vector<KeyFrame*> &vpKFs)
+{
+    return writer.Write(AtlasSection::kBowIndex, mnId, vpKFs.size(), [&vpKFs](boost::archive::binary_oarchive &ar) {
+        std::vector<unsigned int> vWordIds;
+        for(auto pKFi : vpKFs)
+        {
+            vWordIds.clear();
+            for(const auto &word : pKFi->mBowVec)
+                vWordIds.push_back(word.first);
+            ar & pKFi->mnId;
+            ar & vWordIds;
+        }
+    });
+}
+
+bool Map::LoadBowIndex(AtlasFileReader &reader, const AtlasFileSection &section, KeyFrameDatabase* pKFDB)
+{
+    return reader.Read(section, [this, &section, pKFDB](boost::archive::binary_iarchive &ar) {
+        long unsigned int nKFId;
+        std::vector<unsigned int> vWordIds;
+        for(std::uint64_t i = 0; i < section.count; ++i)
+        {
+            ar & nKFId;
+            ar & vWordIds;
+            pKFDB->addUnloaded(this, nKFId, vWordIds);
+        }
+    });
+}
+
+bool Map::Load(AtlasFileReader &reader, const AtlasFileSection &section)
+{
+    switch(section.type)
+    {
+    case AtlasSection::kMap:
+        return reader.Read(section, [this](boost::archive::binary_iarchive &ar) {
+            serializeHeader(ar);
+        });
+    case AtlasSection::kMapPoints:
+        return reader.Read(section, [this, &section](boost::archive::binary_iarchive &ar) {
+            for(std::uint64_t i = 0; i < section.count; ++i)
+            {
+                MapPoint* pMPi = static_cast<MapPoint*>(NULL);
+                ar & pMPi;
+                mvpBackupMapPoints.push_back(pMPi);
+            }
+        });
+    case AtlasSection::kKeyFrames:
+        return reader.Read(section, [this, &section](boost::archive::binary_iarchive &ar) {
+            for(std::uint64_t i = 0; i < section.count; ++i)
+            {
+                KeyFrame* pKFi = static_cast<KeyFrame*>(NULL);
+                ar & pKFi;
+                mvpBackupKeyFrames.push_back(pKFi);
+            }
+        });
+    case AtlasSection::kBowIndex:
+        // Only used when the map is not loaded, see LoadBowIndex
+        return true;
+    default:
+        LOG(ERROR) << "Unexpected section in the atlas file of map " << mnId;
+        return false;
+    }
 }
 
 void Map::PostLoad(
@@ -449,11 +732,15 @@ void Map::PostLoad(
   std::map<unsigned int,
   GeometricCamera*>& mpCams
 ) {
-    std::copy(mvpBackupMapPoints.begin(), mvpBackupMapPoints.end(), std::inserter(mspMapPoints, mspMapPoints.begin()));
-    std::copy(mvpBackupKeyFrames.begin(), mvpBackupKeyFrames.end(), std::inserter(mspKeyFrames, mspKeyFrames.begin()));
+    mMapPoints.Reserve(mvpBackupMapPoints.size());
+    for(auto pMPi : mvpBackupMapPoints)
+        mMapPoints.Insert(pMPi);
+    mKeyFrames.Reserve(mvpBackupKeyFrames.size());
+    for(auto pKFi : mvpBackupKeyFrames)
+        mKeyFrames.Insert(pKFi);
 
     std::map<long unsigned int,MapPoint*> mpMapPointId;
-    for(auto pMPi : mspMapPoints)
+    for(auto pMPi : mMapPoints)
     {
         if(!pMPi || pMPi->isBad())
             continue;
@@ -463,7 +750,7 @@ void Map::PostLoad(
     }
 
     std::map<long unsigned int, KeyFrame*> mpKeyFrameId;
-    for(auto pKFi : mspKeyFrames)
+    for(auto pKFi : mKeyFrames)
     {
         if(!pKFi || pKFi->isBad())
             continue;
@@ -475,7 +762,7 @@ void Map::PostLoad(
     }
 
     // References reconstruction between different instances
-    for(auto pMPi : mspMapPoints)
+    for(auto pMPi : mMapPoints)
     {
         if(!pMPi || pMPi->isBad())
             continue;
@@ -483,7 +770,7 @@ void Map::PostLoad(
         pMPi->PostLoad(mpKeyFrameId, mpMapPointId);
     }
 
-    for(auto pKFi : mspKeyFrames)
+    for(auto pKFi : mKeyFrames)
     {
         if(!pKFi || pKFi->isBad())
             continue;
@@ -511,6 +798,7 @@ void Map::PostLoad(
     }
 
     mvpBackupMapPoints.clear();
+    mvpBackupKeyFrames.clear();
 }
 
 } //namespace ORB_SLAM3
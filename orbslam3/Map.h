@@ -20,6 +20,8 @@
 #define MAP_H
 
 // Standard
+#include <cstddef>
+#include <functional>
 #include <list>
 #include <map>
 #include <mutex>
@@ -33,15 +35,20 @@
 #include <orbslam3/external/Sophus/sophus/se3.hpp>
 // Local
 #include "orbslam3/ORBVocabulary.h"
+#include "orbslam3/PointerSlab.h"
 
 namespace ORB_SLAM3
 {
 
 class Atlas;
+class AtlasFileReader;
+class AtlasFileWriter;
+class EpochReclaimer;
 class GeometricCamera;
 class KeyFrame;
 class KeyFrameDatabase;
 class MapPoint;
+struct AtlasFileSection;
 
 class Map
 {
@@ -72,6 +79,26 @@ class Map
         ar & mbIMU_BA2;
     }
 
+    // Everything but the KeyFrames and MapPoints, for the streamed atlas file
+    template<class Archive>
+    void serializeHeader(Archive &ar)
+    {
+        ar & mnId;
+        ar & mnInitKFid;
+        ar & mnMaxKFid;
+        ar & mnBigChangeIdx;
+
+        ar & mvBackupKeyFrameOriginsId;
+
+        ar & mnBackupKFinitialID;
+        ar & mnBackupKFlowerID;
+
+        ar & mbImuInitialized;
+        ar & mbIsInertial;
+        ar & mbIMU_BA1;
+        ar & mbIMU_BA2;
+    }
+
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     Map();
@@ -82,6 +109,9 @@ public:
     void AddMapPoint(MapPoint* pMP);
     void EraseMapPoint(MapPoint* pMP);
     void EraseKeyFrame(KeyFrame* pKF);
+    // Erase a bad MapPoint and hand it to the reclaimer, which frees it once no thread can hold it
+    void RetireMapPoint(MapPoint* pMP);
+    void SetReclaimer(EpochReclaimer* pReclaimer);
     void SetReferenceMapPoints(const std::vector<MapPoint*> &vpMPs);
     void InformNewBigChange();
     int GetLastBigChangeIdx();
@@ -90,6 +120,13 @@ public:
     std::vector<MapPoint*> GetAllMapPoints();
     std::vector<MapPoint*> GetReferenceMapPoints();
 
+    // Read-only copy of all the KeyFrames / MapPoints, shared by the callers
+    // until the map changes (prefer them to GetAll* when polling the map)
+    typedef PointerSlab<KeyFrame>::Snapshot KeyFrameSnapshot;
+    typedef PointerSlab<MapPoint>::Snapshot MapPointSnapshot;
+    KeyFrameSnapshot GetKeyFrameSnapshot();
+    MapPointSnapshot GetMapPointSnapshot();
+
     long unsigned int MapPointsInMap();
     long unsigned  KeyFramesInMap();
 
@@ -136,6 +173,21 @@ public:
     unsigned int GetLowerKFID();
 
     void PreSave(std::set<GeometricCamera*> &spCams);
+
+    // Streamed save: the map header, then its MapPoints and KeyFrames in
+    // blocks. Only the blocks being written hold their backup ids, instead of
+    // the whole map. itemsSaved is called with the size of every block.
+    bool Save(AtlasFileWriter &writer, std::set<GeometricCamera*> &spCams, const std::function<void(std::size_t)> &itemsSaved);
+    // Snapshot while the system runs, with the map update lock held: write the
+    // map header and back up the graph of the KeyFrames and MapPoints to save
+    bool CaptureSnapshot(AtlasFileWriter &writer, std::set<GeometricCamera*> &spCams, std::vector<MapPoint*> &vpMPs, std::vector<KeyFrame*> &vpKFs);
+    // Then, from any thread, write the captured KeyFrames and MapPoints in blocks
+    bool SaveSnapshot(AtlasFileWriter &writer, const std::vector<MapPoint*> &vpMPs, const std::vector<KeyFrame*> &vpKFs, const std::function<void(std::size_t)> &itemsSaved);
+    // Read one section of this map saved by Save, then PostLoad as usual
+    bool Load(AtlasFileReader &reader, const AtlasFileSection &section);
+    // Index the KeyFrames of this map in the database without loading them (lazy atlas loading)
+    bool LoadBowIndex(AtlasFileReader &reader, const AtlasFileSection &section, KeyFrameDatabase* pKFDB);
+
     void PostLoad(
         KeyFrameDatabase* pKFDB,
         ORBVocabulary* pORBVoc,
@@ -169,10 +221,23 @@ public:
 
 protected:
 
+    // Cleanup and backup ids of the map itself, before its KeyFrames and MapPoints are saved
+    void PrepareSave();
+    void BackupHeaderIds();
+
+    // Write a block of backed up MapPoints / KeyFrames and release their backup ids
+    bool WriteMapPoints(AtlasFileWriter &writer, const std::vector<MapPoint*> &vpMPs, const std::function<void(std::size_t)> &itemsSaved);
+    bool WriteKeyFrames(AtlasFileWriter &writer, const std::vector<KeyFrame*> &vpKFs, const std::function<void(std::size_t)> &itemsSaved);
+    // Write the words of the saved KeyFrames
+    bool WriteBowIndex(AtlasFileWriter &writer, const std::vector<KeyFrame*> &vpKFs);
+
+    static const std::size_t MAP_POINTS_PER_BLOCK = 4096;
+    static const std::size_t KEY_FRAMES_PER_BLOCK = 64;
+
     long unsigned int mnId;
 
-    std::set<MapPoint*> mspMapPoints;
-    std::set<KeyFrame*> mspKeyFrames;
+    PointerSlab<MapPoint> mMapPoints;
+    PointerSlab<KeyFrame> mKeyFrames;
 
     // Save/load, the set structure is broken in libboost 1.58 for ubuntu 16.04, a vector is serializated
     std::vector<MapPoint*> mvpBackupMapPoints;
@@ -210,6 +275,9 @@ protected:
     bool mbIMU_BA1;
     bool mbIMU_BA2;
 
+    // Bad MapPoints are leaked without reclaimer
+    EpochReclaimer* mpReclaimer = nullptr;
+
     // Mutex
     std::mutex mMutexMap;
 
@@ -141,7 +141,9 @@ void MapDrawer::DrawMapPoints()
     if(!pActiveMap)
         return;
 
-    const std::vector<MapPoint*> &vpMPs = pActiveMap->GetAllMapPoints();
+    // Shared copy, only rebuilt when the map changes
+    const Map::MapPointSnapshot pMPs = pActiveMap->GetMapPointSnapshot();
+    const std::vector<MapPoint*> &vpMPs = *pMPs;
     const std::vector<MapPoint*> &vpRefMPs = pActiveMap->GetReferenceMapPoints();
 
     std::set<MapPoint*> spRefMPs(vpRefMPs.begin(), vpRefMPs.end());
@@ -192,7 +194,8 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const b
     if(!pActiveMap)
         return;
 
-    const std::vector<KeyFrame*> vpKFs = pActiveMap->GetAllKeyFrames();
+    const Map::KeyFrameSnapshot pKFs = pActiveMap->GetKeyFrameSnapshot();
+    const std::vector<KeyFrame*> &vpKFs = *pKFs;
 
     if(bDrawKF)
     {
@@ -345,7 +348,8 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const b
             if(pMap == pActiveMap)
                 continue;
 
-            std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+            const Map::KeyFrameSnapshot pMapKFs = pMap->GetKeyFrameSnapshot();
+            const std::vector<KeyFrame*> &vpKFs = *pMapKFs;
 
             for(std::size_t i=0; i<vpKFs.size(); i++)
             {
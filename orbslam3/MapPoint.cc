@@ -24,6 +24,7 @@
 #include "orbslam3/Map.h"
 #include "orbslam3/MapPoint.h"
 #include "orbslam3/ORBmatcher.h"
+#include "orbslam3/ObjectPool.h"
 
 namespace ORB_SLAM3
 {
@@ -31,6 +32,21 @@ namespace ORB_SLAM3
 long unsigned int MapPoint::nNextId=0;
 std::mutex MapPoint::mGlobalMutex;
 
+void* MapPoint::operator new(std::size_t size)
+{
+    if(size != sizeof(MapPoint))
+        return ::operator new(size);
+    return ObjectPool<MapPoint>::Instance().Allocate();
+}
+
+void MapPoint::operator delete(void* p, std::size_t size)
+{
+    if(size != sizeof(MapPoint))
+        ::operator delete(p);
+    else
+        ObjectPool<MapPoint>::Instance().Deallocate(p);
+}
+
 MapPoint::MapPoint():
     mnFirstKFid(0), mnFirstFrame(0), nObs(0), mnTrackReferenceForFrame(0),
     mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
@@ -239,7 +255,7 @@ void MapPoint::SetBadFlag()
         }
     }
 
-    mpMap->EraseMapPoint(this);
+    mpMap->RetireMapPoint(this);
 }
 
 MapPoint* MapPoint::GetReplaced()
@@ -300,7 +316,19 @@ void MapPoint::Replace(MapPoint* pMP)
     pMP->IncreaseVisible(nvisible);
     pMP->ComputeDistinctiveDescriptors();
 
-    mpMap->EraseMapPoint(this);
+    mpMap->RetireMapPoint(this);
+}
+
+void MapPoint::SetPinned()
+{
+    std::unique_lock<std::mutex> lock(mMutexFeatures);
+    mbPinned = true;
+}
+
+bool MapPoint::IsReclaimable()
+{
+    std::unique_lock<std::mutex> lock(mMutexFeatures);
+    return mbBad && !mbPinned && mObservations.empty();
 }
 
 bool MapPoint::isBad()
@@ -573,33 +601,37 @@ void MapPoint::UpdateMap(Map* pMap)
     mpMap = pMap;
 }
 
-void MapPoint::PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP)
+void MapPoint::PreSave(const std::function<bool(KeyFrame*)>& isKF, const std::function<bool(MapPoint*)>& isMP, const bool bEraseForeignObservations)
 {
+    // Read through the locked accessors, the system may still be running (atlas snapshot)
+    MapPoint* pReplaced = GetReplaced();
     mBackupReplacedId = -1;
-    if(mpReplaced && spMP.find(mpReplaced) != spMP.end())
-        mBackupReplacedId = mpReplaced->mnId;
+    if(pReplaced && isMP(pReplaced))
+        mBackupReplacedId = pReplaced->mnId;
 
     mBackupObservationsId1.clear();
     mBackupObservationsId2.clear();
     // Save the id and position in each KF who view it
-    for(auto it = mObservations.cbegin(), end = mObservations.cend(); it != end; ++it)
+    const std::map<KeyFrame*,std::tuple<int,int>> observations = GetObservations();
+    for(auto it = observations.cbegin(), end = observations.cend(); it != end; ++it)
     {
         KeyFrame* pKFi = it->first;
-        if(spKF.find(pKFi) != spKF.end())
+        if(isKF(pKFi))
         {
             mBackupObservationsId1[it->first->mnId] = std::get<0>(it->second);
             mBackupObservationsId2[it->first->mnId] = std::get<1>(it->second);
         }
-        else
+        else if(bEraseForeignObservations)
         {
             EraseObservation(pKFi);
         }
     }
 
     // Save the id of the reference KF
-    if(spKF.find(mpRefKF) != spKF.end())
+    KeyFrame* pRefKF = GetReferenceKeyFrame();
+    if(pRefKF && isKF(pRefKF))
     {
-        mBackupRefKFId = mpRefKF->mnId;
+        mBackupRefKFId = pRefKF->mnId;
     }
 }
 
@@ -631,6 +663,16 @@ void MapPoint::PostLoad(std::map<long unsigned int, KeyFrame*>& mpKFid, std::map
         }
     }
 
+    ClearBackup();
+}
+
+std::scoped_lock<std::mutex, std::mutex> MapPoint::LockState()
+{
+    return std::scoped_lock<std::mutex, std::mutex>(mMutexPos, mMutexFeatures);
+}
+
+void MapPoint::ClearBackup()
+{
     mBackupObservationsId1.clear();
     mBackupObservationsId2.clear();
 }
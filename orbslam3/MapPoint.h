@@ -20,6 +20,8 @@
 #define MAPPOINT_H
 
 // Standard
+#include <cstddef>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <set>
@@ -102,7 +104,10 @@ class MapPoint
 
 
 public:
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    // MapPoints are allocated from ObjectPool<MapPoint>
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
     MapPoint();
 
     MapPoint(const Eigen::Vector3f &Pos, KeyFrame* pRefKF, Map* pMap);
@@ -132,6 +137,11 @@ public:
     void Replace(MapPoint* pMP);
     MapPoint* GetReplaced();
 
+    // A culled KeyFrame keeps its matches, so the MapPoints it observed are never reclaimed
+    void SetPinned();
+    // Whether a retired (bad) MapPoint can be freed: neither observed anymore nor pinned
+    bool IsReclaimable();
+
     void IncreaseVisible(int n=1);
     void IncreaseFound(int n=1);
     float GetFoundRatio();
@@ -155,8 +165,14 @@ public:
 
     void PrintObservations();
 
-    void PreSave(std::set<KeyFrame*>& spKF,std::set<MapPoint*>& spMP);
+    // Only the KeyFrames and MapPoints for which isKF and isMP are true are saved. Observations
+    // from other KeyFrames are erased, unless the map is only being snapshot
+    void PreSave(const std::function<bool(KeyFrame*)>& isKF, const std::function<bool(MapPoint*)>& isMP, const bool bEraseForeignObservations = true);
     void PostLoad(std::map<long unsigned int, KeyFrame*>& mpKFid, std::map<long unsigned int, MapPoint*>& mpMPid);
+    // Release the ids filled by PreSave once serialized
+    void ClearBackup();
+    // Hold the position and features, to serialize the MapPoint while the system runs
+    std::scoped_lock<std::mutex, std::mutex> LockState();
 
 public:
     long unsigned int mnId;
@@ -230,9 +246,10 @@ protected:
      int mnVisible;
      int mnFound;
 
-     // Bad flag (we do not currently erase MapPoint from memory)
+     // Bad flag (bad MapPoints are only freed when the map retires them to an EpochReclaimer)
      bool mbBad;
      MapPoint* mpReplaced;
+     bool mbPinned{false};
      // For save relation without pointer, this is necessary for save/load function
      long long int mBackupReplacedId;
 
@@ -0,0 +1,275 @@
+// Standard
+#include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/ORBVocabulary.h"
+#include "orbslam3/ThreadPool.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Write a random 2-level text vocabulary (k = 4), one leaf short of a full tree.
+void WriteTextVocabulary(const std::string& filename, std::mt19937& rng) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_real_distribution<double> weight(0.0, 5.0);
+
+  std::ofstream f(filename);
+  f << "4 2  0 0\n";
+  const auto write_node = [&](const int parent, const bool leaf) {
+    f << parent << " " << (leaf ? 1 : 0) << " ";
+    for (int i = 0; i < DBoW2::FORB::L; ++i) {
+      f << byte(rng) << " ";
+    }
+    f << (leaf ? weight(rng) : 0.0) << "\n";
+  };
+  for (int i = 0; i < 4; ++i) {
+    write_node(0, false);
+  }
+  for (int parent = 1; parent <= 4; ++parent) {
+    for (int i = 0; i < (parent == 4 ? 3 : 4); ++i) {
+      write_node(parent, true);
+    }
+  }
+}
+
+std::vector<cv::Mat> RandomDescriptors(const std::size_t count, std::mt19937& rng) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<cv::Mat> descriptors;
+  for (std::size_t i = 0; i < count; ++i) {
+    cv::Mat descriptor(1, DBoW2::FORB::L, CV_8U);
+    for (int j = 0; j < DBoW2::FORB::L; ++j) {
+      descriptor.at<std::uint8_t>(0, j) = static_cast<std::uint8_t>(byte(rng));
+    }
+    descriptors.push_back(descriptor);
+  }
+  return descriptors;
+}
+
+// The original DBoW2 transform, descending the tree node by node.
+class ReferenceVocabulary : public ORBVocabulary {
+public:
+  void Transform(const std::vector<cv::Mat>& features, DBoW2::BowVector& v, DBoW2::FeatureVector& fv,
+                 const int levelsup) const {
+    v.clear();
+    fv.clear();
+    DBoW2::LNorm norm;
+    const bool must = m_scoring_object->mustNormalize(norm);
+    ASSERT_TRUE(m_weighting == DBoW2::TF_IDF);
+    for (unsigned int i = 0; i < features.size(); ++i) {
+      DBoW2::WordId id;
+      DBoW2::NodeId nid;
+      DBoW2::WordValue w;
+      Descend(features[i], id, w, nid, levelsup);
+      if (w > 0) {
+        v.addWeight(id, w);
+        fv.addFeature(nid, i);
+      }
+    }
+    if (!v.empty() && !must) {
+      const double nd = v.size();
+      for (auto& word : v)
+        word.second /= nd;
+    }
+    if (must)
+      v.normalize(norm);
+  }
+
+private:
+  static int Distance(const cv::Mat& a, const cv::Mat& b) {
+    int d = 0;
+    for (int i = 0; i < DBoW2::FORB::L; ++i)
+      d += static_cast<int>(std::bitset<8>(a.ptr<std::uint8_t>()[i] ^ b.ptr<std::uint8_t>()[i]).count());
+    return d;
+  }
+
+  void Descend(const cv::Mat& feature, DBoW2::WordId& word_id, DBoW2::WordValue& weight, DBoW2::NodeId& nid,
+               const int levelsup) const {
+    const int nid_level = m_L - levelsup;
+    if (nid_level <= 0)
+      nid = 0;
+    DBoW2::NodeId final_id = 0;
+    int current_level      = 0;
+    do {
+      ++current_level;
+      const std::vector<DBoW2::NodeId>& nodes = m_nodes[final_id].children;
+      final_id                                = nodes[0];
+      int best_d                              = Distance(feature, m_nodes[final_id].descriptor);
+      for (std::size_t k = 1; k < nodes.size(); ++k) {
+        const int d = Distance(feature, m_nodes[nodes[k]].descriptor);
+        if (d < best_d) {
+          best_d   = d;
+          final_id = nodes[k];
+        }
+      }
+      if (current_level == nid_level)
+        nid = final_id;
+    } while (!m_nodes[final_id].isLeaf());
+    word_id = m_nodes[final_id].word_id;
+    weight  = m_nodes[final_id].weight;
+  }
+};
+
+} // namespace
+
+TEST(ORBVocabulary, BinaryRoundTrip) {
+  std::mt19937 rng(42);
+  const std::string text_file   = ::testing::TempDir() + "vocabulary.txt";
+  const std::string binary_file = ::testing::TempDir() + "vocabulary.bin";
+  WriteTextVocabulary(text_file, rng);
+
+  ORBVocabulary text;
+  ASSERT_TRUE(text.loadFromTextFile(text_file));
+  ASSERT_TRUE(text.saveToBinaryFile(binary_file, "checksum"));
+  EXPECT_TRUE(ORBVocabulary::isBinaryFile(binary_file));
+  EXPECT_FALSE(ORBVocabulary::isBinaryFile(text_file));
+
+  ORBVocabulary binary;
+  ASSERT_TRUE(binary.loadFromBinaryFile(binary_file, true));
+  EXPECT_EQ(binary.getChecksum(), "checksum");
+  EXPECT_EQ(binary.size(), text.size());
+  EXPECT_EQ(binary.getBranchingFactor(), text.getBranchingFactor());
+  EXPECT_EQ(binary.getDepthLevels(), text.getDepthLevels());
+
+  // Both vocabularies give the same words and weights.
+  for (int run = 0; run < 20; ++run) {
+    const std::vector<cv::Mat> descriptors = RandomDescriptors(100, rng);
+    DBoW2::BowVector bow_text, bow_binary;
+    DBoW2::FeatureVector features_text, features_binary;
+    text.transform(descriptors, bow_text, features_text, 1);
+    binary.transform(descriptors, bow_binary, features_binary, 1);
+    EXPECT_EQ(bow_text, bow_binary);
+    EXPECT_EQ(features_text, features_binary);
+  }
+
+  // Copies keep the mapping alive.
+  ORBVocabulary copy = binary;
+  binary = ORBVocabulary();
+  DBoW2::BowVector bow_copy;
+  copy.transform(RandomDescriptors(10, rng), bow_copy);
+  EXPECT_FALSE(bow_copy.empty());
+
+  std::remove(text_file.c_str());
+  std::remove(binary_file.c_str());
+}
+
+TEST(ORBVocabulary, BinaryCorruption) {
+  std::mt19937 rng(7);
+  const std::string text_file   = ::testing::TempDir() + "vocabulary_corrupted.txt";
+  const std::string binary_file = ::testing::TempDir() + "vocabulary_corrupted.bin";
+  WriteTextVocabulary(text_file, rng);
+
+  ORBVocabulary text;
+  ASSERT_TRUE(text.loadFromTextFile(text_file));
+  ASSERT_TRUE(text.saveToBinaryFile(binary_file));
+
+  // Flip a byte of the last node descriptor, at the end of the file: only
+  // the full payload check notices it.
+  {
+    std::fstream f(binary_file, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(-10, std::ios::end);
+    f.put(static_cast<char>(0x5a));
+  }
+  ORBVocabulary binary;
+  EXPECT_FALSE(binary.loadFromBinaryFile(binary_file, true));
+  EXPECT_TRUE(binary.loadFromBinaryFile(binary_file, false));
+
+  // A corrupted header is always rejected.
+  {
+    std::fstream f(binary_file, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(12);
+    f.put(static_cast<char>(0x5a));
+  }
+  EXPECT_FALSE(binary.loadFromBinaryFile(binary_file, false));
+  EXPECT_FALSE(ORBVocabulary().loadFromBinaryFile(::testing::TempDir() + "missing.bin"));
+
+  std::remove(text_file.c_str());
+  std::remove(binary_file.c_str());
+}
+
+TEST(ORBVocabulary, ParallelTransform) {
+  std::mt19937 rng(3);
+  const std::string text_file = ::testing::TempDir() + "vocabulary_parallel.txt";
+  WriteTextVocabulary(text_file, rng);
+
+  ORBVocabulary vocabulary;
+  ASSERT_TRUE(vocabulary.loadFromTextFile(text_file));
+
+  ThreadPool pool(3);
+  const ORBVocabulary::ParallelFor parallel_for =
+    [&pool](const std::size_t begin, const std::size_t end, const std::function<void(std::size_t)>& fn) {
+      pool.ParallelFor(begin, end, fn);
+    };
+
+  // Same output as the sequential transform, whatever the batch size.
+  for (const std::size_t count : {0u, 1u, 63u, 64u, 65u, 1500u}) {
+    const std::vector<cv::Mat> descriptors = RandomDescriptors(count, rng);
+    for (const int levelsup : {0, 1, 2}) {
+      DBoW2::BowVector bow_sequential, bow_parallel;
+      DBoW2::FeatureVector features_sequential, features_parallel;
+      vocabulary.transform(descriptors, bow_sequential, features_sequential, levelsup);
+      vocabulary.transform(descriptors, bow_parallel, features_parallel, levelsup, parallel_for);
+      EXPECT_EQ(bow_sequential, bow_parallel);
+      EXPECT_EQ(features_sequential, features_parallel);
+
+      // And the same words as one feature at a time.
+      for (const cv::Mat& descriptor : descriptors) {
+        const DBoW2::WordId word = vocabulary.transform(descriptor);
+        EXPECT_EQ(bow_parallel.count(word), vocabulary.getWordWeight(word) > 0 ? 1u : 0u);
+      }
+    }
+  }
+
+  std::remove(text_file.c_str());
+}
+
+TEST(ORBVocabulary, TransformMatchesNodeDescent) {
+  std::mt19937 rng(11);
+  const std::string text_file   = ::testing::TempDir() + "vocabulary_reference.txt";
+  const std::string binary_file = ::testing::TempDir() + "vocabulary_reference.bin";
+  WriteTextVocabulary(text_file, rng);
+
+  ReferenceVocabulary reference;
+  ASSERT_TRUE(reference.loadFromTextFile(text_file));
+  ORBVocabulary text, binary;
+  ASSERT_TRUE(text.loadFromTextFile(text_file));
+  ASSERT_TRUE(text.saveToBinaryFile(binary_file));
+  ASSERT_TRUE(binary.loadFromBinaryFile(binary_file, true));
+
+  ThreadPool pool(3);
+  const ORBVocabulary::ParallelFor parallel_for =
+    [&pool](const std::size_t begin, const std::size_t end, const std::function<void(std::size_t)>& fn) {
+      pool.ParallelFor(begin, end, fn);
+    };
+
+  // The distances to the 4 children of a node often tie on random
+  // descriptors, where the first child must win.
+  const std::vector<cv::Mat> descriptors = RandomDescriptors(2000, rng);
+  for (const int levelsup : {0, 1, 2}) {
+    SCOPED_TRACE(levelsup);
+    DBoW2::BowVector bow_expected;
+    DBoW2::FeatureVector features_expected;
+    reference.Transform(descriptors, bow_expected, features_expected, levelsup);
+    for (const ORBVocabulary* vocabulary : {&text, &binary}) {
+      DBoW2::BowVector bow, bow_batched;
+      DBoW2::FeatureVector features, features_batched;
+      vocabulary->transform(descriptors, bow, features, levelsup);
+      vocabulary->transform(descriptors, bow_batched, features_batched, levelsup, parallel_for);
+      EXPECT_EQ(bow, bow_expected);
+      EXPECT_EQ(features, features_expected);
+      EXPECT_EQ(bow_batched, bow_expected);
+      EXPECT_EQ(features_batched, features_expected);
+    }
+  }
+
+  std::remove(text_file.c_str());
+  std::remove(binary_file.c_str());
+}
@@ -0,0 +1,536 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+// 3rdparty
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define ORB_SLAM3_ORB_X86
+#endif
+// Local
+#include "orbslam3/ORBdescriptor.h"
+
+namespace ORB_SLAM3 {
+namespace Orb {
+
+namespace {
+
+// Degrees to radians, as the original descriptor computation.
+const float kFactorPI = (float)(CV_PI / 180.f);
+
+// Size of a row of the patch as read by the vector kernels, from -15 to +16.
+constexpr int kPatchRow = 32;
+
+// Circular patch of the orientation, with the weights of the vector kernels:
+// u (the column) and v (the row) where the column is inside the patch, 0
+// elsewhere. Element e of a row is the pixel at u = e - kHalfPatchSize.
+struct AnglePatch {
+  int u_max[kHalfPatchSize + 1];
+  alignas(32) std::int8_t u_weights[kHalfPatchSize + 1][kPatchRow];
+  alignas(32) std::int8_t v_weights[kHalfPatchSize + 1][kPatchRow];
+};
+
+AnglePatch MakeAnglePatch(const std::vector<int>& u_max) {
+  AnglePatch patch;
+  for (int v = 0; v <= kHalfPatchSize; ++v) {
+    // The center row always spans the whole diameter.
+    const int d    = v == 0 ? kHalfPatchSize : u_max[v];
+    patch.u_max[v] = d;
+    for (int e = 0; e < kPatchRow; ++e) {
+      const int u           = e - kHalfPatchSize;
+      const bool inside     = std::abs(u) <= d;
+      patch.u_weights[v][e] = static_cast<std::int8_t>(inside ? u : 0);
+      patch.v_weights[v][e] = static_cast<std::int8_t>(inside ? v : 0);
+    }
+  }
+  return patch;
+}
+
+using AngleFn      = float (*)(const std::uint8_t*, std::ptrdiff_t, const AnglePatch&);
+using DescriptorFn = void (*)(const std::uint8_t*, std::ptrdiff_t, double, double, const Pattern&, std::uint8_t*);
+using BinnedFn     = void (*)(const std::uint8_t*, std::ptrdiff_t, const RotatedPattern&, std::uint8_t*);
+
+// Cosine and sine of a keypoint angle in degrees, as the original descriptor
+// computation.
+inline void Rotation(const float degrees, double& a, double& b) {
+  const float angle = degrees * kFactorPI;
+  a                 = (float)std::cos(angle);
+  b                 = (float)std::sin(angle);
+}
+
+// ──────────────────────────── //
+// Scalar
+
+float AngleScalar(const std::uint8_t* center, const std::ptrdiff_t step, const AnglePatch& patch) {
+  int m_01 = 0, m_10 = 0;
+
+  // Treat the center line differently, v=0
+  for (int u = -kHalfPatchSize; u <= kHalfPatchSize; ++u) {
+    m_10 += u * center[u];
+  }
+
+  // Go line by line in the circular patch
+  for (int v = 1; v <= kHalfPatchSize; ++v) {
+    // Proceed over the two lines
+    int v_sum   = 0;
+    const int d = patch.u_max[v];
+    for (int u = -d; u <= d; ++u) {
+      const int val_plus = center[u + v * step], val_minus = center[u - v * step];
+      v_sum += val_plus - val_minus;
+      m_10 += u * (val_plus + val_minus);
+    }
+    m_01 += v * v_sum;
+  }
+
+  return cv::fastAtan2((float)m_01, (float)m_10);
+}
+
+// Offset from the center of a pattern point rotated by the angle of cosine a
+// and sine b.
+inline std::ptrdiff_t Offset(const double x, const double y, const double a, const double b, const std::ptrdiff_t step) {
+  return cvRound(x * b + y * a) * step + cvRound(x * a - y * b);
+}
+
+void DescriptorScalar(
+  const std::uint8_t* center,
+  const std::ptrdiff_t step,
+  const double a,
+  const double b,
+  const Pattern& pattern,
+  std::uint8_t* desc
+) {
+  for (std::size_t byte = 0; byte < kDescriptorBytes; ++byte) {
+    int val = 0;
+    for (std::size_t bit = 0; bit < 8; ++bit) {
+      const std::size_t i = 8 * byte + bit;
+      const int t0        = center[Offset(pattern.x0[i], pattern.y0[i], a, b, step)];
+      const int t1        = center[Offset(pattern.x1[i], pattern.y1[i], a, b, step)];
+      val |= (t0 < t1) << bit;
+    }
+    desc[byte] = static_cast<std::uint8_t>(val);
+  }
+}
+
+void BinnedScalar(
+  const std::uint8_t* center,
+  const std::ptrdiff_t step,
+  const RotatedPattern& pattern,
+  std::uint8_t* desc
+) {
+  for (std::size_t byte = 0; byte < kDescriptorBytes; ++byte) {
+    int val = 0;
+    for (std::size_t bit = 0; bit < 8; ++bit) {
+      const std::size_t i = 8 * byte + bit;
+      const int t0        = center[pattern.y0[i] * step + pattern.x0[i]];
+      const int t1        = center[pattern.y1[i] * step + pattern.x1[i]];
+      val |= (t0 < t1) << bit;
+    }
+    desc[byte] = static_cast<std::uint8_t>(val);
+  }
+}
+
+#ifdef ORB_SLAM3_ORB_X86
+
+// ──────────────────────────── //
+// x86 AVX2
+
+__attribute__((target("avx2"))) inline int HorizontalSum(const __m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  sum         = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum         = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2"))) inline __m256i Load(const void* p) {
+  return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+}
+
+// One 32-byte load per row of the patch: the weights zero the pixels outside of
+// the circle. maddubs multiplies the pixels by the signed weights and sums the
+// pairs in 16 bits, which cannot saturate (|weight| <= 16).
+__attribute__((target("avx2"))) float AngleAVX2(
+  const std::uint8_t* center,
+  const std::ptrdiff_t step,
+  const AnglePatch& patch
+) {
+  const __m256i ones      = _mm256_set1_epi16(1);
+  const std::uint8_t* row = center - kHalfPatchSize;
+
+  __m256i m_10 = _mm256_madd_epi16(_mm256_maddubs_epi16(Load(row), Load(patch.u_weights[0])), ones);
+  __m256i m_01 = _mm256_setzero_si256();
+  for (int v = 1; v <= kHalfPatchSize; ++v) {
+    const __m256i plus  = Load(row + v * step);
+    const __m256i minus = Load(row - v * step);
+    const __m256i wu    = Load(patch.u_weights[v]);
+    const __m256i wv    = Load(patch.v_weights[v]);
+    m_10 = _mm256_add_epi32(
+      m_10,
+      _mm256_madd_epi16(_mm256_add_epi16(_mm256_maddubs_epi16(plus, wu), _mm256_maddubs_epi16(minus, wu)), ones)
+    );
+    m_01 = _mm256_add_epi32(
+      m_01,
+      _mm256_madd_epi16(_mm256_sub_epi16(_mm256_maddubs_epi16(plus, wv), _mm256_maddubs_epi16(minus, wv)), ones)
+    );
+  }
+
+  return cv::fastAtan2((float)HorizontalSum(m_01), (float)HorizontalSum(m_10));
+}
+
+// Offsets of 4 pattern points rotated by (a, b), exact as Offset().
+__attribute__((target("avx2"))) inline __m128i Offsets4(
+  const double* x,
+  const double* y,
+  const __m256d a,
+  const __m256d b,
+  const __m128i step
+) {
+  const __m256d vx  = _mm256_loadu_pd(x);
+  const __m256d vy  = _mm256_loadu_pd(y);
+  // cvtpd rounds to nearest even, as cvRound.
+  const __m128i row = _mm256_cvtpd_epi32(_mm256_add_pd(_mm256_mul_pd(vx, b), _mm256_mul_pd(vy, a)));
+  const __m128i col = _mm256_cvtpd_epi32(_mm256_sub_pd(_mm256_mul_pd(vx, a), _mm256_mul_pd(vy, b)));
+  return _mm_add_epi32(_mm_mullo_epi32(row, step), col);
+}
+
+// 8 tests per descriptor byte: both points are gathered as 32-bit words (the
+// caller checks that the 3 bytes after every pixel are readable), masked to
+// their first byte and compared.
+__attribute__((target("avx2"))) void DescriptorAVX2(
+  const std::uint8_t* center,
+  const std::ptrdiff_t step,
+  const double a,
+  const double b,
+  const Pattern& pattern,
+  std::uint8_t* desc
+) {
+  const __m256d va    = _mm256_set1_pd(a);
+  const __m256d vb    = _mm256_set1_pd(b);
+  const __m128i vstep = _mm_set1_epi32(static_cast<int>(step));
+  const __m256i low   = _mm256_set1_epi32(0xff);
+  const int* base     = reinterpret_cast<const int*>(center);
+
+  for (std::size_t byte = 0; byte < kDescriptorBytes; ++byte) {
+    const std::size_t i = 8 * byte;
+    const __m256i ofs0  = _mm256_set_m128i(
+      Offsets4(&pattern.x0[i + 4], &pattern.y0[i + 4], va, vb, vstep),
+      Offsets4(&pattern.x0[i], &pattern.y0[i], va, vb, vstep)
+    );
+    const __m256i ofs1 = _mm256_set_m128i(
+      Offsets4(&pattern.x1[i + 4], &pattern.y1[i + 4], va, vb, vstep),
+      Offsets4(&pattern.x1[i], &pattern.y1[i], va, vb, vstep)
+    );
+    const __m256i t0 = _mm256_and_si256(_mm256_i32gather_epi32(base, ofs0, 1), low);
+    const __m256i t1 = _mm256_and_si256(_mm256_i32gather_epi32(base, ofs1, 1), low);
+    desc[byte]       = static_cast<std::uint8_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(t1, t0))));
+  }
+}
+
+// Offsets of 8 points of a rotated pattern.
+__attribute__((target("avx2"))) inline __m256i RotatedOffsets8(const int* x, const int* y, const __m256i step) {
+  return _mm256_add_epi32(_mm256_mullo_epi32(Load(y), step), Load(x));
+}
+
+__attribute__((target("avx2"))) void BinnedAVX2(
+  const std::uint8_t* center,
+  const std::ptrdiff_t step,
+  const RotatedPattern& pattern,
+  std::uint8_t* desc
+) {
+  const __m256i vstep = _mm256_set1_epi32(static_cast<int>(step));
+  const __m256i low   = _mm256_set1_epi32(0xff);
+  const int* base     = reinterpret_cast<const int*>(center);
+
+  for (std::size_t byte = 0; byte < kDescriptorBytes; ++byte) {
+    const std::size_t i = 8 * byte;
+    const __m256i ofs0  = RotatedOffsets8(&pattern.x0[i], &pattern.y0[i], vstep);
+    const __m256i ofs1  = RotatedOffsets8(&pattern.x1[i], &pattern.y1[i], vstep);
+    const __m256i t0    = _mm256_and_si256(_mm256_i32gather_epi32(base, ofs0, 1), low);
+    const __m256i t1    = _mm256_and_si256(_mm256_i32gather_epi32(base, ofs1, 1), low);
+    desc[byte]          = static_cast<std::uint8_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(t1, t0))));
+  }
+}
+
+// ──────────────────────────── //
+// x86 AVX-512
+
+// Offsets of 8 pattern points rotated by (a, b), exact as Offset().
+__attribute__((target("avx512f"))) inline __m256i Offsets8(
+  const double* x,
+  const double* y,
+  const __m512d a,
+  const __m512d b,
+  const __m256i step
+) {
+  const __m512d vx  = _mm512_loadu_pd(x);
+  const __m512d vy  = _mm512_loadu_pd(y);
+  const __m256i row = _mm512_maskz_cvtpd_epi32(0xff, _mm512_add_pd(_mm512_mul_pd(vx, b), _mm512_mul_pd(vy, a)));
+  const __m256i col = _mm512_maskz_cvtpd_epi32(0xff, _mm512_sub_pd(_mm512_mul_pd(vx, a), _mm512_mul_pd(vy, b)));
+  return _mm256_add_epi32(_mm256_mullo_epi32(row, step), col);
+}
+
+// Offsets of 16 pattern points. The zero-masked forms of the intrinsics avoid
+// the undefined vectors of the plain ones, which GCC reports as uninitialized.
+__attribute__((target("avx512f"))) inline __m512i Offsets16(
+  const double* x,
+  const double* y,
+  const __m512d a,
+  const __m512d b,
+  const __m256i step
+) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i low  = _mm512_maskz_inserti64x4(0xff, zero, Offsets8(x, y, a, b, step), 0);
+  return _mm512_maskz_inserti64x4(0xff, low, Offsets8(x + 8, y + 8, a, b, step), 1);
+}
+
+// 16 tests, two descriptor bytes, per pair of gathers; the comparison gives
+// the bits as a mask directly.
+__attribute__((target("avx512f"))) void DescriptorAVX512(
+  const std::uint8_t* center,
+  const std::ptrdiff_t step,
+  const double a,
+  const double b,
+  const Pattern& pattern,
+  std::uint8_t* desc
+) {
+  const __m512d va    = _mm512_set1_pd(a);
+  const __m512d vb    = _mm512_set1_pd(b);
+  const __m256i vstep = _mm256_set1_epi32(static_cast<int>(step));
+  const __m512i low   = _mm512_set1_epi32(0xff);
+  const __m512i zero  = _mm512_setzero_si512();
+
+  for (std::size_t byte = 0; byte < kDescriptorBytes; byte += 2) {
+    const std::size_t i  = 8 * byte;
+    const __m512i ofs0   = Offsets16(&pattern.x0[i], &pattern.y0[i], va, vb, vstep);
+    const __m512i ofs1   = Offsets16(&pattern.x1[i], &pattern.y1[i], va, vb, vstep);
+    const __m512i t0     = _mm512_and_si512(_mm512_mask_i32gather_epi32(zero, 0xffff, ofs0, center, 1), low);
+    const __m512i t1     = _mm512_and_si512(_mm512_mask_i32gather_epi32(zero, 0xffff, ofs1, center, 1), low);
+    const __mmask16 bits = _mm512_cmplt_epi32_mask(t0, t1);
+    desc[byte]           = static_cast<std::uint8_t>(bits);
+    desc[byte + 1]       = static_cast<std::uint8_t>(bits >> 8);
+  }
+}
+
+// Offsets of 16 points of a rotated pattern.
+__attribute__((target("avx512f"))) inline __m512i RotatedOffsets16(const int* x, const int* y, const __m512i step) {
+  return _mm512_add_epi32(_mm512_mullo_epi32(_mm512_loadu_si512(y), step), _mm512_loadu_si512(x));
+}
+
+__attribute__((target("avx512f"))) void BinnedAVX512(
+  const std::uint8_t* center,
+  const std::ptrdiff_t step,
+  const RotatedPattern& pattern,
+  std::uint8_t* desc
+) {
+  const __m512i vstep = _mm512_set1_epi32(static_cast<int>(step));
+  const __m512i low   = _mm512_set1_epi32(0xff);
+  const __m512i zero  = _mm512_setzero_si512();
+
+  for (std::size_t byte = 0; byte < kDescriptorBytes; byte += 2) {
+    const std::size_t i  = 8 * byte;
+    const __m512i ofs0   = RotatedOffsets16(&pattern.x0[i], &pattern.y0[i], vstep);
+    const __m512i ofs1   = RotatedOffsets16(&pattern.x1[i], &pattern.y1[i], vstep);
+    const __m512i t0     = _mm512_and_si512(_mm512_mask_i32gather_epi32(zero, 0xffff, ofs0, center, 1), low);
+    const __m512i t1     = _mm512_and_si512(_mm512_mask_i32gather_epi32(zero, 0xffff, ofs1, center, 1), low);
+    const __mmask16 bits = _mm512_cmplt_epi32_mask(t0, t1);
+    desc[byte]           = static_cast<std::uint8_t>(bits);
+    desc[byte + 1]       = static_cast<std::uint8_t>(bits >> 8);
+  }
+}
+
+#endif // ORB_SLAM3_ORB_X86
+
+// ──────────────────────────── //
+// Dispatch
+
+AngleFn AngleFunction(const Kernel kernel) {
+  switch (kernel) {
+#ifdef ORB_SLAM3_ORB_X86
+    case Kernel::AVX2:
+    case Kernel::AVX512: return AngleAVX2;
+#endif
+    default:             return AngleScalar;
+  }
+}
+
+DescriptorFn DescriptorFunction(const Kernel kernel) {
+  switch (kernel) {
+#ifdef ORB_SLAM3_ORB_X86
+    case Kernel::AVX2:   return DescriptorAVX2;
+    case Kernel::AVX512: return DescriptorAVX512;
+#endif
+    default:             return DescriptorScalar;
+  }
+}
+
+BinnedFn BinnedFunction(const Kernel kernel) {
+  switch (kernel) {
+#ifdef ORB_SLAM3_ORB_X86
+    case Kernel::AVX2:   return BinnedAVX2;
+    case Kernel::AVX512: return BinnedAVX512;
+#endif
+    default:             return BinnedScalar;
+  }
+}
+
+Kernel DetectKernel() {
+  for (const Kernel kernel : {Kernel::AVX512, Kernel::AVX2}) {
+    if (IsSupported(kernel)) {
+      return kernel;
+    }
+  }
+  return Kernel::Scalar;
+}
+
+std::atomic<Kernel>& CurrentKernel() {
+  static std::atomic<Kernel> kernel(DetectKernel());
+  return kernel;
+}
+
+// Whether `size` bytes can be read from `first`, inside the buffer of the image.
+inline bool Readable(const cv::Mat& image, const std::uint8_t* first, const std::ptrdiff_t size) {
+  return first >= image.datastart && first + size <= image.datalimit;
+}
+
+} // namespace
+
+Pattern MakePattern(const cv::Point* points, const int bins) {
+  Pattern pattern;
+  double radius = 0.0;
+  for (std::size_t i = 0; i < kTests; ++i) {
+    const cv::Point& p0 = points[2 * i];
+    const cv::Point& p1 = points[2 * i + 1];
+    pattern.x0[i]       = p0.x;
+    pattern.y0[i]       = p0.y;
+    pattern.x1[i]       = p1.x;
+    pattern.y1[i]       = p1.y;
+    radius = std::max({radius, std::hypot(p0.x, p0.y), std::hypot(p1.x, p1.y)});
+  }
+  // A rotated coordinate is at most the radius, rounded to the nearest.
+  pattern.reach = static_cast<int>(std::ceil(radius));
+
+  pattern.bins = std::max(bins, 0);
+  pattern.rotated.resize(pattern.bins);
+  for (int bin = 0; bin < pattern.bins; ++bin) {
+    double a, b;
+    Rotation(bin * 360.f / pattern.bins, a, b);
+    RotatedPattern& rotated = pattern.rotated[bin];
+    for (std::size_t i = 0; i < kTests; ++i) {
+      rotated.x0[i] = cvRound(pattern.x0[i] * a - pattern.y0[i] * b);
+      rotated.y0[i] = cvRound(pattern.x0[i] * b + pattern.y0[i] * a);
+      rotated.x1[i] = cvRound(pattern.x1[i] * a - pattern.y1[i] * b);
+      rotated.y1[i] = cvRound(pattern.x1[i] * b + pattern.y1[i] * a);
+    }
+  }
+  return pattern;
+}
+
+void ComputeAngles(const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, const std::vector<int>& u_max) {
+  assert(image.type() == CV_8UC1);
+  const AnglePatch patch     = MakeAnglePatch(u_max);
+  const AngleFn angle_fn     = AngleFunction(CurrentKernel().load(std::memory_order_relaxed));
+  const std::ptrdiff_t step  = static_cast<std::ptrdiff_t>(image.step);
+  const std::ptrdiff_t reach = kHalfPatchSize * step + kHalfPatchSize;
+
+  for (cv::KeyPoint& keypoint : keypoints) {
+    const std::uint8_t* center = image.ptr<std::uint8_t>(cvRound(keypoint.pt.y)) + cvRound(keypoint.pt.x);
+    // The vector loads read one byte past the patch of every row.
+    const bool in_buffer = Readable(image, center - reach, 2 * reach + 2);
+    keypoint.angle       = (in_buffer ? angle_fn : AngleScalar)(center, step, patch);
+  }
+}
+
+void ComputeDescriptors(
+  const cv::Mat& image,
+  const std::vector<cv::KeyPoint>& keypoints,
+  const Pattern& pattern,
+  cv::Mat& descriptors
+) {
+  assert(image.type() == CV_8UC1);
+  assert(descriptors.type() == CV_8UC1 && descriptors.cols == (int)kDescriptorBytes);
+  assert(descriptors.rows >= (int)keypoints.size());
+  const Kernel kernel               = CurrentKernel().load(std::memory_order_relaxed);
+  const DescriptorFn descriptor_fn = DescriptorFunction(kernel);
+  const BinnedFn binned_fn         = BinnedFunction(kernel);
+  const std::ptrdiff_t step        = static_cast<std::ptrdiff_t>(image.step);
+  const std::ptrdiff_t reach       = pattern.reach * (step + 1);
+
+  for (std::size_t i = 0; i < keypoints.size(); ++i) {
+    const cv::KeyPoint& keypoint = keypoints[i];
+    const std::uint8_t* center   = image.ptr<std::uint8_t>(cvRound(keypoint.pt.y)) + cvRound(keypoint.pt.x);
+    std::uint8_t* desc           = descriptors.ptr<std::uint8_t>((int)i);
+    // The gathers read 3 bytes past every pixel.
+    const bool in_buffer = Readable(image, center - reach, 2 * reach + 4);
+
+    if (pattern.bins > 0) {
+      const int bin = (cvRound(keypoint.angle * pattern.bins / 360.f) % pattern.bins + pattern.bins) % pattern.bins;
+      (in_buffer ? binned_fn : BinnedScalar)(center, step, pattern.rotated[bin], desc);
+    } else {
+      double a, b;
+      Rotation(keypoint.angle, a, b);
+      (in_buffer ? descriptor_fn : DescriptorScalar)(center, step, a, b, pattern, desc);
+    }
+  }
+}
+
+Kernel ActiveKernel() {
+  return CurrentKernel().load(std::memory_order_relaxed);
+}
+
+bool SetKernel(const Kernel kernel) {
+  if (!IsSupported(kernel)) {
+    return false;
+  }
+  CurrentKernel().store(kernel, std::memory_order_relaxed);
+  return true;
+}
+
+bool IsSupported(const Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Scalar:
+      return true;
+#ifdef ORB_SLAM3_ORB_X86
+    case Kernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+    case Kernel::AVX512:
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+const char* KernelName(const Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::AVX2:   return "avx2";
+    case Kernel::AVX512: return "avx512";
+  }
+  return "unknown";
+}
+
+} // namespace Orb
+} // namespace ORB_SLAM3
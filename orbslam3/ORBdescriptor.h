@@ -0,0 +1,114 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ORB_DESCRIPTOR_H
+#define ORB_DESCRIPTOR_H
+
+// Standard
+#include <array>
+#include <cstddef>
+#include <vector>
+// 3rdparty
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+namespace Orb {
+
+// Radius of the circular patch of the orientation.
+constexpr int kHalfPatchSize = 15;
+
+// Number of BRIEF tests, one bit of the descriptor each.
+constexpr std::size_t kTests           = 256;
+constexpr std::size_t kDescriptorBytes = kTests / 8;
+
+// Instruction set used by the kernels.
+enum class Kernel {
+  Scalar, // One pixel at a time
+  AVX2,   // x86 AVX2: 8 tests per gather, one patch row per load
+  AVX512  // x86 AVX-512: 16 tests per gather (orientation as AVX2)
+};
+
+// Pattern rotated by the center angle of a bin, in integer pixel offsets.
+struct RotatedPattern {
+  std::array<int, kTests> x0{};
+  std::array<int, kTests> y0{};
+  std::array<int, kTests> x1{};
+  std::array<int, kTests> y1{};
+};
+
+// BRIEF pattern prepared for the kernels: the two points of every test, in
+// separate arrays. The coordinates are kept in double so that the rotation of
+// a point (two products of an integer and a float, and their sum) is exact:
+// the rounded offsets, hence the descriptors, are then the same for every
+// kernel, with or without FMA contraction.
+//
+// With angle bins, the descriptors use the pattern rotated by the center of
+// the bin of the keypoint angle instead (the lookup table of the original ORB
+// paper): no rotation per keypoint, but the steering angle is off by up to
+// 180 / bins degrees. Keypoints at the center of a bin get the exact
+// descriptor.
+struct Pattern {
+  std::array<double, kTests> x0{};
+  std::array<double, kTests> y0{};
+  std::array<double, kTests> x1{};
+  std::array<double, kTests> y1{};
+  int reach = 0; // Bound of the rotated offsets, in pixels along each axis
+
+  int bins = 0;                        // 0 when the angles are not quantized
+  std::vector<RotatedPattern> rotated; // One per bin, bin k centered on k * 360 / bins degrees
+};
+
+// Pattern of 2 * kTests points, test i comparing points 2i and 2i + 1, with
+// the given number of angle bins (0 for the exact rotation).
+Pattern MakePattern(const cv::Point* points, const int bins = 0);
+
+// Orientation of the keypoints (angle member, in degrees), from the intensity
+// centroid of the circular patch around them. u_max[v] is the half width of
+// row v of the patch. The keypoints must be at least kHalfPatchSize pixels
+// from the borders of the CV_8UC1 image.
+void ComputeAngles(const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, const std::vector<int>& u_max);
+
+// rBRIEF descriptors of the keypoints, steered by their angle, in the first
+// rows of `descriptors` (CV_8UC1, kDescriptorBytes columns, at least one row
+// per keypoint). The rotated pattern must stay inside the CV_8UC1 image.
+void ComputeDescriptors(
+  const cv::Mat& image,
+  const std::vector<cv::KeyPoint>& keypoints,
+  const Pattern& pattern,
+  cv::Mat& descriptors
+);
+
+// Kernel picked at startup from the CPU features.
+Kernel ActiveKernel();
+
+// Force a kernel, mostly for tests and benchmarks. Returns false and keeps the
+// current one if the CPU does not support it.
+bool SetKernel(const Kernel kernel);
+
+// Whether the CPU (and the build) support the kernel.
+bool IsSupported(const Kernel kernel);
+
+const char* KernelName(const Kernel kernel);
+
+} // namespace Orb
+} // namespace ORB_SLAM3
+
+#endif // ORB_DESCRIPTOR_H
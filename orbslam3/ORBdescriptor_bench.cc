@@ -0,0 +1,169 @@
+// Microbenchmark of the orientation and descriptor kernels, with every kernel
+// supported by the CPU: the kernels alone on FAST corners of the image, then
+// the whole extraction. The descriptors are checked against the scalar kernel,
+// and the quantized steering against the exact one.
+//
+// Usage: ORBdescriptor_bench <image> [n_features] [angle_bins]
+
+// Standard
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+// 3rdparty
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+// Local
+#include "orbslam3/ORBdescriptor.h"
+#include "orbslam3/ORBextractor.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+constexpr int kRuns = 50;
+
+// Run `fn` once to warm up, then return the time per run of the next runs.
+template <typename Fn>
+double TimeMs(Fn&& fn) {
+  fn();
+  const auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < kRuns; ++run) {
+    fn();
+  }
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count() / kRuns;
+}
+
+// Half widths of the rows of the circular patch, as the extractor.
+std::vector<int> PatchHalfWidths() {
+  const int r = Orb::kHalfPatchSize;
+  std::vector<int> u_max(r + 1);
+  const int vmax = cvFloor(r * std::sqrt(2.f) / 2 + 1);
+  const int vmin = cvCeil(r * std::sqrt(2.f) / 2);
+  for (int v = 0; v <= vmax; ++v) {
+    u_max[v] = cvRound(std::sqrt(static_cast<double>(r * r - v * v)));
+  }
+  for (int v = r, v0 = 0; v >= vmin; --v) {
+    while (u_max[v0] == u_max[v0 + 1]) {
+      ++v0;
+    }
+    u_max[v] = v0++;
+  }
+  return u_max;
+}
+
+// Random pattern in the 31x31 patch: the learned one is private to the
+// extractor, and the kernels do not depend on the point values.
+std::vector<cv::Point> RandomPattern() {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> coord(-13, 12);
+  std::vector<cv::Point> points(2 * Orb::kTests);
+  for (cv::Point& p : points) {
+    p = cv::Point(coord(rng), coord(rng));
+  }
+  return points;
+}
+
+double MeanDistance(const cv::Mat& a, const cv::Mat& b) {
+  return a.rows == 0 ? 0.0 : cv::norm(a, b, cv::NORM_HAMMING) / a.rows;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: %s <image> [n_features] [angle_bins]\n", argv[0]);
+    return 1;
+  }
+
+  const cv::Mat image = cv::imread(argv[1], cv::IMREAD_GRAYSCALE);
+  if (image.empty()) {
+    std::fprintf(stderr, "Failed to load image %s\n", argv[1]);
+    return 1;
+  }
+  const int n_features = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const int bins       = argc > 3 ? std::atoi(argv[3]) : 30;
+  if (n_features <= 0 || bins <= 0) {
+    std::fprintf(stderr, "Usage: %s <image> [n_features] [angle_bins]\n", argv[0]);
+    return 1;
+  }
+
+  // Strongest FAST corners away from the borders, as the keypoints of a level.
+  cv::Mat blurred;
+  cv::GaussianBlur(image, blurred, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
+  std::vector<cv::KeyPoint> corners, keypoints;
+  cv::FAST(image, corners, 20, true);
+  const float margin = 19.f;
+  for (const cv::KeyPoint& corner : corners) {
+    if (corner.pt.x >= margin && corner.pt.y >= margin && corner.pt.x <= image.cols - margin
+        && corner.pt.y <= image.rows - margin) {
+      keypoints.push_back(corner);
+    }
+  }
+  cv::KeyPointsFilter::retainBest(keypoints, n_features);
+  if (keypoints.empty()) {
+    std::fprintf(stderr, "No corner in %s\n", argv[1]);
+    return 1;
+  }
+
+  const std::vector<int> u_max        = PatchHalfWidths();
+  const std::vector<cv::Point> points = RandomPattern();
+  const Orb::Pattern exact            = Orb::MakePattern(points.data());
+  const Orb::Pattern binned           = Orb::MakePattern(points.data(), bins);
+  const std::size_t n                 = keypoints.size();
+  std::printf("%zu keypoints, %d runs, %d angle bins\n", n, kRuns, bins);
+  std::printf("%-8s %14s %14s %14s\n", "kernel", "angles us", "exact us", "binned us");
+
+  const Orb::Kernel initial = Orb::ActiveKernel();
+  cv::Mat expected_exact, expected_binned;
+  bool same = true;
+  for (const Orb::Kernel kernel : {Orb::Kernel::Scalar, Orb::Kernel::AVX2, Orb::Kernel::AVX512}) {
+    if (!Orb::SetKernel(kernel)) {
+      continue;
+    }
+    std::vector<cv::KeyPoint> oriented = keypoints;
+    cv::Mat desc_exact(static_cast<int>(n), Orb::kDescriptorBytes, CV_8UC1);
+    cv::Mat desc_binned(static_cast<int>(n), Orb::kDescriptorBytes, CV_8UC1);
+
+    const double angles_ms = TimeMs([&] { Orb::ComputeAngles(image, oriented, u_max); });
+    const double exact_ms  = TimeMs([&] { Orb::ComputeDescriptors(blurred, oriented, exact, desc_exact); });
+    const double binned_ms = TimeMs([&] { Orb::ComputeDescriptors(blurred, oriented, binned, desc_binned); });
+    std::printf("%-8s %14.1f %14.1f %14.1f\n", Orb::KernelName(kernel), angles_ms * 1e3, exact_ms * 1e3, binned_ms * 1e3);
+
+    if (expected_exact.empty()) {
+      expected_exact  = desc_exact;
+      expected_binned = desc_binned;
+    } else {
+      same = same && MeanDistance(desc_exact, expected_exact) == 0.0
+          && MeanDistance(desc_binned, expected_binned) == 0.0;
+    }
+  }
+  std::printf("kernels %s the scalar descriptors\n", same ? "match" : "DIFFER FROM");
+  std::printf(
+    "binned steering: %.2f of %zu bits differ from the exact descriptors on average\n",
+    MeanDistance(expected_binned, expected_exact),
+    Orb::kTests
+  );
+
+  // Whole extraction, with the learned pattern.
+  ORBextractor extractor(n_features, 1.2f, 8, 20, 7);
+  extractor.SetBufferReuse(true);
+  std::vector<int> lapping = {0, 0};
+  std::vector<cv::KeyPoint> extracted;
+  cv::Mat descriptors;
+  for (const Orb::Kernel kernel : {Orb::Kernel::Scalar, Orb::Kernel::AVX2, Orb::Kernel::AVX512}) {
+    if (!Orb::SetKernel(kernel)) {
+      continue;
+    }
+    const double ms = TimeMs([&] { extractor(image, cv::Mat(), extracted, descriptors, lapping); });
+    std::printf("extraction %-8s %8.3f ms/frame\n", Orb::KernelName(kernel), ms);
+  }
+
+  Orb::SetKernel(initial);
+  std::printf("Default kernel: %s\n", Orb::KernelName(initial));
+  return same ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+// Standard
+#include <cmath>
+#include <random>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <opencv2/imgproc.hpp>
+// Local
+#include "orbslam3/ORBdescriptor.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+const Orb::Kernel kAllKernels[] = {
+  Orb::Kernel::Scalar,
+  Orb::Kernel::AVX2,
+  Orb::Kernel::AVX512,
+};
+
+// Smooth random image, as the blurred pyramid levels.
+cv::Mat RandomImage(const int width, const int height) {
+  cv::Mat image(height, width, CV_8UC1);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(256));
+  cv::GaussianBlur(image, image, cv::Size(7, 7), 2, 2);
+  return image;
+}
+
+// Half widths of the rows of the circular patch, as the extractor.
+std::vector<int> PatchHalfWidths() {
+  const int r = Orb::kHalfPatchSize;
+  std::vector<int> u_max(r + 1);
+  const int vmax = cvFloor(r * std::sqrt(2.f) / 2 + 1);
+  const int vmin = cvCeil(r * std::sqrt(2.f) / 2);
+  for (int v = 0; v <= vmax; ++v) {
+    u_max[v] = cvRound(std::sqrt(static_cast<double>(r * r - v * v)));
+  }
+  for (int v = r, v0 = 0; v >= vmin; --v) {
+    while (u_max[v0] == u_max[v0 + 1]) {
+      ++v0;
+    }
+    u_max[v] = v0++;
+  }
+  return u_max;
+}
+
+// Random pattern in the 31x31 patch, as the learned one of the extractor.
+std::vector<cv::Point> RandomPattern() {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> coord(-13, 12);
+  std::vector<cv::Point> points(2 * Orb::kTests);
+  for (cv::Point& p : points) {
+    p = cv::Point(coord(rng), coord(rng));
+  }
+  return points;
+}
+
+// Keypoints far enough from the borders for the descriptors (as FAST and the
+// edge threshold of the extractor), including the extreme positions where
+// the kernels fall back to the scalar reads.
+std::vector<cv::KeyPoint> RandomKeypoints(const cv::Mat& image, const std::size_t count) {
+  const float margin = 19.f;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> x(margin, image.cols - margin);
+  std::uniform_real_distribution<float> y(margin, image.rows - margin);
+  std::uniform_real_distribution<float> angle(0.f, 360.f);
+  std::vector<cv::KeyPoint> keypoints;
+  for (std::size_t i = 0; i < count; ++i) {
+    keypoints.emplace_back(x(rng), y(rng), 31.f, angle(rng));
+  }
+  for (const float a : {0.f, 45.f, 90.f, 180.f, 270.f, 359.9f}) {
+    keypoints.emplace_back(margin, margin, 31.f, a);
+    keypoints.emplace_back(image.cols - margin, image.rows - margin, 31.f, a);
+  }
+  return keypoints;
+}
+
+// The original orientation of the extractor.
+float ReferenceAngle(const cv::Mat& image, const cv::Point2f pt, const std::vector<int>& u_max) {
+  int m_01 = 0, m_10 = 0;
+  const uchar* center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
+  for (int u = -Orb::kHalfPatchSize; u <= Orb::kHalfPatchSize; ++u) {
+    m_10 += u * center[u];
+  }
+  const int step = static_cast<int>(image.step1());
+  for (int v = 1; v <= Orb::kHalfPatchSize; ++v) {
+    int v_sum = 0;
+    for (int u = -u_max[v]; u <= u_max[v]; ++u) {
+      const int val_plus = center[u + v * step], val_minus = center[u - v * step];
+      v_sum += val_plus - val_minus;
+      m_10 += u * (val_plus + val_minus);
+    }
+    m_01 += v * v_sum;
+  }
+  return cv::fastAtan2(static_cast<float>(m_01), static_cast<float>(m_10));
+}
+
+// The original descriptor of the extractor, with the pattern rotated in float.
+void ReferenceDescriptor(const cv::KeyPoint& kpt, const cv::Mat& img, const cv::Point* pattern, uchar* desc) {
+  const float angle = kpt.angle * static_cast<float>(CV_PI / 180.f);
+  const float a = static_cast<float>(std::cos(angle)), b = static_cast<float>(std::sin(angle));
+
+  const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+  const int step      = static_cast<int>(img.step);
+
+#define GET_VALUE(idx) center[cvRound(pattern[idx].x * b + pattern[idx].y * a) * step + cvRound(pattern[idx].x * a - pattern[idx].y * b)]
+
+  for (int i = 0; i < 32; ++i, pattern += 16) {
+    int t0, t1, val;
+    t0 = GET_VALUE(0); t1 = GET_VALUE(1);
+    val = t0 < t1;
+    t0 = GET_VALUE(2); t1 = GET_VALUE(3);
+    val |= (t0 < t1) << 1;
+    t0 = GET_VALUE(4); t1 = GET_VALUE(5);
+    val |= (t0 < t1) << 2;
+    t0 = GET_VALUE(6); t1 = GET_VALUE(7);
+    val |= (t0 < t1) << 3;
+    t0 = GET_VALUE(8); t1 = GET_VALUE(9);
+    val |= (t0 < t1) << 4;
+    t0 = GET_VALUE(10); t1 = GET_VALUE(11);
+    val |= (t0 < t1) << 5;
+    t0 = GET_VALUE(12); t1 = GET_VALUE(13);
+    val |= (t0 < t1) << 6;
+    t0 = GET_VALUE(14); t1 = GET_VALUE(15);
+    val |= (t0 < t1) << 7;
+
+    desc[i] = static_cast<uchar>(val);
+  }
+
+#undef GET_VALUE
+}
+
+cv::Mat Describe(const cv::Mat& image, const std::vector<cv::KeyPoint>& keypoints, const Orb::Pattern& pattern) {
+  cv::Mat descriptors(static_cast<int>(keypoints.size()), Orb::kDescriptorBytes, CV_8UC1);
+  Orb::ComputeDescriptors(image, keypoints, pattern, descriptors);
+  return descriptors;
+}
+
+bool SameRows(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+} // namespace
+
+TEST(ORBdescriptor, AnglesMatchScalar) {
+  const cv::Mat image          = RandomImage(320, 240);
+  const std::vector<int> u_max = PatchHalfWidths();
+  const auto keypoints         = RandomKeypoints(image, 500);
+
+  const Orb::Kernel initial = Orb::ActiveKernel();
+  for (const Orb::Kernel kernel : kAllKernels) {
+    if (!Orb::SetKernel(kernel)) {
+      continue;
+    }
+    SCOPED_TRACE(Orb::KernelName(kernel));
+
+    std::vector<cv::KeyPoint> oriented = keypoints;
+    Orb::ComputeAngles(image, oriented, u_max);
+    for (std::size_t i = 0; i < keypoints.size(); ++i) {
+      ASSERT_EQ(oriented[i].angle, ReferenceAngle(image, keypoints[i].pt, u_max)) << "keypoint " << i;
+    }
+  }
+  Orb::SetKernel(initial);
+}
+
+TEST(ORBdescriptor, DescriptorsMatchScalar) {
+  const cv::Mat image                 = RandomImage(320, 240);
+  const auto keypoints                = RandomKeypoints(image, 500);
+  const std::vector<cv::Point> points = RandomPattern();
+
+  const Orb::Kernel initial = Orb::ActiveKernel();
+  for (const int bins : {0, 30}) {
+    const Orb::Pattern pattern = Orb::MakePattern(points.data(), bins);
+    ASSERT_TRUE(Orb::SetKernel(Orb::Kernel::Scalar));
+    const cv::Mat expected = Describe(image, keypoints, pattern);
+
+    for (const Orb::Kernel kernel : kAllKernels) {
+      if (!Orb::SetKernel(kernel)) {
+        continue;
+      }
+      SCOPED_TRACE(Orb::KernelName(kernel));
+      EXPECT_TRUE(SameRows(Describe(image, keypoints, pattern), expected)) << bins << " bins";
+    }
+  }
+  Orb::SetKernel(initial);
+}
+
+TEST(ORBdescriptor, AngleBins) {
+  const cv::Mat image                 = RandomImage(320, 240);
+  const std::vector<cv::Point> points = RandomPattern();
+  const int bins                      = 30;
+  const Orb::Pattern exact            = Orb::MakePattern(points.data());
+  const Orb::Pattern binned           = Orb::MakePattern(points.data(), bins);
+  EXPECT_EQ(exact.bins, 0);
+  ASSERT_EQ(binned.rotated.size(), static_cast<std::size_t>(bins));
+
+  // Keypoints at the center of a bin get the exact descriptor, keypoints
+  // within the bin get the same one.
+  auto keypoints = RandomKeypoints(image, 300);
+  for (std::size_t i = 0; i < keypoints.size(); ++i) {
+    keypoints[i].angle = static_cast<float>(i % bins) * 360.f / bins;
+  }
+  const cv::Mat centered = Describe(image, keypoints, binned);
+  EXPECT_TRUE(SameRows(centered, Describe(image, keypoints, exact)));
+
+  for (cv::KeyPoint& keypoint : keypoints) {
+    keypoint.angle += 0.4f * 360.f / bins;
+  }
+  EXPECT_TRUE(SameRows(Describe(image, keypoints, binned), centered));
+}
+
+TEST(ORBdescriptor, DescriptorsMatchFloatReference) {
+  const cv::Mat image                 = RandomImage(640, 480);
+  const auto keypoints                = RandomKeypoints(image, 100000);
+  const std::vector<cv::Point> points = RandomPattern();
+
+  const Orb::Kernel initial = Orb::ActiveKernel();
+  ASSERT_TRUE(Orb::SetKernel(Orb::Kernel::Scalar));
+  const cv::Mat descriptors = Describe(image, keypoints, Orb::MakePattern(points.data()));
+  Orb::SetKernel(initial);
+
+  // The double rotation only differs from the float one when a rotated point
+  // sits on a rounding tie: about 1 keypoint in 20k with the learned pattern
+  // (13 keypoints in 100k have one here), and only on the tests of those
+  // points.
+  std::size_t differing = 0;
+  uchar expected[Orb::kDescriptorBytes];
+  for (std::size_t i = 0; i < keypoints.size(); ++i) {
+    ReferenceDescriptor(keypoints[i], image, points.data(), expected);
+    const cv::Mat reference(1, Orb::kDescriptorBytes, CV_8UC1, expected);
+    const double bits = cv::norm(descriptors.row(static_cast<int>(i)), reference, cv::NORM_HAMMING);
+    if (bits > 0.0) {
+      ++differing;
+      EXPECT_LE(bits, 8.0) << "keypoint " << i;
+    }
+  }
+  EXPECT_LE(differing, keypoints.size() / 5000);
+}
@@ -57,6 +57,7 @@
 #include <opencv2/imgproc.hpp>
 // Local
 #include "orbslam3/ORBextractor.h"
+#include "orbslam3/ThreadPool.h"
 
 namespace ORB_SLAM3
 {
@@ -66,79 +67,6 @@ namespace ORB_SLAM3
     const int EDGE_THRESHOLD = 19;
 
 
-    static float IC_Angle(const cv::Mat& image, cv::Point2f pt,  const std::vector<int> & u_max)
-    {
-        int m_01 = 0, m_10 = 0;
-
-        const uchar* center = &image.at<uchar> (cvRound(pt.y), cvRound(pt.x));
-
-        // Treat the center line differently, v=0
-        for (int u = -HALF_PATCH_SIZE; u <= HALF_PATCH_SIZE; ++u)
-            m_10 += u * center[u];
-
-        // Go line by line in the circuI853lar patch
-        int step = (int)image.step1();
-        for (int v = 1; v <= HALF_PATCH_SIZE; ++v)
-        {
-            // Proceed over the two lines
-            int v_sum = 0;
-            int d = u_max[v];
-            for (int u = -d; u <= d; ++u)
-            {
-                int val_plus = center[u + v*step], val_minus = center[u - v*step];
-                v_sum += (val_plus - val_minus);
-                m_10 += u * (val_plus + val_minus);
-            }
-            m_01 += v * v_sum;
-        }
-
-        return cv::fastAtan2((float)m_01, (float)m_10);
-    }
-
-
-    const float factorPI = (float)(CV_PI/180.f);
-    static void computeOrbDescriptor(const cv::KeyPoint& kpt,
-                                     const cv::Mat& img, const cv::Point* pattern,
-                                     uchar* desc)
-    {
-        float angle = (float)kpt.angle*factorPI;
-        float a = (float)std::cos(angle), b = (float)std::sin(angle);
-
-        const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
-        const int step = (int)img.step;
-
-#define GET_VALUE(idx) \
-        center[cvRound(pattern[idx].x*b + pattern[idx].y*a)*step + \
-               cvRound(pattern[idx].x*a - pattern[idx].y*b)]
-
-
-        for (int i = 0; i < 32; ++i, pattern += 16)
-        {
-            int t0, t1, val;
-            t0 = GET_VALUE(0); t1 = GET_VALUE(1);
-            val = t0 < t1;
-            t0 = GET_VALUE(2); t1 = GET_VALUE(3);
-            val |= (t0 < t1) << 1;
-            t0 = GET_VALUE(4); t1 = GET_VALUE(5);
-            val |= (t0 < t1) << 2;
-            t0 = GET_VALUE(6); t1 = GET_VALUE(7);
-            val |= (t0 < t1) << 3;
-            t0 = GET_VALUE(8); t1 = GET_VALUE(9);
-            val |= (t0 < t1) << 4;
-            t0 = GET_VALUE(10); t1 = GET_VALUE(11);
-            val |= (t0 < t1) << 5;
-            t0 = GET_VALUE(12); t1 = GET_VALUE(13);
-            val |= (t0 < t1) << 6;
-            t0 = GET_VALUE(14); t1 = GET_VALUE(15);
-            val |= (t0 < t1) << 7;
-
-            desc[i] = (uchar)val;
-        }
-
-#undef GET_VALUE
-    }
-
-
     static int bit_pattern_31_[256*4] =
             {
                     8,-3, 9,5, // mean (0), correlation (0)
@@ -402,7 +330,7 @@ namespace ORB_SLAM3
     ORBextractor::ORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
                                int _iniThFAST, int _minThFAST):
             nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels),
-            iniThFAST(_iniThFAST), minThFAST(_minThFAST)
+            iniThFAST(_iniThFAST), minThFAST(_minThFAST), mpThreadPool(nullptr), mbReuseBuffers(false)
     {
         mvScaleFactor.resize(nlevels);
         mvLevelSigma2.resize(nlevels);
@@ -423,6 +351,8 @@ namespace ORB_SLAM3
         }
 
         mvImagePyramid.resize(nlevels);
+        mvLevelBuffers.resize(nlevels);
+        mvvKeypoints.resize(nlevels);
 
         mnFeaturesPerLevel.resize(nlevels);
         float factor = 1.0f / scaleFactor;
@@ -437,9 +367,7 @@ namespace ORB_SLAM3
         }
         mnFeaturesPerLevel[nlevels-1] = std::max(nfeatures - sumFeatures, 0);
 
-        const int npoints = 512;
-        const cv::Point* pattern0 = (const cv::Point*)bit_pattern_31_;
-        std::copy(pattern0, pattern0 + npoints, std::back_inserter(pattern));
+        pattern = Orb::MakePattern((const cv::Point*)bit_pattern_31_);
 
         //This is for orientation
         // pre-compute the end of a row in a circular patch
@@ -461,102 +389,154 @@ namespace ORB_SLAM3
         }
     }
 
+    void ORBextractor::SetAngleBins(int nBins)
+    {
+        pattern = Orb::MakePattern((const cv::Point*)bit_pattern_31_, nBins);
+    }
+
     static void computeOrientation(const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, const std::vector<int>& umax)
     {
-        for (auto keypoint = keypoints.begin(),
-               keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
+        Orb::ComputeAngles(image, keypoints, umax);
+    }
+
+    namespace
+    {
+
+    // Doubly linked list of the alive nodes of the arena, with the operations of the std::list it replaces
+    struct NodeList
+    {
+        std::vector<ExtractorNode>& vNodes;
+        int head = -1, tail = -1, size = 0;
+
+        int Add(const ExtractorNode &node)
         {
-            keypoint->angle = IC_Angle(image, keypoint->pt, umax);
+            vNodes.push_back(node);
+            return (int)vNodes.size()-1;
         }
-    }
 
-    void ExtractorNode::DivideNode(ExtractorNode &n1, ExtractorNode &n2, ExtractorNode &n3, ExtractorNode &n4)
+        int PushBack(const ExtractorNode &node)
+        {
+            const int n = Add(node);
+            vNodes[n].prev = tail;
+            vNodes[n].next = -1;
+            if(tail >= 0)
+                vNodes[tail].next = n;
+            else
+                head = n;
+            tail = n;
+            size++;
+            return n;
+        }
+
+        int PushFront(const ExtractorNode &node)
+        {
+            const int n = Add(node);
+            vNodes[n].prev = -1;
+            vNodes[n].next = head;
+            if(head >= 0)
+                vNodes[head].prev = n;
+            else
+                tail = n;
+            head = n;
+            size++;
+            return n;
+        }
+
+        // Unlink the node, returns the next one
+        int Erase(const int n)
+        {
+            const int prev = vNodes[n].prev, next = vNodes[n].next;
+            if(prev >= 0)
+                vNodes[prev].next = next;
+            else
+                head = next;
+            if(next >= 0)
+                vNodes[next].prev = prev;
+            else
+                tail = prev;
+            size--;
+            return next;
+        }
+    };
+
+    } // namespace
+
+    // Split a node in four children. Its key range is partitioned in place, each child getting a sub-range
+    // with the keypoints in their original order.
+    static void divideNode(const ExtractorNode &node, std::vector<ExtractorKey>& vNodeKeys,
+                           std::vector<ExtractorKey>& vSplitKeys, ExtractorNode (&children)[4])
     {
-        const int halfX = std::ceil(static_cast<float>(UR.x-UL.x)/2);
-        const int halfY = std::ceil(static_cast<float>(BR.y-UL.y)/2);
+        const int halfX = std::ceil(static_cast<float>(node.UR.x-node.UL.x)/2);
+        const int halfY = std::ceil(static_cast<float>(node.BR.y-node.UL.y)/2);
+
+        ExtractorNode &n1 = children[0], &n2 = children[1], &n3 = children[2], &n4 = children[3];
 
         //Define boundaries of childs
-        n1.UL = UL;
-        n1.UR = cv::Point2i(UL.x+halfX,UL.y);
-        n1.BL = cv::Point2i(UL.x,UL.y+halfY);
-        n1.BR = cv::Point2i(UL.x+halfX,UL.y+halfY);
-        n1.vKeys.reserve(vKeys.size());
+        n1.UL = node.UL;
+        n1.UR = cv::Point2i(node.UL.x+halfX,node.UL.y);
+        n1.BL = cv::Point2i(node.UL.x,node.UL.y+halfY);
+        n1.BR = cv::Point2i(node.UL.x+halfX,node.UL.y+halfY);
 
         n2.UL = n1.UR;
-        n2.UR = UR;
+        n2.UR = node.UR;
         n2.BL = n1.BR;
-        n2.BR = cv::Point2i(UR.x,UL.y+halfY);
-        n2.vKeys.reserve(vKeys.size());
+        n2.BR = cv::Point2i(node.UR.x,node.UL.y+halfY);
 
         n3.UL = n1.BL;
         n3.UR = n1.BR;
-        n3.BL = BL;
-        n3.BR = cv::Point2i(n1.BR.x,BL.y);
-        n3.vKeys.reserve(vKeys.size());
+        n3.BL = node.BL;
+        n3.BR = cv::Point2i(n1.BR.x,node.BL.y);
 
         n4.UL = n3.UR;
         n4.UR = n2.BR;
         n4.BL = n3.BR;
-        n4.BR = BR;
-        n4.vKeys.reserve(vKeys.size());
+        n4.BR = node.BR;
 
-        //Associate points to childs
-        for(std::size_t i=0;i<vKeys.size();i++)
-        {
-            const cv::KeyPoint &kp = vKeys[i];
-            if(kp.pt.x<n1.UR.x)
-            {
-                if(kp.pt.y<n1.BR.y)
-                    n1.vKeys.push_back(kp);
-                else
-                    n3.vKeys.push_back(kp);
-            }
-            else if(kp.pt.y<n1.BR.y)
-                n2.vKeys.push_back(kp);
-            else
-                n4.vKeys.push_back(kp);
-        }
+        //Associate points to childs: count them, then place them child by child
+        const float midX = n1.UR.x, midY = n1.BR.y;
+        const auto child = [midX, midY](const ExtractorKey &key) {
+            return (key.pt.x<midX ? 0 : 1) + (key.pt.y<midY ? 0 : 2);
+        };
 
-        if(n1.vKeys.size()==1)
-            n1.bNoMore = true;
-        if(n2.vKeys.size()==1)
-            n2.bNoMore = true;
-        if(n3.vKeys.size()==1)
-            n3.bNoMore = true;
-        if(n4.vKeys.size()==1)
-            n4.bNoMore = true;
+        int counts[4] = {0, 0, 0, 0};
+        vSplitKeys.assign(vNodeKeys.begin()+node.begin, vNodeKeys.begin()+node.end);
+        for(const ExtractorKey &key : vSplitKeys)
+            counts[child(key)]++;
 
-    }
-
-    static bool compareNodes(std::pair<int,ExtractorNode*>& e1, std::pair<int,ExtractorNode*>& e2){
-        if(e1.first < e2.first){
-            return true;
-        }
-        else if(e1.first > e2.first){
-            return false;
-        }
-        else{
-            if(e1.second->UL.x < e2.second->UL.x){
-                return true;
-            }
-            else{
-                return false;
-            }
+        int pos[4];
+        for(int c=0, begin=node.begin; c<4; c++)
+        {
+            children[c].begin = pos[c] = begin;
+            children[c].end = begin += counts[c];
+            children[c].bNoMore = counts[c]==1;
         }
+        for(const ExtractorKey &key : vSplitKeys)
+            vNodeKeys[pos[child(key)]++] = key;
     }
 
-    std::vector<cv::KeyPoint> ORBextractor::DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
-                                                         const int &maxX, const int &minY, const int &maxY, const int &N, const int &level)
+    void ORBextractor::DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
+                                         const int &maxX, const int &minY, const int &maxY, const int &N, const int &level,
+                                         std::vector<cv::KeyPoint>& vResultKeys)
     {
+        // The nodes and the keypoint indices live in the arena of the level, reused from frame to frame
+        LevelBuffers &buffers = mvLevelBuffers[level];
+        std::vector<ExtractorNode> &vNodes = buffers.vNodes;
+        std::vector<ExtractorKey> &vNodeKeys = buffers.vNodeKeys;
+        vNodes.clear();
+        NodeList lNodes{vNodes};
+
         // Compute how many initial nodes
         const int nIni = std::round(static_cast<float>(maxX-minX)/(maxY-minY));
 
         const float hX = static_cast<float>(maxX-minX)/nIni;
 
-        std::list<ExtractorNode> lNodes;
-
-        std::vector<ExtractorNode*> vpIniNodes;
-        vpIniNodes.resize(nIni);
+        //Associate points to the initial nodes, in order
+        std::vector<int> &vIniCounts = buffers.vIniCounts;
+        vIniCounts.assign(nIni+1, 0);
+        for(const cv::KeyPoint &kp : vToDistributeKeys)
+            vIniCounts[static_cast<int>(kp.pt.x/hX)+1]++;
+        for(int i=0; i<nIni; i++)
+            vIniCounts[i+1] += vIniCounts[i];
 
         for(int i=0; i<nIni; i++)
         {
@@ -565,182 +545,104 @@ namespace ORB_SLAM3
             ni.UR = cv::Point2i(hX*static_cast<float>(i+1),0);
             ni.BL = cv::Point2i(ni.UL.x,maxY-minY);
             ni.BR = cv::Point2i(ni.UR.x,maxY-minY);
-            ni.vKeys.reserve(vToDistributeKeys.size());
+            ni.begin = vIniCounts[i];
+            ni.end = vIniCounts[i+1];
+            ni.bNoMore = ni.Size()==1;
 
-            lNodes.push_back(ni);
-            vpIniNodes[i] = &lNodes.back();
+            // Drop the empty nodes
+            if(ni.Size()>0)
+                lNodes.PushBack(ni);
         }
 
-        //Associate points to childs
+        vNodeKeys.resize(vToDistributeKeys.size());
         for(std::size_t i=0;i<vToDistributeKeys.size();i++)
         {
             const cv::KeyPoint &kp = vToDistributeKeys[i];
-            vpIniNodes[kp.pt.x/hX]->vKeys.push_back(kp);
+            ExtractorKey &key = vNodeKeys[vIniCounts[static_cast<int>(kp.pt.x/hX)]++];
+            key.pt = kp.pt;
+            key.idx = i;
         }
 
-        auto lit = lNodes.begin();
+        bool bFinish = false;
 
-        while(lit!=lNodes.end())
-        {
-            if(lit->vKeys.size()==1)
+        // Nodes with more than one point created by the last expansion, with their size
+        std::vector<std::pair<int,int> > &vSizeAndNode = buffers.vSizeAndNode;
+        std::vector<std::pair<int,int> > &vPrevSizeAndNode = buffers.vPrevSizeAndNode;
+        vSizeAndNode.clear();
+
+        // Bigger nodes last, ties by position
+        const auto compareNodes = [&vNodes](const std::pair<int,int>& e1, const std::pair<int,int>& e2) {
+            if(e1.first != e2.first)
+                return e1.first < e2.first;
+            return vNodes[e1.second].UL.x < vNodes[e2.second].UL.x;
+        };
+
+        // Replace a node by its non-empty children, pushed at the front
+        const auto expand = [&](const int n, int &nToExpand) {
+            ExtractorNode children[4];
+            divideNode(vNodes[n], vNodeKeys, buffers.vSplitKeys, children);
+
+            // Add childs if they contain points
+            for(const ExtractorNode &child : children)
             {
-                lit->bNoMore=true;
-                lit++;
+                if(child.Size()>0)
+                {
+                    const int c = lNodes.PushFront(child);
+                    if(child.Size()>1)
+                    {
+                        nToExpand++;
+                        vSizeAndNode.push_back(std::make_pair(child.Size(),c));
+                    }
+                }
             }
-            else if(lit->vKeys.empty())
-                lit = lNodes.erase(lit);
-            else
-                lit++;
-        }
-
-        bool bFinish = false;
-
-        int iteration = 0;
-
-        std::vector<std::pair<int,ExtractorNode*> > vSizeAndPointerToNode;
-        vSizeAndPointerToNode.reserve(lNodes.size()*4);
+            return lNodes.Erase(n);
+        };
 
         while(!bFinish)
         {
-            iteration++;
-
-            int prevSize = lNodes.size();
-
-            lit = lNodes.begin();
+            int prevSize = lNodes.size;
 
             int nToExpand = 0;
 
-            vSizeAndPointerToNode.clear();
+            vSizeAndNode.clear();
 
-            while(lit!=lNodes.end())
+            for(int n = lNodes.head; n >= 0;)
             {
-                if(lit->bNoMore)
-                {
-                    // If node only contains one point do not subdivide and continue
-                    lit++;
-                    continue;
-                }
+                // If node only contains one point do not subdivide and continue
+                if(vNodes[n].bNoMore)
+                    n = vNodes[n].next;
+                // If more than one point, subdivide
                 else
-                {
-                    // If more than one point, subdivide
-                    ExtractorNode n1,n2,n3,n4;
-                    lit->DivideNode(n1,n2,n3,n4);
-
-                    // Add childs if they contain points
-                    if(n1.vKeys.size()>0)
-                    {
-                        lNodes.push_front(n1);
-                        if(n1.vKeys.size()>1)
-                        {
-                            nToExpand++;
-                            vSizeAndPointerToNode.push_back(std::make_pair(n1.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
-                    }
-                    if(n2.vKeys.size()>0)
-                    {
-                        lNodes.push_front(n2);
-                        if(n2.vKeys.size()>1)
-                        {
-                            nToExpand++;
-                            vSizeAndPointerToNode.push_back(std::make_pair(n2.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
-                    }
-                    if(n3.vKeys.size()>0)
-                    {
-                        lNodes.push_front(n3);
-                        if(n3.vKeys.size()>1)
-                        {
-                            nToExpand++;
-                            vSizeAndPointerToNode.push_back(std::make_pair(n3.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
-                    }
-                    if(n4.vKeys.size()>0)
-                    {
-                        lNodes.push_front(n4);
-                        if(n4.vKeys.size()>1)
-                        {
-                            nToExpand++;
-                            vSizeAndPointerToNode.push_back(std::make_pair(n4.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
-                    }
-
-                    lit=lNodes.erase(lit);
-                    continue;
-                }
+                    n = expand(n, nToExpand);
             }
 
             // Finish if there are more nodes than required features
             // or all nodes contain just one point
-            if((int)lNodes.size()>=N || (int)lNodes.size()==prevSize)
+            if(lNodes.size>=N || lNodes.size==prevSize)
             {
                 bFinish = true;
             }
-            else if(((int)lNodes.size()+nToExpand*3)>N)
+            else if((lNodes.size+nToExpand*3)>N)
             {
 
                 while(!bFinish)
                 {
 
-                    prevSize = lNodes.size();
+                    prevSize = lNodes.size;
 
-                    std::vector<std::pair<int,ExtractorNode*> > vPrevSizeAndPointerToNode = vSizeAndPointerToNode;
-                    vSizeAndPointerToNode.clear();
+                    vPrevSizeAndNode.swap(vSizeAndNode);
+                    vSizeAndNode.clear();
 
-                    std::sort(vPrevSizeAndPointerToNode.begin(),vPrevSizeAndPointerToNode.end(),compareNodes);
-                    for(int j=vPrevSizeAndPointerToNode.size()-1;j>=0;j--)
+                    std::sort(vPrevSizeAndNode.begin(),vPrevSizeAndNode.end(),compareNodes);
+                    for(int j=vPrevSizeAndNode.size()-1;j>=0;j--)
                     {
-                        ExtractorNode n1,n2,n3,n4;
-                        vPrevSizeAndPointerToNode[j].second->DivideNode(n1,n2,n3,n4);
-
-                        // Add childs if they contain points
-                        if(n1.vKeys.size()>0)
-                        {
-                            lNodes.push_front(n1);
-                            if(n1.vKeys.size()>1)
-                            {
-                                vSizeAndPointerToNode.push_back(std::make_pair(n1.vKeys.size(),&lNodes.front()));
-                                lNodes.front().lit = lNodes.begin();
-                            }
-                        }
-                        if(n2.vKeys.size()>0)
-                        {
-                            lNodes.push_front(n2);
-                            if(n2.vKeys.size()>1)
-                            {
-                                vSizeAndPointerToNode.push_back(std::make_pair(n2.vKeys.size(),&lNodes.front()));
-                                lNodes.front().lit = lNodes.begin();
-                            }
-                        }
-                        if(n3.vKeys.size()>0)
-                        {
-                            lNodes.push_front(n3);
-                            if(n3.vKeys.size()>1)
-                            {
-                                vSizeAndPointerToNode.push_back(std::make_pair(n3.vKeys.size(),&lNodes.front()));
-                                lNodes.front().lit = lNodes.begin();
-                            }
-                        }
-                        if(n4.vKeys.size()>0)
-                        {
-                            lNodes.push_front(n4);
-                            if(n4.vKeys.size()>1)
-                            {
-                                vSizeAndPointerToNode.push_back(std::make_pair(n4.vKeys.size(),&lNodes.front()));
-                                lNodes.front().lit = lNodes.begin();
-                            }
-                        }
-
-                        lNodes.erase(vPrevSizeAndPointerToNode[j].second->lit);
+                        expand(vPrevSizeAndNode[j].second, nToExpand);
 
-                        if((int)lNodes.size()>=N)
+                        if(lNodes.size>=N)
                             break;
                     }
 
-                    if((int)lNodes.size()>=N || (int)lNodes.size()==prevSize)
+                    if(lNodes.size>=N || lNodes.size==prevSize)
                         bFinish = true;
 
                 }
@@ -748,163 +650,145 @@ namespace ORB_SLAM3
         }
 
         // Retain the best point in each node
-        std::vector<cv::KeyPoint> vResultKeys;
+        vResultKeys.clear();
         vResultKeys.reserve(nfeatures);
-        for(auto lit=lNodes.begin(); lit!=lNodes.end(); lit++)
+        for(int n = lNodes.head; n >= 0; n = vNodes[n].next)
         {
-            std::vector<cv::KeyPoint> &vNodeKeys = lit->vKeys;
-            cv::KeyPoint* pKP = &vNodeKeys[0];
+            const ExtractorNode &node = vNodes[n];
+            const cv::KeyPoint* pKP = &vToDistributeKeys[vNodeKeys[node.begin].idx];
             float maxResponse = pKP->response;
 
-            for(std::size_t k=1;k<vNodeKeys.size();k++)
+            for(int k=node.begin+1;k<node.end;k++)
             {
-                if(vNodeKeys[k].response>maxResponse)
+                const cv::KeyPoint &kp = vToDistributeKeys[vNodeKeys[k].idx];
+                if(kp.response>maxResponse)
                 {
-                    pKP = &vNodeKeys[k];
-                    maxResponse = vNodeKeys[k].response;
+                    pKP = &kp;
+                    maxResponse = kp.response;
                 }
             }
 
             vResultKeys.push_back(*pKP);
         }
-
-        return vResultKeys;
     }
 
     void ORBextractor::ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint> >& allKeypoints)
     {
         allKeypoints.resize(nlevels);
 
+        // Levels are independent once the pyramid is built
+        if(mpThreadPool)
+            mpThreadPool->ParallelFor(0, nlevels, [this, &allKeypoints](const std::size_t level) {
+                ComputeKeyPointsLevel(level, allKeypoints[level]);
+            });
+        else
+            for (int level = 0; level < nlevels; ++level)
+                ComputeKeyPointsLevel(level, allKeypoints[level]);
+    }
+
+    void ORBextractor::ComputeKeyPointsLevel(const int level, std::vector<cv::KeyPoint>& keypoints)
+    {
         const float W = 35;
 
-        for (int level = 0; level < nlevels; ++level)
-        {
-            const int minBorderX = EDGE_THRESHOLD-3;
-            const int minBorderY = minBorderX;
-            const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
-            const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
+        const int minBorderX = EDGE_THRESHOLD-3;
+        const int minBorderY = minBorderX;
+        const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
+        const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
 
-            std::vector<cv::KeyPoint> vToDistributeKeys;
-            vToDistributeKeys.reserve(nfeatures*10);
+        const float width = (maxBorderX-minBorderX);
+        const float height = (maxBorderY-minBorderY);
 
-            const float width = (maxBorderX-minBorderX);
-            const float height = (maxBorderY-minBorderY);
+        const int nCols = width/W;
+        const int nRows = height/W;
+        const int wCell = std::ceil(width/nCols);
+        const int hCell = std::ceil(height/nRows);
 
-            const int nCols = width/W;
-            const int nRows = height/W;
-            const int wCell = std::ceil(width/nCols);
-            const int hCell = std::ceil(height/nRows);
+        LevelBuffers &buffers = mvLevelBuffers[level];
+        if((int)buffers.vCellKeys.size() < nRows)
+            buffers.vCellKeys.resize(nRows);
 
-            for(int i=0; i<nRows; i++)
-            {
-                const float iniY =minBorderY+i*hCell;
-                float maxY = iniY+hCell+6;
+        // FAST on each cell of a row, keypoints in cell order
+        const auto detectRow = [&](const int i, std::vector<cv::KeyPoint>& vRowKeys)
+        {
+            const float iniY =minBorderY+i*hCell;
+            float maxY = iniY+hCell+6;
+
+            if(iniY>=maxBorderY-3)
+                return;
+            if(maxY>maxBorderY)
+                maxY = maxBorderY;
 
-                if(iniY>=maxBorderY-3)
+            std::vector<cv::KeyPoint>& vKeysCell = buffers.vCellKeys[i];
+            for(int j=0; j<nCols; j++)
+            {
+                const float iniX =minBorderX+j*wCell;
+                float maxX = iniX+wCell+6;
+                if(iniX>=maxBorderX-6)
                     continue;
-                if(maxY>maxBorderY)
-                    maxY = maxBorderY;
+                if(maxX>maxBorderX)
+                    maxX = maxBorderX;
 
-                for(int j=0; j<nCols; j++)
-                {
-                    const float iniX =minBorderX+j*wCell;
-                    float maxX = iniX+wCell+6;
-                    if(iniX>=maxBorderX-6)
-                        continue;
-                    if(maxX>maxBorderX)
-                        maxX = maxBorderX;
+                vKeysCell.clear();
 
-                    std::vector<cv::KeyPoint> vKeysCell;
+                cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
+                     vKeysCell,iniThFAST,true);
 
+                if(vKeysCell.empty())
+                {
                     cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                         vKeysCell,iniThFAST,true);
-
-                    // if (bRight && j <= 13) {
-                    //     cv::FAST(
-                    //       mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-                    //       vKeysCell,
-                    //       10,
-                    //       true
-                    //     );
-                    // } else if (!bRight && j >= 16) {
-                    //     cv::FAST(
-                    //       mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-                    //       vKeysCell,
-                    //       10,
-                    //       true
-                    //     );
-                    // } else {
-                    //     cv::FAST(
-                    //       mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-                    //       vKeysCell,
-                    //       iniThFAST,
-                    //       true
-                    //     );
-                    // }
-
-                    if(vKeysCell.empty())
-                    {
-                        cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,minThFAST,true);
-                        // if (bRight && j <= 13) {
-                        //     cv::FAST(
-                        //       mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-                        //       vKeysCell,
-                        //       5,
-                        //       true
-                        //     );
-                        // } else if (!bRight && j >= 16) {
-                        //     cv::FAST(
-                        //       mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-                        //       vKeysCell,
-                        //       5,
-                        //       true
-                        //     );
-                        // } else {
-                        //     cv::FAST(
-                        //       mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-                        //       vKeysCell,
-                        //       minThFAST,
-                        //       true
-                        //     );
-                        // }
-                    }
-
-                    if(!vKeysCell.empty())
-                    {
-                        for(auto vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
-                        {
-                            (*vit).pt.x+=j*wCell;
-                            (*vit).pt.y+=i*hCell;
-                            vToDistributeKeys.push_back(*vit);
-                        }
-                    }
+                         vKeysCell,minThFAST,true);
+                }
 
+                for(auto vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
+                {
+                    (*vit).pt.x+=j*wCell;
+                    (*vit).pt.y+=i*hCell;
+                    vRowKeys.push_back(*vit);
                 }
             }
+        };
 
-            std::vector<cv::KeyPoint> & keypoints = allKeypoints[level];
-            keypoints.reserve(nfeatures);
+        std::vector<cv::KeyPoint>& vToDistributeKeys = buffers.vToDistributeKeys;
+        vToDistributeKeys.clear();
+        vToDistributeKeys.reserve(nfeatures*10);
+
+        if(mpThreadPool && nRows > 1)
+        {
+            // One task per row of cells, concatenated in row order so the
+            // distribution sees the same keypoint sequence as the sequential path
+            std::vector<std::vector<cv::KeyPoint> >& vRowKeys = buffers.vRowKeys;
+            if((int)vRowKeys.size() < nRows)
+                vRowKeys.resize(nRows);
+            mpThreadPool->ParallelFor(0, nRows, [&](const std::size_t i) {
+                vRowKeys[i].clear();
+                detectRow(i, vRowKeys[i]);
+            });
+            for(int i=0; i<nRows; i++)
+                vToDistributeKeys.insert(vToDistributeKeys.end(), vRowKeys[i].begin(), vRowKeys[i].end());
+        }
+        else
+        {
+            for(int i=0; i<nRows; i++)
+                detectRow(i, vToDistributeKeys);
+        }
 
-            keypoints = DistributeOctTree(vToDistributeKeys, minBorderX, maxBorderX,
-                                          minBorderY, maxBorderY,mnFeaturesPerLevel[level], level);
+        DistributeOctTree(vToDistributeKeys, minBorderX, maxBorderX,
+                          minBorderY, maxBorderY,mnFeaturesPerLevel[level], level, keypoints);
 
-            const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
+        const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
 
-            // Add border to coordinates and scale information
-            const int nkps = keypoints.size();
-            for(int i=0; i<nkps ; i++)
-            {
-                keypoints[i].pt.x+=minBorderX;
-                keypoints[i].pt.y+=minBorderY;
-                keypoints[i].octave=level;
-                keypoints[i].size = scaledPatchSize;
-            }
+        // Add border to coordinates and scale information
+        const int nkps = keypoints.size();
+        for(int i=0; i<nkps ; i++)
+        {
+            keypoints[i].pt.x+=minBorderX;
+            keypoints[i].pt.y+=minBorderY;
+            keypoints[i].octave=level;
+            keypoints[i].size = scaledPatchSize;
         }
 
         // compute orientations
-        for (int level = 0; level < nlevels; ++level)
-            computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+        computeOrientation(mvImagePyramid[level], keypoints, umax);
     }
 
     void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint> > &allKeypoints)
@@ -1086,13 +970,14 @@ namespace ORB_SLAM3
             computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
     }
 
+    // Descriptors in the first rows of `descriptors`, which only grows (every byte of a row is written)
     static void computeDescriptors(const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors,
-                                   const std::vector<cv::Point>& pattern)
+                                   const Orb::Pattern& pattern)
     {
-        descriptors = cv::Mat::zeros((int)keypoints.size(), 32, CV_8UC1);
+        if(descriptors.rows < (int)keypoints.size())
+            descriptors.create((int)keypoints.size(), 32, CV_8UC1);
 
-        for (std::size_t i = 0; i < keypoints.size(); i++)
-            computeOrbDescriptor(keypoints[i], image, &pattern[0], descriptors.ptr((int)i));
+        Orb::ComputeDescriptors(image, keypoints, pattern, descriptors);
     }
 
     int ORBextractor::operator()( cv::InputArray _image, cv::InputArray _mask, std::vector<cv::KeyPoint>& _keypoints,
@@ -1105,10 +990,17 @@ namespace ORB_SLAM3
         cv::Mat image = _image.getMat();
         assert(image.type() == CV_8UC1 );
 
+        // Without reuse, every image gets new buffers
+        if(!mbReuseBuffers)
+        {
+            mvLevelBuffers.assign(nlevels, LevelBuffers());
+            mvvKeypoints.assign(nlevels, std::vector<cv::KeyPoint>());
+        }
+
         // Pre-compute the scale pyramid
         ComputePyramid(image);
 
-        std::vector < std::vector<cv::KeyPoint> > allKeypoints;
+        std::vector < std::vector<cv::KeyPoint> >& allKeypoints = mvvKeypoints;
         ComputeKeyPointsOctTree(allKeypoints);
         //ComputeKeyPointsOld(allKeypoints);
 
@@ -1127,9 +1019,27 @@ namespace ORB_SLAM3
 
         //_keypoints.clear();
         //_keypoints.reserve(nkeypoints);
-        _keypoints = std::vector<cv::KeyPoint>(nkeypoints);
+        _keypoints.resize(nkeypoints);
+
+        // Compute the descriptors of every level
+        const auto describeLevel = [&](const std::size_t level) {
+            std::vector<cv::KeyPoint>& keypoints = allKeypoints[level];
+            if(keypoints.empty())
+                return;
+
+            // preprocess the resized image, isolated from its border as when it was blurred on a copy
+            LevelBuffers &buffers = mvLevelBuffers[level];
+            cv::GaussianBlur(mvImagePyramid[level], buffers.blurred, cv::Size(7, 7), 2, 2,
+                             cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+
+            computeDescriptors(buffers.blurred, keypoints, buffers.descriptors, pattern);
+        };
+        if(mpThreadPool)
+            mpThreadPool->ParallelFor(0, nlevels, describeLevel);
+        else
+            for (int level = 0; level < nlevels; ++level)
+                describeLevel(level);
 
-        int offset = 0;
         //Modified for speeding up stereo fisheye matching
         int monoIndex = 0, stereoIndex = nkeypoints-1;
         for (int level = 0; level < nlevels; ++level)
@@ -1140,17 +1050,7 @@ namespace ORB_SLAM3
             if(nkeypointsLevel==0)
                 continue;
 
-            // preprocess the resized image
-            cv::Mat workingMat = mvImagePyramid[level].clone();
-            cv::GaussianBlur(workingMat, workingMat, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
-
-            // Compute the descriptors
-            //Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
-            cv::Mat desc = cv::Mat(nkeypointsLevel, 32, CV_8U);
-            computeDescriptors(workingMat, keypoints, desc, pattern);
-
-            offset += nkeypointsLevel;
-
+            const cv::Mat &desc = mvLevelBuffers[level].descriptors;
 
             float scale = mvScaleFactor[level]; //getScale(level, firstLevel, scaleFactor);
             int i = 0;
@@ -1186,7 +1086,8 @@ namespace ORB_SLAM3
             float scale = mvInvScaleFactor[level];
             cv::Size sz(cvRound((float)image.cols*scale), cvRound((float)image.rows*scale));
             cv::Size wholeSize(sz.width + EDGE_THRESHOLD*2, sz.height + EDGE_THRESHOLD*2);
-            cv::Mat temp(wholeSize, image.type()), masktemp;
+            cv::Mat &temp = mvLevelBuffers[level].image;
+            temp.create(wholeSize, image.type());
             mvImagePyramid[level] = temp(cv::Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
 
             // Compute the resized image
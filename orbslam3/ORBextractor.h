@@ -20,25 +20,38 @@
 #define ORBEXTRACTOR_H
 
 // Standard
-#include <list>
+#include <utility>
 #include <vector>
 // 3rdparty
 #include <opencv2/core.hpp>
+// Local
+#include "orbslam3/ORBdescriptor.h"
 
 namespace ORB_SLAM3
 {
 
-class ExtractorNode
-{
-public:
-    ExtractorNode():bNoMore(false){}
+class ThreadPool;
 
-    void DivideNode(ExtractorNode &n1, ExtractorNode &n2, ExtractorNode &n3, ExtractorNode &n4);
+// Keypoint of the quadtree of DistributeOctTree: its position (read by every
+// split) and its index in the distributed keypoints.
+struct ExtractorKey
+{
+    cv::Point2f pt;
+    int idx;
+};
 
-    std::vector<cv::KeyPoint> vKeys;
+// Node of the quadtree of DistributeOctTree, stored in the arena of a pyramid
+// level. Its keypoints are a range of the key array of the arena, split in
+// place between the children; prev/next link the alive nodes in their order.
+struct ExtractorNode
+{
     cv::Point2i UL, UR, BL, BR;
-    std::list<ExtractorNode>::iterator lit;
+    int begin, end; // Range of keys
+    int prev, next; // Neighbours in the node list, -1 at the ends
     bool bNoMore;
+
+    int Size() const {
+        return end - begin;}
 };
 
 class ORBextractor
@@ -81,17 +94,56 @@ public:
         return mvInvLevelSigma2;
     }
 
+    // Opt-in parallel extraction: pyramid levels, rows of FAST cells and the
+    // per-level descriptors run as tasks on the pool. The output (keypoints,
+    // order and descriptors) is the same as the sequential extraction.
+    // The pool is not owned, nullptr goes back to sequential extraction.
+    void SetThreadPool(ThreadPool* pThreadPool){
+        mpThreadPool = pThreadPool;}
+
+    // Opt-in buffer reuse: the pyramid, the smoothed levels, the keypoint
+    // vectors and the descriptor rows are kept from one image to the next, so
+    // a stream of images of the same size allocates them only once. The
+    // levels of mvImagePyramid are then overwritten by the next extraction.
+    void SetBufferReuse(bool bReuse){
+        mbReuseBuffers = bReuse;}
+
+    // Opt-in quantized steering: the descriptors use the pattern rotated by
+    // the center of the angle bin of the keypoint (see Orb::Pattern), which
+    // saves the rotation of the pattern for every keypoint but moves their
+    // bits away from the exact descriptors. 0 (default) steers exactly.
+    void SetAngleBins(int nBins);
+
     std::vector<cv::Mat> mvImagePyramid;
 
 protected:
 
+    // Buffers of a pyramid level
+    struct LevelBuffers
+    {
+        cv::Mat image;       // Level with its border, mvImagePyramid[level] is its interior
+        cv::Mat blurred;     // Smoothed level, for the descriptors
+        cv::Mat descriptors; // At least one row per keypoint of the level
+        std::vector<cv::KeyPoint> vToDistributeKeys;
+        std::vector<std::vector<cv::KeyPoint> > vRowKeys;  // FAST keypoints of every row of cells
+        std::vector<std::vector<cv::KeyPoint> > vCellKeys; // FAST keypoints of the current cell of every row
+        // Quadtree arena of DistributeOctTree
+        std::vector<ExtractorNode> vNodes;
+        std::vector<ExtractorKey> vNodeKeys;  // One range per node
+        std::vector<ExtractorKey> vSplitKeys; // Scratch of the node splits
+        std::vector<int> vIniCounts;  // Keypoints per initial node, then their offsets
+        std::vector<std::pair<int,int> > vSizeAndNode, vPrevSizeAndNode; // Nodes to expand, by size
+    };
+
     void ComputePyramid(cv::Mat image);
     void ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);
-    std::vector<cv::KeyPoint> DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
-                                           const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
+    void ComputeKeyPointsLevel(const int level, std::vector<cv::KeyPoint>& keypoints);
+    void DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
+                           const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level,
+                           std::vector<cv::KeyPoint>& vResultKeys);
 
     void ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);
-    std::vector<cv::Point> pattern;
+    Orb::Pattern pattern;
 
     int nfeatures;
     double scaleFactor;
@@ -107,6 +159,12 @@ protected:
     std::vector<float> mvInvScaleFactor;
     std::vector<float> mvLevelSigma2;
     std::vector<float> mvInvLevelSigma2;
+
+    ThreadPool* mpThreadPool;
+
+    bool mbReuseBuffers;
+    std::vector<LevelBuffers> mvLevelBuffers;
+    std::vector<std::vector<cv::KeyPoint> > mvvKeypoints; // Keypoints of every level
 };
 
 } //namespace ORB_SLAM
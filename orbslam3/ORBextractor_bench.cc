@@ -0,0 +1,175 @@
+// Microbenchmark of the ORB extraction of a stream of same-size images, with
+// new buffers for every image (the historical behavior) and with the buffers
+// of the extractor reused. Counts the heap allocations of the steady state
+// (every malloc-family call, including the ones of OpenCV) to show which ones
+// the reuse removes.
+//
+// Usage: ORBextractor_bench <image> [n_features] [n_frames]
+
+// Standard
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+// 3rdparty
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+// Local
+#include "orbslam3/ORBextractor.h"
+
+using namespace ORB_SLAM3;
+
+// ─────────────────────────────────────────────────────────────────────────── //
+
+// Allocation counter: the malloc family is interposed (glibc), which catches
+// operator new as well as cv::fastMalloc.
+
+namespace {
+
+std::atomic<bool> g_counting{false};
+std::atomic<long> g_allocations{0};
+std::atomic<long> g_bytes{0};
+
+void CountAllocation(const std::size_t size) {
+  if (g_counting.load(std::memory_order_relaxed)) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(static_cast<long>(size), std::memory_order_relaxed);
+  }
+}
+
+} // namespace
+
+#if defined(__GLIBC__)
+extern "C" {
+
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+void* malloc(std::size_t size) {
+  CountAllocation(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size) {
+  CountAllocation(n * size);
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, std::size_t size) {
+  CountAllocation(size);
+  return __libc_realloc(ptr, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size) {
+  CountAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) {
+  CountAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, std::size_t alignment, std::size_t size) {
+  CountAllocation(size);
+  void* data = __libc_memalign(alignment, size);
+  if (data == nullptr) {
+    return ENOMEM;
+  }
+  *ptr = data;
+  return 0;
+}
+
+} // extern "C"
+#endif
+
+// ─────────────────────────────────────────────────────────────────────────── //
+
+namespace {
+
+struct Result {
+  double ms_per_frame     = 0.0;
+  double allocs_per_frame = 0.0;
+  double kib_per_frame    = 0.0;
+  std::vector<cv::KeyPoint> keypoints;
+  cv::Mat descriptors;
+};
+
+Result Run(const cv::Mat& image, const int n_features, const int n_frames, const bool reuse) {
+  ORBextractor extractor(n_features, 1.2f, 8, 20, 7);
+  extractor.SetBufferReuse(reuse);
+
+  // The outputs are reused too, as a steady stream would do.
+  Result result;
+  std::vector<int> lapping = {0, 0};
+  for (int warmup = 0; warmup < 3; ++warmup) {
+    extractor(image, cv::Mat(), result.keypoints, result.descriptors, lapping);
+  }
+
+  g_allocations = 0;
+  g_bytes       = 0;
+  g_counting    = true;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < n_frames; ++frame) {
+    extractor(image, cv::Mat(), result.keypoints, result.descriptors, lapping);
+  }
+  const auto stop = std::chrono::steady_clock::now();
+  g_counting = false;
+
+  result.ms_per_frame     = std::chrono::duration<double, std::milli>(stop - start).count() / n_frames;
+  result.allocs_per_frame = static_cast<double>(g_allocations.load()) / n_frames;
+  result.kib_per_frame    = static_cast<double>(g_bytes.load()) / 1024.0 / n_frames;
+  return result;
+}
+
+void Print(const char* name, const Result& result) {
+  std::printf(
+    "%-8s %8.3f ms/frame %10.1f allocations/frame %10.1f KiB/frame (%zu keypoints)\n",
+    name,
+    result.ms_per_frame,
+    result.allocs_per_frame,
+    result.kib_per_frame,
+    result.keypoints.size()
+  );
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: %s <image> [n_features] [n_frames]\n", argv[0]);
+    return 1;
+  }
+
+  const cv::Mat image = cv::imread(argv[1], cv::IMREAD_GRAYSCALE);
+  if (image.empty()) {
+    std::fprintf(stderr, "Failed to load image %s\n", argv[1]);
+    return 1;
+  }
+  const int n_features = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const int n_frames   = argc > 3 ? std::atoi(argv[3]) : 100;
+  if (n_features <= 0 || n_frames <= 0) {
+    std::fprintf(stderr, "Usage: %s <image> [n_features] [n_frames]\n", argv[0]);
+    return 1;
+  }
+#if !defined(__GLIBC__)
+  std::printf("Allocations are only counted with glibc\n");
+#endif
+
+  const Result fresh  = Run(image, n_features, n_frames, false);
+  const Result reused = Run(image, n_features, n_frames, true);
+  Print("fresh", fresh);
+  Print("reused", reused);
+
+  // Both modes extract the same features.
+  const bool same = fresh.keypoints.size() == reused.keypoints.size()
+                 && fresh.descriptors.size() == reused.descriptors.size()
+                 && (fresh.descriptors.empty() || cv::norm(fresh.descriptors, reused.descriptors, cv::NORM_L1) == 0.0);
+  std::printf("outputs %s\n", same ? "identical" : "DIFFER");
+  return same ? 0 : 1;
+}
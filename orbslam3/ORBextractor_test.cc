@@ -0,0 +1,258 @@
+// Standard
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/ORBextractor.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Bounds of the level given to DistributeOctTree, two initial nodes wide. The
+// keypoints are relative to (kMinX, kMinY), as the FAST keypoints of the
+// extractor.
+constexpr int kMinX = 16, kMaxX = 16 + 960, kMinY = 16, kMaxY = 16 + 448;
+
+// Exposes the quadtree of the extractor.
+class Extractor : public ORBextractor {
+public:
+  Extractor() : ORBextractor(1000, 1.2f, 1, 20, 7) {}
+
+  std::vector<cv::KeyPoint> Distribute(const std::vector<cv::KeyPoint>& keypoints, const int N) {
+    std::vector<cv::KeyPoint> result;
+    DistributeOctTree(keypoints, kMinX, kMaxX, kMinY, kMaxY, N, 0, result);
+    return result;
+  }
+};
+
+// The original quadtree of the extractor: a std::list of nodes, each one
+// holding a copy of its keypoints.
+struct ListNode {
+  std::vector<cv::KeyPoint> vKeys;
+  cv::Point2i UL, UR, BL, BR;
+  std::list<ListNode>::iterator lit;
+  bool bNoMore = false;
+
+  void DivideNode(ListNode& n1, ListNode& n2, ListNode& n3, ListNode& n4) {
+    const int halfX = std::ceil(static_cast<float>(UR.x - UL.x) / 2);
+    const int halfY = std::ceil(static_cast<float>(BR.y - UL.y) / 2);
+
+    n1.UL = UL;
+    n1.UR = cv::Point2i(UL.x + halfX, UL.y);
+    n1.BL = cv::Point2i(UL.x, UL.y + halfY);
+    n1.BR = cv::Point2i(UL.x + halfX, UL.y + halfY);
+
+    n2.UL = n1.UR;
+    n2.UR = UR;
+    n2.BL = n1.BR;
+    n2.BR = cv::Point2i(UR.x, UL.y + halfY);
+
+    n3.UL = n1.BL;
+    n3.UR = n1.BR;
+    n3.BL = BL;
+    n3.BR = cv::Point2i(n1.BR.x, BL.y);
+
+    n4.UL = n3.UR;
+    n4.UR = n2.BR;
+    n4.BL = n3.BR;
+    n4.BR = BR;
+
+    for (const cv::KeyPoint& kp : vKeys) {
+      if (kp.pt.x < n1.UR.x) {
+        if (kp.pt.y < n1.BR.y)
+          n1.vKeys.push_back(kp);
+        else
+          n3.vKeys.push_back(kp);
+      } else if (kp.pt.y < n1.BR.y) {
+        n2.vKeys.push_back(kp);
+      } else {
+        n4.vKeys.push_back(kp);
+      }
+    }
+
+    for (ListNode* n : {&n1, &n2, &n3, &n4})
+      n->bNoMore = n->vKeys.size() == 1;
+  }
+};
+
+bool CompareNodes(const std::pair<int, ListNode*>& e1, const std::pair<int, ListNode*>& e2) {
+  if (e1.first != e2.first)
+    return e1.first < e2.first;
+  return e1.second->UL.x < e2.second->UL.x;
+}
+
+std::vector<cv::KeyPoint> ListDistribute(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int N) {
+  const int minX = kMinX, maxX = kMaxX, minY = kMinY, maxY = kMaxY;
+  const int nIni = std::round(static_cast<float>(maxX - minX) / (maxY - minY));
+  const float hX = static_cast<float>(maxX - minX) / nIni;
+
+  std::list<ListNode> lNodes;
+  std::vector<ListNode*> vpIniNodes(nIni);
+  for (int i = 0; i < nIni; i++) {
+    ListNode ni;
+    ni.UL = cv::Point2i(hX * static_cast<float>(i), 0);
+    ni.UR = cv::Point2i(hX * static_cast<float>(i + 1), 0);
+    ni.BL = cv::Point2i(ni.UL.x, maxY - minY);
+    ni.BR = cv::Point2i(ni.UR.x, maxY - minY);
+    lNodes.push_back(ni);
+    vpIniNodes[i] = &lNodes.back();
+  }
+  for (const cv::KeyPoint& kp : vToDistributeKeys)
+    vpIniNodes[kp.pt.x / hX]->vKeys.push_back(kp);
+
+  for (auto lit = lNodes.begin(); lit != lNodes.end();) {
+    if (lit->vKeys.size() == 1) {
+      lit->bNoMore = true;
+      lit++;
+    } else if (lit->vKeys.empty()) {
+      lit = lNodes.erase(lit);
+    } else {
+      lit++;
+    }
+  }
+
+  // Children with keypoints go to the front, the ones to expand are listed.
+  std::vector<std::pair<int, ListNode*>> vSizeAndPointerToNode;
+  const auto addChildren = [&](ListNode& n1, ListNode& n2, ListNode& n3, ListNode& n4, int& nToExpand) {
+    for (ListNode* n : {&n1, &n2, &n3, &n4}) {
+      if (n->vKeys.empty())
+        continue;
+      lNodes.push_front(*n);
+      if (n->vKeys.size() > 1) {
+        nToExpand++;
+        vSizeAndPointerToNode.push_back(std::make_pair(n->vKeys.size(), &lNodes.front()));
+        lNodes.front().lit = lNodes.begin();
+      }
+    }
+  };
+
+  bool bFinish = false;
+  while (!bFinish) {
+    int prevSize  = lNodes.size();
+    int nToExpand = 0;
+    vSizeAndPointerToNode.clear();
+
+    for (auto lit = lNodes.begin(); lit != lNodes.end();) {
+      if (lit->bNoMore) {
+        lit++;
+        continue;
+      }
+      ListNode n1, n2, n3, n4;
+      lit->DivideNode(n1, n2, n3, n4);
+      addChildren(n1, n2, n3, n4, nToExpand);
+      lit = lNodes.erase(lit);
+    }
+
+    if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize) {
+      bFinish = true;
+    } else if (((int)lNodes.size() + nToExpand * 3) > N) {
+      while (!bFinish) {
+        prevSize = lNodes.size();
+
+        std::vector<std::pair<int, ListNode*>> vPrevSizeAndPointerToNode = vSizeAndPointerToNode;
+        vSizeAndPointerToNode.clear();
+
+        std::sort(vPrevSizeAndPointerToNode.begin(), vPrevSizeAndPointerToNode.end(), CompareNodes);
+        for (int j = vPrevSizeAndPointerToNode.size() - 1; j >= 0; j--) {
+          ListNode n1, n2, n3, n4;
+          vPrevSizeAndPointerToNode[j].second->DivideNode(n1, n2, n3, n4);
+          addChildren(n1, n2, n3, n4, nToExpand);
+          lNodes.erase(vPrevSizeAndPointerToNode[j].second->lit);
+          if ((int)lNodes.size() >= N)
+            break;
+        }
+
+        if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize)
+          bFinish = true;
+      }
+    }
+  }
+
+  // The first keypoint of the best response in each node.
+  std::vector<cv::KeyPoint> vResultKeys;
+  for (ListNode& node : lNodes) {
+    const cv::KeyPoint* pKP = &node.vKeys[0];
+    for (std::size_t k = 1; k < node.vKeys.size(); k++) {
+      if (node.vKeys[k].response > pKP->response)
+        pKP = &node.vKeys[k];
+    }
+    vResultKeys.push_back(*pKP);
+  }
+  return vResultKeys;
+}
+
+// Keypoints in the level, the class id tells them apart.
+std::vector<cv::KeyPoint> RandomKeypoints(std::mt19937& rng, const std::size_t count, const int responses) {
+  std::uniform_real_distribution<float> x(0.f, kMaxX - kMinX - 1), y(0.f, kMaxY - kMinY - 1);
+  std::uniform_int_distribution<int> response(0, responses - 1);
+  std::vector<cv::KeyPoint> keypoints;
+  for (std::size_t i = 0; i < count; ++i) {
+    keypoints.emplace_back(x(rng), y(rng), 7.f, -1.f, static_cast<float>(response(rng)), 0, static_cast<int>(i));
+  }
+  return keypoints;
+}
+
+void ExpectSame(const std::vector<cv::KeyPoint>& result, const std::vector<cv::KeyPoint>& expected) {
+  ASSERT_EQ(result.size(), expected.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(result[i].class_id, expected[i].class_id) << "keypoint " << i;
+    EXPECT_EQ(result[i].pt, expected[i].pt) << "keypoint " << i;
+    EXPECT_EQ(result[i].response, expected[i].response) << "keypoint " << i;
+  }
+}
+
+} // namespace
+
+TEST(ORBextractor, DistributeMatchesList) {
+  std::mt19937 rng(5);
+  Extractor extractor;
+  for (const std::size_t count : {1, 2, 50, 800, 5000}) {
+    // Distinct responses, then a few values and a single one for the ties.
+    for (const int responses : {1 << 20, 4, 1}) {
+      const std::vector<cv::KeyPoint> keypoints = RandomKeypoints(rng, count, responses);
+      for (const int N : {1, 10, 300, 2000}) {
+        SCOPED_TRACE(testing::Message() << count << " keypoints, " << responses << " responses, N " << N);
+        ExpectSame(extractor.Distribute(keypoints, N), ListDistribute(keypoints, N));
+      }
+    }
+  }
+}
+
+TEST(ORBextractor, DistributeMatchesListOnUnsplittableNodes) {
+  std::mt19937 rng(9);
+  Extractor extractor;
+  // Keypoints stacked on a few positions, and on the borders of the nodes:
+  // the nodes of a stack cannot be split, and hold equal responses.
+  std::vector<cv::KeyPoint> keypoints = RandomKeypoints(rng, 200, 3);
+  const cv::Point2f stacks[] = {{0.f, 0.f}, {100.f, 50.f}, {480.f, 224.f}, {479.5f, 223.5f}, {959.f, 447.f}};
+  for (const cv::Point2f& pt : stacks) {
+    for (int i = 0; i < 6; ++i) {
+      const int id = static_cast<int>(keypoints.size());
+      keypoints.emplace_back(pt, 7.f, -1.f, static_cast<float>(i % 2), 0, id);
+    }
+  }
+  std::shuffle(keypoints.begin(), keypoints.end(), rng);
+
+  for (const int N : {1, 5, 50, 150, 1000}) {
+    SCOPED_TRACE(testing::Message() << "N " << N);
+    const std::vector<cv::KeyPoint> result = extractor.Distribute(keypoints, N);
+    ExpectSame(result, ListDistribute(keypoints, N));
+  }
+
+  // Only stacks: every node ends with a single position.
+  std::vector<cv::KeyPoint> stacked;
+  for (const cv::KeyPoint& kp : keypoints) {
+    if (kp.class_id >= 200)
+      stacked.push_back(kp);
+  }
+  for (const int N : {1, 5, 30}) {
+    SCOPED_TRACE(testing::Message() << "stacks, N " << N);
+    ExpectSame(extractor.Distribute(stacked, N), ListDistribute(stacked, N));
+  }
+}
@@ -21,6 +21,7 @@
 // Local
 #include "orbslam3/CameraModels/GeometricCamera.h"
 #include "orbslam3/Frame.h"
+#include "orbslam3/HammingDistance.h"
 #include "orbslam3/KeyFrame.h"
 #include "orbslam3/MapPoint.h"
 #include "orbslam3/ORBmatcher.h"
@@ -42,6 +43,11 @@ namespace ORB_SLAM3
 
         const bool bFactor = th!=1.0;
 
+        std::vector<std::size_t> vCandidates;
+        vCandidates.reserve(F.N);
+
+        std::vector<std::size_t> vIndices;
+
         for(std::size_t iMP=0; iMP<vpMapPoints.size(); iMP++)
         {
             MapPoint* pMP = vpMapPoints[iMP];
@@ -64,19 +70,13 @@ namespace ORB_SLAM3
                 if(bFactor)
                     r*=th;
 
-                const std::vector<std::size_t> vIndices =
-                        F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel);
+                F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r*F.mvScaleFactors[nPredictedLevel],vIndices,nPredictedLevel-1,nPredictedLevel);
 
                 if(!vIndices.empty()){
                     const cv::Mat MPdescriptor = pMP->GetDescriptor();
 
-                    int bestDist=256;
-                    int bestLevel= -1;
-                    int bestDist2=256;
-                    int bestLevel2 = -1;
-                    int bestIdx =-1 ;
-
-                    // Get best and second matches with near keypoints
+                    // Keep the free near keypoints
+                    vCandidates.clear();
                     for(auto vit=vIndices.cbegin(), vend=vIndices.cend(); vit!=vend; vit++)
                     {
                         const std::size_t idx = *vit;
@@ -92,29 +92,25 @@ namespace ORB_SLAM3
                                 continue;
                         }
 
-                        const cv::Mat &d = F.mDescriptors.row(idx);
-
-                        const int dist = DescriptorDistance(MPdescriptor,d);
-
-                        if(dist<bestDist)
-                        {
-                            bestDist2=bestDist;
-                            bestDist=dist;
-                            bestLevel2 = bestLevel;
-                            bestLevel = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                                                        : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                                                          : F.mvKeysRight[idx - F.Nleft].octave;
-                            bestIdx=idx;
-                        }
-                        else if(dist<bestDist2)
-                        {
-                            bestLevel2 = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                                                         : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                                                           : F.mvKeysRight[idx - F.Nleft].octave;
-                            bestDist2=dist;
-                        }
+                        vCandidates.push_back(idx);
                     }
 
+                    // Get best and second matches with near keypoints
+                    const Hamming::BestMatches matches = SearchBestDescriptors(MPdescriptor,F.mDescriptors,vCandidates);
+
+                    const int bestDist = matches.best_distance;
+                    const int bestDist2 = matches.second_distance;
+                    const int bestIdx = matches.best_index;
+                    const auto octave = [&F](const int idx) {
+                        if(idx < 0)
+                            return -1;
+                        return (F.Nleft == -1) ? F.mvKeysUn[idx].octave
+                                               : (idx < F.Nleft) ? F.mvKeys[idx].octave
+                                                                 : F.mvKeysRight[idx - F.Nleft].octave;
+                    };
+                    const int bestLevel = octave(matches.best_index);
+                    const int bestLevel2 = octave(matches.second_index);
+
                     // Apply ratio to second match (only if best and second are in the same scale level)
                     if(bestDist<=TH_HIGH)
                     {
@@ -142,21 +138,15 @@ namespace ORB_SLAM3
                 if(nPredictedLevel != -1){
                     float r = RadiusByViewingCos(pMP->mTrackViewCosR);
 
-                    const std::vector<std::size_t> vIndices =
-                            F.GetFeaturesInArea(pMP->mTrackProjXR,pMP->mTrackProjYR,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel,true);
+                    F.GetFeaturesInArea(pMP->mTrackProjXR,pMP->mTrackProjYR,r*F.mvScaleFactors[nPredictedLevel],vIndices,nPredictedLevel-1,nPredictedLevel,true);
 
                     if(vIndices.empty())
                         continue;
 
                     const cv::Mat MPdescriptor = pMP->GetDescriptor();
 
-                    int bestDist=256;
-                    int bestLevel= -1;
-                    int bestDist2=256;
-                    int bestLevel2 = -1;
-                    int bestIdx =-1 ;
-
-                    // Get best and second matches with near keypoints
+                    // Keep the free near keypoints (descriptor rows of the right image follow the left ones)
+                    vCandidates.clear();
                     for(auto vit=vIndices.cbegin(), vend=vIndices.cend(); vit!=vend; vit++)
                     {
                         const std::size_t idx = *vit;
@@ -165,25 +155,17 @@ namespace ORB_SLAM3
                             if(F.mvpMapPoints[idx + F.Nleft]->Observations()>0)
                                 continue;
 
+                        vCandidates.push_back(idx + F.Nleft);
+                    }
 
-                        const cv::Mat &d = F.mDescriptors.row(idx + F.Nleft);
+                    // Get best and second matches with near keypoints
+                    const Hamming::BestMatches matches = SearchBestDescriptors(MPdescriptor,F.mDescriptors,vCandidates);
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
-
-                        if(dist<bestDist)
-                        {
-                            bestDist2=bestDist;
-                            bestDist=dist;
-                            bestLevel2 = bestLevel;
-                            bestLevel = F.mvKeysRight[idx].octave;
-                            bestIdx=idx;
-                        }
-                        else if(dist<bestDist2)
-                        {
-                            bestLevel2 = F.mvKeysRight[idx].octave;
-                            bestDist2=dist;
-                        }
-                    }
+                    const int bestDist = matches.best_distance;
+                    const int bestDist2 = matches.second_distance;
+                    const int bestIdx = matches.best_index - F.Nleft;
+                    const int bestLevel = (matches.best_index < 0) ? -1 : F.mvKeysRight[bestIdx].octave;
+                    const int bestLevel2 = (matches.second_index < 0) ? -1 : F.mvKeysRight[matches.second_index - F.Nleft].octave;
 
                     // Apply ratio to second match (only if best and second are in the same scale level)
                     if(bestDist<=TH_HIGH)
@@ -231,6 +213,8 @@ namespace ORB_SLAM3
             rotHist[i].reserve(500);
         const float factor = 1.0f/HISTO_LENGTH;
 
+        std::vector<std::size_t> vCandidates;
+
         // We perform the matching over ORB that belong to the same vocabulary node (at a certain level)
         auto KFit = vFeatVecKF.begin();
         auto Fit = F.mFeatVec.begin();
@@ -266,30 +250,27 @@ namespace ORB_SLAM3
                     int bestIdxFR =-1 ;
                     int bestDist2R=256;
 
-                    for(std::size_t iF=0; iF<vIndicesF.size(); iF++)
-                    {
-                        if(F.Nleft == -1){
+                    if(F.Nleft == -1){
+                        vCandidates.clear();
+                        for(std::size_t iF=0; iF<vIndicesF.size(); iF++)
+                        {
                             const unsigned int realIdxF = vIndicesF[iF];
 
                             if(vpMapPointMatches[realIdxF])
                                 continue;
 
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                            const int dist =  DescriptorDistance(dKF,dF);
-
-                            if(dist<bestDist1)
-                            {
-                                bestDist2=bestDist1;
-                                bestDist1=dist;
-                                bestIdxF=realIdxF;
-                            }
-                            else if(dist<bestDist2)
-                            {
-                                bestDist2=dist;
-                            }
+                            vCandidates.push_back(realIdxF);
                         }
-                        else{
+
+                        const Hamming::BestMatches matches = SearchBestDescriptors(dKF,F.mDescriptors,vCandidates);
+                        bestDist1 = matches.best_distance;
+                        bestDist2 = matches.second_distance;
+                        bestIdxF = matches.best_index;
+                    }
+                    else
+                    {
+                        for(std::size_t iF=0; iF<vIndicesF.size(); iF++)
+                        {
                             const unsigned int realIdxF = vIndicesF[iF];
 
                             if(vpMapPointMatches[realIdxF])
@@ -439,6 +420,8 @@ namespace ORB_SLAM3
         int nmatches=0;
 
         // For each Candidate MapPoint Project and Match
+        std::vector<std::size_t> vIndices;
+
         for(int iMP=0, iendMP=vpPoints.size(); iMP<iendMP; iMP++)
         {
             MapPoint* pMP = vpPoints[iMP];
@@ -484,7 +467,7 @@ namespace ORB_SLAM3
             // Search in a radius
             const float radius = th*pKF->mvScaleFactors[nPredictedLevel];
 
-            const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(uv(0),uv(1),radius);
+            pKF->GetFeaturesInArea(uv(0),uv(1),radius,vIndices);
 
             if(vIndices.empty())
                 continue;
@@ -546,6 +529,8 @@ namespace ORB_SLAM3
         int nmatches=0;
 
         // For each Candidate MapPoint Project and Match
+        std::vector<std::size_t> vIndices;
+
         for(int iMP=0, iendMP=vpPoints.size(); iMP<iendMP; iMP++)
         {
             MapPoint* pMP = vpPoints[iMP];
@@ -597,7 +582,7 @@ namespace ORB_SLAM3
             // Search in a radius
             const float radius = th*pKF->mvScaleFactors[nPredictedLevel];
 
-            const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(u,v,radius);
+            pKF->GetFeaturesInArea(u,v,radius,vIndices);
 
             if(vIndices.empty())
                 continue;
@@ -654,6 +639,8 @@ namespace ORB_SLAM3
         std::vector<int> vMatchedDistance(F2.mvKeysUn.size(),INT_MAX);
         std::vector<int> vnMatches21(F2.mvKeysUn.size(),-1);
 
+        std::vector<std::size_t> vIndices2;
+
         for(std::size_t i1=0, iend1=F1.mvKeysUn.size(); i1<iend1; i1++)
         {
             cv::KeyPoint kp1 = F1.mvKeysUn[i1];
@@ -661,7 +648,7 @@ namespace ORB_SLAM3
             if(level1>0)
                 continue;
 
-            std::vector<std::size_t> vIndices2 = F2.GetFeaturesInArea(vbPrevMatched[i1].x,vbPrevMatched[i1].y, windowSize,level1,level1);
+            F2.GetFeaturesInArea(vbPrevMatched[i1].x,vbPrevMatched[i1].y, windowSize,vIndices2,level1,level1);
 
             if(vIndices2.empty())
                 continue;
@@ -1170,6 +1157,8 @@ namespace ORB_SLAM3
 
         // For debbuging
         int count_notMP = 0, count_bad=0, count_isinKF = 0, count_negdepth = 0, count_notinim = 0, count_dist = 0, count_normal=0, count_notidx = 0, count_thcheck = 0;
+        std::vector<std::size_t> vIndices;
+
         for(int i=0; i<nMPs; i++)
         {
             MapPoint* pMP = vpMapPoints[i];
@@ -1239,7 +1228,7 @@ namespace ORB_SLAM3
             // Search in a radius
             const float radius = th*pKF->mvScaleFactors[nPredictedLevel];
 
-            const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(uv(0),uv(1),radius,bRight);
+            pKF->GetFeaturesInArea(uv(0),uv(1),radius,vIndices,bRight);
 
             if(vIndices.empty())
             {
@@ -1353,6 +1342,8 @@ namespace ORB_SLAM3
         const int nPoints = vpPoints.size();
 
         // For each candidate MapPoint project and match
+        std::vector<std::size_t> vIndices;
+
         for(int iMP=0; iMP<nPoints; iMP++)
         {
             MapPoint* pMP = vpPoints[iMP];
@@ -1399,7 +1390,7 @@ namespace ORB_SLAM3
             // Search in a radius
             const float radius = th*pKF->mvScaleFactors[nPredictedLevel];
 
-            const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(uv(0),uv(1),radius);
+            pKF->GetFeaturesInArea(uv(0),uv(1),radius,vIndices);
 
             if(vIndices.empty())
                 continue;
@@ -1489,6 +1480,8 @@ namespace ORB_SLAM3
         std::vector<int> vnMatch2(N2,-1);
 
         // Transform from KF1 to KF2 and search
+        std::vector<std::size_t> vIndices;
+
         for(int i1=0; i1<N1; i1++)
         {
             MapPoint* pMP = vpMapPoints1[i1];
@@ -1532,7 +1525,7 @@ namespace ORB_SLAM3
             // Search in a radius
             const float radius = th*pKF2->mvScaleFactors[nPredictedLevel];
 
-            const std::vector<std::size_t> vIndices = pKF2->GetFeaturesInArea(u,v,radius);
+            pKF2->GetFeaturesInArea(u,v,radius,vIndices);
 
             if(vIndices.empty())
                 continue;
@@ -1612,7 +1605,7 @@ namespace ORB_SLAM3
             // Search in a radius of 2.5*sigma(ScaleLevel)
             const float radius = th*pKF1->mvScaleFactors[nPredictedLevel];
 
-            const std::vector<std::size_t> vIndices = pKF1->GetFeaturesInArea(u,v,radius);
+            pKF1->GetFeaturesInArea(u,v,radius,vIndices);
 
             if(vIndices.empty())
                 continue;
@@ -1688,6 +1681,8 @@ namespace ORB_SLAM3
         const bool bForward = tlc(2)>CurrentFrame.mb && !bMono;
         const bool bBackward = -tlc(2)>CurrentFrame.mb && !bMono;
 
+        std::vector<std::size_t> vIndices2;
+
         for(int i=0; i<LastFrame.N; i++)
         {
             MapPoint* pMP = LastFrame.mvpMapPoints[i];
@@ -1719,14 +1714,12 @@ namespace ORB_SLAM3
                     // Search in a window. Size depends on scale
                     float radius = th*CurrentFrame.mvScaleFactors[nLastOctave];
 
-                    std::vector<std::size_t> vIndices2;
-
                     if(bForward)
-                        vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, nLastOctave);
+                        CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, vIndices2, nLastOctave);
                     else if(bBackward)
-                        vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, 0, nLastOctave);
+                        CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, vIndices2, 0, nLastOctave);
                     else
-                        vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, nLastOctave-1, nLastOctave+1);
+                        CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, vIndices2, nLastOctave-1, nLastOctave+1);
 
                     if(vIndices2.empty())
                         continue;
@@ -1797,14 +1790,12 @@ namespace ORB_SLAM3
                         // Search in a window. Size depends on scale
                         float radius = th*CurrentFrame.mvScaleFactors[nLastOctave];
 
-                        std::vector<std::size_t> vIndices2;
-
                         if(bForward)
-                            vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, nLastOctave, -1,true);
+                            CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, vIndices2, nLastOctave, -1,true);
                         else if(bBackward)
-                            vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, 0, nLastOctave, true);
+                            CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, vIndices2, 0, nLastOctave, true);
                         else
-                            vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, nLastOctave-1, nLastOctave+1, true);
+                            CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, vIndices2, nLastOctave-1, nLastOctave+1, true);
 
                         const cv::Mat dMP = pMP->GetDescriptor();
 
@@ -1897,6 +1888,8 @@ namespace ORB_SLAM3
 
         const std::vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
 
+        std::vector<std::size_t> vIndices2;
+
         for(std::size_t i=0, iend=vpMPs.size(); i<iend; i++)
         {
             MapPoint* pMP = vpMPs[i];
@@ -1932,7 +1925,7 @@ namespace ORB_SLAM3
                     // Search in a window
                     const float radius = th*CurrentFrame.mvScaleFactors[nPredictedLevel];
 
-                    const std::vector<std::size_t> vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, nPredictedLevel-1, nPredictedLevel+1);
+                    CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, vIndices2, nPredictedLevel-1, nPredictedLevel+1);
 
                     if(vIndices2.empty())
                         continue;
@@ -2053,20 +2046,17 @@ namespace ORB_SLAM3
 // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
     int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
     {
-        const int *pa = a.ptr<int32_t>();
-        const int *pb = b.ptr<int32_t>();
-
-        int dist=0;
+        return Hamming::Distance(a.ptr<uchar>(), b.ptr<uchar>());
+    }
 
-        for(int i=0; i<8; i++, pa++, pb++)
-        {
-            unsigned  int v = *pa ^ *pb;
-            v = v - ((v >> 1) & 0x55555555);
-            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-            dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-        }
+    Hamming::BestMatches ORBmatcher::SearchBestDescriptors(const cv::Mat &query, const cv::Mat &candidates)
+    {
+        return Hamming::SearchBest(query.ptr<uchar>(), candidates.ptr<uchar>(), candidates.step[0], nullptr, candidates.rows);
+    }
 
-        return dist;
+    Hamming::BestMatches ORBmatcher::SearchBestDescriptors(const cv::Mat &query, const cv::Mat &candidates, const std::vector<std::size_t> &vIndices)
+    {
+        return Hamming::SearchBest(query.ptr<uchar>(), candidates.ptr<uchar>(), candidates.step[0], vIndices.data(), vIndices.size());
     }
 
 } //namespace ORB_SLAM
@@ -27,6 +27,8 @@
 #include <Eigen/Core>
 #include <opencv2/core.hpp>
 #include <orbslam3/external/Sophus/sophus/sim3.hpp>
+// Local
+#include "orbslam3/HammingDistance.h"
 
 namespace ORB_SLAM3
 {
@@ -43,6 +45,12 @@ namespace ORB_SLAM3
         // Computes the Hamming distance between two ORB descriptors
         static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
 
+        // Best and second best candidates (rows of a descriptor matrix) for a query descriptor, scored in one
+        // batched call with the SIMD kernel of the CPU. Ties keep the first candidate, as in the matcher loops.
+        static Hamming::BestMatches SearchBestDescriptors(const cv::Mat &query, const cv::Mat &candidates);
+        // Same, restricted to the given rows. Returned indices are row numbers.
+        static Hamming::BestMatches SearchBestDescriptors(const cv::Mat &query, const cv::Mat &candidates, const std::vector<std::size_t> &vIndices);
+
         // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
         // Used to track the local map (Tracking)
         int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th=3, const bool bFarPoints = false, const float thFarPoints = 50.0f);
@@ -0,0 +1,121 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+// Standard
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// Fixed-size allocator handing out the storage of objects of type T, used as
+// the class-specific allocator of MapPoint and KeyFrame.
+//
+// The storage is allocated in chunks of kChunkSize slots: objects created one
+// after the other (e.g. the MapPoints triangulated for a KeyFrame) end up next
+// to each other in memory, and the slots of freed objects are reused before
+// a new chunk is allocated. Chunks are only released with the pool.
+//
+// Thread-safe.
+template <typename T, std::size_t kChunkSize = 256>
+class ObjectPool {
+public:
+  struct Stats {
+    std::size_t live        = 0; // Objects currently allocated
+    std::size_t capacity    = 0; // Slots in all the chunks
+    std::size_t allocated   = 0; // Allocations since the pool was created
+    std::size_t deallocated = 0; // Deallocations since the pool was created
+  };
+
+  ObjectPool() = default;
+
+  ObjectPool(const ObjectPool&)            = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  // Storage for one object, to construct in place.
+  void* Allocate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_ == nullptr) {
+      Grow();
+    }
+    Slot* slot = free_;
+    free_      = slot->next;
+    ++stats_.allocated;
+    ++stats_.live;
+    return slot->storage;
+  }
+
+  // Give back the storage of a destroyed object.
+  void Deallocate(void* object) {
+    if (object == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    slot->next = free_;
+    free_      = slot;
+    ++stats_.deallocated;
+    --stats_.live;
+  }
+
+  Stats GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  // Pool shared by all the objects of type T. It is never destroyed, as
+  // objects may still be deleted during the static destruction.
+  static ObjectPool& Instance() {
+    static ObjectPool* pool = new ObjectPool();
+    return *pool;
+  }
+
+private:
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  // Allocate a chunk and chain its slots in the free list, in address order.
+  void Grow() {
+    chunks_.emplace_back(new Slot[kChunkSize]);
+    Slot* chunk = chunks_.back().get();
+    for (std::size_t i = 0; i + 1 < kChunkSize; ++i) {
+      chunk[i].next = &chunk[i + 1];
+    }
+    chunk[kChunkSize - 1].next = free_;
+    free_                      = chunk;
+    stats_.capacity += kChunkSize;
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Slot[]>> chunks_;
+  Slot* free_ = nullptr;
+  Stats stats_;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // OBJECT_POOL_H
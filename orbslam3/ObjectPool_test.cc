@@ -0,0 +1,55 @@
+// Standard
+#include <cstdint>
+#include <set>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/ObjectPool.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+struct alignas(32) Aligned {
+  double values[5];
+};
+
+} // namespace
+
+TEST(ObjectPool, AllocateDeallocate) {
+  ObjectPool<Aligned, 8> pool;
+
+  // More objects than a chunk, all distinct and aligned.
+  std::vector<void*> objects;
+  for (int i = 0; i < 20; ++i) {
+    objects.push_back(pool.Allocate());
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(objects.back()) % alignof(Aligned), 0u);
+    new (objects.back()) Aligned{{1.0, 2.0, 3.0, 4.0, static_cast<double>(i)}};
+  }
+  EXPECT_EQ(std::set<void*>(objects.begin(), objects.end()).size(), objects.size());
+
+  // Consecutive objects of a chunk are contiguous.
+  EXPECT_EQ(static_cast<char*>(objects[1]) - static_cast<char*>(objects[0]), static_cast<std::ptrdiff_t>(sizeof(Aligned)));
+
+  ObjectPool<Aligned, 8>::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.live, 20u);
+  EXPECT_EQ(stats.capacity, 24u);
+  EXPECT_EQ(stats.allocated, 20u);
+
+  // Freed slots are reused before growing.
+  pool.Deallocate(objects[5]);
+  pool.Deallocate(objects[11]);
+  EXPECT_EQ(pool.GetStats().live, 18u);
+  EXPECT_EQ(pool.Allocate(), objects[11]);
+  EXPECT_EQ(pool.Allocate(), objects[5]);
+  for (void* object : objects) {
+    pool.Deallocate(object);
+  }
+
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.live, 0u);
+  EXPECT_EQ(stats.capacity, 24u);
+  EXPECT_EQ(stats.allocated, 22u);
+  EXPECT_EQ(stats.deallocated, 22u);
+}
@@ -17,6 +17,7 @@
 */
 
 // Standard
+#include <atomic>
 #include <mutex>
 #include <utility>
 // 3rdparty
@@ -33,12 +34,16 @@
 #include "orbslam3/CameraModels/GeometricCamera.h"
 #include "orbslam3/Frame.h"
 #include "orbslam3/G2oTypes.h"
+#include "orbslam3/InertialPoseSolver.h"
 #include "orbslam3/KeyFrame.h"
+#include "orbslam3/LocalBAContext.h"
 #include "orbslam3/Map.h"
 #include "orbslam3/MapPoint.h"
 #include "orbslam3/OptimizableTypes.h"
 #include "orbslam3/Optimizer.h"
+#include "orbslam3/PoseSolver.h"
 #include "orbslam3/System.h"
+#include "orbslam3/ThreadPool.h"
 
 namespace ORB_SLAM3
 {
@@ -47,16 +52,28 @@ bool sortByVal(const std::pair<MapPoint*, int> &a, const std::pair<MapPoint*, in
     return (a.second < b.second);
 }
 
-void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+// Loop of the error and linearization passes of g2o on the pool, sequential
+// passes without one. The edges of the bundle adjustments have analytic
+// Jacobians, as the parallel linearization requires.
+static g2o::SparseOptimizer::ParallelFor G2oParallelFor(ThreadPool* pThreadPool, const char* stage)
 {
-    std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
-    std::vector<MapPoint*> vpMP = pMap->GetAllMapPoints();
-    BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust);
+    if(!pThreadPool)
+        return g2o::SparseOptimizer::ParallelFor();
+    return [pThreadPool, stage](size_t begin, size_t end, const std::function<void(size_t)> &fn) {
+        pThreadPool->ParallelFor(begin, end, fn, stage);
+    };
+}
+
+void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust, ThreadPool* pThreadPool)
+{
+    const Map::KeyFrameSnapshot spKFs = pMap->GetKeyFrameSnapshot();
+    const Map::MapPointSnapshot spMPs = pMap->GetMapPointSnapshot();
+    BundleAdjustment(*spKFs,*spMPs,nIterations,pbStopFlag, nLoopKF, bRobust, pThreadPool);
 }
 
 
 void Optimizer::BundleAdjustment(const std::vector<KeyFrame *> &vpKFs, const std::vector<MapPoint *> &vpMP,
-                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust, ThreadPool* pThreadPool)
 {
     std::vector<bool> vbNotIncludedMP;
     vbNotIncludedMP.resize(vpMP.size());
@@ -73,6 +90,7 @@ void Optimizer::BundleAdjustment(const std::vector<KeyFrame *> &vpKFs, const std
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
     optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    optimizer.setParallelFor(G2oParallelFor(pThreadPool, "Optimizer::BundleAdjustment"));
 
     if(pbStopFlag)
         optimizer.setForceStopFlag(pbStopFlag);
@@ -387,11 +405,13 @@ void Optimizer::BundleAdjustment(const std::vector<KeyFrame *> &vpKFs, const std
     }
 }
 
-void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const long unsigned int nLoopId, bool *pbStopFlag, bool bInit, float priorG, float priorA, Eigen::VectorXd *vSingVal, bool *bHess)
+void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const long unsigned int nLoopId, bool *pbStopFlag, bool bInit, float priorG, float priorA, Eigen::VectorXd *vSingVal, bool *bHess, ThreadPool* pThreadPool)
 {
     long unsigned int maxKFid = pMap->GetMaxKFid();
-    const std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
-    const std::vector<MapPoint*> vpMPs = pMap->GetAllMapPoints();
+    const Map::KeyFrameSnapshot spKFs = pMap->GetKeyFrameSnapshot();
+    const std::vector<KeyFrame*>& vpKFs = *spKFs;
+    const Map::MapPointSnapshot spMPs = pMap->GetMapPointSnapshot();
+    const std::vector<MapPoint*>& vpMPs = *spMPs;
 
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
@@ -405,6 +425,7 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     solver->setUserLambdaInit(1e-5);
     optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    optimizer.setParallelFor(G2oParallelFor(pThreadPool, "Optimizer::FullInertialBA"));
 
     if(pbStopFlag)
         optimizer.setForceStopFlag(pbStopFlag);
@@ -809,7 +830,88 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
 }
 
 
+static std::atomic<bool> gbDensePoseSolver(true);
+
+void Optimizer::SetDensePoseSolver(const bool bDense)
+{
+    gbDensePoseSolver.store(bDense, std::memory_order_relaxed);
+}
+
+bool Optimizer::DensePoseSolver()
+{
+    return gbDensePoseSolver.load(std::memory_order_relaxed);
+}
+
 int Optimizer::PoseOptimization(Frame *pFrame)
+{
+    if(DensePoseSolver())
+        return PoseOptimizationDense(pFrame);
+    else
+        return PoseOptimizationG2o(pFrame);
+}
+
+int Optimizer::PoseOptimizationDense(Frame *pFrame)
+{
+    // One solver per thread, its observation arrays are reused from frame to frame
+    thread_local PoseSolver solver;
+
+    if(!pFrame->mpCamera2)
+        solver.Reset(pFrame->mpCamera);
+    else
+    {
+        const Sophus::SE3f Trl = pFrame->GetRelativePoseTrl();
+        solver.Reset(pFrame->mpCamera, pFrame->mpCamera2, Sophus::SE3d(Trl.unit_quaternion().cast<double>(), Trl.translation().cast<double>()));
+    }
+    solver.SetStereo(pFrame->fx, pFrame->fy, pFrame->cx, pFrame->cy, pFrame->mbf);
+
+    const int N = pFrame->N;
+
+    {
+    std::unique_lock<std::mutex> lock(MapPoint::mGlobalMutex);
+
+    for(int i=0; i<N; i++)
+    {
+        MapPoint* pMP = pFrame->mvpMapPoints[i];
+        if(!pMP)
+            continue;
+
+        const Eigen::Vector3d Xw = pMP->GetWorldPos().cast<double>();
+
+        //Conventional SLAM
+        if(!pFrame->mpCamera2)
+        {
+            const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
+            const double invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
+            if(pFrame->mvuRight[i]<0) // Monocular observation
+                solver.AddLeft(i, Xw, Eigen::Vector2d(kpUn.pt.x, kpUn.pt.y), invSigma2);
+            else // Stereo observation
+                solver.AddStereo(i, Xw, Eigen::Vector3d(kpUn.pt.x, kpUn.pt.y, pFrame->mvuRight[i]), invSigma2);
+        }
+        //SLAM with respect a rigid body
+        else if(i < pFrame->Nleft) //Left camera observation
+        {
+            const cv::KeyPoint &kp = pFrame->mvKeys[i];
+            solver.AddLeft(i, Xw, Eigen::Vector2d(kp.pt.x, kp.pt.y), pFrame->mvInvLevelSigma2[kp.octave]);
+        }
+        else //Right camera observation
+        {
+            const cv::KeyPoint &kp = pFrame->mvKeysRight[i - pFrame->Nleft];
+            solver.AddRight(i, Xw, Eigen::Vector2d(kp.pt.x, kp.pt.y), pFrame->mvInvLevelSigma2[kp.octave]);
+        }
+    }
+    }
+
+    // Same rounds and outlier tests as the g2o graph below
+    const Sophus::SE3f Tcw = pFrame->GetPose();
+    Sophus::SE3d T(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>());
+    const int nInliers = solver.Solve(T, pFrame->mvbOutlier);
+    if(solver.NumObservations()>=3)
+        pFrame->SetPose(T.cast<float>());
+
+    return nInliers;
+}
+
+int Optimizer::PoseOptimizationG2o(Frame *pFrame)
 {
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
@@ -1111,7 +1213,7 @@ int Optimizer::PoseOptimization(Frame *pFrame)
     return nInitialCorrespondences-nBad;
 }
 
-void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges)
+void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, ThreadPool* pThreadPool, LocalBAContext* pContext)
 {
     // Local KeyFrames: First Breath Search from Current Keyframe
     std::list<KeyFrame*> lLocalKeyFrames;
@@ -1183,25 +1285,17 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
         return;
     }
 
-    // Setup optimizer
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    if (pMap->IsInertial())
-        solver->setUserLambdaInit(100.0);
+    // Setup optimizer, on the graph of the previous window if there is a context
+    LocalBAContext localContext;
+    LocalBAContext& context = pContext ? *pContext : localContext;
+    g2o::SparseOptimizer& optimizer = context.Begin(pMap);
 
-    optimizer.setAlgorithm(solver);
-    optimizer.setVerbose(false);
+    g2o::OptimizationAlgorithmLevenberg* solver = static_cast<g2o::OptimizationAlgorithmLevenberg*>(optimizer.solver());
+    solver->setUserLambdaInit(pMap->IsInertial() ? 100.0 : 0.0);
 
-    if(pbStopFlag)
-        optimizer.setForceStopFlag(pbStopFlag);
+    optimizer.setParallelFor(G2oParallelFor(pThreadPool, "Optimizer::LocalBundleAdjustment"));
 
-    unsigned long maxKFid = 0;
+    optimizer.setForceStopFlag(pbStopFlag);
 
     // DEBUG LBA
     pCurrentMap->msOptKFs.clear();
@@ -1211,14 +1305,10 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(auto lit=lLocalKeyFrames.begin(), lend=lLocalKeyFrames.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap * vSE3 = context.AddKeyFrame(pKFi);
         Sophus::SE3<float> Tcw = pKFi->GetPose();
         vSE3->setEstimate(g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>()));
-        vSE3->setId(pKFi->mnId);
         vSE3->setFixed(pKFi->mnId==pMap->GetInitKFid());
-        optimizer.addVertex(vSE3);
-        if(pKFi->mnId>maxKFid)
-            maxKFid=pKFi->mnId;
         // DEBUG LBA
         pCurrentMap->msOptKFs.insert(pKFi->mnId);
     }
@@ -1228,14 +1318,10 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(auto lit=lFixedCameras.begin(), lend=lFixedCameras.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap * vSE3 = context.AddKeyFrame(pKFi);
         Sophus::SE3<float> Tcw = pKFi->GetPose();
         vSE3->setEstimate(g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(),Tcw.translation().cast<double>()));
-        vSE3->setId(pKFi->mnId);
         vSE3->setFixed(true);
-        optimizer.addVertex(vSE3);
-        if(pKFi->mnId>maxKFid)
-            maxKFid=pKFi->mnId;
         // DEBUG LBA
         pCurrentMap->msFixedKFs.insert(pKFi->mnId);
     }
@@ -1280,12 +1366,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(auto lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
         MapPoint* pMP = *lit;
-        g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
+        g2o::VertexSBAPointXYZ* vPoint = context.AddMapPoint(pMP);
         vPoint->setEstimate(pMP->GetWorldPos().cast<double>());
-        int id = pMP->mnId+maxKFid+1;
-        vPoint->setId(id);
-        vPoint->setMarginalized(true);
-        optimizer.addVertex(vPoint);
         nPoints++;
 
         const std::map<KeyFrame*,std::tuple<int,int>> observations = pMP->GetObservations();
@@ -1306,21 +1388,16 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     Eigen::Matrix<double,2,1> obs;
                     obs << kpUn.pt.x, kpUn.pt.y;
 
-                    EdgeSE3ProjectXYZ* e = new EdgeSE3ProjectXYZ();
+                    EdgeSE3ProjectXYZ* e = context.AddMonoEdge(pMP, pKFi);
 
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-                    e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
                     e->setMeasurement(obs);
                     const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
                     e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberMono);
+                    e->robustKernel()->setDelta(thHuberMono);
 
                     e->pCamera = pKFi->mpCamera;
 
-                    optimizer.addEdge(e);
                     vpEdgesMono.push_back(e);
                     vpEdgeKFMono.push_back(pKFi);
                     vpMapPointEdgeMono.push_back(pMP);
@@ -1334,18 +1411,14 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     const float kp_ur = pKFi->mvuRight[std::get<0>(mit->second)];
                     obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-                    g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+                    g2o::EdgeStereoSE3ProjectXYZ* e = context.AddStereoEdge(pMP, pKFi);
 
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-                    e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
                     e->setMeasurement(obs);
                     const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
                     Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
                     e->setInformation(Info);
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberStereo);
+                    e->robustKernel()->setDelta(thHuberStereo);
 
                     e->fx = pKFi->fx;
                     e->fy = pKFi->fy;
@@ -1353,7 +1426,6 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     e->cy = pKFi->cy;
                     e->bf = pKFi->mbf;
 
-                    optimizer.addEdge(e);
                     vpEdgesStereo.push_back(e);
                     vpEdgeKFStereo.push_back(pKFi);
                     vpMapPointEdgeStereo.push_back(pMP);
@@ -1371,24 +1443,19 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                         cv::KeyPoint kp = pKFi->mvKeysRight[rightIndex];
                         obs << kp.pt.x, kp.pt.y;
 
-                        EdgeSE3ProjectXYZToBody *e = new EdgeSE3ProjectXYZToBody();
+                        EdgeSE3ProjectXYZToBody *e = context.AddBodyEdge(pMP, pKFi);
 
-                        e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-                        e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
                         e->setMeasurement(obs);
                         const float &invSigma2 = pKFi->mvInvLevelSigma2[kp.octave];
                         e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
 
-                        g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                        e->setRobustKernel(rk);
-                        rk->setDelta(thHuberMono);
+                        e->robustKernel()->setDelta(thHuberMono);
 
                         Sophus::SE3f Trl = pKFi-> GetRelativePoseTrl();
                         e->mTrl = g2o::SE3Quat(Trl.unit_quaternion().cast<double>(), Trl.translation().cast<double>());
 
                         e->pCamera = pKFi->mpCamera2;
 
-                        optimizer.addEdge(e);
                         vpEdgesBody.push_back(e);
                         vpEdgeKFBody.push_back(pKFi);
                         vpMapPointEdgeBody.push_back(pMP);
@@ -1401,6 +1468,9 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     }
     num_edges = nEdges;
 
+    // Drop what left the window
+    context.End();
+
     if(pbStopFlag)
         if(*pbStopFlag)
             return;
@@ -1477,7 +1547,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(auto lit=lLocalKeyFrames.begin(), lend=lLocalKeyFrames.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap* vSE3 = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(pKFi->mnId));
+        g2o::VertexSE3Expmap* vSE3 = context.KeyFrameVertex(pKFi);
         g2o::SE3Quat SE3quat = vSE3->estimate();
         Sophus::SE3f Tiw(SE3quat.rotation().cast<float>(), SE3quat.translation().cast<float>());
         pKFi->SetPose(Tiw);
@@ -1487,7 +1557,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(auto lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
         MapPoint* pMP = *lit;
-        g2o::VertexSBAPointXYZ* vPoint = static_cast<g2o::VertexSBAPointXYZ*>(optimizer.vertex(pMP->mnId+maxKFid+1));
+        g2o::VertexSBAPointXYZ* vPoint = context.MapPointVertex(pMP);
         pMP->SetWorldPos(vPoint->estimate().cast<float>());
         pMP->UpdateNormalAndDepth();
     }
@@ -1512,8 +1582,11 @@ void Optimizer::OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* p
     solver->setUserLambdaInit(1e-16);
     optimizer.setAlgorithm(solver);
 
-    const std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
-    const std::vector<MapPoint*> vpMPs = pMap->GetAllMapPoints();
+    const Map::KeyFrameSnapshot spKFs = pMap->GetKeyFrameSnapshot();
+
+    const std::vector<KeyFrame*>& vpKFs = *spKFs;
+    const Map::MapPointSnapshot spMPs = pMap->GetMapPointSnapshot();
+    const std::vector<MapPoint*>& vpMPs = *spMPs;
 
     const unsigned int nMaxKFid = pMap->GetMaxKFid();
 
@@ -2383,7 +2456,7 @@ int Optimizer::OptimizeSim3(KeyFrame *pKF1, KeyFrame *pKF2, std::vector<MapPoint
     return nIn;
 }
 
-void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, bool bLarge, bool bRecInit)
+void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, bool bLarge, bool bRecInit, ThreadPool* pThreadPool)
 {
     Map* pCurrentMap = pKF->GetMap();
 
@@ -2525,6 +2598,7 @@ void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int&
         solver->setUserLambdaInit(1e0);
         optimizer.setAlgorithm(solver);
     }
+    optimizer.setParallelFor(G2oParallelFor(pThreadPool, "Optimizer::LocalInertialBA"));
 
 
     // Set Local temporal KeyFrame vertices
@@ -3047,7 +3121,8 @@ void Optimizer::InertialOptimization(Map *pMap, Eigen::Matrix3d &Rwg, double &sc
     VLOG(1) << "inertial optimization";
     int its = 200;
     long unsigned int maxKFid = pMap->GetMaxKFid();
-    const std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+    const Map::KeyFrameSnapshot spKFs = pMap->GetKeyFrameSnapshot();
+    const std::vector<KeyFrame*>& vpKFs = *spKFs;
 
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
@@ -3231,7 +3306,8 @@ void Optimizer::InertialOptimization(Map *pMap, Eigen::Vector3d &bg, Eigen::Vect
 {
     int its = 200; // Check number of iterations
     long unsigned int maxKFid = pMap->GetMaxKFid();
-    const std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+    const Map::KeyFrameSnapshot spKFs = pMap->GetKeyFrameSnapshot();
+    const std::vector<KeyFrame*>& vpKFs = *spKFs;
 
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
@@ -3393,7 +3469,8 @@ void Optimizer::InertialOptimization(Map *pMap, Eigen::Matrix3d &Rwg, double &sc
 {
     int its = 10;
     long unsigned int maxKFid = pMap->GetMaxKFid();
-    const std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+    const Map::KeyFrameSnapshot spKFs = pMap->GetKeyFrameSnapshot();
+    const std::vector<KeyFrame*>& vpKFs = *spKFs;
 
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
@@ -4491,7 +4568,123 @@ void Optimizer::MergeInertialBA(KeyFrame* pCurrKF, KeyFrame* pMergeKF, bool *pbS
     pMap->IncreaseChangeIndex();
 }
 
+// State of a frame, as the vertices of the inertial graphs
+static ImuState FrameImuState(const Frame* pFrame)
+{
+    ImuState state;
+    state.R_wb = pFrame->GetImuRotation().cast<double>();
+    state.t_wb = pFrame->GetImuPosition().cast<double>();
+    state.v_wb = pFrame->GetVelocity().cast<double>();
+    state.bias_gyro = pFrame->mImuBias.gyro().cast<double>();
+    state.bias_acc = pFrame->mImuBias.acc().cast<double>();
+    return state;
+}
+
+static void SetFrameImuState(Frame* pFrame, const ImuState& state)
+{
+    pFrame->SetImuPoseVelocity(state.R_wb.cast<float>(), state.t_wb.cast<float>(), state.v_wb.cast<float>());
+    pFrame->mImuBias = IMU::Bias(state.bias_acc[0],state.bias_acc[1],state.bias_acc[2],state.bias_gyro[0],state.bias_gyro[1],state.bias_gyro[2]);
+}
+
+// Cameras, observations and inertial measurements of the frame, as the edges
+// of the inertial graphs
+static void ResetInertialPoseSolver(InertialPoseSolver& solver, Frame* pFrame, IMU::Preintegrated* pPreintegrated)
+{
+    const Sophus::SE3d Tcb(pFrame->mImuCalib.T_cb.unit_quaternion().cast<double>(), pFrame->mImuCalib.T_cb.translation().cast<double>());
+    if(!pFrame->mpCamera2)
+        solver.Reset(pFrame->mpCamera, Tcb, pFrame->mbf);
+    else
+    {
+        const Sophus::SE3f Trl = pFrame->GetRelativePoseTrl();
+        solver.Reset(pFrame->mpCamera, Tcb, pFrame->mbf, pFrame->mpCamera2, Sophus::SE3d(Trl.unit_quaternion().cast<double>(), Trl.translation().cast<double>()));
+    }
+
+    const int N = pFrame->N;
+    const int Nleft = pFrame->Nleft;
+    const bool bRight = (Nleft!=-1);
+
+    {
+    std::unique_lock<std::mutex> lock(MapPoint::mGlobalMutex);
+
+    for(int i=0; i<N; i++)
+    {
+        MapPoint* pMP = pFrame->mvpMapPoints[i];
+        if(!pMP)
+            continue;
+
+        const Eigen::Vector3d Xw = pMP->GetWorldPos().cast<double>();
+        const bool bClose = pMP->mTrackDepth<10.f;
+
+        // Left monocular observation
+        if((!bRight && pFrame->mvuRight[i]<0) || i < Nleft)
+        {
+            const cv::KeyPoint &kpUn = (i < Nleft) ? pFrame->mvKeys[i] : pFrame->mvKeysUn[i];
+            const Eigen::Vector2d obs(kpUn.pt.x, kpUn.pt.y);
+            const float unc2 = pFrame->mpCamera->uncertainty(obs.cast<float>());
+            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave]/unc2;
+            solver.AddMono(i, Xw, obs, invSigma2, 0, bClose);
+        }
+        // Stereo observation
+        else if(!bRight)
+        {
+            const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
+            const Eigen::Vector3d obs(kpUn.pt.x, kpUn.pt.y, pFrame->mvuRight[i]);
+            const float unc2 = pFrame->mpCamera->uncertainty(obs.head(2).cast<float>());
+            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave]/unc2;
+            solver.AddStereo(i, Xw, obs, invSigma2);
+        }
+
+        // Right monocular observation
+        if(bRight && i >= Nleft)
+        {
+            const cv::KeyPoint &kpUn = pFrame->mvKeysRight[i - Nleft];
+            const Eigen::Vector2d obs(kpUn.pt.x, kpUn.pt.y);
+            const float unc2 = pFrame->mpCamera->uncertainty(obs.cast<float>());
+            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave]/unc2;
+            solver.AddMono(i, Xw, obs, invSigma2, 1, bClose);
+        }
+    }
+    }
+
+    const Eigen::Matrix3d InfoG = pFrame->mpImuPreintegrated->C.block<3,3>(9,9).cast<double>().inverse();
+    const Eigen::Matrix3d InfoA = pFrame->mpImuPreintegrated->C.block<3,3>(12,12).cast<double>().inverse();
+    solver.SetInertial(pPreintegrated, InfoG, InfoA);
+}
+
 int Optimizer::PoseInertialOptimizationLastKeyFrame(Frame *pFrame, bool bRecInit)
+{
+    if(DensePoseSolver())
+        return PoseInertialOptimizationLastKeyFrameDense(pFrame, bRecInit);
+    else
+        return PoseInertialOptimizationLastKeyFrameG2o(pFrame, bRecInit);
+}
+
+int Optimizer::PoseInertialOptimizationLastKeyFrameDense(Frame *pFrame, bool bRecInit)
+{
+    // One solver per thread, its observation arrays are reused from frame to frame
+    thread_local InertialPoseSolver solver;
+    ResetInertialPoseSolver(solver, pFrame, pFrame->mpImuPreintegrated);
+
+    // The last keyframe is fixed
+    KeyFrame* pKF = pFrame->mpLastKeyFrame;
+    ImuState previous;
+    previous.R_wb = pKF->GetImuRotation().cast<double>();
+    previous.t_wb = pKF->GetImuPosition().cast<double>();
+    previous.v_wb = pKF->GetVelocity().cast<double>();
+    previous.bias_gyro = pKF->GetGyroBias().cast<double>();
+    previous.bias_acc = pKF->GetAccBias().cast<double>();
+
+    ImuState current = FrameImuState(pFrame);
+    InertialPoseSolver::Matrix15d H;
+    const int nInliers = solver.Solve(current, previous, InertialPoseSolver::kLastKeyFrame, !bRecInit, pFrame->mvbOutlier, H);
+
+    SetFrameImuState(pFrame, current);
+    pFrame->mpcpi = new ConstraintPoseImu(current.R_wb,current.t_wb,current.v_wb,current.bias_gyro,current.bias_acc,H);
+
+    return nInliers;
+}
+
+int Optimizer::PoseInertialOptimizationLastKeyFrameG2o(Frame *pFrame, bool bRecInit)
 {
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolverX::LinearSolverType * linearSolver;
@@ -4876,6 +5069,39 @@ int Optimizer::PoseInertialOptimizationLastKeyFrame(Frame *pFrame, bool bRecInit
 }
 
 int Optimizer::PoseInertialOptimizationLastFrame(Frame *pFrame, bool bRecInit)
+{
+    if(DensePoseSolver())
+        return PoseInertialOptimizationLastFrameDense(pFrame, bRecInit);
+    else
+        return PoseInertialOptimizationLastFrameG2o(pFrame, bRecInit);
+}
+
+int Optimizer::PoseInertialOptimizationLastFrameDense(Frame *pFrame, bool bRecInit)
+{
+    // One solver per thread, its observation arrays are reused from frame to frame
+    thread_local InertialPoseSolver solver;
+    ResetInertialPoseSolver(solver, pFrame, pFrame->mpImuPreintegratedFrame);
+
+    // The previous frame is free under the prior of its last optimization
+    Frame* pFp = pFrame->mpPrevFrame;
+    if (!pFp->mpcpi)
+        VLOG(1) << "pFp->mpcpi does not exist!!!\nPrevious Frame " << pFp->mnId;
+    solver.SetPrior(pFp->mpcpi);
+
+    ImuState previous = FrameImuState(pFp);
+    ImuState current = FrameImuState(pFrame);
+    InertialPoseSolver::Matrix15d H;
+    const int nInliers = solver.Solve(current, previous, InertialPoseSolver::kLastFrame, !bRecInit, pFrame->mvbOutlier, H);
+
+    SetFrameImuState(pFrame, current);
+    pFrame->mpcpi = new ConstraintPoseImu(current.R_wb,current.t_wb,current.v_wb,current.bias_gyro,current.bias_acc,H);
+    delete pFp->mpcpi;
+    pFp->mpcpi = NULL;
+
+    return nInliers;
+}
+
+int Optimizer::PoseInertialOptimizationLastFrameG2o(Frame *pFrame, bool bRecInit)
 {
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolverX::LinearSolverType * linearSolver;
@@ -5310,8 +5536,11 @@ void Optimizer::OptimizeEssentialGraph4DoF(Map* pMap, KeyFrame* pLoopKF, KeyFram
 
     optimizer.setAlgorithm(solver);
 
-    const std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
-    const std::vector<MapPoint*> vpMPs = pMap->GetAllMapPoints();
+    const Map::KeyFrameSnapshot spKFs = pMap->GetKeyFrameSnapshot();
+
+    const std::vector<KeyFrame*>& vpKFs = *spKFs;
+    const Map::MapPointSnapshot spMPs = pMap->GetMapPointSnapshot();
+    const std::vector<MapPoint*>& vpMPs = *spMPs;
 
     const unsigned int nMaxKFid = pMap->GetMaxKFid();
 
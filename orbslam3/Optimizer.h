@@ -34,8 +34,10 @@ namespace ORB_SLAM3
 
 class Frame;
 class KeyFrame;
+class LocalBAContext;
 class Map;
 class MapPoint;
+class ThreadPool;
 
 class Optimizer
 {
@@ -43,16 +45,32 @@ public:
 
     void static BundleAdjustment(const std::vector<KeyFrame*> &vpKF, const std::vector<MapPoint*> &vpMP,
                                  int nIterations = 5, bool *pbStopFlag=NULL, const unsigned long nLoopKF=0,
-                                 const bool bRobust = true);
+                                 const bool bRobust = true, ThreadPool* pThreadPool = nullptr);
     void static GlobalBundleAdjustemnt(Map* pMap, int nIterations=5, bool *pbStopFlag=NULL,
-                                       const unsigned long nLoopKF=0, const bool bRobust = true);
-    void static FullInertialBA(Map *pMap, int its, const bool bFixLocal=false, const unsigned long nLoopKF=0, bool *pbStopFlag=NULL, bool bInit=false, float priorG = 1e2, float priorA=1e6, Eigen::VectorXd *vSingVal = NULL, bool *bHess=NULL);
-
-    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges);
-
+                                       const unsigned long nLoopKF=0, const bool bRobust = true,
+                                       ThreadPool* pThreadPool = nullptr);
+    void static FullInertialBA(Map *pMap, int its, const bool bFixLocal=false, const unsigned long nLoopKF=0, bool *pbStopFlag=NULL, bool bInit=false, float priorG = 1e2, float priorA=1e6, Eigen::VectorXd *vSingVal = NULL, bool *bHess=NULL, ThreadPool* pThreadPool = nullptr);
+
+    // The bundle adjustments above and below take an optional pool, on which
+    // g2o computes the errors and linearizes the edges of the graph.
+    // The local BA builds its graph in pContext, which keeps it between the
+    // windows of consecutive keyframes, or in a graph of its own without it.
+    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, ThreadPool* pThreadPool = nullptr, LocalBAContext* pContext = nullptr);
+
+    // Motion-only BA of the frame pose, with the fixed-size PoseSolver and
+    // InertialPoseSolver or, to compare against them, the original g2o graphs.
+    // PoseOptimization and PoseInertialOptimization* run the selected ones.
     int static PoseOptimization(Frame* pFrame);
+    int static PoseOptimizationDense(Frame* pFrame);
+    int static PoseOptimizationG2o(Frame* pFrame);
+    void static SetDensePoseSolver(const bool bDense);
+    bool static DensePoseSolver();
     int static PoseInertialOptimizationLastKeyFrame(Frame* pFrame, bool bRecInit = false);
+    int static PoseInertialOptimizationLastKeyFrameDense(Frame* pFrame, bool bRecInit = false);
+    int static PoseInertialOptimizationLastKeyFrameG2o(Frame* pFrame, bool bRecInit = false);
     int static PoseInertialOptimizationLastFrame(Frame *pFrame, bool bRecInit = false);
+    int static PoseInertialOptimizationLastFrameDense(Frame *pFrame, bool bRecInit = false);
+    int static PoseInertialOptimizationLastFrameG2o(Frame *pFrame, bool bRecInit = false);
 
     // if bFixScale is true, 6DoF optimization (stereo,rgbd), 7DoF otherwise (mono)
     void static OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* pCurKF,
@@ -77,7 +95,7 @@ public:
 
     // For inertial systems
 
-    void static LocalInertialBA(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, bool bLarge = false, bool bRecInit = false);
+    void static LocalInertialBA(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, bool bLarge = false, bool bRecInit = false, ThreadPool* pThreadPool = nullptr);
     void static MergeInertialBA(KeyFrame* pCurrKF, KeyFrame* pMergeKF, bool *pbStopFlag, Map *pMap, LoopClosing::KeyFrameAndPose &corrPoses);
 
     // Local BA in welding area when two maps are merged
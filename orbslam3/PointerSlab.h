@@ -0,0 +1,181 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POINTER_SLAB_H
+#define POINTER_SLAB_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// Set of pointers stored in slots, used by Map for its MapPoints and KeyFrames.
+//
+// Every pointer gets a slot id, stable until it is erased (ids of erased
+// pointers are reused). The pointers themselves are kept packed in a dense
+// array, so insertion and erasure are O(1) (erasure moves the last pointer in
+// the hole) and iteration is a linear scan. The iteration order is therefore
+// unspecified, as it was for the std::set of pointers it replaces.
+//
+// GetSnapshot() returns the pointers as an immutable shared vector. It is only
+// rebuilt after a modification, so readers polling an unchanged set (e.g. the
+// map viewer) share a single copy.
+//
+// Not thread-safe, the owner synchronizes the accesses.
+template <typename T>
+class PointerSlab {
+public:
+  using Id       = std::uint32_t;
+  using Snapshot = std::shared_ptr<const std::vector<T*>>;
+
+  static constexpr Id kInvalidId             = std::numeric_limits<Id>::max();
+  static constexpr std::size_t kInvalidIndex = std::numeric_limits<std::size_t>::max();
+
+  using const_iterator = typename std::vector<T*>::const_iterator;
+
+  // Insert a pointer and return its slot id (the existing one if it is
+  // already in the set).
+  Id Insert(T* item) {
+    const auto found = ids_.find(item);
+    if (found != ids_.end()) {
+      return found->second;
+    }
+
+    Id id;
+    if (!free_ids_.empty()) {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    } else {
+      id = static_cast<Id>(slots_.size());
+      slots_.push_back(0);
+    }
+    slots_[id] = dense_.size();
+    dense_.push_back(item);
+    dense_ids_.push_back(id);
+    ids_.emplace(item, id);
+    snapshot_.reset();
+    return id;
+  }
+
+  // Erase a pointer, returns false if it is not in the set.
+  bool Erase(T* item) {
+    const auto found = ids_.find(item);
+    if (found == ids_.end()) {
+      return false;
+    }
+
+    const Id id               = found->second;
+    const std::size_t index   = slots_[id];
+    const std::size_t last    = dense_.size() - 1;
+    dense_[index]             = dense_[last];
+    dense_ids_[index]         = dense_ids_[last];
+    slots_[dense_ids_[index]] = index;
+    dense_.pop_back();
+    dense_ids_.pop_back();
+    free_ids_.push_back(id);
+    ids_.erase(found);
+    snapshot_.reset();
+    return true;
+  }
+
+  void Clear() {
+    slots_.clear();
+    free_ids_.clear();
+    dense_.clear();
+    dense_ids_.clear();
+    ids_.clear();
+    snapshot_.reset();
+  }
+
+  bool Contains(T* item) const {
+    return ids_.count(item) > 0;
+  }
+
+  // Slot id of a pointer, kInvalidId if it is not in the set.
+  Id GetId(T* item) const {
+    const auto found = ids_.find(item);
+    return found != ids_.end() ? found->second : kInvalidId;
+  }
+
+  // Position of a pointer in the iteration order, kInvalidIndex if it is not
+  // in the set. An erasure moves the last pointer to the position of the
+  // erased one, so positions do not tell which pointers were in a snapshot.
+  std::size_t GetIndex(T* item) const {
+    const auto found = ids_.find(item);
+    return found != ids_.end() ? slots_[found->second] : kInvalidIndex;
+  }
+
+  // Pointer in a slot, nullptr if the slot is free.
+  T* Get(const Id id) const {
+    if (id >= slots_.size()) {
+      return nullptr;
+    }
+    const std::size_t index = slots_[id];
+    return index < dense_.size() && dense_ids_[index] == id ? dense_[index] : nullptr;
+  }
+
+  std::size_t Size() const {
+    return dense_.size();
+  }
+
+  bool Empty() const {
+    return dense_.empty();
+  }
+
+  void Reserve(const std::size_t size) {
+    dense_.reserve(size);
+    dense_ids_.reserve(size);
+    ids_.reserve(size);
+  }
+
+  const_iterator begin() const {
+    return dense_.begin();
+  }
+
+  const_iterator end() const {
+    return dense_.end();
+  }
+
+  // Copy of the pointers, shared until the next modification.
+  Snapshot GetSnapshot() const {
+    if (!snapshot_) {
+      snapshot_ = std::make_shared<const std::vector<T*>>(dense_);
+    }
+    return snapshot_;
+  }
+
+private:
+  std::vector<std::size_t> slots_;  // Slot id -> index in dense_
+  std::vector<Id> free_ids_;        // Free slot ids, reused first
+  std::vector<T*> dense_;           // Packed pointers
+  std::vector<Id> dense_ids_;       // Index in dense_ -> slot id
+  std::unordered_map<T*, Id> ids_;  // Pointer -> slot id
+  mutable Snapshot snapshot_;       // Reset on every modification
+};
+
+} // namespace ORB_SLAM3
+
+#endif // POINTER_SLAB_H
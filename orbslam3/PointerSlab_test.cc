@@ -0,0 +1,115 @@
+// Standard
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/PointerSlab.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+std::set<int*> Items(const PointerSlab<int>& slab) {
+  return std::set<int*>(slab.begin(), slab.end());
+}
+
+} // namespace
+
+TEST(PointerSlab, InsertErase) {
+  std::vector<int> values(4);
+  PointerSlab<int> slab;
+  EXPECT_TRUE(slab.Empty());
+
+  const PointerSlab<int>::Id a = slab.Insert(&values[0]);
+  const PointerSlab<int>::Id b = slab.Insert(&values[1]);
+  EXPECT_EQ(slab.Insert(&values[0]), a);
+  EXPECT_EQ(slab.Size(), 2u);
+  EXPECT_EQ(slab.Get(a), &values[0]);
+  EXPECT_EQ(slab.Get(b), &values[1]);
+  EXPECT_EQ(slab.GetId(&values[2]), PointerSlab<int>::kInvalidId);
+
+  // Ids stay valid when other pointers are erased, freed ids are reused.
+  const PointerSlab<int>::Id c = slab.Insert(&values[2]);
+  EXPECT_TRUE(slab.Erase(&values[0]));
+  EXPECT_FALSE(slab.Erase(&values[0]));
+  EXPECT_EQ(slab.Get(a), nullptr);
+  EXPECT_EQ(slab.Get(b), &values[1]);
+  EXPECT_EQ(slab.Get(c), &values[2]);
+  EXPECT_FALSE(slab.Contains(&values[0]));
+  EXPECT_EQ(slab.Insert(&values[3]), a);
+  EXPECT_EQ(Items(slab), (std::set<int*>{&values[1], &values[2], &values[3]}));
+
+  slab.Clear();
+  EXPECT_TRUE(slab.Empty());
+  EXPECT_EQ(slab.Get(b), nullptr);
+  EXPECT_EQ(slab.begin(), slab.end());
+}
+
+TEST(PointerSlab, MatchesSet) {
+  std::vector<int> values(500);
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<std::size_t> pick(0, values.size() - 1);
+
+  PointerSlab<int> slab;
+  std::set<int*> reference;
+  for (int i = 0; i < 20000; ++i) {
+    int* item = &values[pick(rng)];
+    if (rng() % 3 == 0) {
+      EXPECT_EQ(slab.Erase(item), reference.erase(item) == 1);
+    } else {
+      slab.Insert(item);
+      reference.insert(item);
+    }
+    ASSERT_EQ(slab.Size(), reference.size());
+  }
+  EXPECT_EQ(Items(slab), reference);
+  for (int* item : reference) {
+    EXPECT_EQ(slab.Get(slab.GetId(item)), item);
+  }
+}
+
+TEST(PointerSlab, Snapshot) {
+  std::vector<int> values(3);
+  PointerSlab<int> slab;
+  slab.Insert(&values[0]);
+  slab.Insert(&values[1]);
+
+  // Shared while the set does not change.
+  const PointerSlab<int>::Snapshot first = slab.GetSnapshot();
+  EXPECT_EQ(slab.GetSnapshot(), first);
+  EXPECT_EQ(first->size(), 2u);
+
+  // A modification leaves the previous snapshot untouched.
+  slab.Erase(&values[0]);
+  slab.Insert(&values[2]);
+  const PointerSlab<int>::Snapshot second = slab.GetSnapshot();
+  EXPECT_NE(second, first);
+  EXPECT_EQ(std::set<int*>(first->begin(), first->end()), (std::set<int*>{&values[0], &values[1]}));
+  EXPECT_EQ(std::set<int*>(second->begin(), second->end()), (std::set<int*>{&values[1], &values[2]}));
+}
+
+TEST(PointerSlab, SnapshotIndex) {
+  std::vector<int> values(4);
+  PointerSlab<int> slab;
+  slab.Insert(&values[0]);
+  slab.Insert(&values[1]);
+  const PointerSlab<int>::Snapshot snapshot = slab.GetSnapshot();
+
+  // Pointers inserted after the snapshot come after it.
+  slab.Insert(&values[2]);
+  for (int* item : *snapshot)
+    EXPECT_LT(slab.GetIndex(item), snapshot->size());
+  EXPECT_EQ(slab.GetIndex(&values[2]), snapshot->size());
+  EXPECT_EQ(slab.GetIndex(&values[3]), PointerSlab<int>::kInvalidIndex);
+
+  // Until one is erased: the last pointer takes its position, below the size
+  // of the snapshot, which is left untouched.
+  slab.Erase(&values[0]);
+  EXPECT_EQ(slab.GetIndex(&values[2]), 0u);
+  EXPECT_EQ(std::set<int*>(snapshot->begin(), snapshot->end()), (std::set<int*>{&values[0], &values[1]}));
+  for (int* item : slab)
+    EXPECT_EQ(*(slab.begin() + slab.GetIndex(item)), item);
+}
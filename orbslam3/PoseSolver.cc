@@ -0,0 +1,420 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// Standard
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+// 3rdparty
+#include <Eigen/Cholesky>
+// Local
+#include "orbslam3/CameraModels/GeometricCamera.h"
+#include "orbslam3/PoseSolver.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+// Damping of g2o::OptimizationAlgorithmLevenberg.
+constexpr double kTau                = 1e-5;
+constexpr double kGoodStepLowerScale = 1.0 / 3.0;
+constexpr double kGoodStepUpperScale = 2.0 / 3.0;
+constexpr int kMaxTrials             = 10;
+
+// Derivative of an error under exp(dx) * T_cw, dx = (omega, upsilon), from its
+// derivative J_p wrt the camera point p: -J_p * [-[p]x | I].
+template <int D>
+void PoseJacobian(const Eigen::Matrix<double, D, 3>& J_p, const Eigen::Vector3d& p, Eigen::Matrix<double, D, 6>& J) {
+  for (int k = 0; k < D; ++k) {
+    const double a = J_p(k, 0), b = J_p(k, 1), c = J_p(k, 2);
+    J(k, 0) = b * p.z() - c * p.y();
+    J(k, 1) = c * p.x() - a * p.z();
+    J(k, 2) = a * p.y() - b * p.x();
+    J(k, 3) = -a;
+    J(k, 4) = -b;
+    J(k, 5) = -c;
+  }
+}
+
+Sophus::SE3d Exp(const PoseSolver::Vector6d& dx) {
+  PoseSolver::Vector6d tangent; // Sophus order: (upsilon, omega)
+  tangent << dx.tail<3>(), dx.head<3>();
+  return Sophus::SE3d::exp(tangent);
+}
+
+// Huber cost of the squared error e2, as g2o::RobustKernelHuber, and its
+// derivative, the weight of the error in the normal equations.
+double Huber(const double e2, const double delta, double& weight) {
+  const double delta2 = delta * delta;
+  if (e2 <= delta2) {
+    weight = 1.0;
+    return e2;
+  }
+  const double e = std::sqrt(e2);
+  weight         = delta / e;
+  return 2.0 * e * delta - delta2;
+}
+
+// Add an error with the information info * I to the normal equations,
+// returns its (robust) chi2.
+template <int D>
+double Accumulate(
+  const Eigen::Matrix<double, D, 1>& e,
+  const Eigen::Matrix<double, D, 6>& J,
+  const double info,
+  const double delta,
+  const bool robust,
+  PoseSolver::Matrix6d& H,
+  PoseSolver::Vector6d& b
+) {
+  const double chi2 = info * e.squaredNorm();
+  double weight     = 1.0;
+  const double cost = robust ? Huber(chi2, delta, weight) : chi2;
+  const double w    = weight * info;
+  // Upper triangle only, the solve reads the self-adjoint view.
+  for (int c = 0; c < 6; ++c) {
+    const Eigen::Matrix<double, D, 1> wJ_c = w * J.col(c);
+    b[c] -= wJ_c.dot(e);
+    for (int r = 0; r <= c; ++r) {
+      H(r, c) += wJ_c.dot(J.col(r));
+    }
+  }
+  return cost;
+}
+
+const double kDeltaMono   = std::sqrt(static_cast<double>(PoseSolver::kChi2Mono));
+const double kDeltaStereo = std::sqrt(static_cast<double>(PoseSolver::kChi2Stereo));
+
+} // namespace
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Observations
+
+void PoseSolver::Observations::Clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  u.clear();
+  v.clear();
+  u_right.clear();
+  info.clear();
+  index.clear();
+  outlier.clear();
+}
+
+void PoseSolver::Observations::Add(
+  const std::size_t i,
+  const Eigen::Vector3d& x_w,
+  const double obs_u,
+  const double obs_v,
+  const double inv_sigma2
+) {
+  x.push_back(x_w.x());
+  y.push_back(x_w.y());
+  z.push_back(x_w.z());
+  u.push_back(obs_u);
+  v.push_back(obs_v);
+  info.push_back(inv_sigma2);
+  index.push_back(static_cast<std::uint32_t>(i));
+  outlier.push_back(0);
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Camera projection
+
+void CameraProjection::Set(const GeometricCamera* model) {
+  camera  = model;
+  pinhole = model != nullptr && model->type() == GeometricCamera::Type::Pinhole;
+  if (pinhole) {
+    fx = model->getParameter(0);
+    fy = model->getParameter(1);
+    cx = model->getParameter(2);
+    cy = model->getParameter(3);
+  }
+}
+
+void CameraProjection::Project(
+  const Eigen::Vector3d& p,
+  Eigen::Vector2d& uv,
+  Eigen::Matrix<double, 2, 3>& J
+) const {
+  if (pinhole) {
+    const double inv_z = 1.0 / p.z();
+    uv << fx * p.x() * inv_z + cx, fy * p.y() * inv_z + cy;
+    J << fx * inv_z, 0.0, -fx * p.x() * inv_z * inv_z,
+         0.0, fy * inv_z, -fy * p.y() * inv_z * inv_z;
+  } else {
+    const Eigen::Vector3f p_f = p.cast<float>();
+    uv                        = camera->project(p_f).cast<double>();
+    J                         = camera->jacobian(p_f).cast<double>();
+  }
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Problem
+
+void PoseSolver::Reset(const GeometricCamera* left, const GeometricCamera* right, const Sophus::SE3d& T_rl) {
+  left_camera_.Set(left);
+  right_camera_.Set(right);
+  R_rl_ = T_rl.rotationMatrix();
+  t_rl_ = T_rl.translation();
+  left_.Clear();
+  right_.Clear();
+  stereo_.Clear();
+}
+
+void PoseSolver::SetStereo(const double fx, const double fy, const double cx, const double cy, const double bf) {
+  stereo_fx_ = fx;
+  stereo_fy_ = fy;
+  stereo_cx_ = cx;
+  stereo_cy_ = cy;
+  stereo_bf_ = bf;
+}
+
+void PoseSolver::AddLeft(
+  const std::size_t index,
+  const Eigen::Vector3d& x_w,
+  const Eigen::Vector2d& uv,
+  const double inv_sigma2
+) {
+  assert(left_camera_.camera != nullptr);
+  left_.Add(index, x_w, uv.x(), uv.y(), inv_sigma2);
+}
+
+void PoseSolver::AddRight(
+  const std::size_t index,
+  const Eigen::Vector3d& x_w,
+  const Eigen::Vector2d& uv,
+  const double inv_sigma2
+) {
+  assert(right_camera_.camera != nullptr);
+  right_.Add(index, x_w, uv.x(), uv.y(), inv_sigma2);
+}
+
+void PoseSolver::AddStereo(
+  const std::size_t index,
+  const Eigen::Vector3d& x_w,
+  const Eigen::Vector3d& uvr,
+  const double inv_sigma2
+) {
+  stereo_.Add(index, x_w, uvr.x(), uvr.y(), inv_sigma2);
+  stereo_.u_right.push_back(uvr.z());
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Errors
+
+Eigen::Vector2d PoseSolver::LeftError(
+  const std::size_t i,
+  const Eigen::Matrix3d& R,
+  const Eigen::Vector3d& t,
+  Eigen::Matrix<double, 2, 6>* J
+) const {
+  const Eigen::Vector3d p = R * Eigen::Vector3d(left_.x[i], left_.y[i], left_.z[i]) + t;
+  Eigen::Vector2d uv;
+  Eigen::Matrix<double, 2, 3> J_uv;
+  left_camera_.Project(p, uv, J_uv);
+  if (J != nullptr) {
+    PoseJacobian<2>(J_uv, p, *J);
+  }
+  return Eigen::Vector2d(left_.u[i] - uv.x(), left_.v[i] - uv.y());
+}
+
+Eigen::Vector2d PoseSolver::RightError(
+  const std::size_t i,
+  const Eigen::Matrix3d& R,
+  const Eigen::Vector3d& t,
+  Eigen::Matrix<double, 2, 6>* J
+) const {
+  const Eigen::Vector3d p   = R * Eigen::Vector3d(right_.x[i], right_.y[i], right_.z[i]) + t;
+  const Eigen::Vector3d p_r = R_rl_ * p + t_rl_;
+  Eigen::Vector2d uv;
+  Eigen::Matrix<double, 2, 3> J_uv;
+  right_camera_.Project(p_r, uv, J_uv);
+  if (J != nullptr) {
+    PoseJacobian<2>(J_uv * R_rl_, p, *J);
+  }
+  return Eigen::Vector2d(right_.u[i] - uv.x(), right_.v[i] - uv.y());
+}
+
+Eigen::Vector3d PoseSolver::StereoError(
+  const std::size_t i,
+  const Eigen::Matrix3d& R,
+  const Eigen::Vector3d& t,
+  Eigen::Matrix<double, 3, 6>* J
+) const {
+  const Eigen::Vector3d p = R * Eigen::Vector3d(stereo_.x[i], stereo_.y[i], stereo_.z[i]) + t;
+  const double inv_z      = 1.0 / p.z();
+  const double u          = stereo_fx_ * p.x() * inv_z + stereo_cx_;
+  const double v          = stereo_fy_ * p.y() * inv_z + stereo_cy_;
+  if (J != nullptr) {
+    const double inv_z2 = inv_z * inv_z;
+    Eigen::Matrix<double, 3, 3> J_uvr;
+    J_uvr << stereo_fx_ * inv_z, 0.0, -stereo_fx_ * p.x() * inv_z2,
+             0.0, stereo_fy_ * inv_z, -stereo_fy_ * p.y() * inv_z2,
+             stereo_fx_ * inv_z, 0.0, (stereo_bf_ - stereo_fx_ * p.x()) * inv_z2;
+    PoseJacobian<3>(J_uvr, p, *J);
+  }
+  return Eigen::Vector3d(stereo_.u[i] - u, stereo_.v[i] - v, stereo_.u_right[i] - (u - stereo_bf_ * inv_z));
+}
+
+// ──────────────────────────────────────────────────────────────────────────── //
+// Solver
+
+double PoseSolver::Linearize(const Sophus::SE3d& T_cw, const bool robust, Matrix6d& H, Vector6d& b) const {
+  const Eigen::Matrix3d R = T_cw.rotationMatrix();
+  const Eigen::Vector3d t = T_cw.translation();
+  // Local sums, which the stores to the observation arrays cannot alias.
+  Matrix6d H_sum = Matrix6d::Zero();
+  Vector6d b_sum = Vector6d::Zero();
+  double chi2    = 0.0;
+
+  Eigen::Matrix<double, 2, 6> J2;
+  for (std::size_t i = 0; i < left_.Size(); ++i) {
+    if (!left_.outlier[i]) {
+      const Eigen::Vector2d e = LeftError(i, R, t, &J2);
+      chi2 += Accumulate<2>(e, J2, left_.info[i], kDeltaMono, robust, H_sum, b_sum);
+    }
+  }
+  for (std::size_t i = 0; i < right_.Size(); ++i) {
+    if (!right_.outlier[i]) {
+      const Eigen::Vector2d e = RightError(i, R, t, &J2);
+      chi2 += Accumulate<2>(e, J2, right_.info[i], kDeltaMono, robust, H_sum, b_sum);
+    }
+  }
+  Eigen::Matrix<double, 3, 6> J3;
+  for (std::size_t i = 0; i < stereo_.Size(); ++i) {
+    if (!stereo_.outlier[i]) {
+      const Eigen::Vector3d e = StereoError(i, R, t, &J3);
+      chi2 += Accumulate<3>(e, J3, stereo_.info[i], kDeltaStereo, robust, H_sum, b_sum);
+    }
+  }
+  H = H_sum;
+  b = b_sum;
+  return chi2;
+}
+
+void PoseSolver::Optimize(Sophus::SE3d& T_cw, const bool robust) const {
+  Matrix6d H, H_trial;
+  Vector6d b, b_trial;
+  double chi2   = Linearize(T_cw, robust, H, b);
+  double lambda = kTau * H.diagonal().cwiseAbs().maxCoeff();
+  double ni     = 2.0;
+  int n_slow    = 0;
+
+  for (int iteration = 0; iteration < kIterations; ++iteration) {
+    const double initial_chi2 = chi2;
+    double rho                = 0.0;
+    int trials                = 0;
+    do {
+      // The trial point is linearized with its chi2, so an accepted step
+      // already has the normal equations of the next iteration.
+      Matrix6d A = H;
+      A.diagonal().array() += lambda;
+      const Vector6d dx           = A.selfadjointView<Eigen::Upper>().ldlt().solve(b);
+      const Sophus::SE3d T_trial  = Exp(dx) * T_cw;
+      const double trial_chi2     = Linearize(T_trial, robust, H_trial, b_trial);
+      rho = (chi2 - trial_chi2) / (dx.dot(lambda * dx + b) + 1e-3);
+      if (rho > 0.0 && std::isfinite(trial_chi2)) {
+        const double alpha = 1.0 - std::pow(2.0 * rho - 1.0, 3);
+        lambda *= std::max(kGoodStepLowerScale, std::min(alpha, kGoodStepUpperScale));
+        ni   = 2.0;
+        T_cw = T_trial;
+        H    = H_trial;
+        b    = b_trial;
+        chi2 = trial_chi2;
+      } else {
+        lambda *= ni;
+        ni *= 2.0;
+      }
+      ++trials;
+    } while (rho < 0.0 && trials < kMaxTrials);
+
+    if (trials == kMaxTrials || rho == 0.0) {
+      break;
+    }
+    // Stop after 3 iterations in a row that gain less than 0.1% of the chi2,
+    // as the vendored OptimizationAlgorithmLevenberg::solve.
+    n_slow = (initial_chi2 - chi2) * 1e3 < initial_chi2 ? n_slow + 1 : 0;
+    if (n_slow >= 3) {
+      break;
+    }
+  }
+}
+
+int PoseSolver::Classify(const Sophus::SE3d& T_cw) {
+  const Eigen::Matrix3d R = T_cw.rotationMatrix();
+  const Eigen::Vector3d t = T_cw.translation();
+  int n_bad               = 0;
+  const auto classify     = [&n_bad](Observations& obs, const std::size_t i, const double e2, const float th) {
+    const float chi2 = static_cast<float>(obs.info[i] * e2);
+    obs.outlier[i]   = chi2 > th;
+    n_bad += obs.outlier[i];
+  };
+
+  for (std::size_t i = 0; i < left_.Size(); ++i) {
+    classify(left_, i, LeftError(i, R, t, nullptr).squaredNorm(), kChi2Mono);
+  }
+  for (std::size_t i = 0; i < right_.Size(); ++i) {
+    classify(right_, i, RightError(i, R, t, nullptr).squaredNorm(), kChi2Mono);
+  }
+  for (std::size_t i = 0; i < stereo_.Size(); ++i) {
+    classify(stereo_, i, StereoError(i, R, t, nullptr).squaredNorm(), kChi2Stereo);
+  }
+  return n_bad;
+}
+
+int PoseSolver::Solve(Sophus::SE3d& T_cw, std::vector<bool>& outliers) {
+  Observations* const kinds[] = {&left_, &right_, &stereo_};
+  for (Observations* obs : kinds) {
+    std::fill(obs->outlier.begin(), obs->outlier.end(), 0);
+  }
+
+  const int n = static_cast<int>(NumObservations());
+  int n_bad   = 0;
+  if (n >= 3) {
+    Sophus::SE3d T = T_cw;
+    for (int round = 0; round < kRounds; ++round) {
+      // Every round starts again from the initial pose, with the inliers of
+      // the previous one. Like g2o, no step without any inlier.
+      T = T_cw;
+      if (n_bad < n) {
+        Optimize(T, round < kRobustRounds);
+      }
+      n_bad = Classify(T);
+      if (n < kMinForRounds) {
+        break;
+      }
+    }
+    T_cw = T;
+  }
+
+  for (const Observations* obs : kinds) {
+    for (std::size_t i = 0; i < obs->Size(); ++i) {
+      outliers[obs->index[i]] = obs->outlier[i] != 0;
+    }
+  }
+  return n >= 3 ? n - n_bad : 0;
+}
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,161 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef POSE_SOLVER_H
+#define POSE_SOLVER_H
+
+// Standard
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+// 3rdparty
+#include <Eigen/Core>
+#include <orbslam3/external/Sophus/sophus/se3.hpp>
+
+namespace ORB_SLAM3 {
+
+class GeometricCamera;
+
+// Projection of a camera, with a closed form for the pinhole model. The other
+// models go through GeometricCamera in single precision, as the g2o edges.
+struct CameraProjection {
+  const GeometricCamera* camera = nullptr;
+  bool pinhole                  = false;
+  double fx = 0.0, fy = 0.0, cx = 0.0, cy = 0.0;
+
+  void Set(const GeometricCamera* model);
+  // Pixel of the camera point p, and its derivative wrt p.
+  void Project(const Eigen::Vector3d& p, Eigen::Vector2d& uv, Eigen::Matrix<double, 2, 3>& J) const;
+};
+
+// Motion-only refinement of the pose of a frame from its matched map points,
+// with the problem of Optimizer::PoseOptimization: reprojection errors in the
+// left camera, in the right camera of a rig, or in a rectified stereo pair,
+// a Huber kernel, and rounds of Levenberg-Marquardt iterations between which
+// the observations are reclassified as inliers or outliers by a chi2 test.
+//
+// The observations are stored per kind as contiguous arrays and the normal
+// equations are a fixed 6x6 system, so a solver that is kept between frames
+// does not allocate once its arrays have grown to the number of matches. The
+// steps and the damping follow g2o::OptimizationAlgorithmLevenberg, and so
+// does the stop of a round after 3 iterations in a row that gain less than
+// 0.1% of the chi2, a rule of the vendored g2o. The poses and the outliers
+// agree with the g2o graph up to rounding.
+class PoseSolver {
+public:
+  using Matrix6d = Eigen::Matrix<double, 6, 6>;
+  using Vector6d = Eigen::Matrix<double, 6, 1>;
+
+  // Schedule of Optimizer::PoseOptimization.
+  static constexpr int kRounds       = 4;  // outlier classifications
+  static constexpr int kIterations   = 10; // iterations per round
+  static constexpr int kRobustRounds = 3;  // first rounds with the Huber kernel
+  static constexpr int kMinForRounds = 10; // observations to run past the first round
+  static constexpr float kChi2Mono   = 5.991f; // 95% with 2 degrees of freedom
+  static constexpr float kChi2Stereo = 7.815f; // 95% with 3 degrees of freedom
+
+  PoseSolver() = default;
+
+  // Drop the observations of the previous frame and set the cameras: `left`
+  // for the left observations, `right` and the transform from the left to the
+  // right camera for the right ones. The cameras are not owned.
+  void Reset(
+    const GeometricCamera* left,
+    const GeometricCamera* right = nullptr,
+    const Sophus::SE3d& T_rl     = Sophus::SE3d()
+  );
+
+  // Calibration of the rectified pair of the stereo observations.
+  void SetStereo(const double fx, const double fy, const double cx, const double cy, const double bf);
+
+  // Observation `index` of the map point at `x_w`, with the information
+  // inv_sigma2 * I of its octave. The index is the one of the outlier flags
+  // written by Solve.
+  void AddLeft(std::size_t index, const Eigen::Vector3d& x_w, const Eigen::Vector2d& uv, double inv_sigma2);
+  void AddRight(std::size_t index, const Eigen::Vector3d& x_w, const Eigen::Vector2d& uv, double inv_sigma2);
+  // (u, v, u_right) in the rectified left image.
+  void AddStereo(std::size_t index, const Eigen::Vector3d& x_w, const Eigen::Vector3d& uvr, double inv_sigma2);
+
+  std::size_t NumObservations() const { return left_.Size() + right_.Size() + stereo_.Size(); }
+
+  // Refine T_cw, the initial pose of every round, and write the class of each
+  // observation to outliers[index]. Returns the number of inliers, or 0 with
+  // the pose untouched when there are fewer than 3 observations.
+  int Solve(Sophus::SE3d& T_cw, std::vector<bool>& outliers);
+
+private:
+  // Observations of one kind, as a structure of arrays.
+  struct Observations {
+    std::vector<double> x, y, z; // map point
+    std::vector<double> u, v, u_right;
+    std::vector<double> info;
+    std::vector<std::uint32_t> index;
+    std::vector<std::uint8_t> outlier;
+
+    std::size_t Size() const { return index.size(); }
+    void Clear();
+    void Add(std::size_t i, const Eigen::Vector3d& x_w, double obs_u, double obs_v, double inv_sigma2);
+  };
+
+  // Error of observation i of each kind with the pose (R, t), and its
+  // derivative wrt the update dx of exp(dx) * T_cw when J is given.
+  Eigen::Vector2d LeftError(
+    std::size_t i,
+    const Eigen::Matrix3d& R,
+    const Eigen::Vector3d& t,
+    Eigen::Matrix<double, 2, 6>* J
+  ) const;
+  Eigen::Vector2d RightError(
+    std::size_t i,
+    const Eigen::Matrix3d& R,
+    const Eigen::Vector3d& t,
+    Eigen::Matrix<double, 2, 6>* J
+  ) const;
+  Eigen::Vector3d StereoError(
+    std::size_t i,
+    const Eigen::Matrix3d& R,
+    const Eigen::Vector3d& t,
+    Eigen::Matrix<double, 3, 6>* J
+  ) const;
+
+  // Robust (or plain) chi2 of the inliers at T_cw, and the normal equations
+  // H dx = b of the Gauss-Newton step, H in its upper triangle.
+  double Linearize(const Sophus::SE3d& T_cw, bool robust, Matrix6d& H, Vector6d& b) const;
+
+  // At most kIterations Levenberg-Marquardt iterations from T_cw.
+  void Optimize(Sophus::SE3d& T_cw, bool robust) const;
+
+  // Reclassify every observation at T_cw, returns the number of outliers.
+  int Classify(const Sophus::SE3d& T_cw);
+
+  CameraProjection left_camera_, right_camera_;
+  Eigen::Matrix3d R_rl_ = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d t_rl_ = Eigen::Vector3d::Zero();
+  double stereo_fx_ = 0.0, stereo_fy_ = 0.0, stereo_cx_ = 0.0, stereo_cy_ = 0.0, stereo_bf_ = 0.0;
+
+  Observations left_, right_, stereo_;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // POSE_SOLVER_H
@@ -0,0 +1,288 @@
+// Standard
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <orbslam3/external/g2o/g2o/core/block_solver.h>
+#include <orbslam3/external/g2o/g2o/core/optimization_algorithm_levenberg.h>
+#include <orbslam3/external/g2o/g2o/core/robust_kernel_impl.h>
+#include <orbslam3/external/g2o/g2o/core/sparse_optimizer.h>
+#include <orbslam3/external/g2o/g2o/solvers/linear_solver_dense.h>
+// Local
+#include "orbslam3/CameraModels/Pinhole.h"
+#include "orbslam3/OptimizableTypes.h"
+#include "orbslam3/PoseSolver.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+constexpr double kFx = 450.0;
+constexpr double kFy = 450.0;
+constexpr double kCx = 320.0;
+constexpr double kCy = 240.0;
+constexpr double kBf = 0.1 * kFx; // 10cm baseline
+
+Pinhole MakeCamera() {
+  return Pinhole({static_cast<float>(kFx), static_cast<float>(kFy), static_cast<float>(kCx), static_cast<float>(kCy)});
+}
+
+Sophus::SE3d TruePose() {
+  return Sophus::SE3d(
+    Sophus::SO3d::exp(Eigen::Vector3d(0.05, -0.1, 0.02)),
+    Eigen::Vector3d(0.2, -0.1, 0.3)
+  );
+}
+
+// Perturbation of the true pose, the initial guess of the solver.
+Sophus::SE3d Perturb(const Sophus::SE3d& T) {
+  return Sophus::SE3d(Sophus::SO3d::exp(Eigen::Vector3d(0.01, 0.015, -0.01)), Eigen::Vector3d(0.03, -0.02, 0.04)) * T;
+}
+
+// Random points in front of the camera at T_cw.
+std::vector<Eigen::Vector3d> RandomPoints(const Sophus::SE3d& T_cw, const std::size_t count, const unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> xy(-2.0, 2.0);
+  std::uniform_real_distribution<double> z(2.0, 8.0);
+  const Sophus::SE3d T_wc = T_cw.inverse();
+  std::vector<Eigen::Vector3d> points(count);
+  for (Eigen::Vector3d& p : points) {
+    p = T_wc * Eigen::Vector3d(xy(rng), xy(rng), z(rng));
+  }
+  return points;
+}
+
+Eigen::Vector2d Project(const Eigen::Vector3d& p) {
+  return Eigen::Vector2d(kFx * p.x() / p.z() + kCx, kFy * p.y() / p.z() + kCy);
+}
+
+void ExpectNear(const Sophus::SE3d& T, const Sophus::SE3d& expected, const double tolerance) {
+  EXPECT_LT((T.translation() - expected.translation()).norm(), tolerance);
+  EXPECT_LT((T.so3() * expected.so3().inverse()).log().norm(), tolerance);
+}
+
+// Monocular and stereo matches of a frame, with noise and wrong matches.
+struct Matches {
+  std::vector<Eigen::Vector3d> points;
+  std::vector<Eigen::Vector3d> uvrs; // u_right < 0 for a monocular match
+};
+
+Matches NoisyMatches(const Sophus::SE3d& T_cw, const std::size_t count, const unsigned seed) {
+  Matches matches;
+  matches.points = RandomPoints(T_cw, count, seed);
+  std::mt19937 rng(seed + 1);
+  std::normal_distribution<double> noise(0.0, 0.7);
+  for (std::size_t i = 0; i < count; ++i) {
+    const Eigen::Vector3d p = T_cw * matches.points[i];
+    Eigen::Vector2d uv      = Project(p) + Eigen::Vector2d(noise(rng), noise(rng));
+    if (i % 9 == 0) {
+      uv += Eigen::Vector2d(25.0, -15.0);
+    }
+    const double u_right = i % 3 == 0 ? uv.x() - kBf / p.z() + noise(rng) : -1.0;
+    matches.uvrs.emplace_back(uv.x(), uv.y(), u_right);
+  }
+  return matches;
+}
+
+// The graph and the rounds of Optimizer::PoseOptimizationG2o on the matches.
+Sophus::SE3d SolveWithG2o(
+  const Matches& matches,
+  const Pinhole& camera,
+  const Sophus::SE3d& T_init,
+  std::vector<bool>& outliers
+) {
+  g2o::SparseOptimizer optimizer;
+  auto* linear_solver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
+  optimizer.setAlgorithm(new g2o::OptimizationAlgorithmLevenberg(new g2o::BlockSolver_6_3(linear_solver)));
+
+  const g2o::SE3Quat initial(T_init.unit_quaternion(), T_init.translation());
+  auto* vertex = new g2o::VertexSE3Expmap();
+  vertex->setEstimate(initial);
+  vertex->setId(0);
+  optimizer.addVertex(vertex);
+
+  std::vector<g2o::OptimizableGraph::Edge*> edges;
+  for (std::size_t i = 0; i < matches.points.size(); ++i) {
+    const Eigen::Vector3d& uvr = matches.uvrs[i];
+    auto* rk                   = new g2o::RobustKernelHuber;
+    if (uvr.z() < 0.0) {
+      auto* e = new EdgeSE3ProjectXYZOnlyPose();
+      e->setMeasurement(uvr.head<2>());
+      e->setInformation(Eigen::Matrix2d::Identity());
+      rk->setDelta(std::sqrt(5.991));
+      e->pCamera = const_cast<Pinhole*>(&camera);
+      e->Xw      = matches.points[i];
+      edges.push_back(e);
+    } else {
+      auto* e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
+      e->setMeasurement(uvr);
+      e->setInformation(Eigen::Matrix3d::Identity());
+      rk->setDelta(std::sqrt(7.815));
+      e->fx = kFx;
+      e->fy = kFy;
+      e->cx = kCx;
+      e->cy = kCy;
+      e->bf = kBf;
+      e->Xw = matches.points[i];
+      edges.push_back(e);
+    }
+    edges.back()->setVertex(0, vertex);
+    edges.back()->setRobustKernel(rk);
+    optimizer.addEdge(edges.back());
+  }
+
+  for (int round = 0; round < PoseSolver::kRounds; ++round) {
+    vertex->setEstimate(initial);
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(PoseSolver::kIterations);
+    for (std::size_t i = 0; i < edges.size(); ++i) {
+      g2o::OptimizableGraph::Edge* e = edges[i];
+      if (outliers[i]) {
+        e->computeError();
+      }
+      const float th = matches.uvrs[i].z() < 0.0 ? PoseSolver::kChi2Mono : PoseSolver::kChi2Stereo;
+      outliers[i]    = static_cast<float>(e->chi2()) > th;
+      e->setLevel(outliers[i] ? 1 : 0);
+      if (round == PoseSolver::kRobustRounds - 1) {
+        e->setRobustKernel(nullptr);
+      }
+    }
+  }
+  const g2o::SE3Quat& T = vertex->estimate();
+  return Sophus::SE3d(T.rotation(), T.translation());
+}
+
+} // namespace
+
+TEST(PoseSolver, TooFewObservations) {
+  const Pinhole camera = MakeCamera();
+  PoseSolver solver;
+  solver.Reset(&camera);
+  const Sophus::SE3d T_true = TruePose();
+  const std::vector<Eigen::Vector3d> points = RandomPoints(T_true, 2, 1);
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    solver.AddLeft(i, points[i], Project(T_true * points[i]), 1.0);
+  }
+
+  const Sophus::SE3d T_init = Perturb(T_true);
+  Sophus::SE3d T            = T_init;
+  std::vector<bool> outliers(points.size(), true);
+  EXPECT_EQ(solver.Solve(T, outliers), 0);
+  EXPECT_EQ(T.matrix(), T_init.matrix());
+  EXPECT_EQ(outliers, std::vector<bool>(points.size(), false));
+}
+
+TEST(PoseSolver, MonocularAndStereo) {
+  const Pinhole camera = MakeCamera();
+  PoseSolver solver;
+  solver.Reset(&camera);
+  solver.SetStereo(kFx, kFy, kCx, kCy, kBf);
+
+  const Sophus::SE3d T_true = TruePose();
+  const std::vector<Eigen::Vector3d> points = RandomPoints(T_true, 100, 2);
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    const Eigen::Vector3d p  = T_true * points[i];
+    const Eigen::Vector2d uv = Project(p);
+    if (i % 2 == 0) {
+      solver.AddLeft(i, points[i], uv, 1.0);
+    } else {
+      solver.AddStereo(i, points[i], Eigen::Vector3d(uv.x(), uv.y(), uv.x() - kBf / p.z()), 1.0);
+    }
+  }
+  ASSERT_EQ(solver.NumObservations(), points.size());
+
+  Sophus::SE3d T = Perturb(T_true);
+  std::vector<bool> outliers(points.size(), true);
+  EXPECT_EQ(solver.Solve(T, outliers), static_cast<int>(points.size()));
+  ExpectNear(T, T_true, 1e-6);
+  EXPECT_EQ(outliers, std::vector<bool>(points.size(), false));
+}
+
+TEST(PoseSolver, RejectsOutliers) {
+  const Pinhole camera = MakeCamera();
+  PoseSolver solver;
+  solver.Reset(&camera);
+
+  const Sophus::SE3d T_true = TruePose();
+  const std::vector<Eigen::Vector3d> points = RandomPoints(T_true, 100, 3);
+  std::mt19937 rng(4);
+  std::normal_distribution<double> noise(0.0, 0.5);
+  std::vector<bool> expected(points.size(), false);
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    Eigen::Vector2d uv = Project(T_true * points[i]) + Eigen::Vector2d(noise(rng), noise(rng));
+    // Every tenth match is wrong by tens of pixels.
+    if (i % 10 == 0) {
+      uv += Eigen::Vector2d(40.0, -30.0);
+      expected[i] = true;
+    }
+    solver.AddLeft(i, points[i], uv, 1.0);
+  }
+
+  Sophus::SE3d T = Perturb(T_true);
+  std::vector<bool> outliers(points.size(), false);
+  EXPECT_EQ(solver.Solve(T, outliers), 90);
+  ExpectNear(T, T_true, 1e-2);
+  EXPECT_EQ(outliers, expected);
+}
+
+TEST(PoseSolver, RigidRig) {
+  const Pinhole left  = MakeCamera();
+  const Pinhole right = MakeCamera();
+  const Sophus::SE3d T_rl(Sophus::SO3d::exp(Eigen::Vector3d(0.0, 0.1, 0.0)), Eigen::Vector3d(-0.2, 0.0, 0.0));
+  PoseSolver solver;
+
+  const Sophus::SE3d T_true = TruePose();
+  const std::vector<Eigen::Vector3d> points = RandomPoints(T_true, 60, 5);
+  // The same solver is reused, as between two frames.
+  for (int frame = 0; frame < 2; ++frame) {
+    solver.Reset(&left, &right, T_rl);
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      const Eigen::Vector3d p = T_true * points[i];
+      if (i < points.size() / 2) {
+        solver.AddLeft(i, points[i], Project(p), 1.0);
+      } else {
+        solver.AddRight(i, points[i], Project(T_rl * p), 1.0);
+      }
+    }
+    ASSERT_EQ(solver.NumObservations(), points.size());
+
+    Sophus::SE3d T = Perturb(T_true);
+    std::vector<bool> outliers(points.size(), true);
+    EXPECT_EQ(solver.Solve(T, outliers), static_cast<int>(points.size()));
+    ExpectNear(T, T_true, 1e-4);
+  }
+}
+
+TEST(PoseSolver, MatchesG2o) {
+  const Pinhole camera = MakeCamera();
+  const Sophus::SE3d T_true = TruePose();
+  const Sophus::SE3d T_init = Perturb(T_true);
+  const Matches matches     = NoisyMatches(T_true, 120, 6);
+
+  PoseSolver solver;
+  solver.Reset(&camera);
+  solver.SetStereo(kFx, kFy, kCx, kCy, kBf);
+  for (std::size_t i = 0; i < matches.points.size(); ++i) {
+    const Eigen::Vector3d& uvr = matches.uvrs[i];
+    if (uvr.z() < 0.0) {
+      solver.AddLeft(i, matches.points[i], uvr.head<2>(), 1.0);
+    } else {
+      solver.AddStereo(i, matches.points[i], uvr, 1.0);
+    }
+  }
+  Sophus::SE3d T = T_init;
+  std::vector<bool> outliers(matches.points.size(), false);
+  const int n_inliers = solver.Solve(T, outliers);
+
+  std::vector<bool> g2o_outliers(matches.points.size(), false);
+  const Sophus::SE3d T_g2o = SolveWithG2o(matches, camera, T_init, g2o_outliers);
+  // The monocular edges of g2o project in single precision.
+  ExpectNear(T, T_g2o, 1e-5);
+  EXPECT_EQ(outliers, g2o_outliers);
+  EXPECT_EQ(n_inliers, std::count(g2o_outliers.begin(), g2o_outliers.end(), false));
+  // Some of the wrong matches and of the noisy ones are rejected.
+  EXPECT_GT(n_inliers, 90);
+  EXPECT_LT(n_inliers, 110);
+}
@@ -446,6 +446,16 @@ namespace ORB_SLAM3 {
         nLevels_ = readParameter<int>(fSettings,"ORBextractor.nLevels",found);
         initThFAST_ = readParameter<int>(fSettings,"ORBextractor.iniThFAST",found);
         minThFAST_ = readParameter<int>(fSettings,"ORBextractor.minThFAST",found);
+
+        parallelExtraction_ = readParameter<int>(fSettings,"ORBextractor.parallel",found,false) != 0;
+
+        reuseExtractorBuffers_ = readParameter<int>(fSettings,"ORBextractor.reuseBuffers",found,false) != 0;
+        if(!found)
+            reuseExtractorBuffers_ = true;
+
+        descriptorAngleBins_ = readParameter<int>(fSettings,"ORBextractor.angleBins",found,false);
+        if(!found)
+            descriptorAngleBins_ = 0;
     }
 
     void Settings::readViewer(cv::FileStorage &fSettings) {
@@ -472,12 +482,27 @@ namespace ORB_SLAM3 {
 
         sLoadFrom_ = readParameter<std::string>(fSettings,"System.LoadAtlasFromFile",found,false);
         sSaveto_ = readParameter<std::string>(fSettings,"System.SaveAtlasToFile",found,false);
+        bLazyLoad_ = readParameter<int>(fSettings,"System.LazyLoadAtlas",found,false) != 0;
     }
 
     void Settings::readOtherParameters(cv::FileStorage& fSettings) {
         bool found;
 
         thFarPoints_ = readParameter<float>(fSettings,"System.thFarPoints",found,false);
+
+        nThreads_ = readParameter<int>(fSettings,"System.nThreads",found,false);
+        if(!found)
+            nThreads_ = -1;
+
+        bReclaimMapPoints_ = readParameter<int>(fSettings,"System.ReclaimMapPoints",found,false) != 0;
+
+        nTrackingPipelineDepth_ = readParameter<int>(fSettings,"System.TrackingPipelineDepth",found,false);
+        if(!found)
+            nTrackingPipelineDepth_ = 2;
+
+        bDensePoseSolver_ = readParameter<int>(fSettings,"System.DensePoseSolver",found,false) != 0;
+        if(!found)
+            bDensePoseSolver_ = true;
     }
 
     void Settings::precomputeRectificationMaps() {
@@ -630,6 +655,9 @@ namespace ORB_SLAM3 {
         output << "\t-ORB number of scales: " << settings.nLevels_ << std::endl;
         output << "\t-Initial FAST threshold: " << settings.initThFAST_ << std::endl;
         output << "\t-Min FAST threshold: " << settings.minThFAST_ << std::endl;
+        output << "\t-Parallel extraction: " << (settings.parallelExtraction_ ? "yes" : "no") << std::endl;
+        output << "\t-Reused extraction buffers: " << (settings.reuseExtractorBuffers_ ? "yes" : "no") << std::endl;
+        output << "\t-Descriptor angle bins: " << settings.descriptorAngleBins_ << std::endl;
 
         return output;
     }
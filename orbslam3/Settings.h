@@ -100,6 +100,9 @@ namespace ORB_SLAM3 {
         float initThFAST() {return initThFAST_;}
         float minThFAST() {return minThFAST_;}
         float scaleFactor() {return scaleFactor_;}
+        bool parallelExtraction() {return parallelExtraction_;}
+        bool reuseExtractorBuffers() {return reuseExtractorBuffers_;}
+        int descriptorAngleBins() {return descriptorAngleBins_;}
 
         float keyFrameSize() {return keyFrameSize_;}
         float keyFrameLineWidth() {return keyFrameLineWidth_;}
@@ -115,8 +118,13 @@ namespace ORB_SLAM3 {
 
         std::string atlasLoadFile() {return sLoadFrom_;}
         std::string atlasSaveFile() {return sSaveto_;}
+        bool atlasLazyLoad() {return bLazyLoad_;}
 
         float thFarPoints() {return thFarPoints_;}
+        int nThreads() {return nThreads_;}
+        bool reclaimMapPoints() {return bReclaimMapPoints_;}
+        int trackingPipelineDepth() {return nTrackingPipelineDepth_;}
+        bool densePoseSolver() {return bDensePoseSolver_;}
 
         cv::Mat M1l() {return M1l_;}
         cv::Mat M2l() {return M2l_;}
@@ -206,6 +214,9 @@ namespace ORB_SLAM3 {
         float scaleFactor_;
         int nLevels_;
         int initThFAST_, minThFAST_;
+        bool parallelExtraction_;
+        bool reuseExtractorBuffers_; //Keep the pyramid and scratch buffers of the extractors between frames
+        int descriptorAngleBins_; //Quantized steering of the descriptors, 0 for the exact rotation
 
         /*
          * Viewer stuff
@@ -223,12 +234,16 @@ namespace ORB_SLAM3 {
          * Save & load maps
          */
         std::string sLoadFrom_, sSaveto_;
+        bool bLazyLoad_; //Load the maps of the atlas on demand
 
         /*
          * Other stuff
          */
         float thFarPoints_;
-
+        int nThreads_; //Workers of the shared thread pool, -1 to pick from the hardware
+        bool bReclaimMapPoints_; //Free the culled MapPoints once no thread can hold them
+        int nTrackingPipelineDepth_; //Frames in flight in the asynchronous tracking
+        bool bDensePoseSolver_; //Refine the frame poses with PoseSolver and InertialPoseSolver instead of g2o graphs
     };
 };
 
@@ -0,0 +1,148 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+// Standard
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// Bounded queue between exactly one producer thread and one consumer thread,
+// used for the IMU measurements handed to the tracking.
+//
+// The slots are allocated once, at construction, and both sides are wait-free:
+// the producer only writes the tail index and the consumer the head index,
+// each published with release/acquire ordering. The capacity is rounded up to
+// a power of two. When the buffer is full, TryPush() fails and counts the
+// rejected item instead of blocking the producer.
+//
+// Producer methods: TryPush(). Consumer methods: Front(), Pop(), Clear() and
+// ExtractRange(). Size() and Empty() are approximate from the producer side.
+template <typename T>
+class SpscRingBuffer {
+public:
+  explicit SpscRingBuffer(const std::size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(capacity) - 1), slots_(new T[mask_ + 1]) {}
+
+  SpscRingBuffer(const SpscRingBuffer&)            = delete;
+  SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+  // Append an item, returns false if the buffer is full.
+  bool TryPush(const T& item) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    slots_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Oldest item, nullptr if the buffer is empty. Valid until Pop().
+  const T* Front() const {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &slots_[head & mask_];
+  }
+
+  // Remove the oldest item, the buffer must not be empty.
+  void Pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // Remove all the items pushed so far.
+  void Clear() {
+    head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  // For items pushed in time order: discard the items older than `begin`, move
+  // those older than `end` to `out`, then append a copy of the first item at
+  // or after `end`, which bounds the range and stays in the buffer. Returns
+  // the number of items appended.
+  template <typename Time, typename GetTime>
+  std::size_t ExtractRange(const Time begin, const Time end, GetTime get_time, std::vector<T>& out) {
+    std::size_t head       = head_.load(std::memory_order_relaxed);
+    const std::size_t tail = tail_.load(std::memory_order_acquire);
+    const std::size_t size = out.size();
+    for (; head != tail; ++head) {
+      const T& item = slots_[head & mask_];
+      const Time t  = get_time(item);
+      if (t < begin) {
+        continue;
+      }
+      out.push_back(item);
+      if (!(t < end)) {
+        break;
+      }
+    }
+    head_.store(head, std::memory_order_release);
+    return out.size() - size;
+  }
+
+  std::size_t Size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+
+  bool Empty() const {
+    return Size() == 0;
+  }
+
+  std::size_t Capacity() const {
+    return mask_ + 1;
+  }
+
+  // Items rejected by TryPush() because the buffer was full.
+  std::size_t Dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static std::size_t RoundUpToPowerOfTwo(const std::size_t n) {
+    std::size_t power = 1;
+    while (power < n) {
+      power <<= 1;
+    }
+    return power;
+  }
+
+  // The indices are only increased, and wrap around with the unsigned
+  // arithmetic. They live on separate cache lines, so that the producer and
+  // the consumer do not invalidate each other's line on every item.
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  const std::size_t mask_;
+  const std::unique_ptr<T[]> slots_;
+  alignas(kCacheLineSize) std::atomic<std::size_t> head_{0}; // Written by the consumer
+  alignas(kCacheLineSize) std::atomic<std::size_t> tail_{0}; // Written by the producer
+  alignas(kCacheLineSize) std::atomic<std::size_t> dropped_{0};
+};
+
+} // namespace ORB_SLAM3
+
+#endif // SPSC_RING_BUFFER_H
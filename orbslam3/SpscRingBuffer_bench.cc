@@ -0,0 +1,143 @@
+// Microbenchmark of the IMU queue of the tracking: a producer thread pushes
+// IMU measurements as fast as possible while the consumer extracts them frame
+// by frame, as PreintegrateIMU does. Compares the historical std::list under
+// a mutex with the SPSC ring buffer.
+//
+// Usage: SpscRingBuffer_bench [n_measurements] [measurements_per_frame]
+
+// Standard
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+// Local
+#include "orbslam3/ImuTypes.h"
+#include "orbslam3/SpscRingBuffer.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+constexpr double kImuPeriod = 0.001; // 1 kHz timestamps
+
+// The std::list queue and the extraction loop of PreintegrateIMU before the
+// ring buffer.
+class ListQueue {
+public:
+  void Push(const IMU::Point& m) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.push_back(m);
+  }
+
+  void Extract(const double begin, const double end, std::vector<IMU::Point>& out) {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (queue_.empty()) {
+        break;
+      }
+      const IMU::Point& m = queue_.front();
+      if (m.t < begin) {
+        queue_.pop_front();
+      } else if (m.t < end) {
+        out.push_back(m);
+        queue_.pop_front();
+      } else {
+        out.push_back(m);
+        break;
+      }
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  std::list<IMU::Point> queue_;
+};
+
+class RingQueue {
+public:
+  explicit RingQueue(const std::size_t capacity) : buffer_(capacity) {}
+
+  void Push(const IMU::Point& m) {
+    while (!buffer_.TryPush(m)) {
+      std::this_thread::yield();
+    }
+  }
+
+  void Extract(const double begin, const double end, std::vector<IMU::Point>& out) {
+    buffer_.ExtractRange(begin, end, [](const IMU::Point& m) { return m.t; }, out);
+  }
+
+private:
+  SpscRingBuffer<IMU::Point> buffer_;
+};
+
+// Push `n` measurements from a producer thread and extract them in frames of
+// `per_frame` measurements.
+template <typename Queue>
+void Run(const char* name, Queue& queue, const int n, const int per_frame) {
+  std::atomic<int> pushed{-1};
+  double push_seconds = 0.0;
+  std::thread producer([&]() {
+    while (pushed.load() < 0) {
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      queue.Push(IMU::Point(0.1f, 0.2f, 9.8f, 0.01f, 0.02f, 0.03f, i * kImuPeriod));
+      pushed.store(i + 1, std::memory_order_release);
+    }
+    push_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  });
+
+  std::vector<IMU::Point> measurements;
+  measurements.reserve(per_frame + 1);
+  std::size_t extracted  = 0;
+  double extract_seconds = 0.0;
+  int frames             = 0;
+  pushed                 = 0;
+  for (int frame = 1; (frame + 1) * per_frame < n; ++frame, ++frames) {
+    // Wait for the measurement after the frame, as the tracking waits for the next image.
+    while (pushed.load(std::memory_order_acquire) <= frame * per_frame) {
+    }
+    const double previous = (frame - 1) * per_frame * kImuPeriod;
+    const double current  = frame * per_frame * kImuPeriod;
+    measurements.clear();
+    const auto begin = std::chrono::steady_clock::now();
+    queue.Extract(previous - kImuPeriod / 2, current - kImuPeriod / 2, measurements);
+    extract_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    extracted += measurements.size();
+  }
+  producer.join();
+
+  std::printf(
+    "%-6s push %8.2f Mmeas/s %7.1f ns/meas | extract %8.3f us/frame (%zu measurements, %d frames)\n",
+    name,
+    n / push_seconds * 1e-6,
+    push_seconds * 1e9 / n,
+    extract_seconds * 1e6 / frames,
+    extracted,
+    frames
+  );
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int n         = argc > 1 ? std::atoi(argv[1]) : 2000000;
+  const int per_frame = argc > 2 ? std::atoi(argv[2]) : 33; // 30 Hz images
+  if (n <= 0 || per_frame <= 0) {
+    std::fprintf(stderr, "Usage: %s [n_measurements] [measurements_per_frame]\n", argv[0]);
+    return 1;
+  }
+
+  ListQueue list;
+  Run("list", list, n, per_frame);
+
+  RingQueue ring(1 << 16);
+  Run("ring", ring, n, per_frame);
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Standard
+#include <thread>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/SpscRingBuffer.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+struct Sample {
+  double t = 0.0;
+  int value = 0;
+};
+
+double GetTime(const Sample& sample) {
+  return sample.t;
+}
+
+} // namespace
+
+TEST(SpscRingBuffer, PushPop) {
+  SpscRingBuffer<int> buffer(3);
+  EXPECT_EQ(buffer.Capacity(), 4u);
+  EXPECT_EQ(buffer.Front(), nullptr);
+
+  // Wrap around the slots several times.
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_TRUE(buffer.TryPush(round * 4 + i));
+    }
+    EXPECT_FALSE(buffer.TryPush(-1));
+    EXPECT_EQ(buffer.Size(), 4u);
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_NE(buffer.Front(), nullptr);
+      EXPECT_EQ(*buffer.Front(), round * 4 + i);
+      buffer.Pop();
+    }
+    EXPECT_TRUE(buffer.Empty());
+  }
+  EXPECT_EQ(buffer.Dropped(), 3u);
+
+  buffer.TryPush(1);
+  buffer.TryPush(2);
+  buffer.Clear();
+  EXPECT_TRUE(buffer.Empty());
+}
+
+TEST(SpscRingBuffer, ExtractRange) {
+  SpscRingBuffer<Sample> buffer(16);
+  for (int i = 0; i < 10; ++i) {
+    buffer.TryPush({0.1 * i, i});
+  }
+
+  // Samples 3 to 6 are in [0.25, 0.65), sample 7 bounds the range and is kept.
+  std::vector<Sample> samples;
+  EXPECT_EQ(buffer.ExtractRange(0.25, 0.65, GetTime, samples), 5u);
+  ASSERT_EQ(samples.size(), 5u);
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    EXPECT_EQ(samples[i].value, static_cast<int>(i) + 3);
+  }
+  ASSERT_NE(buffer.Front(), nullptr);
+  EXPECT_EQ(buffer.Front()->value, 7);
+
+  // A range past the last sample empties the buffer.
+  samples.clear();
+  EXPECT_EQ(buffer.ExtractRange(0.65, 2.0, GetTime, samples), 3u);
+  EXPECT_TRUE(buffer.Empty());
+}
+
+TEST(SpscRingBuffer, Concurrent) {
+  constexpr int kCount = 20000;
+  SpscRingBuffer<Sample> buffer(64);
+
+  std::thread producer([&buffer]() {
+    for (int i = 0; i < kCount; ++i) {
+      while (!buffer.TryPush({static_cast<double>(i), i})) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // The consumer sees every sample once, in order.
+  std::vector<Sample> samples;
+  int expected = 0;
+  while (expected < kCount) {
+    samples.clear();
+    buffer.ExtractRange(-1.0, static_cast<double>(kCount), GetTime, samples);
+    for (const Sample& sample : samples) {
+      ASSERT_EQ(sample.value, expected);
+      ++expected;
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(buffer.Empty());
+}
@@ -0,0 +1,276 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Standard
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+// 3rdparty
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define ORB_SLAM3_STEREO_X86
+#endif
+// Local
+#include "orbslam3/StereoMatching.h"
+
+namespace ORB_SLAM3 {
+namespace Stereo {
+
+namespace {
+
+constexpr int kWindowSize = 2 * kWindowHalfSize + 1;
+
+// Kernels get the top-left pixel of the left window and of the leftmost right
+// window, and write the kOffsets sums.
+using SadsFn = void (*)(const std::uint8_t*, std::ptrdiff_t, const std::uint8_t*, std::ptrdiff_t, int*);
+
+// ──────────────────────────── //
+// Scalar
+
+void SadsScalar(
+  const std::uint8_t* left,
+  const std::ptrdiff_t left_step,
+  const std::uint8_t* right,
+  const std::ptrdiff_t right_step,
+  int* sads
+) {
+  for (int d = 0; d < kOffsets; ++d) {
+    int sad = 0;
+    for (int y = 0; y < kWindowSize; ++y) {
+      const std::uint8_t* l = left + y * left_step;
+      const std::uint8_t* r = right + y * right_step + d;
+      for (int x = 0; x < kWindowSize; ++x) {
+        sad += std::abs(static_cast<int>(l[x]) - static_cast<int>(r[x]));
+      }
+    }
+    sads[d] = sad;
+  }
+}
+
+#ifdef ORB_SLAM3_STEREO_X86
+
+// ──────────────────────────── //
+// x86 SSE2
+
+// A window row is read as 16 bytes, the ones past the window are masked out on
+// both sides so that they add nothing to the sums.
+__attribute__((target("sse2"))) inline __m128i RowMask128() {
+  return _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0);
+}
+
+__attribute__((target("sse2"))) void SadsSSE2(
+  const std::uint8_t* left,
+  const std::ptrdiff_t left_step,
+  const std::uint8_t* right,
+  const std::ptrdiff_t right_step,
+  int* sads
+) {
+  static_assert(kWindowSize <= 16, "A window row must fit in a register");
+  const __m128i mask = RowMask128();
+
+  __m128i acc[kOffsets];
+  for (int d = 0; d < kOffsets; ++d) {
+    acc[d] = _mm_setzero_si128();
+  }
+  for (int y = 0; y < kWindowSize; ++y) {
+    const __m128i l = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left + y * left_step)), mask);
+    const std::uint8_t* r = right + y * right_step;
+    for (int d = 0; d < kOffsets; ++d) {
+      const __m128i rd = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r + d)), mask);
+      acc[d]           = _mm_add_epi32(acc[d], _mm_sad_epu8(l, rd));
+    }
+  }
+  for (int d = 0; d < kOffsets; ++d) {
+    sads[d] = _mm_cvtsi128_si32(_mm_add_epi32(acc[d], _mm_unpackhi_epi64(acc[d], acc[d])));
+  }
+}
+
+// ──────────────────────────── //
+// x86 AVX2
+
+// Rows y and y + 1 of the window, one per 128-bit lane (row y + 1 zero past
+// the window).
+__attribute__((target("avx2"))) inline __m256i LoadRowPair(
+  const std::uint8_t* row,
+  const std::ptrdiff_t step,
+  const bool second,
+  const __m256i mask
+) {
+  const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+  const __m128i hi = second ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + step)) : _mm_setzero_si128();
+  return _mm256_and_si256(_mm256_set_m128i(hi, lo), mask);
+}
+
+__attribute__((target("avx2"))) void SadsAVX2(
+  const std::uint8_t* left,
+  const std::ptrdiff_t left_step,
+  const std::uint8_t* right,
+  const std::ptrdiff_t right_step,
+  int* sads
+) {
+  const __m256i mask = _mm256_broadcastsi128_si256(RowMask128());
+
+  __m256i acc[kOffsets];
+  for (int d = 0; d < kOffsets; ++d) {
+    acc[d] = _mm256_setzero_si256();
+  }
+  for (int y = 0; y < kWindowSize; y += 2) {
+    const bool second = y + 1 < kWindowSize;
+    const __m256i l   = LoadRowPair(left + y * left_step, left_step, second, mask);
+    const std::uint8_t* r = right + y * right_step;
+    for (int d = 0; d < kOffsets; ++d) {
+      acc[d] = _mm256_add_epi32(acc[d], _mm256_sad_epu8(l, LoadRowPair(r + d, right_step, second, mask)));
+    }
+  }
+  for (int d = 0; d < kOffsets; ++d) {
+    const __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc[d]), _mm256_extracti128_si256(acc[d], 1));
+    sads[d]           = _mm_cvtsi128_si32(_mm_add_epi32(sum, _mm_unpackhi_epi64(sum, sum)));
+  }
+}
+
+#endif // ORB_SLAM3_STEREO_X86
+
+// ──────────────────────────── //
+// Dispatch
+
+SadsFn KernelFunction(const Kernel kernel) {
+  switch (kernel) {
+#ifdef ORB_SLAM3_STEREO_X86
+    case Kernel::SSE2: return SadsSSE2;
+    case Kernel::AVX2: return SadsAVX2;
+#endif
+    default:           return SadsScalar;
+  }
+}
+
+Kernel DetectKernel() {
+  for (const Kernel kernel : {Kernel::AVX2, Kernel::SSE2}) {
+    if (IsSupported(kernel)) {
+      return kernel;
+    }
+  }
+  return Kernel::Scalar;
+}
+
+std::atomic<Kernel>& CurrentKernel() {
+  static std::atomic<Kernel> kernel(DetectKernel());
+  return kernel;
+}
+
+// Whether [first, first + size) lies in the buffer of the image: the kernels
+// read up to 5 bytes past the windows, which are usually inside the padded
+// pyramid levels but may not be at the end of the buffer.
+inline bool Readable(const cv::Mat& image, const std::uint8_t* first, const std::ptrdiff_t size) {
+  return first >= image.datastart && first + size <= image.datalimit;
+}
+
+} // namespace
+
+bool WindowSads(const cv::Mat& left, const cv::Mat& right, const int u_left, const int u_right, const int v, int* sads) {
+  assert(left.type() == CV_8UC1 && right.type() == CV_8UC1);
+  constexpr int w = kWindowHalfSize;
+  constexpr int l = kSearchRadius;
+  if (v - w < 0 || v + w >= left.rows || v + w >= right.rows) {
+    return false;
+  }
+  if (u_left - w < 0 || u_left + w >= left.cols || u_right - l - w < 0 || u_right + l + w >= right.cols) {
+    return false;
+  }
+
+  const std::ptrdiff_t left_step  = static_cast<std::ptrdiff_t>(left.step);
+  const std::ptrdiff_t right_step = static_cast<std::ptrdiff_t>(right.step);
+  const std::uint8_t* pl          = left.ptr<std::uint8_t>(v - w) + (u_left - w);
+  const std::uint8_t* pr          = right.ptr<std::uint8_t>(v - w) + (u_right - l - w);
+
+  const bool in_buffer = Readable(left, pl, (kWindowSize - 1) * left_step + 16)
+                      && Readable(right, pr, (kWindowSize - 1) * right_step + kOffsets - 1 + 16);
+  const SadsFn sads_fn = in_buffer ? KernelFunction(CurrentKernel().load(std::memory_order_relaxed)) : SadsScalar;
+  sads_fn(pl, left_step, pr, right_step, sads);
+  return true;
+}
+
+bool RefineMinimum(const int* sads, int& best_sad, int& best_offset, float& delta) {
+  best_sad = INT_MAX;
+  int best = 0;
+  for (int d = 0; d < kOffsets; ++d) {
+    if (sads[d] < best_sad) {
+      best_sad = sads[d];
+      best     = d;
+    }
+  }
+  if (best == 0 || best == kOffsets - 1) {
+    return false;
+  }
+
+  // Parabola fitting, in float as the original matcher.
+  const float dist1 = static_cast<float>(sads[best - 1]);
+  const float dist2 = static_cast<float>(sads[best]);
+  const float dist3 = static_cast<float>(sads[best + 1]);
+  delta             = (dist1 - dist3) / (2.0f * (dist1 + dist3 - 2.0f * dist2));
+  best_offset       = best - kSearchRadius;
+
+  // The first minimum is strictly below its left neighbour, so the parabola is
+  // never flat.
+  return delta >= -1.0f && delta <= 1.0f;
+}
+
+Kernel ActiveKernel() {
+  return CurrentKernel().load(std::memory_order_relaxed);
+}
+
+bool SetKernel(const Kernel kernel) {
+  if (!IsSupported(kernel)) {
+    return false;
+  }
+  CurrentKernel().store(kernel, std::memory_order_relaxed);
+  return true;
+}
+
+bool IsSupported(const Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Scalar:
+      return true;
+#ifdef ORB_SLAM3_STEREO_X86
+    case Kernel::SSE2:
+      return __builtin_cpu_supports("sse2");
+    case Kernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+const char* KernelName(const Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::SSE2:   return "sse2";
+    case Kernel::AVX2:   return "avx2";
+  }
+  return "unknown";
+}
+
+} // namespace Stereo
+} // namespace ORB_SLAM3
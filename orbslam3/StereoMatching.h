@@ -0,0 +1,74 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STEREO_MATCHING_H
+#define STEREO_MATCHING_H
+
+// 3rdparty
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+namespace Stereo {
+
+// Half size of the square correlation window, in pixels of the pyramid level.
+constexpr int kWindowHalfSize = 5;
+
+// Half range of the correlation search around the matched right keypoint.
+constexpr int kSearchRadius = 5;
+constexpr int kOffsets      = 2 * kSearchRadius + 1;
+
+// Instruction set used by the correlation kernels.
+enum class Kernel {
+  Scalar, // One pixel at a time
+  SSE2,   // x86 psadbw: one window row per instruction
+  AVX2    // x86 vpsadbw: two window rows per instruction
+};
+
+// Sums of absolute differences between the window of `left` centered on
+// (u_left, v) and the windows of `right` centered on (u_right + d, v), in
+// sads[d + kSearchRadius] for d in [-kSearchRadius, kSearchRadius]. Both
+// images are CV_8UC1. Returns false, leaving `sads` untouched, when one of the
+// windows is not inside its image.
+bool WindowSads(const cv::Mat& left, const cv::Mat& right, const int u_left, const int u_right, const int v, int* sads);
+
+// Sub-pixel minimum of the SAD curve: the best offset (first one on ties) and
+// the vertex of the parabola through it and its two neighbours, at
+// best_offset + delta. Returns false when the best offset is at an end of the
+// search range or the vertex is more than a pixel away.
+bool RefineMinimum(const int* sads, int& best_sad, int& best_offset, float& delta);
+
+// Kernel picked at startup from the CPU features.
+Kernel ActiveKernel();
+
+// Force a kernel, mostly for tests and benchmarks. Returns false and keeps the
+// current one if the CPU does not support it.
+bool SetKernel(const Kernel kernel);
+
+// Whether the CPU (and the build) support the kernel.
+bool IsSupported(const Kernel kernel);
+
+const char* KernelName(const Kernel kernel);
+
+} // namespace Stereo
+} // namespace ORB_SLAM3
+
+#endif // STEREO_MATCHING_H
@@ -0,0 +1,228 @@
+// Benchmark of the stereo matching of a rectified pair (e.g. a EuRoC pair
+// rectified as in the stereo examples, with the calibration of EuRoC.yaml):
+// the original correlation (cv::Mat windows and cv::norm per offset) against
+// Frame::ComputeStereoMatches with every correlation kernel supported by the
+// CPU, serial then on a thread pool. mvuRight and mvDepth must match the
+// original ones exactly.
+//
+// Usage: StereoMatching_bench <left image> <right image> [n_features] [n_threads]
+
+// Standard
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+#include <vector>
+// 3rdparty
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+// Local
+#include "orbslam3/CameraModels/Pinhole.h"
+#include "orbslam3/Frame.h"
+#include "orbslam3/ORBextractor.h"
+#include "orbslam3/ORBmatcher.h"
+#include "orbslam3/StereoMatching.h"
+#include "orbslam3/ThreadPool.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+constexpr int kRuns = 50;
+
+// Rectified EuRoC calibration (Examples/Stereo/EuRoC.yaml).
+constexpr float kFx      = 435.2046959714599f;
+constexpr float kFy      = 435.2046959714599f;
+constexpr float kCx      = 367.4517211914062f;
+constexpr float kCy      = 252.2008514404297f;
+constexpr float kBf      = 47.90639384423901f;
+constexpr float kThDepth = 35.f;
+
+// Run `fn` once to warm up, then return the time per run of the next runs.
+template <typename Fn>
+double TimeMs(Fn&& fn) {
+  fn();
+  const auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < kRuns; ++run) {
+    fn();
+  }
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count() / kRuns;
+}
+
+struct StereoResult {
+  std::vector<float> u_right;
+  std::vector<float> depth;
+};
+
+// The original Frame::ComputeStereoMatches, on the features of the frame.
+StereoResult ReferenceStereoMatches(const Frame& frame) {
+  const int n             = frame.N;
+  const int th_orb_dist   = (ORBmatcher::TH_HIGH + ORBmatcher::TH_LOW) / 2;
+  const int n_rows        = frame.mpORBextractorLeft->mvImagePyramid[0].rows;
+  StereoResult result{std::vector<float>(n, -1.0f), std::vector<float>(n, -1.0f)};
+
+  std::vector<std::vector<std::size_t>> row_indices(n_rows, std::vector<std::size_t>());
+  for (int i = 0; i < n_rows; ++i) {
+    row_indices[i].reserve(200);
+  }
+  for (std::size_t i_r = 0; i_r < frame.mvKeysRight.size(); ++i_r) {
+    const cv::KeyPoint& kp = frame.mvKeysRight[i_r];
+    const float r          = 2.0f * frame.mvScaleFactors[kp.octave];
+    for (int yi = std::floor(kp.pt.y - r); yi <= std::ceil(kp.pt.y + r); ++yi) {
+      row_indices[yi].push_back(i_r);
+    }
+  }
+
+  const float min_d = 0;
+  const float max_d = frame.mbf / frame.mb;
+  std::vector<std::pair<int, int>> dist_idx;
+  for (int i_l = 0; i_l < n; ++i_l) {
+    const cv::KeyPoint& kp_l                  = frame.mvKeys[i_l];
+    const std::vector<std::size_t>& candidates = row_indices[kp_l.pt.y];
+    const float min_u                         = kp_l.pt.x - max_d;
+    const float max_u                         = kp_l.pt.x - min_d;
+    if (candidates.empty() || max_u < 0) {
+      continue;
+    }
+
+    int best_dist         = ORBmatcher::TH_HIGH;
+    std::size_t best_idx  = 0;
+    const cv::Mat& d_l    = frame.mDescriptors.row(i_l);
+    for (const std::size_t i_r : candidates) {
+      const cv::KeyPoint& kp_r = frame.mvKeysRight[i_r];
+      if (kp_r.octave < kp_l.octave - 1 || kp_r.octave > kp_l.octave + 1) {
+        continue;
+      }
+      if (kp_r.pt.x >= min_u && kp_r.pt.x <= max_u) {
+        const int dist = ORBmatcher::DescriptorDistance(d_l, frame.mDescriptorsRight.row(i_r));
+        if (dist < best_dist) {
+          best_dist = dist;
+          best_idx  = i_r;
+        }
+      }
+    }
+    if (best_dist >= th_orb_dist) {
+      continue;
+    }
+
+    const float scale      = frame.mvInvScaleFactors[kp_l.octave];
+    const float scaled_ul  = std::round(kp_l.pt.x * scale);
+    const float scaled_vl  = std::round(kp_l.pt.y * scale);
+    const float scaled_ur0 = std::round(frame.mvKeysRight[best_idx].pt.x * scale);
+    const cv::Mat& left    = frame.mpORBextractorLeft->mvImagePyramid[kp_l.octave];
+    const cv::Mat& right   = frame.mpORBextractorRight->mvImagePyramid[kp_l.octave];
+    const int w = 5, l = 5;
+    const cv::Mat il = left.rowRange(scaled_vl - w, scaled_vl + w + 1).colRange(scaled_ul - w, scaled_ul + w + 1);
+    if (scaled_ur0 + l - w < 0 || scaled_ur0 + l + w + 1 >= right.cols) {
+      continue;
+    }
+
+    int best_sad = INT_MAX, best_inc = 0;
+    std::vector<float> dists(2 * l + 1);
+    for (int inc = -l; inc <= l; ++inc) {
+      const cv::Mat ir
+        = right.rowRange(scaled_vl - w, scaled_vl + w + 1).colRange(scaled_ur0 + inc - w, scaled_ur0 + inc + w + 1);
+      const float dist = cv::norm(il, ir, cv::NORM_L1);
+      if (dist < best_sad) {
+        best_sad = dist;
+        best_inc = inc;
+      }
+      dists[l + inc] = dist;
+    }
+    if (best_inc == -l || best_inc == l) {
+      continue;
+    }
+    const float dist1 = dists[l + best_inc - 1], dist2 = dists[l + best_inc], dist3 = dists[l + best_inc + 1];
+    const float delta = (dist1 - dist3) / (2.0f * (dist1 + dist3 - 2.0f * dist2));
+    if (delta < -1 || delta > 1) {
+      continue;
+    }
+
+    float best_ur   = frame.mvScaleFactors[kp_l.octave] * (scaled_ur0 + best_inc + delta);
+    float disparity = kp_l.pt.x - best_ur;
+    if (disparity >= min_d && disparity < max_d) {
+      if (disparity <= 0) {
+        disparity = 0.01;
+        best_ur   = kp_l.pt.x - 0.01;
+      }
+      result.depth[i_l]   = frame.mbf / disparity;
+      result.u_right[i_l] = best_ur;
+      dist_idx.emplace_back(best_sad, i_l);
+    }
+  }
+
+  std::sort(dist_idx.begin(), dist_idx.end());
+  const float th_dist = dist_idx.empty() ? 0.f : 1.5f * 1.4f * dist_idx[dist_idx.size() / 2].first;
+  for (int i = static_cast<int>(dist_idx.size()) - 1; i >= 0 && dist_idx[i].first >= th_dist; --i) {
+    result.u_right[dist_idx[i].second] = -1;
+    result.depth[dist_idx[i].second]   = -1;
+  }
+  return result;
+}
+
+bool Same(const Frame& frame, const StereoResult& expected) {
+  return frame.mvuRight == expected.u_right && frame.mvDepth == expected.depth;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::fprintf(stderr, "Usage: %s <left image> <right image> [n_features] [n_threads]\n", argv[0]);
+    return 1;
+  }
+
+  const cv::Mat left  = cv::imread(argv[1], cv::IMREAD_GRAYSCALE);
+  const cv::Mat right = cv::imread(argv[2], cv::IMREAD_GRAYSCALE);
+  if (left.empty() || right.empty() || left.size() != right.size()) {
+    std::fprintf(stderr, "Failed to load the same-size images %s and %s\n", argv[1], argv[2]);
+    return 1;
+  }
+  const int n_features = argc > 3 ? std::atoi(argv[3]) : 1200;
+  const int n_threads  = argc > 4 ? std::atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  if (n_features <= 0 || n_threads < 0) {
+    std::fprintf(stderr, "Usage: %s <left image> <right image> [n_features] [n_threads]\n", argv[0]);
+    return 1;
+  }
+
+  ORBextractor extractor_left(n_features, 1.2f, 8, 20, 7);
+  ORBextractor extractor_right(n_features, 1.2f, 8, 20, 7);
+  Pinhole camera({kFx, kFy, kCx, kCy});
+  cv::Mat k = (cv::Mat_<float>(3, 3) << kFx, 0.f, kCx, 0.f, kFy, kCy, 0.f, 0.f, 1.f);
+  cv::Mat dist_coef = cv::Mat::zeros(4, 1, CV_32F);
+  Frame frame(left, right, 0.0, &extractor_left, &extractor_right, nullptr, k, dist_coef, kBf, kThDepth, &camera);
+
+  StereoResult expected;
+  const double reference_ms = TimeMs([&] { expected = ReferenceStereoMatches(frame); });
+  const long n_matches      = std::count_if(expected.depth.begin(), expected.depth.end(), [](const float d) { return d > 0; });
+  std::printf("%d keypoints (%zu right), %ld stereo matches, %d runs\n", frame.N, frame.mvKeysRight.size(), n_matches, kRuns);
+  std::printf("%-10s %10.3f ms\n", "reference", reference_ms);
+
+  ThreadPool pool(n_threads);
+  const Stereo::Kernel initial = Stereo::ActiveKernel();
+  bool same                    = true;
+  for (const Stereo::Kernel kernel : {Stereo::Kernel::Scalar, Stereo::Kernel::SSE2, Stereo::Kernel::AVX2}) {
+    if (!Stereo::SetKernel(kernel)) {
+      continue;
+    }
+    const double serial_ms = TimeMs([&] { frame.ComputeStereoMatches(); });
+    same                   = same && Same(frame, expected);
+    const double pool_ms   = TimeMs([&] { frame.ComputeStereoMatches(&pool); });
+    same                   = same && Same(frame, expected);
+    std::printf(
+      "%-10s %10.3f ms serial %10.3f ms on %d+1 threads\n",
+      Stereo::KernelName(kernel),
+      serial_ms,
+      pool_ms,
+      n_threads
+    );
+  }
+  Stereo::SetKernel(initial);
+
+  std::printf("mvuRight and mvDepth %s\n", same ? "identical" : "DIFFER");
+  return same ? 0 : 1;
+}
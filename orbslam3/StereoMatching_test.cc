@@ -0,0 +1,126 @@
+// Standard
+#include <cmath>
+#include <random>
+// 3rdparty
+#include <gtest/gtest.h>
+#include <opencv2/core.hpp>
+// Local
+#include "orbslam3/StereoMatching.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+const Stereo::Kernel kAllKernels[] = {
+  Stereo::Kernel::Scalar,
+  Stereo::Kernel::SSE2,
+  Stereo::Kernel::AVX2,
+};
+
+cv::Mat RandomImage(const int width, const int height, const int seed) {
+  cv::Mat image(height, width, CV_8UC1);
+  cv::RNG rng(seed);
+  rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+  return image;
+}
+
+// The original correlation of Frame::ComputeStereoMatches.
+void ReferenceSads(const cv::Mat& left, const cv::Mat& right, const int u_left, const int u_right, const int v, int* sads) {
+  const int w = Stereo::kWindowHalfSize;
+  const int l = Stereo::kSearchRadius;
+  const cv::Mat il = left.rowRange(v - w, v + w + 1).colRange(u_left - w, u_left + w + 1);
+  for (int d = -l; d <= l; ++d) {
+    const cv::Mat ir = right.rowRange(v - w, v + w + 1).colRange(u_right + d - w, u_right + d + w + 1);
+    sads[d + l]      = static_cast<int>(cv::norm(il, ir, cv::NORM_L1));
+  }
+}
+
+} // namespace
+
+TEST(StereoMatching, SadsMatchReference) {
+  // Padded images, as the pyramid levels, then tight ones where the windows of
+  // the last rows end at the end of the buffer.
+  const cv::Mat padded_left  = RandomImage(200, 120, 1);
+  const cv::Mat padded_right = RandomImage(200, 120, 2);
+  const cv::Rect roi(20, 20, 160, 80);
+  const cv::Mat images[][2] = {
+    {padded_left(roi), padded_right(roi)},
+    {RandomImage(64, 40, 3), RandomImage(64, 40, 4)},
+  };
+
+  const int w = Stereo::kWindowHalfSize;
+  const int l = Stereo::kSearchRadius;
+  std::mt19937 rng(42);
+  const Stereo::Kernel initial = Stereo::ActiveKernel();
+  for (const auto& pair : images) {
+    const cv::Mat& left  = pair[0];
+    const cv::Mat& right = pair[1];
+    std::uniform_int_distribution<int> u_left(w, left.cols - w - 1);
+    std::uniform_int_distribution<int> u_right(l + w, right.cols - l - w - 1);
+    std::uniform_int_distribution<int> v(w, left.rows - w - 1);
+    for (int i = 0; i < 200; ++i) {
+      // Every fifth window at the bottom-right corner.
+      const int ul = i % 5 ? u_left(rng) : left.cols - w - 1;
+      const int ur = i % 5 ? u_right(rng) : right.cols - l - w - 1;
+      const int vv = i % 5 ? v(rng) : left.rows - w - 1;
+      int expected[Stereo::kOffsets];
+      ReferenceSads(left, right, ul, ur, vv, expected);
+
+      for (const Stereo::Kernel kernel : kAllKernels) {
+        if (!Stereo::SetKernel(kernel)) {
+          continue;
+        }
+        SCOPED_TRACE(Stereo::KernelName(kernel));
+        int sads[Stereo::kOffsets];
+        ASSERT_TRUE(Stereo::WindowSads(left, right, ul, ur, vv, sads));
+        for (int d = 0; d < Stereo::kOffsets; ++d) {
+          ASSERT_EQ(sads[d], expected[d]) << "window " << i << ", offset " << d - l;
+        }
+      }
+    }
+  }
+  Stereo::SetKernel(initial);
+}
+
+TEST(StereoMatching, WindowsOutsideImage) {
+  const cv::Mat left  = RandomImage(64, 40, 5);
+  const cv::Mat right = RandomImage(64, 40, 6);
+  const int w         = Stereo::kWindowHalfSize;
+  const int l         = Stereo::kSearchRadius;
+  int sads[Stereo::kOffsets];
+  EXPECT_TRUE(Stereo::WindowSads(left, right, w, l + w, w, sads));
+  EXPECT_FALSE(Stereo::WindowSads(left, right, w - 1, l + w, w, sads));
+  EXPECT_FALSE(Stereo::WindowSads(left, right, w, l + w - 1, w, sads));
+  EXPECT_FALSE(Stereo::WindowSads(left, right, w, right.cols - l - w, w, sads));
+  EXPECT_FALSE(Stereo::WindowSads(left, right, w, l + w, left.rows - w, sads));
+}
+
+TEST(StereoMatching, RefineMinimum) {
+  // Samples of a parabola with its vertex at offset 1.3.
+  int sads[Stereo::kOffsets];
+  for (int d = 0; d < Stereo::kOffsets; ++d) {
+    const float x = static_cast<float>(d - Stereo::kSearchRadius) - 1.3f;
+    sads[d]       = static_cast<int>(std::lround(1000.f + 100.f * x * x));
+  }
+  int best_sad, best_offset;
+  float delta;
+  ASSERT_TRUE(Stereo::RefineMinimum(sads, best_sad, best_offset, delta));
+  EXPECT_EQ(best_offset, 1);
+  EXPECT_EQ(best_sad, sads[1 + Stereo::kSearchRadius]);
+  EXPECT_NEAR(best_offset + delta, 1.3f, 1e-2f);
+
+  // Minimum at an end of the search range.
+  for (int d = 0; d < Stereo::kOffsets; ++d) {
+    sads[d] = 1000 - d;
+  }
+  EXPECT_FALSE(Stereo::RefineMinimum(sads, best_sad, best_offset, delta));
+
+  // On ties, the first minimum is kept.
+  for (int d = 0; d < Stereo::kOffsets; ++d) {
+    sads[d] = 1000;
+  }
+  sads[4] = sads[7] = 10;
+  ASSERT_TRUE(Stereo::RefineMinimum(sads, best_sad, best_offset, delta));
+  EXPECT_EQ(best_offset, 4 - Stereo::kSearchRadius);
+  EXPECT_EQ(delta, 0.f);
+}
@@ -16,6 +16,10 @@
 * If not, see <http://www.gnu.org/licenses/>.
 */
 
+// Standard
+#include <algorithm>
+#include <chrono>
+#include <exception>
 // 3rdparty
 #include <glog/logging.h>
 #include <openssl/md5.h>
@@ -32,13 +36,16 @@
 // Local
 #include "orbslam3/Atlas.h"
 #include "orbslam3/Converter.h"
+#include "orbslam3/EpochReclaimer.h"
 #include "orbslam3/FrameDrawer.h"
+#include "orbslam3/KeyFrame.h"
 #include "orbslam3/KeyFrameDatabase.h"
 #include "orbslam3/LocalMapping.h"
 #include "orbslam3/LoopClosing.h"
 #include "orbslam3/Map.h"
 #include "orbslam3/MapDrawer.h"
 #include "orbslam3/MapPoint.h"
+#include "orbslam3/ObjectPool.h"
 #include "orbslam3/Settings.h"
 #include "orbslam3/System.h"
 #include "orbslam3/Tracking.h"
@@ -50,7 +57,8 @@ namespace ORB_SLAM3
 System::System(const std::string &strVocFile, const std::string &strSettingsFile, const eSensor sensor,
                const bool bUseViewer, const int initFr, const std::string &strSequence):
     mSensor(sensor), mpViewer(static_cast<Viewer*>(NULL)), mbReset(false), mbResetActiveMap(false),
-    mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mbShutDown(false)
+    mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mbShutDown(false),
+    mbLazyLoadAtlas(false), mbReclaimMapPoints(false), mbAtlasSnapshotRunning(false)
 {
     // Output welcome message
     LOG(INFO) << "ORB-SLAM3 Copyright (C) 2017-2020 Carlos Campos, Richard "
@@ -89,6 +97,8 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
 
         mStrLoadAtlasFromFile = settings_->atlasLoadFile();
         mStrSaveAtlasToFile = settings_->atlasSaveFile();
+        mbLazyLoadAtlas = settings_->atlasLazyLoad();
+        mbReclaimMapPoints = settings_->reclaimMapPoints();
 
         LOG(INFO) << *settings_;
     }
@@ -105,6 +115,12 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
         {
             mStrSaveAtlasToFile = (string)node;
         }
+
+        node = fsSettings["System.LazyLoadAtlas"];
+        mbLazyLoadAtlas = !node.empty() && node.isInt() && node.operator int() != 0;
+
+        node = fsSettings["System.ReclaimMapPoints"];
+        mbReclaimMapPoints = !node.empty() && node.isInt() && node.operator int() != 0;
     }
 
     node = fsSettings["loopClosing"];
@@ -114,8 +130,45 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
         activeLC = static_cast<int>(fsSettings["loopClosing"]) != 0;
     }
 
+    // Shared worker pool, one worker less than the cores as the tracking thread takes part in the work
+    int nThreads = -1;
+    if(settings_)
+        nThreads = settings_->nThreads();
+    else
+    {
+        node = fsSettings["System.nThreads"];
+        if(!node.empty() && node.isInt())
+            nThreads = node.operator int();
+    }
+    if(nThreads < 0)
+        nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    mpThreadPool = std::make_unique<ThreadPool>(nThreads);
+    LOG(INFO) << "Thread pool with " << nThreads << " workers";
+
+    // Frames in flight in the asynchronous tracking: one extracted while the previous one is tracked
+    int nPipelineDepth = 2;
+    if(settings_)
+        nPipelineDepth = settings_->trackingPipelineDepth();
+    else
+    {
+        node = fsSettings["System.TrackingPipelineDepth"];
+        if(!node.empty() && node.isInt())
+            nPipelineDepth = node.operator int();
+    }
+    mpTrackingPipeline = std::make_unique<TwoStagePipeline>(std::max(1, nPipelineDepth));
+
     mStrVocabularyFilePath = strVocFile;
 
+    mAtlasProgressCallback = [nLastStep = std::size_t(0)](const std::size_t done, const std::size_t total) mutable
+    {
+        const std::size_t step = total > 0 ? 10 * done / total : 10;
+        if(step != nLastStep)
+        {
+            nLastStep = step;
+            LOG(INFO) << "Atlas: " << done << " / " << total << " KeyFrames and MapPoints";
+        }
+    };
+
     bool loadedAtlas = false;
 
     if(mStrLoadAtlasFromFile.empty())
@@ -123,8 +176,7 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
         //Load ORB Vocabulary
         LOG(INFO) << "Loading ORB Vocabulary. This could take a while";
 
-        mpVocabulary = new ORBVocabulary();
-        bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+        bool bVocLoad = LoadVocabulary(strVocFile);
         if(!bVocLoad)
         {
             LOG(ERROR) << "Wrong path to vocabulary";
@@ -145,8 +197,7 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
         //Load ORB Vocabulary
         LOG(INFO) << "Loading ORB Vocabulary. This could take a while";
 
-        mpVocabulary = new ORBVocabulary();
-        bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+        bool bVocLoad = LoadVocabulary(strVocFile);
         if(!bVocLoad)
         {
             LOG(ERROR) << "Wrong path to vocabulary";
@@ -189,6 +240,16 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
     if (mSensor==IMU_STEREO || mSensor==IMU_MONOCULAR || mSensor==IMU_RGBD)
         mpAtlas->SetInertialSensor();
 
+    // The threads created below drop the bad MapPoints they kept from their previous iteration at
+    // their quiescent points: a retired MapPoint waits for the epoch in progress, then for two
+    // quiescent states of every thread
+    if(mbReclaimMapPoints)
+    {
+        mpReclaimer = new EpochReclaimer(3);
+        mpAtlas->SetReclaimer(mpReclaimer);
+        LOG(INFO) << "Culled MapPoints are reclaimed";
+    }
+
     //Create Drawers. These are used by the Viewer
     mpFrameDrawer = new FrameDrawer(mpAtlas);
     mpMapDrawer = new MapDrawer(mpAtlas, strSettingsFile, settings_);
@@ -219,6 +280,8 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
     //Initialize the Loop Closing thread and launch
     // mSensor!=MONOCULAR && mSensor!=IMU_MONOCULAR
     mpLoopCloser = new LoopClosing(mpAtlas, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, activeLC); // mSensor!=MONOCULAR);
+    mpLoopCloser->SetReclaimer(mpReclaimer);
+    mpLoopCloser->SetThreadPool(mpThreadPool.get());
     mptLoopClosing = new thread(&LoopClosing::Run, mpLoopCloser);
 
     //Set pointers between threads
@@ -247,180 +310,339 @@ System::System(const std::string &strVocFile, const std::string &strSettingsFile
 
 Sophus::SE3f System::TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename)
 {
-    if(mSensor!=STEREO && mSensor!=IMU_STEREO)
-    {
-        LOG(ERROR) << "TrackStereo called but input sensor was neither Stereo nor Stereo-Inertial";
-        exit(-1);
-    }
+    CheckStereoSensor();
 
     cv::Mat imLeftToFeed, imRightToFeed;
-    if(settings_ && settings_->needToRectify()){
-        cv::Mat M1l = settings_->M1l();
-        cv::Mat M2l = settings_->M2l();
-        cv::Mat M1r = settings_->M1r();
-        cv::Mat M2r = settings_->M2r();
+    PrepareStereoImages(imLeft,imRight,true,imLeftToFeed,imRightToFeed);
 
-        cv::remap(imLeft, imLeftToFeed, M1l, M2l, cv::INTER_LINEAR);
-        cv::remap(imRight, imRightToFeed, M1r, M2r, cv::INTER_LINEAR);
-    }
-    else if(settings_ && settings_->needToResize()){
-        cv::resize(imLeft,imLeftToFeed,settings_->newImSize());
-        cv::resize(imRight,imRightToFeed,settings_->newImSize());
-    }
-    else{
-        imLeftToFeed = imLeft.clone();
-        imRightToFeed = imRight.clone();
-    }
+    CheckModeAndReset();
 
-    // Check mode change
-    {
-        std::unique_lock<std::mutex> lock(mMutexMode);
-        if(mbActivateLocalizationMode)
-        {
-            mpLocalMapper->RequestStop();
+    if (mSensor == System::IMU_STEREO)
+        GrabImuData(vImuMeas);
 
-            // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+    LOG(INFO) << "Start GrabImageStereo";
+    Sophus::SE3f Tcw = mpTracker->GrabImageStereo(imLeftToFeed,imRightToFeed,timestamp,filename);
+    LOG(INFO) << "End GrabImageStereo";
 
-            mpTracker->InformOnlyTracking(true);
-            mbActivateLocalizationMode = false;
-        }
-        if(mbDeactivateLocalizationMode)
-        {
-            mpTracker->InformOnlyTracking(false);
-            mpLocalMapper->Release();
-            mbDeactivateLocalizationMode = false;
-        }
-    }
+    UpdateTrackingState();
+
+    return Tcw;
+}
+
+Sophus::SE3f System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename)
+{
+    CheckRGBDSensor();
+
+    cv::Mat imToFeed, imDepthToFeed;
+    PrepareRGBDImages(im,depthmap,true,imToFeed,imDepthToFeed);
+
+    CheckModeAndReset();
+
+    if (mSensor == System::IMU_RGBD)
+        GrabImuData(vImuMeas);
+
+    Sophus::SE3f Tcw = mpTracker->GrabImageRGBD(imToFeed,imDepthToFeed,timestamp,filename);
+
+    UpdateTrackingState();
+    return Tcw;
+}
+
+Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename)
+{
 
-    // Check reset
     {
         std::unique_lock<std::mutex> lock(mMutexReset);
-        if(mbReset)
-        {
-            mpTracker->Reset();
-            mbReset = false;
-            mbResetActiveMap = false;
-        }
-        else if(mbResetActiveMap)
-        {
-            mpTracker->ResetActiveMap();
-            mbResetActiveMap = false;
-        }
+        if(mbShutDown)
+            return Sophus::SE3f();
     }
 
+    CheckMonocularSensor();
+
+    cv::Mat imToFeed;
+    PrepareMonocularImage(im,true,imToFeed);
+
+    CheckModeAndReset();
+
+    if (mSensor == System::IMU_MONOCULAR)
+        GrabImuData(vImuMeas);
+
+    Sophus::SE3f Tcw = mpTracker->GrabImageMonocular(imToFeed,timestamp,filename);
+
+    UpdateTrackingState();
+
+    return Tcw;
+}
+
+Sophus::SE3f System::TrackStereo(const ImageView &left, const ImageView &right, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, ReleaseCallback release)
+{
+    CheckStereoSensor();
+
+    CheckModeAndReset();
+
     if (mSensor == System::IMU_STEREO)
-        for(std::size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
-            mpTracker->GrabImuData(vImuMeas[i_imu]);
+        GrabImuData(vImuMeas);
 
-    LOG(INFO) << "Start GrabImageStereo";
-    Sophus::SE3f Tcw = mpTracker->GrabImageStereo(imLeftToFeed,imRightToFeed,timestamp,filename);
-    LOG(INFO) << "End GrabImageStereo";
+    Sophus::SE3f Tcw = mpTracker->GrabImageStereo(left,right,timestamp,filename,release);
 
-    std::unique_lock<std::mutex> lock2(mMutexState);
-    mTrackingState = mpTracker->mState;
-    mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
-    mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
+    UpdateTrackingState();
 
     return Tcw;
 }
 
-Sophus::SE3f System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename)
+Sophus::SE3f System::TrackRGBD(const ImageView &im, const DepthView &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, ReleaseCallback release)
+{
+    CheckRGBDSensor();
+
+    CheckModeAndReset();
+
+    if (mSensor == System::IMU_RGBD)
+        GrabImuData(vImuMeas);
+
+    Sophus::SE3f Tcw = mpTracker->GrabImageRGBD(im,depthmap,timestamp,filename,release);
+
+    UpdateTrackingState();
+
+    return Tcw;
+}
+
+Sophus::SE3f System::TrackMonocular(const ImageView &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, ReleaseCallback release)
 {
-    if(mSensor!=RGBD  && mSensor!=IMU_RGBD)
     {
-        LOG(ERROR) << "TrackRGBD called but input sensor was not RGBD";
-        exit(-1);
+        std::unique_lock<std::mutex> lock(mMutexReset);
+        if(mbShutDown)
+            return Sophus::SE3f();
     }
 
-    cv::Mat imToFeed = im.clone();
-    cv::Mat imDepthToFeed = depthmap.clone();
-    if(settings_ && settings_->needToResize()){
-        cv::Mat resizedIm;
-        cv::resize(im,resizedIm,settings_->newImSize());
-        imToFeed = resizedIm;
+    CheckMonocularSensor();
 
-        cv::resize(depthmap,imDepthToFeed,settings_->newImSize());
-    }
+    CheckModeAndReset();
 
-    // Check mode change
+    if (mSensor == System::IMU_MONOCULAR)
+        GrabImuData(vImuMeas);
+
+    Sophus::SE3f Tcw = mpTracker->GrabImageMonocular(im,timestamp,filename,release);
+
+    UpdateTrackingState();
+
+    return Tcw;
+}
+
+std::future<Sophus::SE3f> System::TrackStereoAsync(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, TrackingCallback callback)
+{
+    CheckStereoSensor();
+
+    const cv::Mat imLeftCopy = imLeft.clone();
+    const cv::Mat imRightCopy = imRight.clone();
+    return SubmitTracking([this, imLeftCopy, imRightCopy, timestamp, filename](Tracking::InputFrame &input)
     {
-        std::unique_lock<std::mutex> lock(mMutexMode);
-        if(mbActivateLocalizationMode)
-        {
-            mpLocalMapper->RequestStop();
+        cv::Mat imLeftToFeed, imRightToFeed;
+        PrepareStereoImages(imLeftCopy,imRightCopy,false,imLeftToFeed,imRightToFeed);
+        mpTracker->PrepareStereo(imLeftToFeed,imRightToFeed,timestamp,filename,input);
+    }, vImuMeas, timestamp, callback);
+}
 
-            // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+std::future<Sophus::SE3f> System::TrackRGBDAsync(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, TrackingCallback callback)
+{
+    CheckRGBDSensor();
 
-            mpTracker->InformOnlyTracking(true);
-            mbActivateLocalizationMode = false;
-        }
-        if(mbDeactivateLocalizationMode)
-        {
-            mpTracker->InformOnlyTracking(false);
-            mpLocalMapper->Release();
-            mbDeactivateLocalizationMode = false;
-        }
-    }
+    const cv::Mat imCopy = im.clone();
+    const cv::Mat imDepthCopy = depthmap.clone();
+    return SubmitTracking([this, imCopy, imDepthCopy, timestamp, filename](Tracking::InputFrame &input)
+    {
+        cv::Mat imToFeed, imDepthToFeed;
+        PrepareRGBDImages(imCopy,imDepthCopy,false,imToFeed,imDepthToFeed);
+        mpTracker->PrepareRGBD(imToFeed,imDepthToFeed,timestamp,filename,input);
+    }, vImuMeas, timestamp, callback);
+}
+
+std::future<Sophus::SE3f> System::TrackMonocularAsync(const cv::Mat &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, TrackingCallback callback)
+{
+    CheckMonocularSensor();
+
+    const cv::Mat imCopy = im.clone();
+    return SubmitTracking([this, imCopy, timestamp, filename](Tracking::InputFrame &input)
+    {
+        cv::Mat imToFeed;
+        PrepareMonocularImage(imCopy,false,imToFeed);
+        mpTracker->PrepareMonocular(imToFeed,timestamp,filename,input);
+    }, vImuMeas, timestamp, callback);
+}
+
+std::future<Sophus::SE3f> System::TrackStereoAsync(const ImageView &left, const ImageView &right, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, TrackingCallback callback, ReleaseCallback release)
+{
+    CheckStereoSensor();
+
+    return SubmitTracking([this, left, right, timestamp, filename, release](Tracking::InputFrame &input)
+    {
+        mpTracker->PrepareStereo(left,right,timestamp,filename,release,input);
+    }, vImuMeas, timestamp, callback, release);
+}
+
+std::future<Sophus::SE3f> System::TrackRGBDAsync(const ImageView &im, const DepthView &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, TrackingCallback callback, ReleaseCallback release)
+{
+    CheckRGBDSensor();
+
+    return SubmitTracking([this, im, depthmap, timestamp, filename, release](Tracking::InputFrame &input)
+    {
+        mpTracker->PrepareRGBD(im,depthmap,timestamp,filename,release,input);
+    }, vImuMeas, timestamp, callback, release);
+}
+
+std::future<Sophus::SE3f> System::TrackMonocularAsync(const ImageView &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename, TrackingCallback callback, ReleaseCallback release)
+{
+    CheckMonocularSensor();
+
+    return SubmitTracking([this, im, timestamp, filename, release](Tracking::InputFrame &input)
+    {
+        mpTracker->PrepareMonocular(im,timestamp,filename,release,input);
+    }, vImuMeas, timestamp, callback, release);
+}
+
+template<typename Prepare>
+std::future<Sophus::SE3f> System::SubmitTracking(Prepare prepare, const std::vector<IMU::Point>& vImuMeas, const double timestamp, TrackingCallback callback, const ReleaseCallback &release)
+{
+    // State of a frame shared by the two stages
+    struct AsyncFrame
+    {
+        Tracking::InputFrame input;
+        std::exception_ptr error;
+        std::promise<Sophus::SE3f> pose;
+    };
+    std::shared_ptr<AsyncFrame> pFrame = std::make_shared<AsyncFrame>();
+    std::future<Sophus::SE3f> pose = pFrame->pose.get_future();
 
-    // Check reset
     {
         std::unique_lock<std::mutex> lock(mMutexReset);
-        if(mbReset)
-        {
-            mpTracker->Reset();
-            mbReset = false;
-            mbResetActiveMap = false;
-        }
-        else if(mbResetActiveMap)
+        if(mbShutDown)
         {
-            mpTracker->ResetActiveMap();
-            mbResetActiveMap = false;
+            if(release)
+                release();
+            pFrame->pose.set_value(Sophus::SE3f());
+            return pose;
         }
     }
 
-    if (mSensor == System::IMU_RGBD)
-        for(std::size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
-            mpTracker->GrabImuData(vImuMeas[i_imu]);
+    // The frames are extracted on the first stage, and tracked in order on the second one. The BoW
+    // are not computed ahead: the tracking only computes them for the frames that need them.
+    mpTrackingPipeline->Submit(
+        [pFrame, prepare]()
+        {
+            try
+            {
+                prepare(pFrame->input);
+            }
+            catch(...)
+            {
+                pFrame->error = std::current_exception();
+            }
+        },
+        [this, pFrame, vImuMeas, timestamp, callback]()
+        {
+            Sophus::SE3f Tcw;
+            try
+            {
+                if(pFrame->error)
+                    std::rethrow_exception(pFrame->error);
 
-    Sophus::SE3f Tcw = mpTracker->GrabImageRGBD(imToFeed,imDepthToFeed,timestamp,filename);
+                CheckModeAndReset();
 
-    std::unique_lock<std::mutex> lock2(mMutexState);
-    mTrackingState = mpTracker->mState;
-    mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
-    mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
-    return Tcw;
+                if (mSensor == System::IMU_STEREO || mSensor == System::IMU_RGBD || mSensor == System::IMU_MONOCULAR)
+                    GrabImuData(vImuMeas);
+
+                Tcw = mpTracker->TrackInputFrame(pFrame->input);
+
+                UpdateTrackingState();
+            }
+            catch(...)
+            {
+                LOG(ERROR) << "Tracking of the frame " << std::fixed << timestamp << " failed";
+                pFrame->pose.set_exception(std::current_exception());
+                return;
+            }
+
+            pFrame->pose.set_value(Tcw);
+            if(callback)
+                callback(timestamp,Tcw);
+        });
+
+    return pose;
 }
 
-Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas, std::string filename)
+void System::WaitForTracking()
 {
+    mpTrackingPipeline->Wait();
+}
 
+void System::CheckStereoSensor()
+{
+    if(mSensor!=STEREO && mSensor!=IMU_STEREO)
     {
-        std::unique_lock<std::mutex> lock(mMutexReset);
-        if(mbShutDown)
-            return Sophus::SE3f();
+        LOG(ERROR) << "TrackStereo called but input sensor was neither Stereo nor Stereo-Inertial";
+        exit(-1);
+    }
+}
+
+void System::CheckRGBDSensor()
+{
+    if(mSensor!=RGBD  && mSensor!=IMU_RGBD)
+    {
+        LOG(ERROR) << "TrackRGBD called but input sensor was not RGBD";
+        exit(-1);
     }
+}
 
+void System::CheckMonocularSensor()
+{
     if(mSensor!=MONOCULAR && mSensor!=IMU_MONOCULAR)
     {
         LOG(ERROR) << "TrackMonocular called but input sensor was neither Monocular nor Monocular-Inertial";
         exit(-1);
     }
+}
+
+void System::PrepareStereoImages(const cv::Mat &imLeft, const cv::Mat &imRight, const bool bCopy, cv::Mat &imLeftToFeed, cv::Mat &imRightToFeed)
+{
+    if(settings_ && settings_->needToRectify()){
+        cv::Mat M1l = settings_->M1l();
+        cv::Mat M2l = settings_->M2l();
+        cv::Mat M1r = settings_->M1r();
+        cv::Mat M2r = settings_->M2r();
+
+        cv::remap(imLeft, imLeftToFeed, M1l, M2l, cv::INTER_LINEAR);
+        cv::remap(imRight, imRightToFeed, M1r, M2r, cv::INTER_LINEAR);
+    }
+    else if(settings_ && settings_->needToResize()){
+        cv::resize(imLeft,imLeftToFeed,settings_->newImSize());
+        cv::resize(imRight,imRightToFeed,settings_->newImSize());
+    }
+    else{
+        imLeftToFeed = bCopy ? imLeft.clone() : imLeft;
+        imRightToFeed = bCopy ? imRight.clone() : imRight;
+    }
+}
 
-    cv::Mat imToFeed = im.clone();
+void System::PrepareRGBDImages(const cv::Mat &im, const cv::Mat &depthmap, const bool bCopy, cv::Mat &imToFeed, cv::Mat &imDepthToFeed)
+{
     if(settings_ && settings_->needToResize()){
-        cv::Mat resizedIm;
-        cv::resize(im,resizedIm,settings_->newImSize());
-        imToFeed = resizedIm;
+        cv::resize(im,imToFeed,settings_->newImSize());
+        cv::resize(depthmap,imDepthToFeed,settings_->newImSize());
+    }
+    else{
+        imToFeed = bCopy ? im.clone() : im;
+        imDepthToFeed = bCopy ? depthmap.clone() : depthmap;
     }
+}
 
+void System::PrepareMonocularImage(const cv::Mat &im, const bool bCopy, cv::Mat &imToFeed)
+{
+    if(settings_ && settings_->needToResize())
+        cv::resize(im,imToFeed,settings_->newImSize());
+    else
+        imToFeed = bCopy ? im.clone() : im;
+}
+
+void System::CheckModeAndReset()
+{
     // Check mode change
     {
         std::unique_lock<std::mutex> lock(mMutexMode);
@@ -429,10 +651,7 @@ Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp,
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             mpTracker->InformOnlyTracking(true);
             mbActivateLocalizationMode = false;
@@ -456,24 +675,26 @@ Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp,
         }
         else if(mbResetActiveMap)
         {
-            LOG(WARNING) << "SYSTEM -> Reseting active map in monocular case";
+            if(mSensor == MONOCULAR || mSensor == IMU_MONOCULAR)
+                LOG(WARNING) << "SYSTEM -> Reseting active map in monocular case";
             mpTracker->ResetActiveMap();
             mbResetActiveMap = false;
         }
     }
+}
 
-    if (mSensor == System::IMU_MONOCULAR)
-        for(std::size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
-            mpTracker->GrabImuData(vImuMeas[i_imu]);
-
-    Sophus::SE3f Tcw = mpTracker->GrabImageMonocular(imToFeed,timestamp,filename);
+void System::GrabImuData(const std::vector<IMU::Point>& vImuMeas)
+{
+    for(std::size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
+        mpTracker->GrabImuData(vImuMeas[i_imu]);
+}
 
-    std::unique_lock<std::mutex> lock2(mMutexState);
+void System::UpdateTrackingState()
+{
+    std::unique_lock<std::mutex> lock(mMutexState);
     mTrackingState = mpTracker->mState;
     mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
     mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
-
-    return Tcw;
 }
 
 
@@ -522,6 +743,9 @@ void System::Shutdown()
         mbShutDown = true;
     }
 
+    // The frames already queued are tracked before the threads are stopped
+    mpTrackingPipeline->Wait();
+
     LOG(INFO) << "Shutdown";
 
     mpLocalMapper->RequestFinish();
@@ -546,6 +770,9 @@ void System::Shutdown()
     //     usleep(5000);
     // }
 
+    if(mtAtlasSnapshot.joinable())
+        mtAtlasSnapshot.join();
+
     if(!mStrSaveAtlasToFile.empty())
     {
         VLOG(1) << "Atlas saving to file " << mStrSaveAtlasToFile;
@@ -674,10 +901,10 @@ void System::SaveTrajectoryEuRoC(const std::string &filename)
     LOG(INFO) << "There are " << vpMaps.size() << " maps in the atlas";
     for(auto pMap :vpMaps)
     {
-        LOG(INFO) << "Map " << pMap->GetId() << " has " << pMap->GetAllKeyFrames().size() << " KFs";
-        if(pMap->GetAllKeyFrames().size() > numMaxKFs)
+        LOG(INFO) << "Map " << pMap->GetId() << " has " << pMap->KeyFramesInMap() << " KFs";
+        if(pMap->KeyFramesInMap() > numMaxKFs)
         {
-            numMaxKFs = pMap->GetAllKeyFrames().size();
+            numMaxKFs = pMap->KeyFramesInMap();
             pBiggerMap = pMap;
         }
     }
@@ -1052,9 +1279,9 @@ void System::SaveKeyFrameTrajectoryEuRoC(const std::string &filename)
     int numMaxKFs = 0;
     for(auto pMap :vpMaps)
     {
-        if(pMap && pMap->GetAllKeyFrames().size() > numMaxKFs)
+        if(pMap && pMap->KeyFramesInMap() > numMaxKFs)
         {
-            numMaxKFs = pMap->GetAllKeyFrames().size();
+            numMaxKFs = pMap->KeyFramesInMap();
             pBiggerMap = pMap;
         }
     }
@@ -1376,6 +1603,134 @@ float System::GetImageScale()
     return mpTracker->GetImageScale();
 }
 
+ThreadPool* System::GetThreadPool()
+{
+    return mpThreadPool.get();
+}
+
+void System::SetStageTimingHook(ThreadPool::StageHook hook)
+{
+    mpThreadPool->SetStageHook(std::move(hook));
+}
+
+void System::SetAtlasProgressCallback(AtlasProgressCallback callback)
+{
+    mAtlasProgressCallback = std::move(callback);
+}
+
+bool System::RequestAtlasSnapshot(const std::string &filename)
+{
+    if(mbAtlasSnapshotRunning.exchange(true))
+    {
+        LOG(WARNING) << "An atlas snapshot is already running";
+        return false;
+    }
+    if(mtAtlasSnapshot.joinable())
+        mtAtlasSnapshot.join();
+
+    // Hashing the vocabulary may take a while, do it before pausing the tracking
+    const std::string strVocabularyChecksum = GetVocabularyCheckSum();
+    const std::size_t found = mStrVocabularyFilePath.find_last_of("/\\");
+    const std::string strVocabularyName = mStrVocabularyFilePath.substr(found+1);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto pSnapshot = std::make_shared<Atlas::Snapshot>();
+    // No captured MapPoint is reclaimed until the snapshot is written
+    EpochParticipant participant(mpReclaimer);
+    bool bCaptured;
+    {
+        // Tracking, local mapping and loop closing change the graph of the current map under this lock
+        Map* pCurrentMap = mpAtlas->GetCurrentMap();
+        std::unique_lock<std::mutex> lock;
+        if(pCurrentMap)
+            lock = std::unique_lock<std::mutex>(pCurrentMap->mMutexMapUpdate);
+        bCaptured = mpAtlas->CaptureSnapshot(filename, strVocabularyName, strVocabularyChecksum, *pSnapshot);
+    }
+    const double dPauseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        std::unique_lock<std::mutex> lock(mMutexAtlasSnapshot);
+        mAtlasSnapshotMetrics.dLastPauseMs = dPauseMs;
+        mAtlasSnapshotMetrics.dMaxPauseMs = std::max(mAtlasSnapshotMetrics.dMaxPauseMs, dPauseMs);
+    }
+    if(!bCaptured)
+    {
+        LOG(ERROR) << "Failed to capture the atlas snapshot " << filename;
+        std::unique_lock<std::mutex> lock(mMutexAtlasSnapshot);
+        mAtlasSnapshotMetrics.nSnapshots++;
+        mAtlasSnapshotMetrics.bLastSucceeded = false;
+        mbAtlasSnapshotRunning = false;
+        return false;
+    }
+    VLOG(1) << "Atlas snapshot captured in " << dPauseMs << " ms";
+
+    const AtlasProgressCallback progress = mAtlasProgressCallback;
+    mtAtlasSnapshot = std::thread([this, pSnapshot, progress, start, participant = std::move(participant)]()
+    {
+        const bool bOk = mpAtlas->SaveSnapshot(*pSnapshot, progress);
+        const double dDurationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if(bOk)
+            LOG(INFO) << "Atlas snapshot saved to " << pSnapshot->strFilename << " in " << dDurationMs << " ms";
+
+        std::unique_lock<std::mutex> lock(mMutexAtlasSnapshot);
+        mAtlasSnapshotMetrics.nSnapshots++;
+        mAtlasSnapshotMetrics.bLastSucceeded = bOk;
+        mAtlasSnapshotMetrics.dLastDurationMs = dDurationMs;
+        mAtlasSnapshotMetrics.nLastItems = pSnapshot->nTotal;
+        mbAtlasSnapshotRunning = false;
+    });
+    return true;
+}
+
+bool System::IsAtlasSnapshotRunning()
+{
+    return mbAtlasSnapshotRunning;
+}
+
+System::AtlasSnapshotMetrics System::GetAtlasSnapshotMetrics()
+{
+    std::unique_lock<std::mutex> lock(mMutexAtlasSnapshot);
+    return mAtlasSnapshotMetrics;
+}
+
+EpochReclaimer* System::GetReclaimer()
+{
+    return mpReclaimer;
+}
+
+System::MapMemoryMetrics System::GetMapMemoryMetrics()
+{
+    MapMemoryMetrics metrics;
+    const ObjectPool<MapPoint>::Stats mapPoints = ObjectPool<MapPoint>::Instance().GetStats();
+    const ObjectPool<KeyFrame>::Stats keyFrames = ObjectPool<KeyFrame>::Instance().GetStats();
+    metrics.nLiveMapPoints = mapPoints.live;
+    metrics.nLiveKeyFrames = keyFrames.live;
+    metrics.nPooledMapPoints = mapPoints.capacity;
+    metrics.nPooledKeyFrames = keyFrames.capacity;
+    if(mpReclaimer)
+    {
+        const EpochReclaimer::Stats reclaimer = mpReclaimer->GetStats();
+        metrics.nRetiredMapPoints = reclaimer.retired;
+        metrics.nFreedMapPoints = reclaimer.reclaimed;
+        metrics.nKeptMapPoints = reclaimer.kept;
+        metrics.nPendingMapPoints = reclaimer.pending;
+    }
+    return metrics;
+}
+
+System::QueueMetrics System::GetQueueMetrics()
+{
+    QueueMetrics metrics;
+    metrics.localMapping = mpLocalMapper->GetQueueMetrics();
+    metrics.loopClosing = mpLoopCloser->GetQueueMetrics();
+    return metrics;
+}
+
+TwoStagePipeline::Metrics System::GetTrackingPipelineMetrics()
+{
+    return mpTrackingPipeline->GetMetrics();
+}
+
 #ifdef REGISTER_TIMES
 void System::InsertRectTime(double& time)
 {
@@ -1396,21 +1751,19 @@ void System::InsertTrackTime(double& time)
 void System::SaveAtlas(int type){
     if(!mStrSaveAtlasToFile.empty())
     {
-        //clock_t start = clock();
-
-        // Save the current session
-        mpAtlas->PreSave();
-
         std::string pathSaveFileName = "./";
         pathSaveFileName = pathSaveFileName.append(mStrSaveAtlasToFile);
         pathSaveFileName = pathSaveFileName.append(".osa");
 
-        std::string strVocabularyChecksum = CalculateCheckSum(mStrVocabularyFilePath,TEXT_FILE);
+        std::string strVocabularyChecksum = GetVocabularyCheckSum();
         std::size_t found = mStrVocabularyFilePath.find_last_of("/\\");
         std::string strVocabularyName = mStrVocabularyFilePath.substr(found+1);
 
         if(type == TEXT_FILE) // File text
         {
+            // Save the current session
+            mpAtlas->PreSave();
+
             LOG(INFO) << "Starting to write the save text file";
             std::remove(pathSaveFileName.c_str());
             std::ofstream ofs(pathSaveFileName, std::ios::binary);
@@ -1423,14 +1776,17 @@ void System::SaveAtlas(int type){
         }
         else if(type == BINARY_FILE) // File binary
         {
+            // Chunked atlas file, written as a stream of blocks
             LOG(INFO) << "Starting to write the save binary file";
-            std::remove(pathSaveFileName.c_str());
-            std::ofstream ofs(pathSaveFileName, std::ios::binary);
-            boost::archive::binary_oarchive oa(ofs);
-            oa << strVocabularyName;
-            oa << strVocabularyChecksum;
-            oa << mpAtlas;
-            LOG(INFO) << "End to write save binary file";
+            const auto start = std::chrono::steady_clock::now();
+            if(!mpAtlas->Save(pathSaveFileName, strVocabularyName, strVocabularyChecksum, mAtlasProgressCallback))
+            {
+                LOG(ERROR) << "Failed to write the save binary file";
+                return;
+            }
+            const auto stop = std::chrono::steady_clock::now();
+            LOG(INFO) << "End to write save binary file in "
+                      << std::chrono::duration<double>(stop - start).count() << " s";
         }
     }
 }
@@ -1460,7 +1816,19 @@ bool System::LoadAtlas(int type)
         LOG(INFO) << "End to load the save text file ";
         isRead = true;
     }
-    else if(type == BINARY_FILE) // File binary
+    else if(type == BINARY_FILE && AtlasFileReader::IsAtlasFile(pathLoadFileName)) // Chunked atlas file
+    {
+        LOG(INFO) << "Starting to read the save binary file";
+        const auto start = std::chrono::steady_clock::now();
+        mpAtlas = new Atlas();
+        isRead = mpAtlas->Load(pathLoadFileName, strFileVoc, strVocChecksum, mAtlasProgressCallback, mbLazyLoadAtlas);
+        if(!isRead)
+            return false;
+        const auto stop = std::chrono::steady_clock::now();
+        LOG(INFO) << "End to load the save binary file in "
+                  << std::chrono::duration<double>(stop - start).count() << " s";
+    }
+    else if(type == BINARY_FILE) // File binary, boost archive of earlier versions
     {
         LOG(INFO) << "Starting to read the save binary file";
         std::ifstream ifs(pathLoadFileName, std::ios::binary);
@@ -1480,7 +1848,7 @@ bool System::LoadAtlas(int type)
     if(isRead)
     {
         //Check if the vocabulary is the same
-        std::string strInputVocabularyChecksum = CalculateCheckSum(mStrVocabularyFilePath,TEXT_FILE);
+        std::string strInputVocabularyChecksum = GetVocabularyCheckSum();
 
         if(strInputVocabularyChecksum.compare(strVocChecksum) != 0)
         {
@@ -1498,6 +1866,48 @@ bool System::LoadAtlas(int type)
     return false;
 }
 
+bool System::LoadVocabulary(const std::string &strVocFile)
+{
+    mpVocabulary = new ORBVocabulary();
+    mStrVocabularyChecksum.clear();
+
+    const auto start = std::chrono::steady_clock::now();
+    bool bVocLoad = false;
+    if(ORBVocabulary::isBinaryFile(strVocFile))
+    {
+        bVocLoad = mpVocabulary->loadFromBinaryFile(strVocFile);
+        if(bVocLoad)
+            mStrVocabularyChecksum = mpVocabulary->getChecksum();
+
+        // Sessions are checked against the MD5 of the text vocabulary, which
+        // only the converter can store in the header
+        if(bVocLoad && mStrVocabularyChecksum.empty())
+        {
+            LOG(ERROR) << "The binary vocabulary " << strVocFile << " has no checksum of its text vocabulary, convert it again with convert_vocabulary";
+            bVocLoad = false;
+        }
+    }
+    else
+        bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+    const auto end = std::chrono::steady_clock::now();
+
+    if(bVocLoad)
+        LOG(INFO) << "Vocabulary with " << mpVocabulary->size() << " words loaded in "
+                  << std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(end - start).count() << " ms";
+
+    return bVocLoad;
+}
+
+std::string System::GetVocabularyCheckSum()
+{
+    // Text vocabularies are only hashed when a session is saved or loaded,
+    // binary ones always carry the checksum of their text vocabulary
+    if(mStrVocabularyChecksum.empty())
+        mStrVocabularyChecksum = CalculateCheckSum(mStrVocabularyFilePath,TEXT_FILE);
+
+    return mStrVocabularyChecksum;
+}
+
 std::string System::CalculateCheckSum(std::string filename, int type)
 {
     std::string checksum = "";
@@ -20,7 +20,12 @@
 #define SYSTEM_H
 
 // Standard
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -29,8 +34,13 @@
 #include <opencv2/core.hpp>
 #include <orbslam3/external/Sophus/sophus/se3.hpp>
 // Local
+#include "orbslam3/AtlasFile.h"
+#include "orbslam3/ImageInput.h"
 #include "orbslam3/ImuTypes.h"
 #include "orbslam3/ORBVocabulary.h"
+#include "orbslam3/ThreadPool.h"
+#include "orbslam3/TwoStagePipeline.h"
+#include "orbslam3/WorkQueue.h"
 
 namespace ORB_SLAM3
 {
@@ -40,7 +50,9 @@ namespace ORB_SLAM3
 // 1: Debug messages
 
 class Atlas;
+class EpochReclaimer;
 class FrameDrawer;
+class KeyFrame;
 class KeyFrameDatabase;
 class LocalMapping;
 class LoopClosing;
@@ -91,6 +103,32 @@ public:
     // Returns the camera pose (empty if tracking fails).
     Sophus::SE3f TrackMonocular(const cv::Mat &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="");
 
+    // Zero-copy versions of the Track* functions, for caller-owned buffers (e.g. of a camera driver): the
+    // views are converted (color, scale, depth units) in one pass into pooled buffers, without copy nor
+    // allocation, then `release` is called and the caller can reuse its buffers.
+    Sophus::SE3f TrackStereo(const ImageView &left, const ImageView &right, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", ReleaseCallback release = ReleaseCallback());
+    Sophus::SE3f TrackRGBD(const ImageView &im, const DepthView &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", ReleaseCallback release = ReleaseCallback());
+    Sophus::SE3f TrackMonocular(const ImageView &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", ReleaseCallback release = ReleaseCallback());
+
+    // Asynchronous versions of the Track* functions: the images are copied and the call returns once
+    // the frame is queued. The feature extraction of a frame runs while the previous frame is tracked,
+    // with at most System.TrackingPipelineDepth frames in flight (the call blocks when it is reached).
+    // The frames are tracked in submission order; the future holds the pose, or the exception that
+    // stopped the tracking of the frame, and the callback (which must not throw) receives the pose
+    // once it is known. Do not mix them with the synchronous calls, and call WaitForTracking before
+    // reading the tracking state. Frames in flight when a reset is applied keep their ids.
+    typedef std::function<void(double timestamp, const Sophus::SE3f &Tcw)> TrackingCallback;
+    std::future<Sophus::SE3f> TrackStereoAsync(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", TrackingCallback callback = TrackingCallback());
+    std::future<Sophus::SE3f> TrackRGBDAsync(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", TrackingCallback callback = TrackingCallback());
+    std::future<Sophus::SE3f> TrackMonocularAsync(const cv::Mat &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", TrackingCallback callback = TrackingCallback());
+    // The views are read on the pipeline thread: the buffers must stay valid until `release` is called.
+    std::future<Sophus::SE3f> TrackStereoAsync(const ImageView &left, const ImageView &right, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", TrackingCallback callback = TrackingCallback(), ReleaseCallback release = ReleaseCallback());
+    std::future<Sophus::SE3f> TrackRGBDAsync(const ImageView &im, const DepthView &depthmap, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", TrackingCallback callback = TrackingCallback(), ReleaseCallback release = ReleaseCallback());
+    std::future<Sophus::SE3f> TrackMonocularAsync(const ImageView &im, const double &timestamp, const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(), std::string filename="", TrackingCallback callback = TrackingCallback(), ReleaseCallback release = ReleaseCallback());
+
+    // Block until the frames given to the asynchronous Track* functions are tracked.
+    void WaitForTracking();
+
 
     // This stops local mapping thread (map building) and performs only camera tracking.
     void ActivateLocalizationMode();
@@ -157,18 +195,105 @@ public:
 
     float GetImageScale();
 
+    // Worker pool shared by the intra-frame parallel sections (stereo extraction,
+    // two-view reconstruction, ...). It lives as long as the System.
+    ThreadPool* GetThreadPool();
+
+    // Receive the wall time of every named parallel section run on the pool
+    // (e.g. "Frame::ExtractORB"). Pass an empty hook to disable it.
+    void SetStageTimingHook(ThreadPool::StageHook hook);
+
+    // Receive the progress (MapPoints and KeyFrames done, total) of the atlas saved at
+    // shutdown. By default it is logged every 10%. Pass an empty callback to disable it.
+    void SetAtlasProgressCallback(AtlasProgressCallback callback);
+
+    // Timings of the atlas snapshots
+    struct AtlasSnapshotMetrics
+    {
+        std::size_t nSnapshots = 0;     // Snapshots finished so far
+        bool bLastSucceeded = false;
+        double dLastPauseMs = 0.0;      // Time the current map was locked to capture the last snapshot
+        double dMaxPauseMs = 0.0;
+        double dLastDurationMs = 0.0;   // Capture and write of the last snapshot
+        std::size_t nLastItems = 0;     // MapPoints and KeyFrames in the last snapshot
+    };
+
+    // Save the atlas to a file (chunked atlas file, as saved at shutdown) while the system keeps
+    // running. Tracking only pauses while the map graph is captured, the file is written on a
+    // background thread, reporting to the atlas progress callback. Returns false if a snapshot
+    // is still running or the file can not be created. Shutdown waits for a running snapshot.
+    bool RequestAtlasSnapshot(const std::string &filename);
+    bool IsAtlasSnapshotRunning();
+    AtlasSnapshotMetrics GetAtlasSnapshotMetrics();
+
+    // Reclaimer freeing the culled MapPoints once no thread can hold them (System.ReclaimMapPoints: 1),
+    // nullptr when disabled. When enabled, the MapPoints returned by GetTrackedMapPoints are only
+    // valid until the next frame is tracked.
+    EpochReclaimer* GetReclaimer();
+
+    // Memory of the MapPoints and KeyFrames
+    struct MapMemoryMetrics
+    {
+        std::size_t nLiveMapPoints = 0;     // MapPoints allocated and not freed yet
+        std::size_t nLiveKeyFrames = 0;
+        std::size_t nPooledMapPoints = 0;   // Capacity of the pools
+        std::size_t nPooledKeyFrames = 0;
+        std::size_t nRetiredMapPoints = 0;  // Culled MapPoints handed to the reclaimer
+        std::size_t nFreedMapPoints = 0;
+        std::size_t nKeptMapPoints = 0;     // Retired but still referred to (e.g. by a culled KeyFrame)
+        std::size_t nPendingMapPoints = 0;  // Retired, waiting for all the threads to be quiescent
+    };
+    MapMemoryMetrics GetMapMemoryMetrics();
+
+    // Keyframe queues of the local mapping and of the loop closing threads
+    struct QueueMetrics
+    {
+        WorkQueue<KeyFrame*>::Metrics localMapping;
+        WorkQueue<KeyFrame*>::Metrics loopClosing;
+    };
+    QueueMetrics GetQueueMetrics();
+
+    // Preprocessing and tracking stages of the asynchronous Track* functions
+    TwoStagePipeline::Metrics GetTrackingPipelineMetrics();
+
 #ifdef REGISTER_TIMES
     void InsertRectTime(double& time);
     void InsertResizeTime(double& time);
     void InsertTrackTime(double& time);
 #endif
 
+    // MD5 of a file, as hexadecimal string (empty if it can not be read).
+    static std::string CalculateCheckSum(std::string filename, int type);
+
 private:
 
     void SaveAtlas(int type);
     bool LoadAtlas(int type);
 
-    std::string CalculateCheckSum(std::string filename, int type);
+    // Shared by the synchronous and asynchronous Track* functions.
+    void CheckStereoSensor();
+    void CheckRGBDSensor();
+    void CheckMonocularSensor();
+    void PrepareStereoImages(const cv::Mat &imLeft, const cv::Mat &imRight, const bool bCopy, cv::Mat &imLeftToFeed, cv::Mat &imRightToFeed);
+    void PrepareRGBDImages(const cv::Mat &im, const cv::Mat &depthmap, const bool bCopy, cv::Mat &imToFeed, cv::Mat &imDepthToFeed);
+    void PrepareMonocularImage(const cv::Mat &im, const bool bCopy, cv::Mat &imToFeed);
+    // Apply the pending mode change and reset requests
+    void CheckModeAndReset();
+    void GrabImuData(const std::vector<IMU::Point>& vImuMeas);
+    void UpdateTrackingState();
+
+    // Queue a frame in the tracking pipeline: prepare(Tracking::InputFrame&) builds it on the pipeline thread.
+    // `release` is called if the frame is dropped before (after the shutdown).
+    template<typename Prepare>
+    std::future<Sophus::SE3f> SubmitTracking(Prepare prepare, const std::vector<IMU::Point>& vImuMeas, const double timestamp, TrackingCallback callback, const ReleaseCallback &release = ReleaseCallback());
+
+    // Load the vocabulary, from the binary format if the file is a binary vocabulary, else from text.
+    // A binary vocabulary without the checksum of its text vocabulary is rejected.
+    bool LoadVocabulary(const std::string &strVocFile);
+
+    // Checksum of the vocabulary stored in the saved sessions. The MD5 of the text vocabulary,
+    // read from the header for a binary vocabulary (no need to rehash the whole file).
+    std::string GetVocabularyCheckSum();
 
     // Input sensor
     eSensor mSensor;
@@ -207,6 +332,15 @@ private:
     std::thread* mptLoopClosing;
     std::thread* mptViewer;
 
+    // Long-lived workers for intra-frame parallelism, created before the Tracking.
+    std::unique_ptr<ThreadPool> mpThreadPool;
+
+    // Builds the frames of the asynchronous Track* functions while the previous ones are tracked.
+    std::unique_ptr<TwoStagePipeline> mpTrackingPipeline;
+
+    // Reclaimer of the culled MapPoints, created before the threads when enabled
+    EpochReclaimer* mpReclaimer{nullptr};
+
     // Reset flag
     std::mutex mMutexReset;
     bool mbReset;
@@ -229,8 +363,21 @@ private:
     //
     std::string mStrLoadAtlasFromFile;
     std::string mStrSaveAtlasToFile;
+    // Load only the map headers and page in the maps on demand (chunked atlas files)
+    bool mbLazyLoadAtlas;
+    // Free the culled MapPoints
+    bool mbReclaimMapPoints;
 
     std::string mStrVocabularyFilePath;
+    std::string mStrVocabularyChecksum;
+
+    AtlasProgressCallback mAtlasProgressCallback;
+
+    // Background atlas snapshot
+    std::thread mtAtlasSnapshot;
+    std::atomic<bool> mbAtlasSnapshotRunning;
+    std::mutex mMutexAtlasSnapshot;
+    AtlasSnapshotMetrics mAtlasSnapshotMetrics;
 
     Settings* settings_;
 };
@@ -0,0 +1,170 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+// Local
+#include "orbslam3/ThreadPool.h"
+
+namespace ORB_SLAM3 {
+
+ThreadPool::ThreadPool(const std::size_t num_threads) {
+  workers_.reserve(num_threads);
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::size_t ThreadPool::NumThreads() const {
+  return workers_.size();
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      // Drain the queue before stopping so no future is left unsatisfied.
+      if (stop_ && tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::ParallelFor(
+  const std::size_t begin,
+  const std::size_t end,
+  const std::function<void(std::size_t)>& fn,
+  const char* stage
+) {
+  const std::shared_ptr<const StageHook> hook = stage ? std::atomic_load(&stage_hook_) : nullptr;
+  if (!hook) {
+    RunParallelFor(begin, end, fn);
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  RunParallelFor(begin, end, fn);
+  const auto stop = std::chrono::steady_clock::now();
+  (*hook)(stage, std::chrono::duration<double, std::milli>(stop - start).count());
+}
+
+void ThreadPool::SetStageHook(StageHook hook) {
+  std::shared_ptr<const StageHook> new_hook;
+  if (hook) {
+    new_hook = std::make_shared<const StageHook>(std::move(hook));
+  }
+  std::atomic_store(&stage_hook_, new_hook);
+}
+
+void ThreadPool::RunParallelFor(
+  const std::size_t begin,
+  const std::size_t end,
+  const std::function<void(std::size_t)>& fn
+) {
+  if (begin >= end) {
+    return;
+  }
+  const std::size_t count = end - begin;
+  if (count == 1 || workers_.empty()) {
+    for (std::size_t i = begin; i < end; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  // Shared with the helper tasks, which may start after this call returned.
+  struct State {
+    std::atomic<std::size_t> next{0};
+    std::size_t done = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  auto state = std::make_shared<State>();
+
+  // Claim indices until none is left. Only a claimed index can hold the
+  // caller back, and whoever claimed it is already running it.
+  const auto work = [state, begin, count, &fn]() {
+    std::size_t n_done = 0;
+    std::exception_ptr error;
+    for (std::size_t i = state->next++; i < count; i = state->next++) {
+      try {
+        fn(begin + i);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      ++n_done;
+    }
+    if (n_done == 0) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (error && !state->error) {
+      state->error = error;
+    }
+    state->done += n_done;
+    if (state->done == count) {
+      state->finished.notify_all();
+    }
+  };
+
+  const std::size_t n_helpers = std::min(workers_.size(), count - 1);
+  for (std::size_t i = 0; i < n_helpers; ++i) {
+    Enqueue(work);
+  }
+  work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&state, count] { return state->done == count; });
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,107 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Standard
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// Fixed set of long-lived worker threads executing submitted tasks in FIFO
+// order. A single pool is owned by System and shared by the intra-frame
+// parallel sections (stereo extraction, pyramid levels, two-view
+// reconstruction, ...).
+class ThreadPool {
+public:
+  // Called with the name and wall time (in ms) of every named parallel
+  // section, from the thread that ran the section.
+  using StageHook = std::function<void(const std::string& stage, const double duration_ms)>;
+
+  explicit ThreadPool(const std::size_t num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&)            = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  std::size_t NumThreads() const;
+
+  // Queue a task, the returned future holds its result (or exception).
+  template <typename F>
+  std::future<std::invoke_result_t<F>> Submit(F&& task);
+
+  // Call fn(i) for every i in [begin, end) and return once all calls are done.
+  // The calling thread takes part in the work, so it is safe to call from a
+  // task already running on the pool (nested parallel sections never wait on
+  // a worker that is itself waiting).
+  // When `stage` is given, the section is timed and reported to the hook.
+  void ParallelFor(
+    const std::size_t begin,
+    const std::size_t end,
+    const std::function<void(std::size_t)>& fn,
+    const char* stage = nullptr
+  );
+
+  // Install (or remove with an empty hook) the per-stage timing hook. Safe to
+  // call while sections are running.
+  void SetStageHook(StageHook hook);
+
+private:
+  void RunParallelFor(
+    const std::size_t begin,
+    const std::size_t end,
+    const std::function<void(std::size_t)>& fn
+  );
+  void Enqueue(std::function<void()> task);
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stop_ = false;
+  std::shared_ptr<const StageHook> stage_hook_;
+};
+
+template <typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::Submit(F&& task) {
+  using R = std::invoke_result_t<F>;
+  // std::function needs a copyable callable, hence the shared packaged_task.
+  auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+  std::future<R> result = packaged->get_future();
+  Enqueue([packaged]() { (*packaged)(); });
+  return result;
+}
+
+} // namespace ORB_SLAM3
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,88 @@
+// Standard
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/ThreadPool.h"
+
+using namespace ORB_SLAM3;
+
+TEST(ThreadPool, Submit) {
+  ThreadPool pool(2);
+  EXPECT_EQ(pool.NumThreads(), 2u);
+
+  std::future<int> a = pool.Submit([] { return 40; });
+  std::future<int> b = pool.Submit([] { return 2; });
+  EXPECT_EQ(a.get() + b.get(), 42);
+
+  std::future<void> error = pool.Submit([] { throw std::runtime_error("error"); });
+  EXPECT_THROW(error.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(3);
+
+  // Every index is visited exactly once.
+  std::vector<std::atomic<int>> visits(1000);
+  pool.ParallelFor(0, visits.size(), [&visits](const std::size_t i) { ++visits[i]; });
+  for (const auto& v : visits) {
+    EXPECT_EQ(v.load(), 1);
+  }
+
+  // Empty and reversed ranges are no-ops.
+  int calls = 0;
+  pool.ParallelFor(5, 5, [&calls](const std::size_t) { ++calls; });
+  pool.ParallelFor(5, 2, [&calls](const std::size_t) { ++calls; });
+  EXPECT_EQ(calls, 0);
+
+  // Exceptions reach the caller.
+  EXPECT_THROW(
+    pool.ParallelFor(0, 10, [](const std::size_t i) {
+      if (i == 7) {
+        throw std::runtime_error("error");
+      }
+    }),
+    std::runtime_error
+  );
+}
+
+TEST(ThreadPool, NestedParallelFor) {
+  // Nested sections must not deadlock even when every worker is busy.
+  ThreadPool pool(2);
+  std::atomic<int> sum(0);
+  pool.ParallelFor(0, 8, [&](const std::size_t) {
+    pool.ParallelFor(0, 16, [&](const std::size_t j) { sum += static_cast<int>(j); });
+  });
+  EXPECT_EQ(sum.load(), 8 * (15 * 16 / 2));
+}
+
+TEST(ThreadPool, NoWorkers) {
+  // Without workers everything runs on the caller.
+  ThreadPool pool(0);
+  int sum = 0;
+  pool.ParallelFor(0, 4, [&sum](const std::size_t i) { sum += static_cast<int>(i); });
+  EXPECT_EQ(sum, 6);
+}
+
+TEST(ThreadPool, StageHook) {
+  ThreadPool pool(2);
+  std::vector<std::string> stages;
+  pool.SetStageHook([&stages](const std::string& stage, const double duration_ms) {
+    EXPECT_GE(duration_ms, 0.0);
+    stages.push_back(stage);
+  });
+
+  // Only named sections are reported.
+  pool.ParallelFor(0, 4, [](const std::size_t) {}, "named");
+  pool.ParallelFor(0, 4, [](const std::size_t) {});
+  ASSERT_EQ(stages.size(), 1u);
+  EXPECT_EQ(stages[0], "named");
+
+  // Removing the hook stops the reports.
+  pool.SetStageHook(nullptr);
+  pool.ParallelFor(0, 4, [](const std::size_t) {}, "named");
+  EXPECT_EQ(stages.size(), 1u);
+}
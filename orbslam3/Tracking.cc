@@ -17,8 +17,10 @@
 */
 
 // Standard
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <utility>
 // 3rdparty
 #include <glog/logging.h>
 #include <opencv2/imgproc.hpp>
@@ -41,6 +43,7 @@
 #include "orbslam3/Optimizer.h"
 #include "orbslam3/Settings.h"
 #include "orbslam3/System.h"
+#include "orbslam3/ThreadPool.h"
 #include "orbslam3/Tracking.h"
 #include "orbslam3/Viewer.h"
 
@@ -55,6 +58,13 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpAtlas(pAtlas), mnLastRelocFrameId(0), time_recently_lost(5.0),
     mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL))
 {
+    // Shared workers of the intra-frame parallel sections
+    mpThreadPool = pSys ? pSys->GetThreadPool() : nullptr;
+    mEpochParticipant = EpochParticipant(pSys ? pSys->GetReclaimer() : nullptr);
+
+    // Resize and rectification of the zero-copy inputs
+    mpSettings = settings;
+
     // Load camera parameters from settings file
     if(settings){
         newParameterLoader(settings);
@@ -221,8 +231,8 @@ void Tracking::TrackStats2File()
     std::ofstream f;
     f.open("SessionInfo.txt");
     f << std::fixed;
-    f << "Number of KFs: " << mpAtlas->GetAllKeyFrames().size() << std::endl;
-    f << "Number of MPs: " << mpAtlas->GetAllMapPoints().size() << std::endl;
+    f << "Number of KFs: " << mpAtlas->KeyFramesInMap() << std::endl;
+    f << "Number of MPs: " << mpAtlas->MapPointsInMap() << std::endl;
 
     f << "OpenCV version: " << CV_VERSION << std::endl;
 
@@ -408,22 +418,22 @@ void Tracking::PrintTimeStats()
 
     // Map complexity
     LOG(INFO) << "Map complexity";
-    LOG(INFO) << "KFs in map: " << mpAtlas->GetAllKeyFrames().size();
-    LOG(INFO) << "MPs in map: " << mpAtlas->GetAllMapPoints().size();
+    LOG(INFO) << "KFs in map: " << mpAtlas->KeyFramesInMap();
+    LOG(INFO) << "MPs in map: " << mpAtlas->MapPointsInMap();
     f << "---------------------------" << std::endl;
     f << std::endl << "Map complexity" << std::endl;
     std::vector<Map*> vpMaps = mpAtlas->GetAllMaps();
     Map* pBestMap = vpMaps[0];
     for(int i=1; i<vpMaps.size(); ++i)
     {
-        if(pBestMap->GetAllKeyFrames().size() < vpMaps[i]->GetAllKeyFrames().size())
+        if(pBestMap->KeyFramesInMap() < vpMaps[i]->KeyFramesInMap())
         {
             pBestMap = vpMaps[i];
         }
     }
 
-    f << "KFs in map: " << pBestMap->GetAllKeyFrames().size() << std::endl;
-    f << "MPs in map: " << pBestMap->GetAllMapPoints().size() << std::endl;
+    f << "KFs in map: " << pBestMap->KeyFramesInMap() << std::endl;
+    f << "MPs in map: " << pBestMap->MapPointsInMap() << std::endl;
 
     f << "---------------------------" << std::endl;
     f << std::endl << "Place Recognition (mean$\\pm$std)" << std::endl;
@@ -533,6 +543,38 @@ Tracking::~Tracking()
 
 }
 
+void Tracking::EnableParallelExtraction(const bool bParallel)
+{
+    if(!bParallel || !mpThreadPool)
+        return;
+
+    for(ORBextractor* pExtractor : {mpORBextractorLeft, mpORBextractorRight, mpIniORBextractor})
+        if(pExtractor)
+            pExtractor->SetThreadPool(mpThreadPool);
+
+    LOG(INFO) << "Parallel ORB extraction on " << mpThreadPool->NumThreads() << " pool workers";
+}
+
+void Tracking::EnableBufferReuse(const bool bReuse)
+{
+    // The frames are extracted one at a time and only read the pyramid while they are built
+    for(ORBextractor* pExtractor : {mpORBextractorLeft, mpORBextractorRight, mpIniORBextractor})
+        if(pExtractor)
+            pExtractor->SetBufferReuse(bReuse);
+}
+
+void Tracking::SetDescriptorAngleBins(const int nBins)
+{
+    if(nBins <= 0)
+        return;
+
+    for(ORBextractor* pExtractor : {mpORBextractorLeft, mpORBextractorRight, mpIniORBextractor})
+        if(pExtractor)
+            pExtractor->SetAngleBins(nBins);
+
+    LOG(INFO) << "ORB descriptors steered in " << nBins << " angle bins";
+}
+
 void Tracking::newParameterLoader(Settings *settings) {
     mpCamera = settings->camera1();
     mpCamera = mpAtlas->AddCamera(mpCamera);
@@ -601,6 +643,11 @@ void Tracking::newParameterLoader(Settings *settings) {
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
         mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
 
+    EnableParallelExtraction(settings->parallelExtraction());
+    EnableBufferReuse(settings->reuseExtractorBuffers());
+    SetDescriptorAngleBins(settings->descriptorAngleBins());
+    Optimizer::SetDensePoseSolver(settings->densePoseSolver());
+
     //IMU parameters
     Sophus::SE3f Tbc = settings->Tbc();
     mInsertKFsLost = settings->insertKFsWhenLost();
@@ -1288,6 +1335,34 @@ bool Tracking::ParseORBParamFile(cv::FileStorage &fSettings)
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
         mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
 
+    // Optional, sequential extraction by default
+    bool bParallel = false;
+    node = fSettings["ORBextractor.parallel"];
+    if(!node.empty() && node.isInt())
+        bParallel = node.operator int() != 0;
+    EnableParallelExtraction(bParallel);
+
+    // Optional, reused buffers by default
+    bool bReuseBuffers = true;
+    node = fSettings["ORBextractor.reuseBuffers"];
+    if(!node.empty() && node.isInt())
+        bReuseBuffers = node.operator int() != 0;
+    EnableBufferReuse(bReuseBuffers);
+
+    // Optional, exact steering by default
+    int nAngleBins = 0;
+    node = fSettings["ORBextractor.angleBins"];
+    if(!node.empty() && node.isInt())
+        nAngleBins = node.operator int();
+    SetDescriptorAngleBins(nAngleBins);
+
+    // Optional, dense pose solvers by default
+    bool bDensePoseSolver = true;
+    node = fSettings["System.DensePoseSolver"];
+    if(!node.empty() && node.isInt())
+        bDensePoseSolver = node.operator int() != 0;
+    Optimizer::SetDensePoseSolver(bDensePoseSolver);
+
     std::ostringstream oss;
     oss << "ORB Extractor Parameters: "                 << std::endl;
     oss << "- Number of Features: "     << nFeatures    << std::endl;
@@ -1295,6 +1370,7 @@ bool Tracking::ParseORBParamFile(cv::FileStorage &fSettings)
     oss << "- Scale Factor: "           << fScaleFactor << std::endl;
     oss << "- Initial Fast Threshold: " << fIniThFAST   << std::endl;
     oss << "- Minimum Fast Threshold: " << fMinThFAST   << std::endl;
+    oss << "- Parallel Extraction: "    << bParallel    << std::endl;
     LOG(INFO) << oss.str();
 
     return true;
@@ -1453,164 +1529,326 @@ bool Tracking::GetStepByStep()
 
 
 Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, std::string filename)
+{
+    InputFrame input;
+    PrepareStereo(imRectLeft,imRectRight,timestamp,filename,input);
+    return TrackInputFrame(input);
+}
+
+
+Sophus::SE3f Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, std::string filename)
+{
+    InputFrame input;
+    PrepareRGBD(imRGB,imD,timestamp,filename,input);
+    return TrackInputFrame(input);
+}
+
+
+Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp, std::string filename)
+{
+    mbIniExtractorHint = NeedIniExtractor();
+
+    InputFrame input;
+    PrepareMonocular(im,timestamp,filename,input);
+    return TrackInputFrame(input);
+}
+
+
+Sophus::SE3f Tracking::GrabImageStereo(const ImageView &left, const ImageView &right, const double &timestamp, std::string filename, const ReleaseCallback &release)
+{
+    InputFrame input;
+    PrepareStereo(left,right,timestamp,filename,release,input);
+    return TrackInputFrame(input);
+}
+
+
+Sophus::SE3f Tracking::GrabImageRGBD(const ImageView &im, const DepthView &depth, const double &timestamp, std::string filename, const ReleaseCallback &release)
+{
+    InputFrame input;
+    PrepareRGBD(im,depth,timestamp,filename,release,input);
+    return TrackInputFrame(input);
+}
+
+
+Sophus::SE3f Tracking::GrabImageMonocular(const ImageView &im, const double &timestamp, std::string filename, const ReleaseCallback &release)
+{
+    mbIniExtractorHint = NeedIniExtractor();
+
+    InputFrame input;
+    PrepareMonocular(im,timestamp,filename,release,input);
+    return TrackInputFrame(input);
+}
+
+
+void Tracking::PrepareStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, std::string filename, InputFrame &input)
 {
     // LOG(INFO) << "GrabImageStereo";
 
-    mImGray = imRectLeft;
+    input.imGray = imRectLeft;
     cv::Mat imGrayRight = imRectRight;
-    mImRight = imRectRight;
+    input.imRight = imRectRight;
 
-    if(mImGray.channels()==3)
+    if(input.imGray.channels()==3)
     {
         // LOG(INFO) << "Image with 3 channels";
         if(mbRGB)
         {
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_RGB2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_RGB2GRAY);
             cv::cvtColor(imGrayRight,imGrayRight,cv::COLOR_RGB2GRAY);
         }
         else
         {
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_BGR2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_BGR2GRAY);
             cv::cvtColor(imGrayRight,imGrayRight,cv::COLOR_BGR2GRAY);
         }
     }
-    else if(mImGray.channels()==4)
+    else if(input.imGray.channels()==4)
     {
         // LOG(INFO) << "Image with 4 channels";
         if(mbRGB)
         {
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_RGBA2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_RGBA2GRAY);
             cv::cvtColor(imGrayRight,imGrayRight,cv::COLOR_RGBA2GRAY);
         }
         else
         {
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_BGRA2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_BGRA2GRAY);
             cv::cvtColor(imGrayRight,imGrayRight,cv::COLOR_BGRA2GRAY);
         }
     }
 
     // LOG(INFO) << "Incoming frame creation";
 
-    if (mSensor == System::STEREO && !mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera);
-    else if(mSensor == System::STEREO && mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr);
-    else if(mSensor == System::IMU_STEREO && !mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,&mLastFrame,*mpImuCalib);
-    else if(mSensor == System::IMU_STEREO && mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr,&mLastFrame,*mpImuCalib);
+    BuildStereoFrame(input,imGrayRight,timestamp,filename);
 
     // LOG(INFO) << "Incoming frame ended";
+}
 
-    mCurrentFrame.mNameFile = filename;
-    mCurrentFrame.mnDataset = mnNumDataset;
 
-#ifdef REGISTER_TIMES
-    vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-    vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
-#endif
+void Tracking::PrepareStereo(const ImageView &left, const ImageView &right, const double &timestamp, std::string filename, const ReleaseCallback &release, InputFrame &input)
+{
+    cv::Mat imGrayRight;
+    try
+    {
+        if(mpSettings && mpSettings->needToRectify())
+        {
+            input.imGray = mImageConverter.Remap(mImageConverter.ToGray(left),mpSettings->M1l(),mpSettings->M2l());
+            imGrayRight = mImageConverter.Remap(mImageConverter.ToGray(right),mpSettings->M1r(),mpSettings->M2r());
+        }
+        else
+        {
+            input.imGray = mImageConverter.ToGray(left,InputSize());
+            imGrayRight = mImageConverter.ToGray(right,InputSize());
+        }
+    }
+    catch(...)
+    {
+        if(release)
+            release();
+        throw;
+    }
+    input.imRight = imGrayRight;
+    if(release)
+        release();
 
-    // LOG(INFO) << "Tracking start";
-    Track();
-    // LOG(INFO) << "Tracking end";
+    BuildStereoFrame(input,imGrayRight,timestamp,filename);
+}
 
-    return mCurrentFrame.GetPose();
+
+cv::Size Tracking::InputSize()
+{
+    return mpSettings && mpSettings->needToResize() ? mpSettings->newImSize() : cv::Size();
 }
 
 
-Sophus::SE3f Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, std::string filename)
+void Tracking::BuildStereoFrame(InputFrame &input, const cv::Mat &imGrayRight, const double &timestamp, const std::string &filename)
 {
-    mImGray = imRGB;
+    // Inertial frames are chained to the previous frame when they are tracked
+    std::unique_lock<std::mutex> lock(mMutexPrepare);
+    if (mSensor == System::STEREO && !mpCamera2)
+        input.frame = Frame(input.imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,static_cast<Frame*>(NULL),IMU::Calib(),mpThreadPool);
+    else if(mSensor == System::STEREO && mpCamera2)
+        input.frame = Frame(input.imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr,static_cast<Frame*>(NULL),IMU::Calib(),mpThreadPool);
+    else if(mSensor == System::IMU_STEREO && !mpCamera2)
+        input.frame = Frame(input.imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,static_cast<Frame*>(NULL),*mpImuCalib,mpThreadPool);
+    else if(mSensor == System::IMU_STEREO && mpCamera2)
+        input.frame = Frame(input.imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr,static_cast<Frame*>(NULL),*mpImuCalib,mpThreadPool);
+
+    input.frame.mNameFile = filename;
+}
+
+
+void Tracking::PrepareRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, std::string filename, InputFrame &input)
+{
+    input.imGray = imRGB;
     cv::Mat imDepth = imD;
 
-    if(mImGray.channels()==3)
+    if(input.imGray.channels()==3)
     {
         if(mbRGB)
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_RGB2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_RGB2GRAY);
         else
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_BGR2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_BGR2GRAY);
     }
-    else if(mImGray.channels()==4)
+    else if(input.imGray.channels()==4)
     {
         if(mbRGB)
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_RGBA2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_RGBA2GRAY);
         else
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_BGRA2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_BGRA2GRAY);
     }
 
     if((fabs(mDepthMapFactor-1.0f)>1e-5) || imDepth.type()!=CV_32F)
         imDepth.convertTo(imDepth,CV_32F,mDepthMapFactor);
 
-    if (mSensor == System::RGBD)
-        mCurrentFrame = Frame(mImGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera);
-    else if(mSensor == System::IMU_RGBD)
-        mCurrentFrame = Frame(mImGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,&mLastFrame,*mpImuCalib);
-
-
-
+    BuildRGBDFrame(input,imDepth,timestamp,filename);
+}
 
 
+void Tracking::PrepareRGBD(const ImageView &im, const DepthView &depth, const double &timestamp, std::string filename, const ReleaseCallback &release, InputFrame &input)
+{
+    cv::Mat imDepth;
+    try
+    {
+        input.imGray = mImageConverter.ToGray(im,InputSize());
+        imDepth = mImageConverter.ToDepth(depth,mDepthMapFactor,InputSize());
+    }
+    catch(...)
+    {
+        if(release)
+            release();
+        throw;
+    }
+    if(release)
+        release();
 
-    mCurrentFrame.mNameFile = filename;
-    mCurrentFrame.mnDataset = mnNumDataset;
+    BuildRGBDFrame(input,imDepth,timestamp,filename);
+}
 
-#ifdef REGISTER_TIMES
-    vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-#endif
 
-    Track();
+void Tracking::BuildRGBDFrame(InputFrame &input, const cv::Mat &imDepth, const double &timestamp, const std::string &filename)
+{
+    // Inertial frames are chained to the previous frame when they are tracked
+    std::unique_lock<std::mutex> lock(mMutexPrepare);
+    if (mSensor == System::RGBD)
+        input.frame = Frame(input.imGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera);
+    else if(mSensor == System::IMU_RGBD)
+        input.frame = Frame(input.imGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,static_cast<Frame*>(NULL),*mpImuCalib);
 
-    return mCurrentFrame.GetPose();
+    input.frame.mNameFile = filename;
 }
 
 
-Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp, std::string filename)
+void Tracking::PrepareMonocular(const cv::Mat &im, const double &timestamp, std::string filename, InputFrame &input)
 {
-    mImGray = im;
-    if(mImGray.channels()==3)
+    input.imGray = im;
+    if(input.imGray.channels()==3)
     {
         if(mbRGB)
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_RGB2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_RGB2GRAY);
         else
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_BGR2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_BGR2GRAY);
     }
-    else if(mImGray.channels()==4)
+    else if(input.imGray.channels()==4)
     {
         if(mbRGB)
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_RGBA2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_RGBA2GRAY);
         else
-            cv::cvtColor(mImGray,mImGray,cv::COLOR_BGRA2GRAY);
+            cv::cvtColor(input.imGray,input.imGray,cv::COLOR_BGRA2GRAY);
     }
 
-    if (mSensor == System::MONOCULAR)
+    // The extractor depends on the state after the previous frame, which may not be tracked yet
+    input.bIniExtractor = mbIniExtractorHint;
+
+    std::unique_lock<std::mutex> lock(mMutexPrepare);
+    BuildMonocularFrame(input,timestamp,filename);
+}
+
+
+void Tracking::PrepareMonocular(const ImageView &im, const double &timestamp, std::string filename, const ReleaseCallback &release, InputFrame &input)
+{
+    try
     {
-        if(mState==NOT_INITIALIZED || mState==NO_IMAGES_YET ||(lastID - initID) < mMaxFrames)
-            mCurrentFrame = Frame(mImGray,timestamp,mpIniORBextractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth);
-        else
-            mCurrentFrame = Frame(mImGray,timestamp,mpORBextractorLeft,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth);
+        input.imGray = mImageConverter.ToGray(im,InputSize());
+    }
+    catch(...)
+    {
+        if(release)
+            release();
+        throw;
     }
+    if(release)
+        release();
+
+    input.bIniExtractor = mbIniExtractorHint;
+
+    std::unique_lock<std::mutex> lock(mMutexPrepare);
+    BuildMonocularFrame(input,timestamp,filename);
+}
+
+
+void Tracking::BuildMonocularFrame(InputFrame &input, const double &timestamp, const std::string &filename)
+{
+    ORBextractor* pExtractor = input.bIniExtractor ? mpIniORBextractor : mpORBextractorLeft;
+
+    // Inertial frames are chained to the previous frame when they are tracked
+    if (mSensor == System::MONOCULAR)
+        input.frame = Frame(input.imGray,timestamp,pExtractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth);
     else if(mSensor == System::IMU_MONOCULAR)
+        input.frame = Frame(input.imGray,timestamp,pExtractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth,static_cast<Frame*>(NULL),*mpImuCalib);
+
+    input.frame.mNameFile = filename;
+}
+
+
+bool Tracking::NeedIniExtractor()
+{
+    if (mSensor == System::MONOCULAR)
+        return mState==NOT_INITIALIZED || mState==NO_IMAGES_YET ||(lastID - initID) < mMaxFrames;
+    return mState==NOT_INITIALIZED || mState==NO_IMAGES_YET;
+}
+
+
+Sophus::SE3f Tracking::TrackInputFrame(InputFrame &input)
+{
+    const bool bMonocular = mSensor == System::MONOCULAR || mSensor == System::IMU_MONOCULAR;
+    if(bMonocular && input.bIniExtractor != NeedIniExtractor())
     {
-        if(mState==NOT_INITIALIZED || mState==NO_IMAGES_YET)
+        // The state changed since the frame was built (e.g. the map got initialized while it was extracted):
+        // extract it again with the right extractor, under the same id
+        const long unsigned int nId = input.frame.mnId;
+        input.bIniExtractor = !input.bIniExtractor;
         {
-            mCurrentFrame = Frame(mImGray,timestamp,mpIniORBextractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth,&mLastFrame,*mpImuCalib);
+            std::unique_lock<std::mutex> lock(mMutexPrepare);
+            BuildMonocularFrame(input,input.frame.mTimeStamp,input.frame.mNameFile);
         }
-        else
-            mCurrentFrame = Frame(mImGray,timestamp,mpORBextractorLeft,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth,&mLastFrame,*mpImuCalib);
+        input.frame.mnId = nId;
     }
 
-    if (mState==NO_IMAGES_YET)
-        t0=timestamp;
-
-    mCurrentFrame.mNameFile = filename;
+    mImGray = input.imGray;
+    mImRight = input.imRight;
+    mCurrentFrame = std::move(input.frame);
+    if(mSensor == System::IMU_MONOCULAR || mSensor == System::IMU_STEREO || mSensor == System::IMU_RGBD)
+        mCurrentFrame.SetPrevFrame(&mLastFrame);
     mCurrentFrame.mnDataset = mnNumDataset;
 
+    if (bMonocular && mState==NO_IMAGES_YET)
+        t0=mCurrentFrame.mTimeStamp;
+
 #ifdef REGISTER_TIMES
     vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
+    if (mSensor == System::STEREO || mSensor == System::IMU_STEREO)
+        vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
 #endif
 
-    lastID = mCurrentFrame.mnId;
+    if (bMonocular)
+        lastID = mCurrentFrame.mnId;
+
+    // LOG(INFO) << "Tracking start";
     Track();
+    // LOG(INFO) << "Tracking end";
+
+    mbIniExtractorHint = NeedIniExtractor();
 
     return mCurrentFrame.GetPose();
 }
@@ -1618,8 +1856,8 @@ Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &times
 
 void Tracking::GrabImuData(const IMU::Point &imuMeasurement)
 {
-    std::unique_lock<std::mutex> lock(mMutexImuQueue);
-    mlQueueImuData.push_back(imuMeasurement);
+    if(!mImuQueue.TryPush(imuMeasurement))
+        LOG_EVERY_N(WARNING, 1000) << "IMU queue full, " << mImuQueue.Dropped() << " measurements dropped";
 }
 
 void Tracking::PreintegrateIMU()
@@ -1633,46 +1871,16 @@ void Tracking::PreintegrateIMU()
     }
 
     mvImuFromLastFrame.clear();
-    mvImuFromLastFrame.reserve(mlQueueImuData.size());
-    if(mlQueueImuData.size() == 0)
+    if(mImuQueue.Empty())
     {
-        VLOG(1) << "Not IMU data in mlQueueImuData!!";
+        VLOG(1) << "Not IMU data in mImuQueue!!";
         mCurrentFrame.setIntegrated();
         return;
     }
 
-    while(true)
-    {
-        bool bSleep = false;
-        {
-            std::unique_lock<std::mutex> lock(mMutexImuQueue);
-            if(!mlQueueImuData.empty())
-            {
-                IMU::Point* m = &mlQueueImuData.front();
-                if(m->t<mCurrentFrame.mpPrevFrame->mTimeStamp-mImuPer)
-                {
-                    mlQueueImuData.pop_front();
-                }
-                else if(m->t<mCurrentFrame.mTimeStamp-mImuPer)
-                {
-                    mvImuFromLastFrame.push_back(*m);
-                    mlQueueImuData.pop_front();
-                }
-                else
-                {
-                    mvImuFromLastFrame.push_back(*m);
-                    break;
-                }
-            }
-            else
-            {
-                break;
-                bSleep = true;
-            }
-        }
-        if(bSleep)
-            usleep(500);
-    }
+    // Measurements from the previous frame to the current one, plus the first one after it (kept for the next frame)
+    mImuQueue.ExtractRange(mCurrentFrame.mpPrevFrame->mTimeStamp-mImuPer, mCurrentFrame.mTimeStamp-mImuPer,
+                           [](const IMU::Point& m) { return m.t; }, mvImuFromLastFrame);
 
     const int n = mvImuFromLastFrame.size()-1;
     if(n==0){
@@ -1809,6 +2017,8 @@ void Tracking::Track()
         return;
     }
 
+    Quiesce();
+
     Map* pCurrentMap = mpAtlas->GetCurrentMap();
     if(!pCurrentMap)
     {
@@ -1820,8 +2030,7 @@ void Tracking::Track()
         if(mLastFrame.mTimeStamp>mCurrentFrame.mTimeStamp)
         {
             LOG(ERROR) << "Frame with a timestamp older than previous frame detected!";
-            std::unique_lock<std::mutex> lock(mMutexImuQueue);
-            mlQueueImuData.clear();
+            mImuQueue.Clear();
             CreateMapInAtlas();
             return;
         }
@@ -1911,7 +2120,7 @@ void Tracking::Track()
 
         if(mState!=OK) // If rightly initialized, mState=OK
         {
-            mLastFrame = Frame(mCurrentFrame);
+            mLastFrame = mCurrentFrame;
             return;
         }
 
@@ -2290,7 +2499,7 @@ void Tracking::Track()
         if(!mCurrentFrame.mpReferenceKF)
             mCurrentFrame.mpReferenceKF = mpReferenceKF;
 
-        mLastFrame = Frame(mCurrentFrame);
+        mLastFrame = mCurrentFrame;
     }
 
 
@@ -2423,7 +2632,7 @@ void Tracking::StereoInitialization()
 
         mpLocalMapper->InsertKeyFrame(pKFini);
 
-        mLastFrame = Frame(mCurrentFrame);
+        mLastFrame = mCurrentFrame;
         mnLastKeyFrameId = mCurrentFrame.mnId;
         mpLastKeyFrame = pKFini;
         //mnLastRelocFrameId = mCurrentFrame.mnId;
@@ -2453,8 +2662,8 @@ void Tracking::MonocularInitialization()
         if(mCurrentFrame.mvKeys.size()>100)
         {
 
-            mInitialFrame = Frame(mCurrentFrame);
-            mLastFrame = Frame(mCurrentFrame);
+            mInitialFrame = mCurrentFrame;
+            mLastFrame = mCurrentFrame;
             mvbPrevMatched.resize(mCurrentFrame.mvKeysUn.size());
             for(std::size_t i=0; i<mCurrentFrame.mvKeysUn.size(); i++)
                 mvbPrevMatched[i]=mCurrentFrame.mvKeysUn[i].pt;
@@ -2500,6 +2709,7 @@ void Tracking::MonocularInitialization()
         Sophus::SE3f Tcw;
         std::vector<bool> vbTriangulated; // Triangulated Correspondences (mvIniMatches)
 
+        mpCamera->setThreadPool(mpThreadPool);
         if(mpCamera->reconstructFromTwoViews(mInitialFrame.mvKeysUn,mCurrentFrame.mvKeysUn,mvIniMatches,Tcw,mvIniP3D,vbTriangulated))
         {
             for(std::size_t i=0, iend=mvIniMatches.size(); i<iend;i++)
@@ -2532,8 +2742,8 @@ void Tracking::CreateInitialMapMonocular()
         pKFini->mpImuPreintegrated = (IMU::Preintegrated*)(NULL);
 
 
-    pKFini->ComputeBoW();
-    pKFcur->ComputeBoW();
+    pKFini->ComputeBoW(mpThreadPool);
+    pKFcur->ComputeBoW(mpThreadPool);
 
     // Insert KFs in the map
     mpAtlas->AddKeyFrame(pKFini);
@@ -2576,7 +2786,7 @@ void Tracking::CreateInitialMapMonocular()
 
     // Bundle Adjustment
     VLOG(1) << "New Map created with " << mpAtlas->MapPointsInMap() << " points";
-    Optimizer::GlobalBundleAdjustemnt(mpAtlas->GetCurrentMap(),20);
+    Optimizer::GlobalBundleAdjustemnt(mpAtlas->GetCurrentMap(),20,NULL,0,true,mpThreadPool);
 
     float medianDepth = pKFini->ComputeSceneMedianDepth(2);
     float invMedianDepth;
@@ -2644,7 +2854,7 @@ void Tracking::CreateInitialMapMonocular()
     double aux = (mCurrentFrame.mTimeStamp-mLastFrame.mTimeStamp)/(mCurrentFrame.mTimeStamp-mInitialFrame.mTimeStamp);
     phi *= aux;
 
-    mLastFrame = Frame(mCurrentFrame);
+    mLastFrame = mCurrentFrame;
 
     mpAtlas->SetReferenceMapPoints(mvpLocalMapPoints);
 
@@ -2715,11 +2925,37 @@ void Tracking::CheckReplacedInLastFrame()
     }
 }
 
+void Tracking::Quiesce()
+{
+    if(!mEpochParticipant.IsRegistered())
+        return;
+
+    for(int i=0; i<mLastFrame.N; i++)
+    {
+        MapPoint* pMP = mLastFrame.mvpMapPoints[i];
+        if(pMP && pMP->isBad())
+        {
+            MapPoint* pRep = pMP->GetReplaced();
+            mLastFrame.mvpMapPoints[i] = pRep && !pRep->isBad() ? pRep : static_cast<MapPoint*>(NULL);
+        }
+    }
+
+    const std::size_t nLocalMapPoints = mvpLocalMapPoints.size();
+    mvpLocalMapPoints.erase(std::remove_if(mvpLocalMapPoints.begin(), mvpLocalMapPoints.end(),
+                                           [](MapPoint* pMP) { return pMP->isBad(); }),
+                            mvpLocalMapPoints.end());
+    // The map may have been given the bad ones again for the viewer
+    if(mvpLocalMapPoints.size() != nLocalMapPoints)
+        mpAtlas->SetReferenceMapPoints(mvpLocalMapPoints);
+
+    mEpochParticipant.Quiesce();
+}
+
 
 bool Tracking::TrackReferenceKeyFrame()
 {
     // Compute Bag of Words vector
-    mCurrentFrame.ComputeBoW();
+    mCurrentFrame.ComputeBoW(mpThreadPool);
 
     // We perform first an ORB matching with the reference keyframe
     // If enough matches are found we setup a PnP solver
@@ -3608,7 +3844,7 @@ bool Tracking::Relocalization()
 {
     VLOG(1) << "Starting relocalization";
     // Compute Bag of Words Vector
-    mCurrentFrame.ComputeBoW();
+    mCurrentFrame.ComputeBoW(mpThreadPool);
 
     // Relocalization is performed when tracking is lost
     // Track Lost: Query KeyFrame Database for keyframe candidates for relocalisation
@@ -3781,8 +4017,7 @@ void Tracking::Reset(bool bLocMap)
     if(mpViewer)
     {
         mpViewer->RequestStop();
-        while(!mpViewer->isStopped())
-            usleep(3000);
+        mpViewer->WaitUntilStopped();
     }
 
     // Reset Local Mapping
@@ -3812,8 +4047,12 @@ void Tracking::Reset(bool bLocMap)
     mnInitialFrameId = 0;
 
     KeyFrame::nNextId = 0;
-    Frame::nNextId = 0;
+    {
+        std::unique_lock<std::mutex> lock(mMutexPrepare);
+        Frame::nNextId = 0;
+    }
     mState = NO_IMAGES_YET;
+    mbIniExtractorHint = true;
 
     mbReadyToInitializate = false;
     mbSetInit=false;
@@ -3841,8 +4080,7 @@ void Tracking::ResetActiveMap(bool bLocMap)
     if(mpViewer)
     {
         mpViewer->RequestStop();
-        while(!mpViewer->isStopped())
-            usleep(3000);
+        mpViewer->WaitUntilStopped();
     }
 
     Map* pMap = mpAtlas->GetCurrentMap();
@@ -3870,9 +4108,13 @@ void Tracking::ResetActiveMap(bool bLocMap)
 
     //KeyFrame::nNextId = mpAtlas->GetLastInitKFid();
     //Frame::nNextId = mnLastInitFrameId;
-    mnLastInitFrameId = Frame::nNextId;
+    {
+        std::unique_lock<std::mutex> lock(mMutexPrepare);
+        mnLastInitFrameId = Frame::nNextId;
+    }
     //mnLastRelocFrameId = mnLastInitFrameId;
     mState = NO_IMAGES_YET; //NOT_INITIALIZED;
+    mbIniExtractorHint = true;
 
     mbReadyToInitializate = false;
 
@@ -3882,7 +4124,7 @@ void Tracking::ResetActiveMap(bool bLocMap)
     LOG(INFO) << "mnFirstFrameId = " << mnFirstFrameId;
     for(auto pMap : mpAtlas->GetAllMaps())
     {
-        if(pMap->GetAllKeyFrames().size() > 0)
+        if(pMap->KeyFramesInMap() > 0)
         {
             if(index > pMap->GetLowerKFID())
                 index = pMap->GetLowerKFID();
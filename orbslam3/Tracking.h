@@ -21,6 +21,7 @@
 #define TRACKING_H
 
 // Standard
+#include <atomic>
 #include <list>
 #include <mutex>
 #include <string>
@@ -29,9 +30,12 @@
 #include <opencv2/core.hpp>
 #include <orbslam3/external/Sophus/sophus/se3.hpp>
 // Local
+#include "orbslam3/EpochReclaimer.h"
 #include "orbslam3/Frame.h"
+#include "orbslam3/ImageInput.h"
 #include "orbslam3/ImuTypes.h"
 #include "orbslam3/ORBVocabulary.h"
+#include "orbslam3/SpscRingBuffer.h"
 
 namespace ORB_SLAM3
 {
@@ -47,6 +51,7 @@ class MapDrawer;
 class ORBextractor;
 class Settings;
 class System;
+class ThreadPool;
 class Viewer;
 
 class Tracking
@@ -69,6 +74,32 @@ public:
     Sophus::SE3f GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, std::string filename);
     Sophus::SE3f GrabImageMonocular(const cv::Mat &im, const double &timestamp, std::string filename);
 
+    // Zero-copy inputs: the caller-owned views are converted (color, scale, depth units) in one pass into
+    // pooled buffers, then `release` is called and the caller can reuse them.
+    Sophus::SE3f GrabImageStereo(const ImageView &left, const ImageView &right, const double &timestamp, std::string filename, const ReleaseCallback &release);
+    Sophus::SE3f GrabImageRGBD(const ImageView &im, const DepthView &depth, const double &timestamp, std::string filename, const ReleaseCallback &release);
+    Sophus::SE3f GrabImageMonocular(const ImageView &im, const double &timestamp, std::string filename, const ReleaseCallback &release);
+
+    // Frame of an input, built by Prepare*() and tracked by TrackInputFrame()
+    struct InputFrame
+    {
+        Frame frame;
+        cv::Mat imGray;
+        cv::Mat imRight;
+        bool bIniExtractor = false; // Monocular: extracted with the initialization extractor
+    };
+
+    // The two halves of GrabImage*(). Prepare*() preprocesses the input and builds its frame, it can run on
+    // another thread while the previous frame is tracked (but not concurrently with itself).
+    // TrackInputFrame() tracks the prepared frames, in input order.
+    void PrepareStereo(const cv::Mat &imRectLeft,const cv::Mat &imRectRight, const double &timestamp, std::string filename, InputFrame &input);
+    void PrepareRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, std::string filename, InputFrame &input);
+    void PrepareMonocular(const cv::Mat &im, const double &timestamp, std::string filename, InputFrame &input);
+    void PrepareStereo(const ImageView &left, const ImageView &right, const double &timestamp, std::string filename, const ReleaseCallback &release, InputFrame &input);
+    void PrepareRGBD(const ImageView &im, const DepthView &depth, const double &timestamp, std::string filename, const ReleaseCallback &release, InputFrame &input);
+    void PrepareMonocular(const ImageView &im, const double &timestamp, std::string filename, const ReleaseCallback &release, InputFrame &input);
+    Sophus::SE3f TrackInputFrame(InputFrame &input);
+
     void GrabImuData(const IMU::Point &imuMeasurement);
 
     void SetLocalMapper(LocalMapping* pLocalMapper);
@@ -202,6 +233,9 @@ protected:
     void CreateInitialMapMonocular();
 
     void CheckReplacedInLastFrame();
+    // Drop the bad MapPoints kept from the previous frames, then declare the
+    // tracking quiescent so that they can be reclaimed (see EpochReclaimer)
+    void Quiesce();
     bool TrackReferenceKeyFrame();
     void UpdateLastFrame();
     bool TrackWithMotionModel();
@@ -222,6 +256,14 @@ protected:
     // Perform preintegration from last frame
     void PreintegrateIMU();
 
+    // Whether the next monocular frame needs the initialization extractor, given the tracking state
+    bool NeedIniExtractor();
+    // Size of the images given to the tracking (empty to keep the input size)
+    cv::Size InputSize();
+    void BuildStereoFrame(InputFrame &input, const cv::Mat &imGrayRight, const double &timestamp, const std::string &filename);
+    void BuildRGBDFrame(InputFrame &input, const cv::Mat &imDepth, const double &timestamp, const std::string &filename);
+    void BuildMonocularFrame(InputFrame &input, const double &timestamp, const std::string &filename);
+
     // Reset IMU biases and compute frame velocity
     void ResetFrameIMU();
 
@@ -230,12 +272,20 @@ protected:
     // Imu preintegration from last frame
     IMU::Preintegrated *mpImuPreintegratedFromLastKF;
 
-    // Queue of IMU measurements between frames
-    std::list<IMU::Point> mlQueueImuData;
+    // Queue of IMU measurements between frames, from GrabImuData to PreintegrateIMU (65 s at 1 kHz)
+    SpscRingBuffer<IMU::Point> mImuQueue{1 << 16};
 
     // Vector of IMU measurements from previous to current frame (to be filled by PreintegrateIMU)
     std::vector<IMU::Point> mvImuFromLastFrame;
-    std::mutex mMutexImuQueue;
+
+    // Serializes the frame construction (extractors and Frame::nNextId) between Prepare*() and the tracking
+    std::mutex mMutexPrepare;
+    // NeedIniExtractor() after the last tracked frame, the extractor Prepare*() uses for the next one
+    std::atomic<bool> mbIniExtractorHint{true};
+
+    // Pooled buffers of the zero-copy inputs, used by Prepare*()
+    ImageConverter mImageConverter;
+    Settings* mpSettings;
 
     // Imu calibration parameters
     IMU::Calib *mpImuCalib;
@@ -257,6 +307,12 @@ protected:
     ORBextractor* mpORBextractorLeft, *mpORBextractorRight;
     ORBextractor* mpIniORBextractor;
 
+    // Workers shared by the intra-frame parallel sections, owned by the System
+    ThreadPool* mpThreadPool{nullptr};
+
+    // Registration to the reclaimer of the bad MapPoints, if enabled
+    EpochParticipant mEpochParticipant;
+
     //BoW
     ORBVocabulary* mpORBVocabulary;
     KeyFrameDatabase* mpKeyFrameDB;
@@ -353,6 +409,13 @@ protected:
 
     void newParameterLoader(Settings* settings);
 
+    // Run the ORB extractors on the shared thread pool (no-op if !bParallel)
+    void EnableParallelExtraction(const bool bParallel);
+    // Keep the pyramid and scratch buffers of the ORB extractors between frames
+    void EnableBufferReuse(const bool bReuse);
+    // Quantize the steering of the descriptors in nBins angle bins (0 for the exact rotation)
+    void SetDescriptorAngleBins(const int nBins);
+
 #ifdef REGISTER_LOOP
     bool Stop();
 
@@ -0,0 +1,141 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Standard
+#include <algorithm>
+#include <chrono>
+#include <utility>
+// Local
+#include "orbslam3/TwoStagePipeline.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMs(const Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+TwoStagePipeline::TwoStagePipeline(const std::size_t capacity)
+  : capacity_(std::max<std::size_t>(capacity, 1)),
+    first_thread_(&TwoStagePipeline::FirstStageLoop, this),
+    second_thread_(&TwoStagePipeline::SecondStageLoop, this) {}
+
+TwoStagePipeline::~TwoStagePipeline() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  first_ready_.notify_one();
+  second_ready_.notify_one();
+  first_thread_.join();
+  second_thread_.join();
+}
+
+void TwoStagePipeline::Submit(Stage first, Stage second) {
+  const Clock::time_point start = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  completed_.wait(lock, [this]() { return metrics_.in_flight < capacity_; });
+  metrics_.submit_wait_ms += ElapsedMs(start);
+
+  first_queue_.push_back({std::move(first), std::move(second)});
+  ++metrics_.submitted;
+  ++metrics_.in_flight;
+  metrics_.max_in_flight = std::max(metrics_.max_in_flight, metrics_.in_flight);
+  lock.unlock();
+  first_ready_.notify_one();
+}
+
+void TwoStagePipeline::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  completed_.wait(lock, [this]() { return metrics_.in_flight == 0; });
+}
+
+TwoStagePipeline::Metrics TwoStagePipeline::GetMetrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_;
+}
+
+void TwoStagePipeline::FirstStageLoop() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      first_ready_.wait(lock, [this]() { return stop_ || !first_queue_.empty(); });
+      if (first_queue_.empty()) {
+        return;
+      }
+      job = std::move(first_queue_.front());
+      first_queue_.pop_front();
+    }
+
+    const Clock::time_point start = Clock::now();
+    if (job.first) {
+      job.first();
+    }
+    const double duration_ms = ElapsedMs(start);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      metrics_.first_stage_ms += duration_ms;
+      second_queue_.push_back(std::move(job));
+    }
+    second_ready_.notify_one();
+  }
+}
+
+void TwoStagePipeline::SecondStageLoop() {
+  while (true) {
+    Job job;
+    {
+      const Clock::time_point start = Clock::now();
+      std::unique_lock<std::mutex> lock(mutex_);
+      second_ready_.wait(lock, [this]() { return stop_ || !second_queue_.empty(); });
+      if (second_queue_.empty()) {
+        return;
+      }
+      job = std::move(second_queue_.front());
+      second_queue_.pop_front();
+      metrics_.second_idle_ms += ElapsedMs(start);
+    }
+
+    const Clock::time_point start = Clock::now();
+    if (job.second) {
+      job.second();
+    }
+    const double duration_ms = ElapsedMs(start);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      metrics_.second_stage_ms += duration_ms;
+      ++metrics_.completed;
+      --metrics_.in_flight;
+    }
+    completed_.notify_all();
+  }
+}
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,100 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TWO_STAGE_PIPELINE_H
+#define TWO_STAGE_PIPELINE_H
+
+// Standard
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace ORB_SLAM3 {
+
+// Jobs made of two stages, each stage running on its own thread: the first
+// stage of a job (e.g. building the Frame of new images) runs while the second
+// stage of the previous one (tracking the previous Frame) does.
+//
+// Both stages run in submission order, so the second stages see the jobs in
+// the order they were submitted. At most `capacity` jobs are in flight:
+// Submit() blocks until one completes, bounding the memory held by the queued
+// jobs.
+//
+// The stages must not throw; they report their errors themselves (e.g. through
+// a promise).
+class TwoStagePipeline {
+public:
+  using Stage = std::function<void()>;
+
+  struct Metrics {
+    std::size_t submitted     = 0; // Jobs submitted since the creation
+    std::size_t completed     = 0; // Jobs whose second stage returned
+    std::size_t in_flight     = 0; // Jobs submitted and not completed
+    std::size_t max_in_flight = 0;
+    double submit_wait_ms     = 0; // Time Submit() blocked on a full pipeline
+    double first_stage_ms     = 0; // Time spent in the first stages
+    double second_stage_ms    = 0; // Time spent in the second stages
+    double second_idle_ms     = 0; // Time the second stage waited for a first stage
+  };
+
+  explicit TwoStagePipeline(const std::size_t capacity);
+
+  // Complete the submitted jobs, then stop the threads.
+  ~TwoStagePipeline();
+
+  TwoStagePipeline(const TwoStagePipeline&)            = delete;
+  TwoStagePipeline& operator=(const TwoStagePipeline&) = delete;
+
+  void Submit(Stage first, Stage second);
+
+  // Block until all the submitted jobs are completed.
+  void Wait();
+
+  Metrics GetMetrics() const;
+
+private:
+  struct Job {
+    Stage first;
+    Stage second;
+  };
+
+  void FirstStageLoop();
+  void SecondStageLoop();
+
+  const std::size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable first_ready_;  // A job waits for its first stage, or stop
+  std::condition_variable second_ready_; // A job waits for its second stage, or stop
+  std::condition_variable completed_;    // A job completed
+  std::deque<Job> first_queue_;
+  std::deque<Job> second_queue_;
+  bool stop_ = false;
+  Metrics metrics_;
+  std::thread first_thread_;
+  std::thread second_thread_;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // TWO_STAGE_PIPELINE_H
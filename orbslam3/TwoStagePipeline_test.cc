@@ -0,0 +1,70 @@
+// Standard
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/TwoStagePipeline.h"
+
+using namespace ORB_SLAM3;
+
+TEST(TwoStagePipeline, Order) {
+  std::mutex mutex;
+  std::vector<int> first;
+  std::vector<int> second;
+  {
+    TwoStagePipeline pipeline(3);
+    for (int i = 0; i < 50; ++i) {
+      pipeline.Submit(
+        [&, i]() {
+          std::lock_guard<std::mutex> lock(mutex);
+          first.push_back(i);
+        },
+        [&, i]() {
+          std::lock_guard<std::mutex> lock(mutex);
+          second.push_back(i);
+        }
+      );
+    }
+    pipeline.Wait();
+
+    const TwoStagePipeline::Metrics metrics = pipeline.GetMetrics();
+    EXPECT_EQ(metrics.submitted, 50u);
+    EXPECT_EQ(metrics.completed, 50u);
+    EXPECT_EQ(metrics.in_flight, 0u);
+    EXPECT_LE(metrics.max_in_flight, 3u);
+
+    // Jobs submitted before the destruction are completed.
+    pipeline.Submit(nullptr, [&]() { second.push_back(50); });
+  }
+
+  ASSERT_EQ(first.size(), 50u);
+  ASSERT_EQ(second.size(), 51u);
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_EQ(first[i], i);
+    EXPECT_EQ(second[i], i);
+  }
+}
+
+TEST(TwoStagePipeline, Overlap) {
+  // The first stage of a job runs while the second stage of the previous one
+  // waits for it: without the overlap, this would dead-lock.
+  std::atomic<int> started{-1};
+  TwoStagePipeline pipeline(2);
+  for (int i = 0; i < 10; ++i) {
+    pipeline.Submit(
+      [&started, i]() { started = i; },
+      [&started, i]() {
+        while (i < 9 && started.load() <= i) {
+          std::this_thread::yield();
+        }
+      }
+    );
+  }
+  pipeline.Wait();
+  EXPECT_EQ(started.load(), 9);
+  EXPECT_EQ(pipeline.GetMetrics().max_in_flight, 2u);
+}
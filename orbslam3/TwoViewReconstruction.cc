@@ -28,6 +28,7 @@
 // Local
 #include "orbslam3/Converter.h"
 #include "orbslam3/GeometricTools.h"
+#include "orbslam3/ThreadPool.h"
 #include "orbslam3/TwoViewReconstruction.h"
 
 namespace ORB_SLAM3 {
@@ -43,12 +44,14 @@ constexpr float kMinSingularValueRatio = 1.00001f; // minimum ratio between sing
 TwoViewReconstruction::TwoViewReconstruction(
   const Eigen::Matrix3f& K,
   const float std_dev,
-  const std::size_t ransac_iterations
+  const std::size_t ransac_iterations,
+  ThreadPool* thread_pool
 )
   : K_(K)
   , std_dev_(std_dev)
   , var_(std_dev * std_dev)
   , ransac_iterations_(ransac_iterations)
+  , thread_pool_(thread_pool)
 {}
 
 bool TwoViewReconstruction::reconstruct(
@@ -138,29 +141,45 @@ bool TwoViewReconstruction::reconstruct(
   // ──────────────────────────── //
   // Parallel computation of the fundamental matrix and homography matrix
 
-  // Launch threads to compute in parallel fundamental and homography matrices.
+  // Compute in parallel fundamental and homography matrices, on the shared
+  // workers when available, otherwise on two dedicated threads.
   std::vector<bool> inliers_H, inliers_F;
   float score_H, score_F;
   Eigen::Matrix3f H, F;
 
-  std::thread thread_H(
-    &TwoViewReconstruction::findHomography,
-    this,
-    std::ref(inliers_H),
-    std::ref(score_H),
-    std::ref(H)
-  );
-  std::thread thread_F(
-    &TwoViewReconstruction::findFundamental,
-    this,
-    std::ref(inliers_F),
-    std::ref(score_F),
-    std::ref(F)
-  );
+  if (thread_pool_) {
+    thread_pool_->ParallelFor(
+      0,
+      2,
+      [&](const std::size_t i) {
+        if (i == 0) {
+          findHomography(inliers_H, score_H, H);
+        } else {
+          findFundamental(inliers_F, score_F, F);
+        }
+      },
+      "TwoViewReconstruction::findModels"
+    );
+  } else {
+    std::thread thread_H(
+      &TwoViewReconstruction::findHomography,
+      this,
+      std::ref(inliers_H),
+      std::ref(score_H),
+      std::ref(H)
+    );
+    std::thread thread_F(
+      &TwoViewReconstruction::findFundamental,
+      this,
+      std::ref(inliers_F),
+      std::ref(score_F),
+      std::ref(F)
+    );
 
-  // Wait until both threads have finished.
-  thread_H.join();
-  thread_F.join();
+    // Wait until both threads have finished.
+    thread_H.join();
+    thread_F.join();
+  }
 
   // ──────────────────────────── //
   // Evaluate scores and select the best model
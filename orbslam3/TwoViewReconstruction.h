@@ -32,6 +32,8 @@
 
 namespace ORB_SLAM3 {
 
+class ThreadPool;
+
 // Class handling the two-view reconstruction of the relative pose and 3D scene
 // structure from two views. It uses the 8-point algorithm to estimate the
 // fundamental/homography matrices and RANSAC to remove outliers.
@@ -42,7 +44,8 @@ public:
   TwoViewReconstruction(
     const Eigen::Matrix3f& K,
     const float std_dev = 1.f,
-    const std::size_t ransac_iterations = 200
+    const std::size_t ransac_iterations = 200,
+    ThreadPool* thread_pool = nullptr // workers for the parallel H/F estimation, not owned
   );
 
   // Computes in parallel a fundamental matrix and a homography.
@@ -200,6 +203,8 @@ private:
   std::size_t ransac_iterations_;
   // Sets for RANSAC iterations, each set contains 8 indices of matches.
   std::vector<std::vector<std::size_t>> ransac_sets_;
+  // Shared workers, dedicated threads are spawned when null.
+  ThreadPool* thread_pool_;
 };
 
 } // namespace ORB_SLAM3
@@ -37,6 +37,8 @@ Viewer::Viewer(System* pSystem, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer
     both(false), mpSystem(pSystem), mpFrameDrawer(pFrameDrawer),mpMapDrawer(pMapDrawer), mpTracker(pTracking),
     mbFinishRequested(false), mbFinished(true), mbStopped(true), mbStopRequested(false)
 {
+    mEpochParticipant = EpochParticipant(pSystem ? pSystem->GetReclaimer() : nullptr);
+
     if(settings){
         newParameterLoader(settings);
     }
@@ -376,10 +378,13 @@ void Viewer::Run()
             menuStop = false;
         }
 
+        mEpochParticipant.Quiesce();
+
         if(Stop())
         {
             while(isStopped())
             {
+                mEpochParticipant.Quiesce();
                 usleep(3000);
             }
         }
@@ -388,6 +393,7 @@ void Viewer::Run()
             break;
     }
 
+    mEpochParticipant = EpochParticipant();
     SetFinish();
 }
 
@@ -405,8 +411,14 @@ bool Viewer::CheckFinish()
 
 void Viewer::SetFinish()
 {
-    std::unique_lock<std::mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+        std::unique_lock<std::mutex> lock(mMutexFinish);
+        mbFinished = true;
+    }
+    // A finished viewer does not stop anymore, release the waits for the stop
+    std::unique_lock<std::mutex> lock(mMutexStop);
+    mbStopped = true;
+    mcvStopped.notify_all();
 }
 
 bool Viewer::isFinished()
@@ -428,6 +440,12 @@ bool Viewer::isStopped()
     return mbStopped;
 }
 
+void Viewer::WaitUntilStopped()
+{
+    std::unique_lock<std::mutex> lock(mMutexStop);
+    mcvStopped.wait(lock, [this] { return mbStopped; });
+}
+
 bool Viewer::Stop()
 {
     std::unique_lock<std::mutex> lock(mMutexStop);
@@ -439,6 +457,7 @@ bool Viewer::Stop()
     {
         mbStopped = true;
         mbStopRequested = false;
+        mcvStopped.notify_all();
         return true;
     }
 
@@ -20,11 +20,14 @@
 #define VIEWER_H
 
 // Standard
+#include <condition_variable>
 #include <mutex>
 #include <string>
 // 3rdparty
 #include <Eigen/Core>
 #include <opencv2/core.hpp>
+// Local
+#include "orbslam3/EpochReclaimer.h"
 
 namespace ORB_SLAM3
 {
@@ -54,6 +57,8 @@ public:
     bool isFinished();
 
     bool isStopped();
+    // Block until the viewer stopped (or finished) after a RequestStop()
+    void WaitUntilStopped();
 
     bool isStepByStep();
 
@@ -89,9 +94,13 @@ private:
     bool mbStopped;
     bool mbStopRequested;
     std::mutex mMutexStop;
+    std::condition_variable mcvStopped;
 
     bool mbStopTrack;
 
+    // The map drawer holds MapPoints only while drawing
+    EpochParticipant mEpochParticipant;
+
 };
 
 }
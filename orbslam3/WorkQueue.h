@@ -0,0 +1,171 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez
+ * Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós,
+ * University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ORB-SLAM3. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+// Standard
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// FIFO queue handing work items (the KeyFrames of the local mapping and of the
+// loop closing) to the thread consuming them.
+//
+// The consumer blocks in WaitFor() until an item is pushed or Notify() is
+// called, e.g. by a stop, reset or finish request it must handle. A push or a
+// notification posted while the consumer is busy is kept until its next wait,
+// so none is lost between checking the queue and the requests and waiting.
+// Items already in the queue at the previous wait do not wake it again: a
+// consumer leaving items for later (e.g. while stopped) does not spin.
+//
+// Thread-safe.
+template <typename T>
+class WorkQueue {
+public:
+  struct Metrics {
+    std::size_t depth     = 0; // Items in the queue
+    std::size_t max_depth = 0; // Largest depth since the creation
+    std::size_t pushed    = 0; // Items pushed since the creation
+    std::size_t popped    = 0; // Items popped since the creation
+    std::size_t dropped   = 0; // Items cleared or erased since the creation
+    double mean_wait_ms   = 0; // Mean time of the popped items in the queue
+    double max_wait_ms    = 0; // Longest time of a popped item in the queue
+    double idle_ms        = 0; // Time the consumer spent in WaitFor()
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  // Append an item and wake the consumer.
+  void Push(T item) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      items_.push_back({std::move(item), Clock::now()});
+      notified_ = true;
+      ++metrics_.pushed;
+      metrics_.max_depth = std::max(metrics_.max_depth, items_.size());
+    }
+    condition_.notify_one();
+  }
+
+  // Pop the oldest item, returns false if the queue is empty.
+  bool TryPop(T& item) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.empty()) {
+      return false;
+    }
+    const double wait_ms = std::chrono::duration<double, std::milli>(Clock::now() - items_.front().pushed).count();
+    item                 = std::move(items_.front().item);
+    items_.pop_front();
+    ++metrics_.popped;
+    total_wait_ms_       += wait_ms;
+    metrics_.max_wait_ms = std::max(metrics_.max_wait_ms, wait_ms);
+    return true;
+  }
+
+  // Remove all the items and return them, in queue order.
+  std::vector<T> Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<T> items;
+    items.reserve(items_.size());
+    for (Entry& entry : items_) {
+      items.push_back(std::move(entry.item));
+    }
+    metrics_.dropped += items_.size();
+    items_.clear();
+    return items;
+  }
+
+  // Remove the items matching a predicate, returns their number.
+  template <typename Predicate>
+  std::size_t EraseIf(Predicate predicate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::size_t size = items_.size();
+    items_.erase(
+      std::remove_if(items_.begin(), items_.end(), [&predicate](const Entry& entry) { return predicate(entry.item); }),
+      items_.end()
+    );
+    metrics_.dropped += size - items_.size();
+    return size - items_.size();
+  }
+
+  bool Empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.empty();
+  }
+
+  std::size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+  }
+
+  // Wake the consumer without an item.
+  void Notify() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      notified_ = true;
+    }
+    condition_.notify_one();
+  }
+
+  // Block until an item is pushed or a notification is posted since the
+  // previous wait, or the timeout expires. Returns false on timeout.
+  template <typename Rep, typename Period>
+  bool WaitFor(const std::chrono::duration<Rep, Period>& timeout) {
+    const Clock::time_point start = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    const bool woken = condition_.wait_for(lock, timeout, [this]() { return notified_; });
+    notified_ = false;
+    metrics_.idle_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return woken;
+  }
+
+  Metrics GetMetrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Metrics metrics      = metrics_;
+    metrics.depth        = items_.size();
+    metrics.mean_wait_ms = metrics_.popped > 0 ? total_wait_ms_ / static_cast<double>(metrics_.popped) : 0.0;
+    return metrics;
+  }
+
+private:
+  struct Entry {
+    T item;
+    Clock::time_point pushed;
+  };
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Entry> items_;
+  bool notified_        = false;
+  double total_wait_ms_ = 0;
+  Metrics metrics_;
+};
+
+} // namespace ORB_SLAM3
+
+#endif // WORK_QUEUE_H
@@ -0,0 +1,65 @@
+// Standard
+#include <chrono>
+#include <thread>
+#include <vector>
+// 3rdparty
+#include <gtest/gtest.h>
+// Local
+#include "orbslam3/WorkQueue.h"
+
+using namespace ORB_SLAM3;
+
+TEST(WorkQueue, Order) {
+  WorkQueue<int> queue;
+  for (int i = 0; i < 5; ++i) {
+    queue.Push(i);
+  }
+  EXPECT_EQ(queue.Size(), 5u);
+
+  int item = -1;
+  ASSERT_TRUE(queue.TryPop(item));
+  EXPECT_EQ(item, 0);
+  EXPECT_EQ(queue.EraseIf([](const int i) { return i % 2 == 0; }), 2u);
+  EXPECT_EQ(queue.Clear(), (std::vector<int>{1, 3}));
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_FALSE(queue.TryPop(item));
+
+  const WorkQueue<int>::Metrics metrics = queue.GetMetrics();
+  EXPECT_EQ(metrics.depth, 0u);
+  EXPECT_EQ(metrics.max_depth, 5u);
+  EXPECT_EQ(metrics.pushed, 5u);
+  EXPECT_EQ(metrics.popped, 1u);
+  EXPECT_EQ(metrics.dropped, 4u);
+}
+
+TEST(WorkQueue, Wait) {
+  WorkQueue<int> queue;
+
+  // Nothing to wait for.
+  EXPECT_FALSE(queue.WaitFor(std::chrono::milliseconds(1)));
+
+  // A push or notification since the previous wait returns at once, only once.
+  queue.Push(1);
+  EXPECT_TRUE(queue.WaitFor(std::chrono::hours(1)));
+  EXPECT_FALSE(queue.WaitFor(std::chrono::milliseconds(1)));
+  int item = 0;
+  ASSERT_TRUE(queue.TryPop(item));
+  queue.Notify();
+  EXPECT_TRUE(queue.WaitFor(std::chrono::hours(1)));
+  EXPECT_FALSE(queue.WaitFor(std::chrono::milliseconds(1)));
+
+  // The consumer is woken by a producer.
+  std::thread producer([&queue]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.Push(2);
+  });
+  EXPECT_TRUE(queue.WaitFor(std::chrono::hours(1)));
+  ASSERT_TRUE(queue.TryPop(item));
+  EXPECT_EQ(item, 2);
+  producer.join();
+
+  const WorkQueue<int>::Metrics metrics = queue.GetMetrics();
+  EXPECT_EQ(metrics.popped, 2u);
+  EXPECT_GT(metrics.idle_ms, 0.0);
+  EXPECT_GE(metrics.max_wait_ms, metrics.mean_wait_ms);
+}
@@ -13,6 +13,10 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstring>
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512VL__)
+#include <immintrin.h>
+#endif
 #include <stdint-gcc.h>
 
 #include "FORB.h"
@@ -23,7 +27,7 @@ namespace DBoW2 {
 
 // --------------------------------------------------------------------------
 
-const int FORB::L=32;
+const int FORB::L;
 
 void FORB::meanValue(const std::vector<FORB::pDescriptor> &descriptors, 
   FORB::TDescriptor &mean)
@@ -100,6 +104,35 @@ int FORB::distance(const FORB::TDescriptor &a,
   return dist;
 }
 
+// --------------------------------------------------------------------------
+
+void FORB::distances(const unsigned char *a, const unsigned char *rows,
+  size_t stride, size_t count, int *d)
+{
+  // L = 32 bytes, i.e. four 64-bit words per descriptor
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512VL__)
+  const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+  for(size_t i = 0; i < count; ++i, rows += stride)
+  {
+    const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows));
+    const __m256i c = _mm256_popcnt_epi64(_mm256_xor_si256(va, vb));
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(c),
+      _mm256_extracti128_si256(c, 1));
+    d[i] = _mm_cvtsi128_si32(_mm_add_epi64(s, _mm_unpackhi_epi64(s, s)));
+  }
+#else
+  uint64_t qa[4];
+  memcpy(qa, a, sizeof(qa));
+  for(size_t i = 0; i < count; ++i, rows += stride)
+  {
+    uint64_t qb[4];
+    memcpy(qb, rows, sizeof(qb));
+    d[i] = __builtin_popcountll(qa[0] ^ qb[0]) + __builtin_popcountll(qa[1] ^ qb[1])
+      + __builtin_popcountll(qa[2] ^ qb[2]) + __builtin_popcountll(qa[3] ^ qb[3]);
+  }
+#endif
+}
+
 // --------------------------------------------------------------------------
   
 std::string FORB::toString(const FORB::TDescriptor &a)
@@ -136,6 +169,23 @@ void FORB::fromString(FORB::TDescriptor &a, const std::string &s)
 
 // --------------------------------------------------------------------------
 
+void FORB::toBytes(const FORB::TDescriptor &a, unsigned char *bytes)
+{
+  if(a.empty())
+    memset(bytes, 0, FORB::L);
+  else
+    memcpy(bytes, a.ptr<unsigned char>(), FORB::L);
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::fromBytes(FORB::TDescriptor &a, const unsigned char *bytes)
+{
+  a = cv::Mat(1, FORB::L, CV_8U, const_cast<unsigned char*>(bytes));
+}
+
+// --------------------------------------------------------------------------
+
 void FORB::toMat32F(const std::vector<TDescriptor> &descriptors, 
   cv::Mat &mat)
 {
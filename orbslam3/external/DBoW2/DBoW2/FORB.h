@@ -28,7 +28,7 @@ public:
   /// Pointer to a single descriptor
   typedef const TDescriptor *pDescriptor;
   /// Descriptor length (in bytes)
-  static const int L;
+  static const int L = 32;
 
   /**
    * Calculates the mean value of a set of descriptors
@@ -46,6 +46,18 @@ public:
    */
   static int distance(const TDescriptor &a, const TDescriptor &b);
 
+  /**
+   * Calculates the distances between a descriptor and count descriptors
+   * stored stride bytes apart
+   * @param a L bytes of the descriptor
+   * @param rows L bytes of the first descriptor to compare with
+   * @param stride bytes between two descriptors of rows
+   * @param count number of descriptors in rows
+   * @param d (out) count distances
+   */
+  static void distances(const unsigned char *a, const unsigned char *rows,
+    size_t stride, size_t count, int *d);
+
   /**
    * Returns a string version of the descriptor
    * @param a descriptor
@@ -60,6 +72,21 @@ public:
    */
   static void fromString(TDescriptor &a, const std::string &s);
 
+  /**
+   * Copies the L bytes of a descriptor
+   * @param a descriptor
+   * @param bytes (out) L bytes
+   */
+  static void toBytes(const TDescriptor &a, unsigned char *bytes);
+
+  /**
+   * Returns a descriptor referencing L bytes, which are not copied and
+   * must outlive it
+   * @param a (out) descriptor
+   * @param bytes L bytes
+   */
+  static void fromBytes(TDescriptor &a, const unsigned char *bytes);
+
   /**
    * Returns a mat with the descriptors in float format
    * @param descriptors
@@ -26,6 +26,16 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <functional>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
@@ -44,6 +54,11 @@ template<class TDescriptor, class F>
 class TemplatedVocabulary
 {		
 public:
+
+  /// Calls fn(i) for every i in [begin, end), possibly concurrently, and
+  /// returns once all calls are done
+  typedef std::function<void(size_t begin, size_t end,
+    const std::function<void(size_t)> &fn)> ParallelFor;
   
   /**
    * Initiates an empty vocabulary
@@ -145,6 +160,21 @@ public:
   virtual void transform(const std::vector<TDescriptor>& features,
     BowVector &v, FeatureVector &fv, int levelsup) const;
 
+  /**
+   * Transform a set of descriptors into a bow vector and a feature vector.
+   * The words of all the descriptors are looked up first, in blocks run
+   * through parallel_for (sequentially if empty), then the vectors are
+   * built in feature order, so the result is the same as above
+   * @param features
+   * @param v (out) bow vector
+   * @param fv (out) feature vector of nodes and feature indexes
+   * @param levelsup levels to go up the vocabulary tree to get the node index
+   * @param parallel_for runner of the lookup blocks
+   */
+  void transform(const std::vector<TDescriptor>& features,
+    BowVector &v, FeatureVector &fv, int levelsup,
+    const ParallelFor &parallel_for) const;
+
   /**
    * Transforms a single feature into a word (without weight)
    * @param feature
@@ -246,6 +276,42 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file written by saveToBinaryFile.
+   * The file is memory-mapped and the node descriptors point into the
+   * mapping, which lives as long as the vocabulary (or any copy of it).
+   * Only the header hash is checked unless verify is set, in which case the
+   * whole payload is hashed too
+   * @param filename
+   * @param verify check the payload hash as well
+   * @return false if the file could not be mapped or is not valid
+   */
+  bool loadFromBinaryFile(const std::string &filename, bool verify = false);
+
+  /**
+   * Saves the vocabulary into a binary file: a fixed header followed by the
+   * flat arrays of node descriptors, node weights, node parents and word
+   * nodes, in host byte order
+   * @param filename
+   * @param checksum identifier of the source vocabulary stored in the header
+   *   (e.g. the MD5 of the text file it was converted from), at most 39 chars
+   * @return false if the file could not be written
+   */
+  bool saveToBinaryFile(const std::string &filename,
+    const std::string &checksum = "") const;
+
+  /**
+   * Returns whether the file starts with the binary vocabulary magic
+   * @param filename
+   */
+  static bool isBinaryFile(const std::string &filename);
+
+  /**
+   * Returns the checksum stored in the header of the binary file the
+   * vocabulary was loaded from (empty otherwise)
+   */
+  inline const std::string& getChecksum() const { return m_checksum; }
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -293,6 +359,68 @@ protected:
   /// Pointer to descriptor
   typedef const TDescriptor *pDescriptor;
 
+  /// Header of the binary vocabulary files
+  struct BinaryHeader
+  {
+    /// "DBOW2VOC"
+    char magic[8];
+    /// Format version
+    uint32_t version;
+    /// Bytes per node descriptor
+    uint32_t descriptor_bytes;
+    /// Branching factor, depth levels, scoring and weighting
+    int32_t k, L, scoring, weighting;
+    /// Number of nodes (root included) and words
+    uint32_t node_count, word_count;
+    /// FNV-1a hash of everything after the header
+    uint64_t payload_hash;
+    /// Identifier of the source vocabulary, NUL-terminated
+    char checksum[40];
+    /// FNV-1a hash of the header bytes before this field
+    uint64_t header_hash;
+  };
+
+  /// Offsets of the arrays of a binary vocabulary file
+  struct BinaryLayout
+  {
+    size_t weights, first_child, num_children, child_ids, words, descriptors,
+      size;
+
+    BinaryLayout(size_t node_count, size_t word_count);
+  };
+
+  /// Structure-of-arrays copy of the tree used to descend it: the children
+  /// of every node are packed contiguously, their descriptors in 32-byte
+  /// aligned rows, so that a level of a descent is a single sweep over a few
+  /// consecutive rows
+  struct FlatTree
+  {
+    /// Per node: index of its first child in the packed arrays (every node
+    /// but the root is the child of exactly one node)
+    const uint32_t *first_child;
+    /// Per node: number of children (0 for the leaves)
+    const uint32_t *num_children;
+    /// Packed node ids of the children
+    const uint32_t *child_ids;
+    /// Packed descriptors of the children
+    const unsigned char *descriptors;
+
+    /// Backing memory: either the owned buffers or the binary file mapping
+    std::vector<uint32_t> indices;
+    std::vector<unsigned char> rows;
+    std::shared_ptr<const void> mapping;
+  };
+
+  /// Bytes per descriptor row of the flat tree
+  static size_t rowBytes() { return (F::L + 31) & ~size_t(31); }
+
+  /**
+   * 64-bit FNV-1a hash
+   * @param data
+   * @param size bytes to hash
+   */
+  static uint64_t fnv1a(const void *data, size_t size);
+
   /// Tree node
   struct Node 
   {
@@ -361,6 +489,46 @@ protected:
    * @param id (out) word id
    */
   virtual void transform(const TDescriptor &feature, WordId &id) const;
+
+  /**
+   * Returns the word id associated to a feature, descending the flat tree
+   * @param feature F::L bytes of the feature
+   * @param id (out) word id
+   * @param weight (out) word weight
+   * @param nid (out) if given, id of the node "levelsup" levels up
+   * @param levelsup
+   */
+  void transformFlat(const unsigned char *feature, WordId &id,
+    WordValue &weight, NodeId* nid, int levelsup) const;
+
+  /**
+   * Looks the words of all the features up, in blocks run through
+   * parallel_for (sequentially if empty)
+   * @param features
+   * @param ids (out) word id of every feature
+   * @param weights (out) word weight of every feature
+   * @param nids (out) if given, node id "levelsup" levels up of every feature
+   * @param levelsup
+   * @param parallel_for
+   */
+  void transform(const std::vector<TDescriptor>& features,
+    std::vector<WordId> &ids, std::vector<WordValue> &weights,
+    std::vector<NodeId> *nids, int levelsup,
+    const ParallelFor &parallel_for) const;
+
+  /**
+   * Packs the children of every node as laid out in the flat tree
+   * @param indices (out) first_child, num_children and child_ids arrays,
+   *   one after the other
+   * @param rows (out) descriptor rows of the packed children
+   */
+  void packChildren(std::vector<uint32_t> &indices,
+    std::vector<unsigned char> &rows) const;
+
+  /**
+   * Builds the flat tree from the nodes
+   */
+  void createFlatTree();
       
   /**
    * Creates a level in the tree, under the parent, by running kmeans with
@@ -425,6 +593,13 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Flat copy of the tree used by transform (shared by the copies of the
+  /// vocabulary). The node descriptors may point into its memory
+  std::shared_ptr<const FlatTree> m_flat;
+
+  /// Checksum read from the binary file header (if any)
+  std::string m_checksum;
   
 };
 
@@ -548,6 +723,10 @@ TemplatedVocabulary<TDescriptor,F>::operator=
   
   this->m_nodes = voc.m_nodes;
   this->createWords();
+
+  // Copied descriptors may still point into the flat tree
+  this->m_flat = voc.m_flat;
+  this->m_checksum = voc.m_checksum;
   
   return *this;
 }
@@ -560,6 +739,8 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 {
   m_nodes.clear();
   m_words.clear();
+  m_flat.reset();
+  m_checksum.clear();
   
   // expected_nodes = Sum_{i=0..L} ( k^i )
 	int expected_nodes = 
@@ -580,6 +761,7 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 
   // create the words
   createWords();
+  createFlatTree();
 
   // and set the weight of each node of the tree
   setNodeWeights(training_features);
@@ -1077,20 +1259,17 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
 
-	typename vector<TDescriptor>::const_iterator fit;
+  // w is the idf value if TF_IDF, 1 if TF, idf if IDF, or 1 if BINARY
+  vector<WordId> ids;
+  vector<WordValue> weights;
+  transform(features, ids, weights, NULL, 0, ParallelFor());
 
   if(m_weighting == TF || m_weighting == TF_IDF)
   {
-    for(fit = features.begin(); fit < features.end(); ++fit)
+    for(size_t i = 0; i < features.size(); ++i)
     {
-      WordId id;
-      WordValue w; 
-      // w is the idf value if TF_IDF, 1 if TF
-      
-      transform(*fit, id, w);
-      
       // not stopped
-      if(w > 0) v.addWeight(id, w);
+      if(weights[i] > 0) v.addWeight(ids[i], weights[i]);
     }
     
     if(!v.empty() && !must)
@@ -1104,18 +1283,11 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   }
   else // IDF || BINARY
   {
-    for(fit = features.begin(); fit < features.end(); ++fit)
+    for(size_t i = 0; i < features.size(); ++i)
     {
-      WordId id;
-      WordValue w;
-      // w is idf if IDF, or 1 if BINARY
-      
-      transform(*fit, id, w);
-      
       // not stopped
-      if(w > 0) v.addIfNotExist(id, w);
-      
-    } // if add_features
+      if(weights[i] > 0) v.addIfNotExist(ids[i], weights[i]);
+    }
   } // if m_weighting == ...
   
   if(must) v.normalize(norm);
@@ -1127,6 +1299,17 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(
   const std::vector<TDescriptor>& features,
   BowVector &v, FeatureVector &fv, int levelsup) const
+{
+  transform(features, v, fv, levelsup, ParallelFor());
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F> 
+void TemplatedVocabulary<TDescriptor,F>::transform(
+  const std::vector<TDescriptor>& features,
+  BowVector &v, FeatureVector &fv, int levelsup,
+  const ParallelFor &parallel_for) const
 {
   v.clear();
   fv.clear();
@@ -1139,25 +1322,22 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   // normalize 
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
+
+  // w is the idf value if TF_IDF, 1 if TF, idf if IDF, or 1 if BINARY
+  vector<WordId> ids;
+  vector<WordValue> weights;
+  vector<NodeId> nids;
+  transform(features, ids, weights, &nids, levelsup, parallel_for);
   
-  typename vector<TDescriptor>::const_iterator fit;
-  
+  // the vectors are filled in feature order, as done feature by feature
   if(m_weighting == TF || m_weighting == TF_IDF)
   {
-    unsigned int i_feature = 0;
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
+    for(unsigned int i_feature = 0; i_feature < features.size(); ++i_feature)
     {
-      WordId id;
-      NodeId nid;
-      WordValue w; 
-      // w is the idf value if TF_IDF, 1 if TF
-      
-      transform(*fit, id, w, &nid, levelsup);
-      
-      if(w > 0) // not stopped
+      if(weights[i_feature] > 0) // not stopped
       { 
-        v.addWeight(id, w);
-        fv.addFeature(nid, i_feature);
+        v.addWeight(ids[i_feature], weights[i_feature]);
+        fv.addFeature(nids[i_feature], i_feature);
       }
     }
     
@@ -1172,20 +1352,12 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   }
   else // IDF || BINARY
   {
-    unsigned int i_feature = 0;
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
+    for(unsigned int i_feature = 0; i_feature < features.size(); ++i_feature)
     {
-      WordId id;
-      NodeId nid;
-      WordValue w;
-      // w is idf if IDF, or 1 if BINARY
-      
-      transform(*fit, id, w, &nid, levelsup);
-      
-      if(w > 0) // not stopped
+      if(weights[i_feature] > 0) // not stopped
       {
-        v.addIfNotExist(id, w);
-        fv.addFeature(nid, i_feature);
+        v.addIfNotExist(ids[i_feature], weights[i_feature]);
+        fv.addFeature(nids[i_feature], i_feature);
       }
     }
   } // if m_weighting == ...
@@ -1195,6 +1367,37 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transform(
+  const std::vector<TDescriptor>& features,
+  std::vector<WordId> &ids, std::vector<WordValue> &weights,
+  std::vector<NodeId> *nids, int levelsup,
+  const ParallelFor &parallel_for) const
+{
+  const size_t n = features.size();
+  ids.assign(n, 0);
+  weights.assign(n, 0);
+  if(nids) nids->assign(n, 0);
+
+  // Blocks of features amortize the dispatch of the parallel runs
+  const size_t block_size = 64;
+  const size_t blocks = (n + block_size - 1) / block_size;
+  const std::function<void(size_t)> lookup = [&](size_t block)
+  {
+    const size_t end = std::min(n, (block + 1) * block_size);
+    for(size_t i = block * block_size; i < end; ++i)
+      transform(features[i], ids[i], weights[i], nids ? &(*nids)[i] : NULL,
+        levelsup);
+  };
+
+  if(parallel_for && blocks > 1)
+    parallel_for(0, blocks, lookup);
+  else
+    for(size_t block = 0; block < blocks; ++block) lookup(block);
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F> 
 inline double TemplatedVocabulary<TDescriptor,F>::score
   (const BowVector &v1, const BowVector &v2) const
@@ -1218,6 +1421,14 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature, 
   WordId &word_id, WordValue &weight, NodeId *nid, int levelsup) const
 { 
+  if(m_flat)
+  {
+    alignas(32) unsigned char bytes[F::L];
+    F::toBytes(feature, bytes);
+    transformFlat(bytes, word_id, weight, nid, levelsup);
+    return;
+  }
+
   // propagate the feature down the tree
   vector<NodeId> nodes;
   typename vector<NodeId>::const_iterator nit;
@@ -1260,6 +1471,62 @@ void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature,
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transformFlat(
+  const unsigned char *feature, WordId &word_id, WordValue &weight,
+  NodeId *nid, int levelsup) const
+{
+  const FlatTree &flat = *m_flat;
+  const size_t row_bytes = rowBytes();
+
+  // level at which the node must be stored in nid, if given
+  const int nid_level = m_L - levelsup;
+  if(nid_level <= 0 && nid != NULL) *nid = 0; // root
+
+  NodeId final_id = 0; // root
+  int current_level = 0;
+
+  // distances to a chunk of children, in a single sweep over their rows
+  const uint32_t chunk = 32;
+  int distances[chunk];
+
+  do
+  {
+    ++current_level;
+    const uint32_t first = flat.first_child[final_id];
+    const uint32_t n = flat.num_children[final_id];
+
+    // first child with the lowest distance, as in the node by node descent
+    uint32_t best = 0;
+    int best_d = std::numeric_limits<int>::max();
+    for(uint32_t c = 0; c < n; c += chunk)
+    {
+      const uint32_t m = std::min(chunk, n - c);
+      F::distances(feature, flat.descriptors + (first + c) * row_bytes,
+        row_bytes, m, distances);
+      for(uint32_t i = 0; i < m; ++i)
+      {
+        if(distances[i] < best_d)
+        {
+          best_d = distances[i];
+          best = c + i;
+        }
+      }
+    }
+    final_id = flat.child_ids[first + best];
+
+    if(nid != NULL && current_level == nid_level)
+      *nid = final_id;
+
+  } while(flat.num_children[final_id] != 0);
+
+  // turn node id into word id
+  word_id = m_nodes[final_id].word_id;
+  weight = m_nodes[final_id].weight;
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 NodeId TemplatedVocabulary<TDescriptor,F>::getParentNode
   (WordId wid, int levelsup) const
@@ -1345,6 +1612,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
 
     m_words.clear();
     m_nodes.clear();
+    m_flat.reset();
+    m_checksum.clear();
 
     string s;
     getline(f,s);
@@ -1419,6 +1688,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
         }
     }
 
+    createFlatTree();
+
     return true;
 
 }
@@ -1450,6 +1721,291 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+TemplatedVocabulary<TDescriptor,F>::BinaryLayout::BinaryLayout(
+  size_t node_count, size_t word_count)
+{
+  // The weights are 8-byte aligned and the descriptor rows 32-byte aligned,
+  // so that every array can be used in place
+  const auto align = [](size_t offset, size_t alignment)
+    { return (offset + alignment - 1) & ~(alignment - 1); };
+  const size_t child_count = node_count - 1;
+
+  weights = align(sizeof(BinaryHeader), 8);
+  first_child = weights + sizeof(WordValue) * node_count;
+  num_children = first_child + sizeof(uint32_t) * node_count;
+  child_ids = num_children + sizeof(uint32_t) * node_count;
+  words = child_ids + sizeof(uint32_t) * child_count;
+  descriptors = align(words + sizeof(uint32_t) * word_count, 32);
+  size = descriptors + rowBytes() * child_count;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+uint64_t TemplatedVocabulary<TDescriptor,F>::fnv1a(const void *data,
+  size_t size)
+{
+  const unsigned char *p = static_cast<const unsigned char*>(data);
+  uint64_t hash = 14695981039346656037ull;
+  for(size_t i = 0; i < size; ++i)
+  {
+    hash ^= p[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::isBinaryFile(
+  const std::string &filename)
+{
+  char magic[8];
+  ifstream f(filename.c_str(), ios_base::in | ios_base::binary);
+  if(!f.read(magic, sizeof(magic))) return false;
+  return std::memcmp(magic, "DBOW2VOC", sizeof(magic)) == 0;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(
+  const std::string &filename, const std::string &checksum) const
+{
+  if(m_nodes.empty()) return false;
+
+  BinaryHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "DBOW2VOC", sizeof(header.magic));
+  header.version = 2;
+  header.descriptor_bytes = F::L;
+  header.k = m_k;
+  header.L = m_L;
+  header.scoring = m_scoring;
+  header.weighting = m_weighting;
+  header.node_count = m_nodes.size();
+  header.word_count = m_words.size();
+  if(checksum.size() >= sizeof(header.checksum)) return false;
+  std::memcpy(header.checksum, checksum.c_str(), checksum.size());
+
+  // The file holds the flat tree as is
+  std::vector<uint32_t> indices;
+  std::vector<unsigned char> rows;
+  packChildren(indices, rows);
+
+  // Lay out the whole file in memory, then hash and write it
+  const BinaryLayout layout(m_nodes.size(), m_words.size());
+  std::vector<unsigned char> buffer(layout.size, 0);
+  unsigned char *base = buffer.data();
+
+  for(size_t i = 0; i < m_nodes.size(); ++i)
+  {
+    std::memcpy(base + layout.weights + i * sizeof(WordValue),
+      &m_nodes[i].weight, sizeof(WordValue));
+  }
+  std::memcpy(base + layout.first_child, indices.data(),
+    indices.size() * sizeof(uint32_t));
+  for(size_t wid = 0; wid < m_words.size(); ++wid)
+  {
+    const uint32_t nid = m_words[wid]->id;
+    std::memcpy(base + layout.words + wid * sizeof(uint32_t), &nid,
+      sizeof(uint32_t));
+  }
+  std::memcpy(base + layout.descriptors, rows.data(), rows.size());
+
+  header.payload_hash = fnv1a(base + sizeof(header), layout.size - sizeof(header));
+  header.header_hash = fnv1a(&header, offsetof(BinaryHeader, header_hash));
+  std::memcpy(base, &header, sizeof(header));
+
+  ofstream f(filename.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+  if(!f.is_open()) return false;
+  f.write(reinterpret_cast<const char*>(base), buffer.size());
+  return f.good();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(
+  const std::string &filename, bool verify)
+{
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BinaryHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  const size_t size = st.st_size;
+  void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED) return false;
+
+  // Released with the last flat tree referencing it
+  std::shared_ptr<const void> mapping(addr,
+    [size](const void *p) { munmap(const_cast<void*>(p), size); });
+  const unsigned char *base = static_cast<const unsigned char*>(addr);
+
+  BinaryHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if(std::memcmp(header.magic, "DBOW2VOC", sizeof(header.magic)) != 0 ||
+    header.header_hash != fnv1a(&header, offsetof(BinaryHeader, header_hash)) ||
+    header.version != 2 || (int)header.descriptor_bytes != F::L ||
+    header.node_count == 0 || header.checksum[sizeof(header.checksum) - 1] != '\0')
+  {
+    std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+    return false;
+  }
+
+  const BinaryLayout layout(header.node_count, header.word_count);
+  if(layout.size != size ||
+    (verify && header.payload_hash != fnv1a(base + sizeof(header), size - sizeof(header))))
+  {
+    std::cerr << "Vocabulary loading failure: The binary file is corrupted!" << endl;
+    return false;
+  }
+
+  // Read-ahead the arrays, they are all touched while building the tree
+  madvise(addr, size, MADV_WILLNEED);
+
+  std::shared_ptr<FlatTree> flat = std::make_shared<FlatTree>();
+  flat->first_child = reinterpret_cast<const uint32_t*>(base + layout.first_child);
+  flat->num_children = reinterpret_cast<const uint32_t*>(base + layout.num_children);
+  flat->child_ids = reinterpret_cast<const uint32_t*>(base + layout.child_ids);
+  flat->descriptors = base + layout.descriptors;
+  flat->mapping = mapping;
+
+  const WordValue *weights =
+    reinterpret_cast<const WordValue*>(base + layout.weights);
+  const uint32_t *words =
+    reinterpret_cast<const uint32_t*>(base + layout.words);
+
+  m_words.clear();
+  m_nodes.clear();
+  m_flat.reset();
+  m_checksum.clear();
+
+  const auto fail = [this]()
+  {
+    std::cerr << "Vocabulary loading failure: The binary file is corrupted!" << endl;
+    m_nodes.clear();
+    m_words.clear();
+    return false;
+  };
+
+  // The children must be packed in node order, each node being the child of
+  // a single node with a lower id
+  m_nodes.resize(header.node_count);
+  std::vector<bool> is_child(header.node_count, false);
+  uint32_t packed = 0;
+  for(NodeId pid = 0; pid < header.node_count; ++pid)
+  {
+    Node &node = m_nodes[pid];
+    node.id = pid;
+    node.weight = weights[pid];
+
+    const uint32_t n = flat->num_children[pid];
+    if(flat->first_child[pid] != packed || n > header.node_count - 1 - packed)
+      return fail();
+
+    node.children.reserve(n);
+    for(uint32_t i = packed; i < packed + n; ++i)
+    {
+      const NodeId cid = flat->child_ids[i];
+      if(cid <= pid || cid >= header.node_count || is_child[cid])
+        return fail();
+      is_child[cid] = true;
+      node.children.push_back(cid);
+      m_nodes[cid].parent = pid;
+      F::fromBytes(m_nodes[cid].descriptor, flat->descriptors + i * rowBytes());
+    }
+    packed += n;
+  }
+  if(packed != header.node_count - 1) return fail();
+
+  m_words.resize(header.word_count);
+  for(WordId wid = 0; wid < header.word_count; ++wid)
+  {
+    const NodeId nid = words[wid];
+    if(nid == 0 || nid >= header.node_count) return fail();
+    m_nodes[nid].word_id = wid;
+    m_words[wid] = &m_nodes[nid];
+  }
+
+  m_k = header.k;
+  m_L = header.L;
+  m_scoring = (ScoringType)header.scoring;
+  m_weighting = (WeightingType)header.weighting;
+  createScoringObject();
+
+  m_flat = flat;
+  m_checksum = header.checksum;
+
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::packChildren(
+  std::vector<uint32_t> &indices, std::vector<unsigned char> &rows) const
+{
+  const size_t node_count = m_nodes.size();
+  const size_t child_count = node_count > 0 ? node_count - 1 : 0;
+
+  indices.assign(2 * node_count + child_count, 0);
+  uint32_t *first_child = indices.data();
+  uint32_t *num_children = first_child + node_count;
+  uint32_t *child_ids = num_children + node_count;
+
+  rows.assign(rowBytes() * child_count, 0);
+
+  uint32_t packed = 0;
+  for(size_t pid = 0; pid < node_count; ++pid)
+  {
+    const vector<NodeId> &children = m_nodes[pid].children;
+    first_child[pid] = packed;
+    num_children[pid] = children.size();
+    for(size_t i = 0; i < children.size(); ++i, ++packed)
+    {
+      child_ids[packed] = children[i];
+      F::toBytes(m_nodes[children[i]].descriptor, &rows[packed * rowBytes()]);
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::createFlatTree()
+{
+  m_flat.reset();
+  if(m_nodes.empty()) return;
+
+  std::shared_ptr<FlatTree> flat = std::make_shared<FlatTree>();
+  std::vector<unsigned char> rows;
+  packChildren(flat->indices, rows);
+
+  // Align the first row to 32 bytes
+  flat->rows.resize(rows.size() + 31);
+  unsigned char *aligned = flat->rows.data() +
+    ((32 - reinterpret_cast<uintptr_t>(flat->rows.data()) % 32) % 32);
+  std::memcpy(aligned, rows.data(), rows.size());
+
+  flat->first_child = flat->indices.data();
+  flat->num_children = flat->first_child + m_nodes.size();
+  flat->child_ids = flat->num_children + m_nodes.size();
+  flat->descriptors = aligned;
+  m_flat = flat;
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -1575,6 +2131,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
 {
   m_words.clear();
   m_nodes.clear();
+  m_flat.reset();
+  m_checksum.clear();
   
   cv::FileNode fvoc = fs[name];
   
@@ -1619,6 +2177,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  createFlatTree();
 }
 
 // --------------------------------------------------------------------------
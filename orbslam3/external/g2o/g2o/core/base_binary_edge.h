@@ -63,11 +63,14 @@ namespace g2o {
       _hessianRowMajor(false),
       _hessian(0, VertexXiType::Dimension, VertexXjType::Dimension), // HACK we map to the null pointer for initializing the Maps
       _hessianTransposed(0, VertexXjType::Dimension, VertexXiType::Dimension),
-      _jacobianOplusXi(0, D, Di), _jacobianOplusXj(0, D, Dj)
+      _jacobianOplusXi(0, D, Di), _jacobianOplusXj(0, D, Dj),
+      _storedQuadraticForm(0)
       {
         _vertices.resize(2);
       }
 
+      virtual ~BaseBinaryEdge() { delete _storedQuadraticForm;}
+
       virtual OptimizableGraph::Vertex* createFrom();
       virtual OptimizableGraph::Vertex* createTo();
 
@@ -90,6 +93,10 @@ namespace g2o {
 
       virtual void constructQuadraticForm() ;
 
+      virtual void storeQuadraticForm();
+
+      virtual void addStoredQuadraticForm(int i);
+
       virtual void mapHessianMemory(double* d, int i, int j, bool rowMajor);
 
       using BaseEdge<D,E>::resize;
@@ -108,6 +115,18 @@ namespace g2o {
       JacobianXiOplusType _jacobianOplusXi;
       JacobianXjOplusType _jacobianOplusXj;
 
+      //! terms of the vertices kept by storeQuadraticForm(), the off diagonal block in the mapped order
+      struct StoredQuadraticForm {
+        Matrix<double, Di, Di> Ai;
+        Matrix<double, Dj, Dj> Aj;
+        Matrix<double, Di, 1> bi;
+        Matrix<double, Dj, 1> bj;
+        Matrix<double, Di, Dj> hessian;
+        Matrix<double, Dj, Di> hessianTransposed;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+      };
+      StoredQuadraticForm* _storedQuadraticForm;
+
     public:
       EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   };
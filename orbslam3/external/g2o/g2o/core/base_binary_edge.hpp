@@ -119,6 +119,94 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   }
 }
 
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::storeQuadraticForm()
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+
+  const JacobianXiOplusType& A = jacobianOplusXi();
+  const JacobianXjOplusType& B = jacobianOplusXj();
+
+  bool fromNotFixed = !(from->fixed());
+  bool toNotFixed = !(to->fixed());
+
+  if (! (fromNotFixed || toNotFixed))
+    return;
+
+  if (! _storedQuadraticForm)
+    _storedQuadraticForm = new StoredQuadraticForm;
+  StoredQuadraticForm& q = *_storedQuadraticForm;
+
+  // the expressions of constructQuadraticForm()
+  const InformationType& omega = _information;
+  Matrix<double, D, 1> omega_r = - omega * _error;
+  if (this->robustKernel() == 0) {
+    if (fromNotFixed) {
+      Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
+      q.bi.noalias() = A.transpose() * omega_r;
+      q.Ai.noalias() = AtO*A;
+      if (toNotFixed ) {
+        if (_hessianRowMajor)
+          q.hessianTransposed.noalias() = B.transpose() * AtO.transpose();
+        else
+          q.hessian.noalias() = AtO * B;
+      }
+    }
+    if (toNotFixed) {
+      q.bj.noalias() = B.transpose() * omega_r;
+      q.Aj.noalias() = B.transpose() * omega * B;
+    }
+  } else {
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    InformationType weightedOmega = this->robustInformation(rho);
+
+    omega_r *= rho[1];
+    if (fromNotFixed) {
+      q.bi.noalias() = A.transpose() * omega_r;
+      q.Ai.noalias() = A.transpose() * weightedOmega * A;
+      if (toNotFixed ) {
+        if (_hessianRowMajor)
+          q.hessianTransposed.noalias() = B.transpose() * weightedOmega * A;
+        else
+          q.hessian.noalias() = A.transpose() * weightedOmega * B;
+      }
+    }
+    if (toNotFixed) {
+      q.bj.noalias() = B.transpose() * omega_r;
+      q.Aj.noalias() = B.transpose() * weightedOmega * B;
+    }
+  }
+}
+
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::addStoredQuadraticForm(int i)
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+  const StoredQuadraticForm& q = *_storedQuadraticForm;
+
+  // the vertex later in the Hessian adds the off diagonal block
+  bool addHessian = !(from->fixed()) && !(to->fixed());
+  if (i == 0) {
+    from->b() += q.bi;
+    from->A() += q.Ai;
+    addHessian = addHessian && from->hessianIndex() > to->hessianIndex();
+  } else {
+    to->b() += q.bj;
+    to->A() += q.Aj;
+    addHessian = addHessian && to->hessianIndex() > from->hessianIndex();
+  }
+  if (addHessian) {
+    if (_hessianRowMajor)
+      _hessianTransposed += q.hessianTransposed;
+    else
+      _hessian += q.hessian;
+  }
+}
+
 template <int D, typename E, typename VertexXiType, typename VertexXjType>
 void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 {
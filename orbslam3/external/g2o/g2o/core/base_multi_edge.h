@@ -68,10 +68,12 @@ namespace g2o {
       typedef typename BaseEdge<D,E>::InformationType InformationType;
       typedef Eigen::Map<MatrixXd, MatrixXd::Flags & AlignedBit ? Aligned : Unaligned > HessianBlockType;
 
-      BaseMultiEdge() : BaseEdge<D,E>()
+      BaseMultiEdge() : BaseEdge<D,E>(), _storedQuadraticForm(0)
       {
       }
 
+      virtual ~BaseMultiEdge() { delete _storedQuadraticForm;}
+
       virtual void linearizeOplus(JacobianWorkspace& jacobianWorkspace);
 
       /**
@@ -86,6 +88,10 @@ namespace g2o {
 
       virtual void constructQuadraticForm() ;
 
+      virtual void storeQuadraticForm();
+
+      virtual void addStoredQuadraticForm(int i);
+
       virtual void mapHessianMemory(double* d, int i, int j, bool rowMajor);
 
       using BaseEdge<D,E>::computeError;
@@ -100,7 +106,16 @@ namespace g2o {
       std::vector<HessianHelper> _hessian;
       std::vector<JacobianType, aligned_allocator<JacobianType> > _jacobianOplus; ///< jacobians of the edge (w.r.t. oplus)
 
+      //! terms of the vertices kept by storeQuadraticForm(), the off diagonal blocks indexed as _hessian
+      struct StoredQuadraticForm {
+        std::vector<MatrixXd, aligned_allocator<MatrixXd> > A;
+        std::vector<VectorXd, aligned_allocator<VectorXd> > b;
+        std::vector<MatrixXd, aligned_allocator<MatrixXd> > hessian;
+      };
+      StoredQuadraticForm* _storedQuadraticForm;
+
       void computeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError);
+      void storeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError);
 
     public:
       EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -48,6 +48,42 @@ void BaseMultiEdge<D, E>::constructQuadraticForm()
 }
 
 
+template <int D, typename E>
+void BaseMultiEdge<D, E>::storeQuadraticForm()
+{
+  if (this->robustKernel()) {
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    Matrix<double, D, 1> omega_r = - _information * _error;
+    omega_r *= rho[1];
+    storeQuadraticForm(this->robustInformation(rho), omega_r);
+  } else {
+    storeQuadraticForm(_information, - _information * _error);
+  }
+}
+
+template <int D, typename E>
+void BaseMultiEdge<D, E>::addStoredQuadraticForm(int i)
+{
+  OptimizableGraph::Vertex* from = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
+  const StoredQuadraticForm& q = *_storedQuadraticForm;
+  int fromDim = from->dimension();
+  Eigen::Map<MatrixXd> fromMap(from->hessianData(), fromDim, fromDim);
+  Eigen::Map<VectorXd> fromB(from->bData(), fromDim);
+  fromMap += q.A[i];
+  fromB += q.b[i];
+
+  // the vertex later in the Hessian adds the off diagonal blocks
+  for (size_t j = 0; j < _vertices.size(); ++j) {
+    OptimizableGraph::Vertex* to = static_cast<OptimizableGraph::Vertex*>(_vertices[j]);
+    if ((int)j == i || to->fixed() || to->hessianIndex() > from->hessianIndex())
+      continue;
+    int idx = (int)j < i ? internal::computeUpperTriangleIndex(j, i) : internal::computeUpperTriangleIndex(i, j);
+    _hessian[idx].matrix += q.hessian[idx];
+  }
+}
+
 template <int D, typename E>
 void BaseMultiEdge<D, E>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 {
@@ -220,3 +256,43 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
 
   }
 }
+
+template <int D, typename E>
+void BaseMultiEdge<D, E>::storeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError)
+{
+  if (! _storedQuadraticForm)
+    _storedQuadraticForm = new StoredQuadraticForm;
+  StoredQuadraticForm& q = *_storedQuadraticForm;
+  q.A.resize(_vertices.size());
+  q.b.resize(_vertices.size());
+  q.hessian.resize(_hessian.size());
+
+  // the expressions of computeQuadraticForm()
+  for (size_t i = 0; i < _vertices.size(); ++i) {
+    OptimizableGraph::Vertex* from = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
+    bool istatus = !(from->fixed());
+
+    if (istatus) {
+      const MatrixXd& A = _jacobianOplus[i];
+
+      MatrixXd AtO = A.transpose() * omega;
+      q.A[i].noalias() = AtO * A;
+      q.b[i].noalias() = A.transpose() * weightedError;
+
+      for (size_t j = i+1; j < _vertices.size(); ++j) {
+        OptimizableGraph::Vertex* to = static_cast<OptimizableGraph::Vertex*>(_vertices[j]);
+        bool jstatus = !(to->fixed());
+        if (jstatus) {
+          const MatrixXd& B = _jacobianOplus[j];
+          int idx = internal::computeUpperTriangleIndex(i, j);
+          assert(idx < (int)_hessian.size());
+          if (_hessian[idx].transposed) {
+            q.hessian[idx].noalias() = B.transpose() * AtO.transpose();
+          } else {
+            q.hessian[idx].noalias() = AtO * B;
+          }
+        }
+      }
+    }
+  }
+}
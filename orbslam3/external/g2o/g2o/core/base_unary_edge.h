@@ -51,11 +51,14 @@ namespace g2o {
       typedef typename BaseEdge<D,E>::InformationType InformationType;
 
       BaseUnaryEdge() : BaseEdge<D,E>(),
-        _jacobianOplusXi(0, D, VertexXiType::Dimension)
+        _jacobianOplusXi(0, D, VertexXiType::Dimension),
+        _storedQuadraticForm(0)
       {
         _vertices.resize(1);
       }
 
+      virtual ~BaseUnaryEdge() { delete _storedQuadraticForm;}
+
       virtual void resize(size_t size);
 
       virtual bool allVerticesFixed() const;
@@ -73,6 +76,10 @@ namespace g2o {
 
       virtual void constructQuadraticForm();
 
+      virtual void storeQuadraticForm();
+
+      virtual void addStoredQuadraticForm(int i);
+
       virtual void initialEstimate(const OptimizableGraph::VertexSet& from, OptimizableGraph::Vertex* to);
 
       virtual void mapHessianMemory(double*, int, int, bool) {assert(0 && "BaseUnaryEdge does not map memory of the Hessian");}
@@ -89,6 +96,14 @@ namespace g2o {
 
       JacobianXiOplusType _jacobianOplusXi;
 
+      //! terms of the vertex kept by storeQuadraticForm()
+      struct StoredQuadraticForm {
+        Matrix<double, VertexXiType::Dimension, VertexXiType::Dimension> A;
+        Matrix<double, VertexXiType::Dimension, 1> b;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+      };
+      StoredQuadraticForm* _storedQuadraticForm;
+
     public:
       EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   };
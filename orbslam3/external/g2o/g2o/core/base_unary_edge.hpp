@@ -71,6 +71,41 @@ void BaseUnaryEdge<D, E, VertexXiType>::constructQuadraticForm()
   }
 }
 
+template <int D, typename E, typename VertexXiType>
+void BaseUnaryEdge<D, E, VertexXiType>::storeQuadraticForm()
+{
+  VertexXiType* from=static_cast<VertexXiType*>(_vertices[0]);
+  if (from->fixed())
+    return;
+
+  if (! _storedQuadraticForm)
+    _storedQuadraticForm = new StoredQuadraticForm;
+  const JacobianXiOplusType& A = jacobianOplusXi();
+  const InformationType& omega = _information;
+
+  if (this->robustKernel()) {
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    InformationType weightedOmega = this->robustInformation(rho);
+
+    _storedQuadraticForm->b.noalias() = rho[1] * A.transpose() * omega * _error;
+    _storedQuadraticForm->A.noalias() = A.transpose() * weightedOmega * A;
+  } else {
+    _storedQuadraticForm->b.noalias() = A.transpose() * omega * _error;
+    _storedQuadraticForm->A.noalias() = A.transpose() * omega * A;
+  }
+}
+
+template <int D, typename E, typename VertexXiType>
+void BaseUnaryEdge<D, E, VertexXiType>::addStoredQuadraticForm(int i)
+{
+  (void) i;
+  VertexXiType* from=static_cast<VertexXiType*>(_vertices[0]);
+  from->b() -= _storedQuadraticForm->b;
+  from->A() += _storedQuadraticForm->A;
+}
+
 template <int D, typename E, typename VertexXiType>
 void BaseUnaryEdge<D, E, VertexXiType>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 {
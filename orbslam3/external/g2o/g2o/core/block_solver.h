@@ -28,6 +28,7 @@
 #define G2O_BLOCK_SOLVER_H
 #include <Eigen/Core>
 #include "solver.h"
+#include "optimizable_graph.h"
 #include "linear_solver.h"
 #include "sparse_block_matrix.h"
 #include "sparse_block_matrix_diagonal.h"
@@ -147,6 +148,32 @@ namespace g2o {
 
       void deallocate();
 
+      /**
+       * true if the active vertices and edges, and the mapping of the
+       * vertices, are those of the last buildStructure(), whose matrices can
+       * then be kept. The edges are compared by internal id, so an edge must
+       * not change its vertices in between.
+       */
+      bool structureUnchanged() const;
+      //! keeps what structureUnchanged() compares
+      void cacheStructure();
+
+      /**
+       * buildSystem() on the parallel loop of the optimizer: the edges are
+       * linearized concurrently and keep their terms, then each vertex sums
+       * the terms of its edges in the order of the active edges
+       */
+      void buildSystemParallel();
+      void buildVertexEdges();
+
+      /**
+       * the Schur complement of solve() on the parallel loop of the
+       * optimizer: the landmark blocks are inverted concurrently, then each
+       * task reduces the landmarks into one block row of the pose system,
+       * in the order of the landmarks as sequentially
+       */
+      void computeSchurComplementParallel();
+
       SparseBlockMatrix<PoseMatrixType>* _Hpp;
       SparseBlockMatrix<LandmarkMatrixType>* _Hll;
       SparseBlockMatrix<PoseLandmarkMatrixType>* _Hpl;
@@ -173,6 +200,20 @@ namespace g2o {
 
       int _numPoses, _numLandmarks;
       int _sizePoses, _sizeLandmarks;
+
+      //! active edges of each vertex in the index mapping, as (edge, vertex index in the edge), in ranges of _vertexEdgesStart
+      std::vector<int> _vertexEdgesStart;
+      std::vector<std::pair<OptimizableGraph::Edge*, int> > _vertexEdges;
+
+      //! blocks of each pose row of Hpl, as (landmark, block), in ranges of _poseLandmarksStart
+      std::vector<int> _poseLandmarksStart;
+      std::vector<std::pair<int, PoseLandmarkMatrixType*> > _poseLandmarks;
+
+      //! active vertices and edges of the last buildStructure()
+      std::vector<OptimizableGraph::Vertex*> _structureVertices;
+      std::vector<double*> _structureHessianData;
+      std::vector<long long> _structureEdgeIds;
+      bool _structureSchur;
   };
 
 
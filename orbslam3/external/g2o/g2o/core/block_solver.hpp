@@ -59,6 +59,7 @@ BlockSolver<Traits>::BlockSolver(LinearSolverType* linearSolver) :
   _sizePoses=0;
   _sizeLandmarks=0;
   _doSchur=true;
+  _structureSchur=true;
 }
 
 template <typename Traits>
@@ -130,6 +131,7 @@ void BlockSolver<Traits>::deallocate()
     delete _HschurTransposedCCS;
     _HschurTransposedCCS = 0;
   }
+  _structureVertices.clear();
 }
 
 template <typename Traits>
@@ -144,6 +146,19 @@ bool BlockSolver<Traits>::buildStructure(bool zeroBlocks)
 {
   assert(_optimizer);
 
+  // the matrices of the previous optimize() fit the same graph
+  if (structureUnchanged()) {
+    if (zeroBlocks) {
+      _Hpp->clear();
+      if (_doSchur) {
+        _Hll->clear();
+        _Hpl->clear();
+      }
+    }
+    return true;
+  }
+  _vertexEdgesStart.clear();
+
   size_t sparseDim = 0;
   _numPoses=0;
   _numLandmarks=0;
@@ -253,12 +268,31 @@ bool BlockSolver<Traits>::buildStructure(bool zeroBlocks)
     }
   }
 
-  if (! _doSchur)
+  if (! _doSchur) {
+    cacheStructure();
     return true;
+  }
 
   _DInvSchur->diagonal().resize(landmarkIdx);
   _Hpl->fillSparseBlockMatrixCCS(*_HplCCS);
 
+  // rows of Hpl, in the order of the landmarks
+  _poseLandmarksStart.assign(_numPoses + 1, 0);
+  for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_HplCCS->blockCols().size()); ++landmarkIndex) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+    for (size_t k = 0; k < landmarkColumn.size(); ++k)
+      ++_poseLandmarksStart[landmarkColumn[k].row + 1];
+  }
+  for (int i = 0; i < _numPoses; ++i)
+    _poseLandmarksStart[i + 1] += _poseLandmarksStart[i];
+  _poseLandmarks.resize(_poseLandmarksStart[_numPoses]);
+  std::vector<int> next(_poseLandmarksStart.begin(), _poseLandmarksStart.end() - 1);
+  for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_HplCCS->blockCols().size()); ++landmarkIndex) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+    for (size_t k = 0; k < landmarkColumn.size(); ++k)
+      _poseLandmarks[next[landmarkColumn[k].row]++] = std::make_pair(landmarkIndex, landmarkColumn[k].block);
+  }
+
   for (size_t i = 0; i < _optimizer->indexMapping().size(); ++i) {
     OptimizableGraph::Vertex* v = _optimizer->indexMapping()[i];
     if (v->marginalized()){
@@ -291,12 +325,51 @@ bool BlockSolver<Traits>::buildStructure(bool zeroBlocks)
   delete schurMatrixLookup;
   _Hschur->fillSparseBlockMatrixCCSTransposed(*_HschurTransposedCCS);
 
+  cacheStructure();
+  return true;
+}
+
+template <typename Traits>
+bool BlockSolver<Traits>::structureUnchanged() const
+{
+  const SparseOptimizer::VertexContainer& vertices = _optimizer->indexMapping();
+  const SparseOptimizer::EdgeContainer& edges = _optimizer->activeEdges();
+  if (! _Hpp || _structureSchur != _doSchur || _structureVertices.size() != vertices.size() || _structureEdgeIds.size() != edges.size())
+    return false;
+  // a vertex is mapped to its block, the poses before the landmarks
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    OptimizableGraph::Vertex* v = vertices[i];
+    if (v != _structureVertices[i] || v->hessianData() != _structureHessianData[i] || v->marginalized() != (static_cast<int>(i) >= _numPoses))
+      return false;
+  }
+  // the internal ids of the edges are never reused
+  for (size_t k = 0; k < edges.size(); ++k) {
+    if (edges[k]->internalId() != _structureEdgeIds[k])
+      return false;
+  }
   return true;
 }
 
+template <typename Traits>
+void BlockSolver<Traits>::cacheStructure()
+{
+  const SparseOptimizer::VertexContainer& vertices = _optimizer->indexMapping();
+  const SparseOptimizer::EdgeContainer& edges = _optimizer->activeEdges();
+  _structureSchur = _doSchur;
+  _structureVertices.assign(vertices.begin(), vertices.end());
+  _structureHessianData.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i)
+    _structureHessianData[i] = vertices[i]->hessianData();
+  _structureEdgeIds.resize(edges.size());
+  for (size_t k = 0; k < edges.size(); ++k)
+    _structureEdgeIds[k] = edges[k]->internalId();
+}
+
 template <typename Traits>
 bool BlockSolver<Traits>::updateStructure(const std::vector<HyperGraph::Vertex*>& vset, const HyperGraph::EdgeSet& edges)
 {
+  _structureVertices.clear();
+  _vertexEdgesStart.clear();
   for (std::vector<HyperGraph::Vertex*>::const_iterator vit = vset.begin(); vit != vset.end(); ++vit) {
     OptimizableGraph::Vertex* v = static_cast<OptimizableGraph::Vertex*>(*vit);
     int dim = v->dimension();
@@ -375,6 +448,9 @@ bool BlockSolver<Traits>::solve(){
 
   //_DInvSchur->clear();
   memset (_coefficients, 0, _sizePoses*sizeof(double));
+  if (_optimizer->parallelFor()) {
+    computeSchurComplementParallel();
+  } else {
 # ifdef G2O_OPENMP
 # pragma omp parallel for default (shared) schedule(dynamic, 10)
 # endif
@@ -430,6 +506,7 @@ bool BlockSolver<Traits>::solve(){
       }
     }
   }
+  }
   //cerr << "Solve [marginalize] = " <<  get_monotonic_time()-t << endl;
 
   // _bschur = _b for calling solver, and not touching _b
@@ -486,6 +563,91 @@ bool BlockSolver<Traits>::solve(){
 }
 
 
+template <typename Traits>
+void BlockSolver<Traits>::buildVertexEdges()
+{
+  // edges of the vertices, in the order of the active edges
+  const SparseOptimizer::EdgeContainer& edges = _optimizer->activeEdges();
+  const int numEdges = static_cast<int>(edges.size());
+  const int numVertices = static_cast<int>(_optimizer->indexMapping().size());
+  _vertexEdgesStart.assign(numVertices + 1, 0);
+  for (int k = 0; k < numEdges; ++k) {
+    const OptimizableGraph::Edge* e = edges[k];
+    for (size_t i = 0; i < e->vertices().size(); ++i) {
+      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+      if (v->hessianIndex() >= 0)
+        ++_vertexEdgesStart[v->hessianIndex() + 1];
+    }
+  }
+  for (int i = 0; i < numVertices; ++i)
+    _vertexEdgesStart[i + 1] += _vertexEdgesStart[i];
+  _vertexEdges.resize(_vertexEdgesStart[numVertices]);
+  std::vector<int> next(_vertexEdgesStart.begin(), _vertexEdgesStart.end() - 1);
+  for (int k = 0; k < numEdges; ++k) {
+    OptimizableGraph::Edge* e = edges[k];
+    for (size_t i = 0; i < e->vertices().size(); ++i) {
+      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+      if (v->hessianIndex() >= 0)
+        _vertexEdges[next[v->hessianIndex()]++] = std::make_pair(e, static_cast<int>(i));
+    }
+  }
+}
+
+template <typename Traits>
+void BlockSolver<Traits>::computeSchurComplementParallel()
+{
+  // inverse and Dinv * b of each landmark, the latter in the landmark part of _coefficients
+  _optimizer->parallelBlocks(static_cast<int>(_Hll->blockCols().size()), [this](int begin, int end) {
+    for (int landmarkIndex = begin; landmarkIndex < end; ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      LandmarkVectorType  db(D->rows());
+      for (int j=0; j<D->rows(); ++j) {
+        db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+      }
+      typename LandmarkVectorType::MapType(&_coefficients[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses], D->rows()) = Dinv*db;
+    }
+  });
+
+  // each task writes one block row of the Schur complement
+  _optimizer->parallelFor()(0, _numPoses, [this](size_t pose) {
+    const int i1 = static_cast<int>(pose);
+    typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], _HplCCS->rowsOfBlock(i1));
+    for (int k = _poseLandmarksStart[i1]; k < _poseLandmarksStart[i1 + 1]; ++k) {
+      const int landmarkIndex = _poseLandmarks[k].first;
+      const PoseLandmarkMatrixType* Bi = _poseLandmarks[k].second;
+      const LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      const typename LandmarkVectorType::ConstMapType db(&_coefficients[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses], Dinv.rows());
+
+      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+      Bb.noalias() += (*Bi)*db;
+
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+
+      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
+      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
+      for (; it_inner != landmarkColumn.end(); ++it_inner) {
+        int i2 = it_inner->row;
+        const PoseLandmarkMatrixType* Bj = it_inner->block;
+        assert(Bj);
+        while (targetColumnIt->row < i2)
+          ++targetColumnIt;
+        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+        PoseMatrixType* Hi1i2 = targetColumnIt->block;
+        assert(Hi1i2);
+        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+      }
+    }
+  });
+}
+
 template <typename Traits>
 bool BlockSolver<Traits>::computeMarginals(SparseBlockMatrix<MatrixXd>& spinv, const std::vector<std::pair<int, int> >& blockIndices)
 {
@@ -516,6 +678,11 @@ bool BlockSolver<Traits>::buildSystem()
     _Hpl->clear();
   }
 
+  if (_optimizer->parallelFor()) {
+    buildSystemParallel();
+    return 0;
+  }
+
   // resetting the terms for the pairwise constraints
   // built up the current system by storing the Hessian blocks in the edges and vertices
 # ifndef G2O_OPENMP
@@ -560,6 +727,55 @@ bool BlockSolver<Traits>::buildSystem()
 }
 
 
+template <typename Traits>
+void BlockSolver<Traits>::buildSystemParallel()
+{
+  const SparseOptimizer::EdgeContainer& edges = _optimizer->activeEdges();
+  const SparseOptimizer::VertexContainer& vertices = _optimizer->indexMapping();
+  const int numEdges = static_cast<int>(edges.size());
+  const int numVertices = static_cast<int>(vertices.size());
+
+  if (_vertexEdgesStart.empty())
+    buildVertexEdges();
+
+  // linearize the edges, each task with its own copy of the workspace
+  _optimizer->parallelBlocks(numEdges, [this, &edges](int begin, int end) {
+    JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
+    for (int k = begin; k < end; ++k) {
+      OptimizableGraph::Edge* e = edges[k];
+      e->linearizeOplus(jacobianWorkspace);
+      e->storeQuadraticForm();
+#  ifndef NDEBUG
+      for (size_t i = 0; i < e->vertices().size(); ++i) {
+        const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+        if (! v->fixed()) {
+          bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
+          if (hasANan) {
+            cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
+            break;
+          }
+        }
+      }
+#  endif
+    }
+  });
+
+  // each vertex sums its terms and the off diagonal blocks with the vertices
+  // before it, so every block has a single writer
+  _optimizer->parallelBlocks(numVertices, [this, &vertices](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      OptimizableGraph::Vertex* v = vertices[i];
+      for (int k = _vertexEdgesStart[i]; k < _vertexEdgesStart[i + 1]; ++k)
+        _vertexEdges[k].first->addStoredQuadraticForm(_vertexEdges[k].second);
+      int iBase = v->colInHessian();
+      if (v->marginalized())
+        iBase+=_sizePoses;
+      v->copyB(_b+iBase);
+    }
+  });
+}
+
+
 template <typename Traits>
 bool BlockSolver<Traits>::setLambda(double lambda, bool backup)
 {
@@ -437,6 +437,23 @@ namespace g2o {
          */
         virtual void constructQuadraticForm() = 0;
 
+        /**
+         * computes the terms of constructQuadraticForm() and keeps them in the
+         * edge instead of adding them, so that edges sharing vertices can be
+         * linearized concurrently
+         */
+        virtual void storeQuadraticForm() = 0;
+
+        /**
+         * adds the stored terms of the i-th vertex to its parameter vector b
+         * and hessian block, and the stored off diagonal blocks between the
+         * i-th vertex and the vertices with a lower hessian index to the
+         * mapped memory. Called once per non fixed vertex after
+         * storeQuadraticForm(), it sums the same terms as
+         * constructQuadraticForm().
+         */
+        virtual void addStoredQuadraticForm(int i) = 0;
+
         /**
          * maps the internal matrix to some external memory location,
          * you need to provide the memory before calling constructQuadraticForm
@@ -67,12 +67,21 @@ namespace g2o{
         (*(*it))(this);
     }
 
-#   ifdef G2O_OPENMP
-#   pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
-#   endif
-    for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
-      OptimizableGraph::Edge* e = _activeEdges[k];
-      e->computeError();
+    if (_parallelFor) {
+      parallelBlocks(static_cast<int>(_activeEdges.size()), [this](int begin, int end) {
+        for (int k = begin; k < end; ++k) {
+          OptimizableGraph::Edge* e = _activeEdges[k];
+          e->computeError();
+        }
+      });
+    } else {
+#     ifdef G2O_OPENMP
+#     pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
+#     endif
+      for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
+        OptimizableGraph::Edge* e = _activeEdges[k];
+        e->computeError();
+      }
     }
 
 #  ifndef NDEBUG
@@ -87,6 +96,19 @@ namespace g2o{
 
   }
 
+  void SparseOptimizer::parallelBlocks(int n, const std::function<void(int begin, int end)>& fn) const
+  {
+    const int numBlocks = (n + parallelBlockSize - 1) / parallelBlockSize;
+    if (! _parallelFor || numBlocks < 2) {
+      fn(0, n);
+      return;
+    }
+    _parallelFor(0, numBlocks, [n, &fn](size_t block) {
+      const int begin = static_cast<int>(block) * parallelBlockSize;
+      fn(begin, std::min(n, begin + parallelBlockSize));
+    });
+  }
+
   double SparseOptimizer::activeChi2( ) const
   {
     double chi = 0.0;
@@ -33,6 +33,7 @@
 #include "sparse_block_matrix.h"
 #include "batch_stats.h"
 
+#include <functional>
 #include <map>
 
 namespace g2o {
@@ -52,6 +53,15 @@ namespace g2o {
 
     friend class ActivePathCostFunction;
 
+    /**
+     * runs fn(i) for every i in [begin, end), possibly concurrently, and
+     * returns when all are done
+     */
+    typedef std::function<void(size_t begin, size_t end, const std::function<void(size_t)>& fn)> ParallelFor;
+
+    //! number of edges or vertices of a task of the parallel passes
+    static const int parallelBlockSize = 128;
+
     // Attention: _solver & _statistics is own by SparseOptimizer and will be
     // deleted in its destructor.
     SparseOptimizer();
@@ -278,6 +288,24 @@ namespace g2o {
     
     bool computeBatchStatistics() const { return _computeBatchStatistics;}
 
+    /**
+     * computes the errors and linearizes the edges with this parallel loop,
+     * an empty one (the default) keeps them sequential. The parallel
+     * linearization requires that linearizeOplus() of the active edges only
+     * reads their vertices, i.e., analytic Jacobians, and sums the Hessian
+     * blocks in the order of the sequential one, so the result is the same
+     * whatever the number of threads.
+     */
+    void setParallelFor(const ParallelFor& parallelFor) { _parallelFor = parallelFor;}
+    const ParallelFor& parallelFor() const { return _parallelFor;}
+
+    /**
+     * calls fn(begin, end) on consecutive blocks of [0, n) of
+     * parallelBlockSize elements with the parallel loop, or once on [0, n)
+     * without one or when there is a single block
+     */
+    void parallelBlocks(int n, const std::function<void(int begin, int end)>& fn) const;
+
     /**** callbacks ****/
     //! add an action to be executed before the error vectors are computed
     bool addComputeErrorAction(HyperGraphAction* action);
@@ -306,6 +334,7 @@ namespace g2o {
 
     BatchStatisticsContainer _batchStatistics;   ///< global statistics of the optimizer, e.g., timing, num-non-zeros
     bool _computeBatchStatistics;
+    ParallelFor _parallelFor;
   };
 } // end namespace
 
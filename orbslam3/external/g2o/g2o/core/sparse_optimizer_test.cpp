@@ -0,0 +1,284 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "sparse_optimizer.h"
+#include "base_multi_edge.h"
+#include "block_solver.h"
+#include "optimization_algorithm_levenberg.h"
+#include "robust_kernel_impl.h"
+#include "../solvers/linear_solver_eigen.h"
+#include "../types/types_six_dof_expmap.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace g2o;
+using namespace Eigen;
+
+namespace {
+
+  typedef Matrix<double, 9, 1> Vector9d;
+
+  /**
+   * signed sums of the translations of three poses, t0 + t1 - t2, t1 - t0 and
+   * t2 - t1, with analytic Jacobians. One 3D block per pose, as the 9D
+   * inertial edges of ORB-SLAM, so that the fixed-size error fits the
+   * columns of the numeric Jacobian of BaseMultiEdge.
+   */
+  class EdgeTranslationSum : public BaseMultiEdge<9, Vector9d>
+  {
+    public:
+      static const int numVertices = 3;
+
+      EdgeTranslationSum() { resize(numVertices);}
+
+      virtual bool read(std::istream&) { return false;}
+      virtual bool write(std::ostream&) const { return false;}
+
+      //! sign of the translation of pose i in the block r of the error
+      static double sign(int r, int i)
+      {
+        static const double signs[numVertices][numVertices] = {{1., 1., -1.}, {-1., 1., 0.}, {0., -1., 1.}};
+        return signs[r][i];
+      }
+
+      static Vector9d sums(const Vector3d& t0, const Vector3d& t1, const Vector3d& t2)
+      {
+        Vector9d sums;
+        for (int r = 0; r < numVertices; ++r)
+          sums.segment<3>(3 * r) = sign(r, 0) * t0 + sign(r, 1) * t1 + sign(r, 2) * t2;
+        return sums;
+      }
+
+      const Vector3d& translation(int i) const { return static_cast<const VertexSE3Expmap*>(_vertices[i])->estimate().translation();}
+
+      void computeError()
+      {
+        _error = sums(translation(0), translation(1), translation(2)) - _measurement;
+      }
+
+      virtual void linearizeOplus()
+      {
+        // the update is applied on the left, with the rotation first
+        for (int i = 0; i < numVertices; ++i) {
+          const Vector3d& t = translation(i);
+          Matrix<double, 3, 6> J;
+          J << 0., t.z(), -t.y(), 1., 0., 0.,
+               -t.z(), 0., t.x(), 0., 1., 0.,
+               t.y(), -t.x(), 0., 0., 0., 1.;
+          for (int r = 0; r < numVertices; ++r)
+            _jacobianOplus[i].block<3, 6>(3 * r, 0) = sign(r, i) * J;
+        }
+      }
+  };
+
+  /**
+   * the loop of SparseOptimizer::setParallelFor() on threads, which take the
+   * indices in turn
+   */
+  SparseOptimizer::ParallelFor threadedFor(int numThreads)
+  {
+    return [numThreads](size_t begin, size_t end, const std::function<void(size_t)>& fn) {
+      std::atomic<size_t> next(begin);
+      std::vector<std::thread> threads;
+      for (int t = 0; t < numThreads; ++t)
+        threads.emplace_back([&]() {
+          for (size_t i = next++; i < end; i = next++)
+            fn(i);
+        });
+      for (std::thread& thread : threads)
+        thread.join();
+    };
+  }
+
+  const double fx = 450., fy = 450., cx = 320., cy = 240.;
+
+  OptimizationAlgorithm* levenberg()
+  {
+    BlockSolver_6_3::LinearSolverType* linearSolver = new LinearSolverEigen<BlockSolver_6_3::PoseMatrixType>();
+    BlockSolver_6_3* blockSolver = new BlockSolver_6_3(linearSolver);
+    return new OptimizationAlgorithmLevenberg(blockSolver);
+  }
+
+  const int numPoses = 8, numPoints = 400;
+
+  /**
+   * a bundle adjustment of 8 poses, the first one fixed, and 400 points with
+   * noisy and wrong observations
+   */
+  void addBundleAdjustment(SparseOptimizer& optimizer)
+  {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> xy(-3., 3.), depth(4., 10.);
+    std::normal_distribution<double> noise(0., 1.);
+
+    std::vector<SE3Quat> poses;
+    for (int i = 0; i < numPoses; ++i) {
+      SE3Quat pose(Quaterniond(AngleAxisd(0.02 * i, Vector3d::UnitY())), Vector3d(-0.1 * i, 0.01 * i, 0.));
+      poses.push_back(pose);
+      VertexSE3Expmap* v = new VertexSE3Expmap();
+      v->setId(i);
+      v->setFixed(i == 0);
+      v->setEstimate(SE3Quat(Quaterniond::Identity(), Vector3d(0.02, -0.01, 0.03) * (i > 0)) * pose);
+      optimizer.addVertex(v);
+    }
+
+    for (int j = 0; j < numPoints; ++j) {
+      const Vector3d point(xy(rng), xy(rng), depth(rng));
+      VertexSBAPointXYZ* v = new VertexSBAPointXYZ();
+      v->setId(numPoses + j);
+      v->setMarginalized(true);
+      v->setEstimate(point + 0.05 * Vector3d(noise(rng), noise(rng), noise(rng)));
+      optimizer.addVertex(v);
+
+      for (int i = 0; i < numPoses; ++i) {
+        const Vector3d p = poses[i].map(point);
+        Vector2d obs(fx * p.x() / p.z() + cx, fy * p.y() / p.z() + cy);
+        obs += Vector2d(noise(rng), noise(rng));
+        if ((i + j) % 17 == 0)
+          obs += Vector2d(30., -20.);
+
+        EdgeSE3ProjectXYZ* e = new EdgeSE3ProjectXYZ();
+        e->setVertex(0, optimizer.vertex(numPoses + j));
+        e->setVertex(1, optimizer.vertex(i));
+        e->setMeasurement(obs);
+        e->setInformation(Matrix2d::Identity());
+        RobustKernelHuber* rk = new RobustKernelHuber;
+        rk->setDelta(sqrt(5.991));
+        e->setRobustKernel(rk);
+        e->fx = fx; e->fy = fy; e->cx = cx; e->cy = cy;
+        optimizer.addEdge(e);
+      }
+    }
+
+    // a prior on the second pose, and sums of translations in both orders of the Hessian
+    EdgeSE3ProjectXYZOnlyPose* prior = new EdgeSE3ProjectXYZOnlyPose();
+    prior->setVertex(0, optimizer.vertex(1));
+    prior->Xw = Vector3d(0., 0., 5.);
+    const Vector3d p = poses[1].map(prior->Xw);
+    prior->setMeasurement(Vector2d(fx * p.x() / p.z() + cx, fy * p.y() / p.z() + cy));
+    prior->setInformation(Matrix2d::Identity());
+    prior->fx = fx; prior->fy = fy; prior->cx = cx; prior->cy = cy;
+    optimizer.addEdge(prior);
+    const int sums[3][3] = {{3, 1, 2}, {0, 6, 4}, {5, 7, 2}};
+    for (int k = 0; k < 3; ++k) {
+      EdgeTranslationSum* e = new EdgeTranslationSum();
+      for (int i = 0; i < EdgeTranslationSum::numVertices; ++i)
+        e->setVertex(i, optimizer.vertex(sums[k][i]));
+      e->setMeasurement(EdgeTranslationSum::sums(poses[sums[k][0]].translation(), poses[sums[k][1]].translation(), poses[sums[k][2]].translation()));
+      e->setInformation(100. * Matrix<double, 9, 9>::Identity());
+      optimizer.addEdge(e);
+    }
+  }
+
+  std::vector<double> estimates(SparseOptimizer& optimizer)
+  {
+    std::vector<double> estimates;
+    for (int i = 0; i < numPoses + numPoints; ++i) {
+      std::vector<double> estimate;
+      static_cast<OptimizableGraph::Vertex*>(optimizer.vertex(i))->getEstimateData(estimate);
+      estimates.insert(estimates.end(), estimate.begin(), estimate.end());
+    }
+    estimates.push_back(optimizer.activeRobustChi2());
+    return estimates;
+  }
+
+  //! estimates after 10 iterations
+  std::vector<double> bundleAdjustment(const SparseOptimizer::ParallelFor& parallelFor)
+  {
+    SparseOptimizer optimizer;
+    optimizer.setAlgorithm(levenberg());
+    optimizer.setParallelFor(parallelFor);
+    addBundleAdjustment(optimizer);
+    optimizer.initializeOptimization();
+    optimizer.optimize(10);
+    return estimates(optimizer);
+  }
+
+  /**
+   * estimates after three rounds, the second one without the outliers of the
+   * first one and the third one on the same edges as the second one, with a
+   * new solver when newSolver
+   */
+  std::vector<double> roundsOfBundleAdjustment(const SparseOptimizer::ParallelFor& parallelFor, bool newSolver)
+  {
+    SparseOptimizer optimizer;
+    optimizer.setAlgorithm(levenberg());
+    optimizer.setParallelFor(parallelFor);
+    addBundleAdjustment(optimizer);
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(3);
+
+    optimizer.computeActiveErrors();
+    int numOutliers = 0;
+    for (HyperGraph::EdgeSet::iterator it = optimizer.edges().begin(); it != optimizer.edges().end(); ++it) {
+      OptimizableGraph::Edge* e = static_cast<OptimizableGraph::Edge*>(*it);
+      if (e->chi2() > 5.991) {
+        e->setLevel(1);
+        ++numOutliers;
+      }
+    }
+    EXPECT_GT(numOutliers, 0);
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(3);
+
+    if (newSolver) {
+      OptimizationAlgorithm* solver = optimizer.solver();
+      optimizer.setAlgorithm(levenberg());
+      delete solver;
+    }
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(3);
+    return estimates(optimizer);
+  }
+
+} // namespace
+
+TEST(SparseOptimizer, ParallelLinearizationMatchesSequential)
+{
+  const std::vector<double> sequential = bundleAdjustment(SparseOptimizer::ParallelFor());
+  const std::vector<double> parallel = bundleAdjustment(threadedFor(4));
+  ASSERT_EQ(parallel.size(), sequential.size());
+  for (size_t i = 0; i < sequential.size(); ++i)
+    EXPECT_NEAR(parallel[i], sequential[i], 1e-9 * (1. + std::abs(sequential[i])));
+}
+
+TEST(SparseOptimizer, ParallelLinearizationIsDeterministic)
+{
+  const std::vector<double> reference = bundleAdjustment(threadedFor(1));
+  for (int numThreads = 2; numThreads <= 8; numThreads *= 2)
+    EXPECT_EQ(bundleAdjustment(threadedFor(numThreads)), reference);
+}
+
+TEST(SparseOptimizer, StructureIsKeptBetweenOptimizations)
+{
+  EXPECT_EQ(roundsOfBundleAdjustment(SparseOptimizer::ParallelFor(), false), roundsOfBundleAdjustment(SparseOptimizer::ParallelFor(), true));
+  EXPECT_EQ(roundsOfBundleAdjustment(threadedFor(4), false), roundsOfBundleAdjustment(threadedFor(4), true));
+}
@@ -36,6 +36,7 @@
 
 #include "../core/eigen_types.h"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -96,8 +97,11 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
       if (_init)
         _sparseMatrix.resize(A.rows(), A.cols());
       fillSparseMatrix(A, !_init);
-      if (_init) // compute the symbolic composition once
+      if (_init && ! samePattern()) { // compute the symbolic composition once per pattern
         computeSymbolicDecomposition(A);
+        _patternOuter.assign(_sparseMatrix.outerIndexPtr(), _sparseMatrix.outerIndexPtr() + _sparseMatrix.outerSize() + 1);
+        _patternInner.assign(_sparseMatrix.innerIndexPtr(), _sparseMatrix.innerIndexPtr() + _sparseMatrix.nonZeros());
+      }
       _init = false;
 
       double t=get_monotonic_time();
@@ -125,7 +129,7 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
 
     //! do the AMD ordering on the blocks or on the scalar matrix
     bool blockOrdering() const { return _blockOrdering;}
-    void setBlockOrdering(bool blockOrdering) { _blockOrdering = blockOrdering;}
+    void setBlockOrdering(bool blockOrdering) { _blockOrdering = blockOrdering; _patternOuter.clear();}
 
     //! write a debug dump of the system matrix if it is not SPD in solve
     virtual bool writeDebug() const { return _writeDebug;}
@@ -137,6 +141,17 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
     bool _writeDebug;
     SparseMatrix _sparseMatrix;
     CholeskyDecomposition _cholesky;
+    //! the pattern of the last symbolic decomposition, kept over init() for a graph with the same structure
+    std::vector<int> _patternOuter;
+    std::vector<int> _patternInner;
+
+    bool samePattern() const
+    {
+      return _patternOuter.size() == static_cast<size_t>(_sparseMatrix.outerSize() + 1)
+        && _patternInner.size() == static_cast<size_t>(_sparseMatrix.nonZeros())
+        && std::equal(_patternOuter.begin(), _patternOuter.end(), _sparseMatrix.outerIndexPtr())
+        && std::equal(_patternInner.begin(), _patternInner.end(), _sparseMatrix.innerIndexPtr());
+    }
 
     /**
      * compute the symbolic decompostion of the matrix only once.
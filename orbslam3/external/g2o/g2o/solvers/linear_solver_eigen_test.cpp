@@ -0,0 +1,116 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "linear_solver_eigen.h"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+using namespace g2o;
+using namespace Eigen;
+
+namespace {
+
+  const int numBlocks = 4, blockSize = 2;
+
+  /**
+   * upper triangle of a block tridiagonal SPD matrix with the given
+   * off-diagonal blocks, scaled by s
+   */
+  void fill(SparseBlockMatrix<MatrixXd>& A, MatrixXd& dense, const std::vector<std::pair<int, int> >& offDiagonal, double s)
+  {
+    dense.setZero(numBlocks * blockSize, numBlocks * blockSize);
+    for (int i = 0; i < numBlocks; ++i) {
+      MatrixXd& m = *A.block(i, i, true);
+      m << 4. * s + i, 1., 1., 5. * s;
+      dense.block(i * blockSize, i * blockSize, blockSize, blockSize) = m;
+    }
+    for (size_t k = 0; k < offDiagonal.size(); ++k) {
+      const int r = offDiagonal[k].first, c = offDiagonal[k].second;
+      MatrixXd& m = *A.block(r, c, true);
+      m << 0.5, -0.25 * s, 0.125, 0.5 * s;
+      dense.block(r * blockSize, c * blockSize, blockSize, blockSize) = m;
+      dense.block(c * blockSize, r * blockSize, blockSize, blockSize) = m.transpose();
+    }
+  }
+
+  //! the solution of A x = b, with the time of the symbolic decomposition in symbolic, -1 if skipped
+  VectorXd solve(LinearSolverEigen<MatrixXd>& solver, const std::vector<std::pair<int, int> >& offDiagonal, double s, double& symbolic)
+  {
+    int blockIndices[numBlocks];
+    for (int i = 0; i < numBlocks; ++i)
+      blockIndices[i] = (i + 1) * blockSize;
+    SparseBlockMatrix<MatrixXd> A(blockIndices, blockIndices, numBlocks, numBlocks);
+    MatrixXd dense;
+    fill(A, dense, offDiagonal, s);
+
+    VectorXd b = VectorXd::LinSpaced(numBlocks * blockSize, 1., 2.);
+    VectorXd x(b.size());
+    G2OBatchStatistics stats;
+    stats.timeSymbolicDecomposition = -1.;
+    G2OBatchStatistics::setGlobalStats(&stats);
+    solver.init();
+    EXPECT_TRUE(solver.solve(A, x.data(), b.data()));
+    G2OBatchStatistics::setGlobalStats(0);
+    symbolic = stats.timeSymbolicDecomposition;
+
+    EXPECT_LT((dense * x - b).norm(), 1e-12);
+    return x;
+  }
+
+} // namespace
+
+TEST(LinearSolverEigen, SymbolicDecompositionIsKeptForTheSamePattern)
+{
+  std::vector<std::pair<int, int> > chain;
+  chain.push_back(std::make_pair(0, 1));
+  chain.push_back(std::make_pair(1, 2));
+  std::vector<std::pair<int, int> > moreBlocks = chain;
+  moreBlocks.push_back(std::make_pair(0, 3));
+
+  for (int blockOrdering = 0; blockOrdering < 2; ++blockOrdering) {
+    LinearSolverEigen<MatrixXd> solver;
+    solver.setBlockOrdering(blockOrdering);
+    double symbolic;
+    solve(solver, chain, 1., symbolic);
+    EXPECT_GE(symbolic, 0.);
+
+    // new values on the same pattern reuse the decomposition
+    const VectorXd x = solve(solver, chain, 2., symbolic);
+    EXPECT_EQ(symbolic, -1.);
+    LinearSolverEigen<MatrixXd> fresh;
+    fresh.setBlockOrdering(blockOrdering);
+    EXPECT_EQ(solve(fresh, chain, 2., symbolic), x);
+
+    // a new block redoes it
+    solve(solver, moreBlocks, 2., symbolic);
+    EXPECT_GE(symbolic, 0.);
+    solve(solver, moreBlocks, 3., symbolic);
+    EXPECT_EQ(symbolic, -1.);
+  }
+}